@@ -195,6 +195,7 @@ std::string AsyncFizzClientT<SM>::getApplicationProtocol() const noexcept {
 template <typename SM>
 void AsyncFizzClientT<SM>::close() {
   if (transport_->good()) {
+    flushCoalescedWrites();
     fizzClient_.appCloseImmediate();
   } else {
     DelayedDestruction::DestructorGuard dg(this);
@@ -320,6 +321,38 @@ void AsyncFizzClientT<SM>::transportDataAvailable() {
   fizzClient_.newTransportData();
 }
 
+template <typename SM>
+void AsyncFizzClientT<SM>::updateWriteRecordLayer() {
+  if (isKTLSOffloaded()) {
+    // A key update installed a new user space write record layer; move the
+    // kernel over to its key instead.
+    auto params =
+        KTLS::getWriteParams(getState(), AppTrafficSecrets::ClientAppTraffic);
+    if (params) {
+      rekeyKTLS(std::move(*params));
+      state_.writeRecordLayer() = std::make_unique<KTLSWriteRecordLayer>();
+    }
+    return;
+  }
+  configureWriteRecordLayer(state_.writeRecordLayer().get());
+}
+
+template <typename SM>
+bool AsyncFizzClientT<SM>::offloadWriteRecordLayer(int fd) {
+  if (fizzClient_.actionProcessing() ||
+      getState().state() != StateEnum::Established) {
+    return false;
+  }
+  auto params =
+      KTLS::getWriteParams(getState(), AppTrafficSecrets::ClientAppTraffic);
+  if (!params) {
+    return false;
+  }
+  KTLS::enableTx(fd, *params);
+  state_.writeRecordLayer() = std::make_unique<KTLSWriteRecordLayer>();
+  return true;
+}
+
 template <typename SM>
 void AsyncFizzClientT<SM>::deliverAllErrors(
     const folly::AsyncSocketException& ex,
@@ -339,6 +372,7 @@ void AsyncFizzClientT<SM>::deliverAllErrors(
     }
   }
   fizzClient_.moveToErrorState(ex);
+  failCoalescedWrites(ex);
   deliverError(ex, closeTransport);
 }
 
@@ -380,6 +414,10 @@ void AsyncFizzClientT<SM>::ActionMoveVisitor::operator()(DeliverAppData& data) {
 template <typename SM>
 void AsyncFizzClientT<SM>::ActionMoveVisitor::operator()(WriteToSocket& data) {
   DCHECK(!data.contents.empty());
+  if (client_.isKTLSOffloaded()) {
+    client_.writeToKTLSSocket(data);
+    return;
+  }
   Buf allData = std::move(data.contents.front().data);
   for (size_t i = 1; i < data.contents.size(); ++i) {
     allData->prependChain(std::move(data.contents[i].data));
@@ -474,6 +512,7 @@ void AsyncFizzClientT<SM>::ActionMoveVisitor::operator()(
     client_.replaySafetyCallback_ = nullptr;
     callback->onReplaySafe();
   }
+  client_.startKTLSOffload();
 }
 
 template <typename SM>
@@ -513,6 +552,7 @@ void AsyncFizzClientT<SM>::ActionMoveVisitor::operator()(WaitForData&) {
 template <typename SM>
 void AsyncFizzClientT<SM>::ActionMoveVisitor::operator()(MutateState& mutator) {
   mutator(client_.state_);
+  client_.updateWriteRecordLayer();
 }
 
 template <typename SM>
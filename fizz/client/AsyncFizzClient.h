@@ -148,6 +148,10 @@ class AsyncFizzClientT : public AsyncFizzBase,
 
   void transportDataAvailable() override;
 
+  void updateWriteRecordLayer() override;
+
+  bool offloadWriteRecordLayer(int fd) override;
+
  private:
   void deliverAllErrors(
       const folly::AsyncSocketException& ex,
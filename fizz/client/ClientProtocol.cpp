@@ -655,7 +655,7 @@ EventHandler<ClientTypes, StateEnum::Uninitialized, Event::Connect>::handle(
     if (earlyDataParams) {
       auto earlyWriteSecret = keyScheduler->getSecret(
           EarlySecrets::ClientEarlyTraffic,
-          handshakeContext->getHandshakeContext()->coalesce());
+          handshakeContext->getHandshakeContextRange());
       if (!context->getOmitEarlyRecordLayer()) {
         earlyWriteRecordLayer =
             context->getFactory()->makeEncryptedWriteRecordLayer(
@@ -672,7 +672,7 @@ EventHandler<ClientTypes, StateEnum::Uninitialized, Event::Connect>::handle(
 
       auto earlyExporterVector = keyScheduler->getSecret(
           EarlySecrets::EarlyExporter,
-          handshakeContext->getHandshakeContext()->coalesce());
+          handshakeContext->getHandshakeContextRange());
       earlyDataParams->earlyExporterSecret =
           folly::IOBuf::copyBuffer(folly::range(earlyExporterVector.secret));
 
@@ -987,7 +987,7 @@ EventHandler<ClientTypes, StateEnum::ExpectingServerHello, Event::ServerHello>::
   handshakeWriteRecordLayer->setProtocolVersion(version);
   auto handshakeWriteSecret = scheduler->getSecret(
       HandshakeSecrets::ClientHandshakeTraffic,
-      handshakeContext->getHandshakeContext()->coalesce());
+      handshakeContext->getHandshakeContextRange());
   Protocol::setAead(
       *handshakeWriteRecordLayer,
       cipher,
@@ -1001,7 +1001,7 @@ EventHandler<ClientTypes, StateEnum::ExpectingServerHello, Event::ServerHello>::
   handshakeReadRecordLayer->setProtocolVersion(version);
   auto handshakeReadSecret = scheduler->getSecret(
       HandshakeSecrets::ServerHandshakeTraffic,
-      handshakeContext->getHandshakeContext()->coalesce());
+      handshakeContext->getHandshakeContextRange());
   Protocol::setAead(
       *handshakeReadRecordLayer,
       cipher,
@@ -1527,7 +1527,7 @@ Actions EventHandler<
   leaf->verify(
       certVerify.algorithm,
       CertificateVerifyContext::Server,
-      state.handshakeContext()->getHandshakeContext()->coalesce(),
+      state.handshakeContext()->getHandshakeContextRange(),
       certVerify.signature->coalesce());
 
   if (state.verifier()) {
@@ -1600,7 +1600,7 @@ EventHandler<ClientTypes, StateEnum::ExpectingFinished, Event::Finished>::
       break;
     case ClientAuthType::Sent: {
       auto selectedCert = state.selectedClientCert();
-      encodedCertMessage = encodeHandshake(selectedCert->getCertMessage());
+      encodedCertMessage = selectedCert->getEncodedCertMessage();
       state.handshakeContext()->appendToTranscript(*encodedCertMessage);
 
       auto sigScheme = *state.clientAuthSigScheme();
@@ -1632,7 +1632,7 @@ EventHandler<ClientTypes, StateEnum::ExpectingFinished, Event::Finished>::
       state.keyScheduler()
           ->getSecret(
               MasterSecrets::ResumptionMaster,
-              state.handshakeContext()->getHandshakeContext()->coalesce())
+              state.handshakeContext()->getHandshakeContextRange())
           .secret));
 
   WriteToSocket clientFlight;
@@ -30,32 +30,10 @@ inline std::unique_ptr<folly::IOBuf> HkdfImpl<Hash>::expand(
   if (UNLIKELY(outputBytes > 255 * Hash::HashLen)) {
     throw std::runtime_error("Output too long");
   }
-  // HDKF expansion step.
-  size_t numRounds = (outputBytes + Hash::HashLen - 1) / Hash::HashLen;
-  auto expanded = folly::IOBuf::create(numRounds * Hash::HashLen);
-
-  auto in = folly::IOBuf::create(0);
-  for (size_t round = 1; round <= numRounds; ++round) {
-    in->prependChain(info.clone());
-    // We're guaranteed that the round num will fit in
-    // one byte because of the check at the beginning of
-    // the method.
-    auto roundNum = folly::IOBuf::create(1);
-    roundNum->append(1);
-    roundNum->writableData()[0] = round;
-    in->prependChain(std::move(roundNum));
-
-    size_t outputStartIdx = (round - 1) * Hash::HashLen;
-    Hash::hmac(
-        folly::range(extractedKey),
-        *in,
-        {expanded->writableData() + outputStartIdx, Hash::HashLen});
-    expanded->append(Hash::HashLen);
-
-    in = expanded->clone();
-    in->trimStart(outputStartIdx);
-  }
-  expanded->trimEnd(numRounds * Hash::HashLen - outputBytes);
+  auto expanded = folly::IOBuf::create(outputBytes);
+  expanded->append(outputBytes);
+  KeyedHkdf<Hash>(extractedKey)
+      .expand(info, {expanded->writableData(), outputBytes});
   return expanded;
 }
 
@@ -67,4 +45,111 @@ inline std::unique_ptr<folly::IOBuf> HkdfImpl<Hash>::hkdf(
     size_t outputBytes) const {
   return expand(folly::range(extract(salt, ikm)), info, outputBytes);
 }
+
+template <typename Hash>
+KeyedHkdf<Hash>::KeyedHkdf(folly::ByteRange prk) : ctx_(HMAC_CTX_new()) {
+  CHECK_EQ(prk.size(), Hash::HashLen);
+  if (!ctx_ ||
+      HMAC_Init_ex(
+          ctx_.get(), prk.data(), prk.size(), Hash::HashEngine(), nullptr) !=
+          1) {
+    throw std::runtime_error("Failed to key HMAC");
+  }
+}
+
+template <typename Hash>
+void KeyedHkdf<Hash>::expand(
+    const folly::IOBuf& info,
+    folly::MutableByteRange out) {
+  expandImpl(
+      [this, &info]() {
+        for (auto range : info) {
+          if (HMAC_Update(ctx_.get(), range.data(), range.size()) != 1) {
+            return false;
+          }
+        }
+        return true;
+      },
+      out);
+}
+
+template <typename Hash>
+void KeyedHkdf<Hash>::expand(
+    folly::ByteRange info,
+    folly::MutableByteRange out) {
+  expandImpl(
+      [this, info]() {
+        return HMAC_Update(ctx_.get(), info.data(), info.size()) == 1;
+      },
+      out);
+}
+
+template <typename Hash>
+void KeyedHkdf<Hash>::expandLabel(
+    folly::StringPiece labelPrefix,
+    folly::StringPiece label,
+    folly::ByteRange context,
+    folly::MutableByteRange out) {
+  auto labelLength = labelPrefix.size() + label.size();
+  if (labelLength > 0xff) {
+    throw std::runtime_error("HkdfLabel too long");
+  }
+  std::array<uint8_t, 1 + 0xff> encodedLabel;
+  encodedLabel[0] = static_cast<uint8_t>(labelLength);
+  memcpy(encodedLabel.data() + 1, labelPrefix.data(), labelPrefix.size());
+  memcpy(
+      encodedLabel.data() + 1 + labelPrefix.size(), label.data(), label.size());
+  expandEncodedLabel(
+      folly::ByteRange(encodedLabel.data(), 1 + labelLength), context, out);
+}
+
+template <typename Hash>
+void KeyedHkdf<Hash>::expandEncodedLabel(
+    folly::ByteRange encodedLabel,
+    folly::ByteRange context,
+    folly::MutableByteRange out) {
+  if (context.size() > 0xff || out.size() > 0xffff) {
+    throw std::runtime_error("HkdfLabel too long");
+  }
+  // Hashed in pieces, in the order encodeHkdfLabel() writes them.
+  const uint8_t length[] = {static_cast<uint8_t>(out.size() >> 8),
+                            static_cast<uint8_t>(out.size())};
+  const uint8_t contextLength = static_cast<uint8_t>(context.size());
+  expandImpl(
+      [this, &length, &contextLength, encodedLabel, context]() {
+        return HMAC_Update(ctx_.get(), length, sizeof(length)) == 1 &&
+            HMAC_Update(
+                ctx_.get(), encodedLabel.data(), encodedLabel.size()) == 1 &&
+            HMAC_Update(ctx_.get(), &contextLength, 1) == 1 &&
+            HMAC_Update(ctx_.get(), context.data(), context.size()) == 1;
+      },
+      out);
+}
+
+template <typename Hash>
+template <typename UpdateInfo>
+void KeyedHkdf<Hash>::expandImpl(
+    UpdateInfo&& updateInfo,
+    folly::MutableByteRange out) {
+  if (UNLIKELY(out.size() > 255 * Hash::HashLen)) {
+    throw std::runtime_error("Output too long");
+  }
+  // T(i) = HMAC(prk, T(i - 1) | info | i)
+  std::array<uint8_t, Hash::HashLen> block;
+  size_t offset = 0;
+  for (uint8_t round = 1; offset < out.size(); ++round) {
+    // Passing no key or digest restarts from the pads computed when keying.
+    if (HMAC_Init_ex(ctx_.get(), nullptr, 0, nullptr, nullptr) != 1 ||
+        (offset > 0 &&
+         HMAC_Update(ctx_.get(), block.data(), block.size()) != 1) ||
+        !updateInfo() || HMAC_Update(ctx_.get(), &round, 1) != 1 ||
+        HMAC_Final(ctx_.get(), block.data(), nullptr) != 1) {
+      throw std::runtime_error("HMAC failed");
+    }
+    auto length = std::min(block.size(), out.size() - offset);
+    memcpy(out.data() + offset, block.data(), length);
+    offset += length;
+  }
+  CryptoUtils::clean(folly::range(block));
+}
 } // namespace fizz
@@ -8,7 +8,12 @@
 
 #pragma once
 
+#include <fizz/crypto/Utils.h>
 #include <folly/io/IOBuf.h>
+#include <folly/portability/OpenSSL.h>
+#include <folly/ssl/OpenSSLPtrTypes.h>
+
+#include <array>
 
 namespace fizz {
 /**
@@ -46,6 +51,7 @@ class Hkdf {
  *
  * The template struct requires the following parameters:
  *   - HashLen: length of the hash digest
+ *   - HashEngine: function returning EVP_MD* to use
  *   - hmac(ByteRange key, const IOBuf& in, MutableByteRange out)
  */
 template <typename Hash>
@@ -71,6 +77,60 @@ class HkdfImpl : public Hkdf {
     return HashLen;
   }
 };
+
+/**
+ * HKDF-Expand keyed with a single pseudorandom key.
+ *
+ * The HMAC key schedule (the hashed inner and outer pads) is computed once
+ * when the object is created and reused for every expansion, and expansions
+ * are done on the stack without allocating. This is worth it when several
+ * labels are expanded from the same secret, like a traffic key and iv.
+ *
+ * The template struct requires HashLen and HashEngine, as in Sha.
+ */
+template <typename Hash>
+class KeyedHkdf {
+ public:
+  static constexpr size_t HashLen = Hash::HashLen;
+
+  /**
+   * prk must be HashLen bytes.
+   */
+  explicit KeyedHkdf(folly::ByteRange prk);
+
+  /**
+   * Fills out with HKDF-Expand(prk, info, out.size()).
+   */
+  void expand(const folly::IOBuf& info, folly::MutableByteRange out);
+
+  void expand(folly::ByteRange info, folly::MutableByteRange out);
+
+  /**
+   * Fills out with HKDF-Expand-Label(prk, label, context, out.size()) as
+   * defined by TLS 1.3, where labelPrefix is prepended to label.
+   */
+  void expandLabel(
+      folly::StringPiece labelPrefix,
+      folly::StringPiece label,
+      folly::ByteRange context,
+      folly::MutableByteRange out);
+
+  /**
+   * As expandLabel(), with the prefix and label already encoded, length byte
+   * included, as by encodeHkdfLabelName(). Only encodedLabel and context are
+   * hashed; nothing is copied.
+   */
+  void expandEncodedLabel(
+      folly::ByteRange encodedLabel,
+      folly::ByteRange context,
+      folly::MutableByteRange out);
+
+ private:
+  template <typename UpdateInfo>
+  void expandImpl(UpdateInfo&& updateInfo, folly::MutableByteRange out);
+
+  folly::ssl::HmacCtxUniquePtr ctx_;
+};
 } // namespace fizz
 
 #include <fizz/crypto/Hkdf-inl.h>
@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/Types.h>
+#include <folly/Range.h>
+
+#include <stdexcept>
+
+namespace fizz {
+
+/**
+ * The label of an HkdfLabel, prefix included, encoded as opaque<7..255>:
+ * a length byte followed by the prefix and label.
+ */
+struct EncodedHkdfLabel {
+  // Enough for the TLS 1.3 labels under any reasonable prefix.
+  static constexpr size_t kMaxSize = 64;
+
+  // The label without its prefix.
+  folly::StringPiece label;
+  size_t size;
+  uint8_t data[kMaxSize];
+
+  folly::ByteRange encoded() const {
+    return folly::ByteRange(data, size);
+  }
+};
+
+/**
+ * Encodes prefix and label as they appear in an HkdfLabel. Usable in constant
+ * expressions, where a label that doesn't fit fails to compile.
+ */
+constexpr EncodedHkdfLabel encodeHkdfLabelName(
+    folly::StringPiece prefix,
+    folly::StringPiece label) {
+  if (1 + prefix.size() + label.size() > EncodedHkdfLabel::kMaxSize) {
+    throw std::logic_error("label too long");
+  }
+  EncodedHkdfLabel encoded{label, 1 + prefix.size() + label.size(), {}};
+  encoded.data[0] = static_cast<uint8_t>(prefix.size() + label.size());
+  for (size_t i = 0; i < prefix.size(); ++i) {
+    encoded.data[1 + i] = static_cast<uint8_t>(prefix[i]);
+  }
+  for (size_t i = 0; i < label.size(); ++i) {
+    encoded.data[1 + prefix.size() + i] = static_cast<uint8_t>(label[i]);
+  }
+  return encoded;
+}
+
+/**
+ * The default "tls13 " prefix. A custom prefix is a struct like this one,
+ * with a constexpr value() returning the prefix.
+ */
+struct Tls13HkdfLabelPrefix {
+  static constexpr folly::StringPiece value() {
+    return kHkdfLabelPrefix;
+  }
+};
+
+/**
+ * Every label TLS 1.3 expands, encoded under Prefix at compile time.
+ */
+template <class Prefix = Tls13HkdfLabelPrefix>
+struct HkdfLabelTable {
+  static constexpr EncodedHkdfLabel kLabels[] = {
+      encodeHkdfLabelName(Prefix::value(), "key"),
+      encodeHkdfLabelName(Prefix::value(), "iv"),
+      encodeHkdfLabelName(Prefix::value(), "finished"),
+      encodeHkdfLabelName(Prefix::value(), "derived"),
+      encodeHkdfLabelName(Prefix::value(), "ext binder"),
+      encodeHkdfLabelName(Prefix::value(), "res binder"),
+      encodeHkdfLabelName(Prefix::value(), "c e traffic"),
+      encodeHkdfLabelName(Prefix::value(), "e exp master"),
+      encodeHkdfLabelName(Prefix::value(), "c hs traffic"),
+      encodeHkdfLabelName(Prefix::value(), "s hs traffic"),
+      encodeHkdfLabelName(Prefix::value(), "c ap traffic"),
+      encodeHkdfLabelName(Prefix::value(), "s ap traffic"),
+      encodeHkdfLabelName(Prefix::value(), "exp master"),
+      encodeHkdfLabelName(Prefix::value(), "res master"),
+      encodeHkdfLabelName(Prefix::value(), "traffic upd"),
+      encodeHkdfLabelName(Prefix::value(), "resumption"),
+      encodeHkdfLabelName(Prefix::value(), "exporter"),
+  };
+
+  /**
+   * Returns the encoding of label, or nullptr if it isn't in the table.
+   */
+  static const EncodedHkdfLabel* find(folly::StringPiece label) {
+    for (const auto& encoded : kLabels) {
+      if (encoded.label == label) {
+        return &encoded;
+      }
+    }
+    return nullptr;
+  }
+};
+
+template <class Prefix>
+constexpr EncodedHkdfLabel HkdfLabelTable<Prefix>::kLabels[];
+} // namespace fizz
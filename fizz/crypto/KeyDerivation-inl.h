@@ -8,9 +8,76 @@
 
 namespace fizz {
 
+inline std::vector<uint8_t> KeyDerivation::noPskDerivedSecret() {
+  auto zeros = std::vector<uint8_t>(hashLength(), 0);
+  auto earlySecret = hkdfExtract(folly::range(zeros), folly::range(zeros));
+  return deriveSecret(folly::range(earlySecret), "derived", blankHash());
+}
+
 template <typename Hash>
 KeyDerivationImpl<Hash>::KeyDerivationImpl(const std::string& labelPrefix)
-    : labelPrefix_(labelPrefix) {}
+    : labelPrefix_(labelPrefix) {
+  if (folly::StringPiece(labelPrefix_) == Tls13HkdfLabelPrefix::value()) {
+    findLabel_ = &HkdfLabelTable<>::find;
+    noPskDerivedSecret_ = &getNoPskDerivedSecret<Tls13HkdfLabelPrefix>;
+  }
+}
+
+template <typename Hash>
+template <class Prefix>
+KeyDerivationImpl<Hash>::KeyDerivationImpl(HkdfLabelTable<Prefix>)
+    : labelPrefix_(Prefix::value().str()),
+      findLabel_(&HkdfLabelTable<Prefix>::find),
+      noPskDerivedSecret_(&getNoPskDerivedSecret<Prefix>) {}
+
+template <typename Hash>
+template <class Prefix>
+const std::vector<uint8_t>& KeyDerivationImpl<Hash>::getNoPskDerivedSecret() {
+  static const std::vector<uint8_t> secret =
+      KeyDerivationImpl<Hash>(HkdfLabelTable<Prefix>())
+          .KeyDerivation::noPskDerivedSecret();
+  return secret;
+}
+
+template <typename Hash>
+std::vector<uint8_t> KeyDerivationImpl<Hash>::noPskDerivedSecret() {
+  if (noPskDerivedSecret_) {
+    return noPskDerivedSecret_();
+  }
+  return KeyDerivation::noPskDerivedSecret();
+}
+
+template <typename Hash>
+KeyDerivationImpl<Hash>::~KeyDerivationImpl() {
+  CryptoUtils::clean(folly::range(keyedSecret_));
+}
+
+template <typename Hash>
+KeyedHkdf<Hash>& KeyDerivationImpl<Hash>::getKeyedHkdf(
+    folly::ByteRange secret) {
+  CHECK_EQ(secret.size(), Hash::HashLen);
+  if (!keyedHkdf_ ||
+      !CryptoUtils::equal(secret, folly::range(keyedSecret_))) {
+    keyedHkdf_ = std::make_unique<KeyedHkdf<Hash>>(secret);
+    memcpy(keyedSecret_.data(), secret.data(), secret.size());
+  }
+  return *keyedHkdf_;
+}
+
+template <typename Hash>
+void KeyDerivationImpl<Hash>::expandLabelInto(
+    folly::ByteRange secret,
+    folly::StringPiece label,
+    folly::ByteRange context,
+    folly::MutableByteRange out) {
+  auto& hkdf = getKeyedHkdf(secret);
+  auto encoded = findLabel_ ? findLabel_(label) : nullptr;
+  if (encoded) {
+    hkdf.expandEncodedLabel(encoded->encoded(), context, out);
+  } else {
+    hkdf.expandLabel(labelPrefix_, label, context, out);
+  }
+}
 
 template <typename Hash>
 Buf KeyDerivationImpl<Hash>::expandLabel(
@@ -18,10 +85,14 @@ Buf KeyDerivationImpl<Hash>::expandLabel(
     folly::StringPiece label,
     Buf hashValue,
     uint16_t length) {
-  HkdfLabel hkdfLabel = {
-      length, std::string(label.begin(), label.end()), std::move(hashValue)};
-  return HkdfImpl<Hash>().expand(
-      secret, *encodeHkdfLabel(std::move(hkdfLabel), labelPrefix_), length);
+  auto out = folly::IOBuf::create(length);
+  out->append(length);
+  expandLabelInto(
+      secret,
+      label,
+      hashValue ? hashValue->coalesce() : folly::ByteRange(),
+      {out->writableData(), length});
+  return out;
 }
 
 template <typename Hash>
@@ -29,7 +100,10 @@ Buf KeyDerivationImpl<Hash>::hkdfExpand(
     folly::ByteRange secret,
     Buf info,
     uint16_t length) {
-  return HkdfImpl<Hash>().expand(secret, *info, length);
+  auto out = folly::IOBuf::create(length);
+  out->append(length);
+  getKeyedHkdf(secret).expand(*info, {out->writableData(), length});
+  return out;
 }
 
 template <typename Hash>
@@ -39,17 +113,8 @@ std::vector<uint8_t> KeyDerivationImpl<Hash>::deriveSecret(
     folly::ByteRange messageHash) {
   CHECK_EQ(secret.size(), Hash::HashLen);
   CHECK_EQ(messageHash.size(), Hash::HashLen);
-  // Copying the buffer to avoid violating constness of the data.
-  auto hashBuf = folly::IOBuf::copyBuffer(messageHash);
-  auto out = expandLabel(secret, label, std::move(hashBuf), Hash::HashLen);
   std::vector<uint8_t> prk(Hash::HashLen);
-  size_t offset = 0;
-  for (auto buf : *out) {
-    size_t remaining = Hash::HashLen - offset;
-    size_t length = std::min(buf.size(), remaining);
-    memcpy(prk.data() + offset, buf.data(), length);
-    offset += length;
-  }
+  expandLabelInto(secret, label, messageHash, folly::range(prk));
   return prk;
 }
 } // namespace fizz
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <fizz/crypto/Hkdf.h>
+#include <fizz/crypto/HkdfLabels.h>
 #include <fizz/record/Types.h>
 
 namespace fizz {
@@ -54,15 +55,46 @@ class KeyDerivation {
       folly::ByteRange key,
       const folly::IOBuf& in,
       folly::MutableByteRange out) = 0;
+
+  /**
+   * Returns Derive-Secret(HKDF-Extract(0, 0), "derived", ""), the salt the
+   * handshake secret is extracted with when no PSK is used. It is the same
+   * for every such handshake, so implementations may compute it once.
+   */
+  virtual std::vector<uint8_t> noPskDerivedSecret();
 };
 
+/**
+ * KeyDerivation implementation using a templated hash.
+ *
+ * Expansions reuse the HMAC key schedule of the last secret expanded from, so
+ * expanding several labels from the same secret in a row (a traffic key and
+ * iv, or the client and server traffic secrets) only keys HMAC once.
+ *
+ * Labels used by TLS 1.3 are hashed from encodings computed at compile time
+ * (see HkdfLabelTable) rather than being encoded on every call.
+ */
 template <typename Hash>
 class KeyDerivationImpl : public KeyDerivation {
  public:
-  ~KeyDerivationImpl() override = default;
+  ~KeyDerivationImpl() override;
 
+  /**
+   * Uses HkdfLabelTable<> when labelPrefix is the default prefix, and encodes
+   * labels as they are expanded otherwise.
+   */
   KeyDerivationImpl(const std::string& labelPrefix);
 
+  /**
+   * Uses the encodings in HkdfLabelTable<Prefix> for a custom prefix, eg
+   * KeyDerivationImpl<Sha256>(HkdfLabelTable<MyPrefix>()).
+   */
+  template <class Prefix>
+  explicit KeyDerivationImpl(HkdfLabelTable<Prefix>);
+
+  KeyDerivationImpl(KeyDerivationImpl&&) = default;
+  KeyDerivationImpl& operator=(KeyDerivationImpl&&) = default;
+
   size_t hashLength() const override {
     return Hash::HashLen;
   }
@@ -101,8 +133,29 @@ class KeyDerivationImpl : public KeyDerivation {
     return HkdfImpl<Hash>().extract(salt, ikm);
   }
 
+  /**
+   * Computed once per process for prefixes with a label table.
+   */
+  std::vector<uint8_t> noPskDerivedSecret() override;
+
  private:
+  template <class Prefix>
+  static const std::vector<uint8_t>& getNoPskDerivedSecret();
+
+  KeyedHkdf<Hash>& getKeyedHkdf(folly::ByteRange secret);
+
+  void expandLabelInto(
+      folly::ByteRange secret,
+      folly::StringPiece label,
+      folly::ByteRange context,
+      folly::MutableByteRange out);
+
   std::string labelPrefix_;
+  const EncodedHkdfLabel* (*findLabel_)(folly::StringPiece label){nullptr};
+  const std::vector<uint8_t>& (*noPskDerivedSecret_)(){nullptr};
+
+  std::array<uint8_t, Hash::HashLen> keyedSecret_;
+  std::unique_ptr<KeyedHkdf<Hash>> keyedHkdf_;
 };
 } // namespace fizz
 
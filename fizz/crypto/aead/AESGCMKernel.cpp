@@ -0,0 +1,688 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/aead/AESGCMKernel.h>
+
+#include <fizz/crypto/Utils.h>
+#include <folly/CpuId.h>
+#include <folly/Portability.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if FOLLY_X64 && !defined(_MSC_VER)
+#define FIZZ_HAVE_AESGCM_KERNEL 1
+#include <immintrin.h>
+#else
+#define FIZZ_HAVE_AESGCM_KERNEL 0
+#endif
+
+namespace fizz {
+
+constexpr size_t AESGCMKernel::kBlockSize;
+constexpr size_t AESGCMKernel::kIVLength;
+constexpr size_t AESGCMKernel::kTagLength;
+
+#if FIZZ_HAVE_AESGCM_KERNEL
+
+#define FIZZ_AESGCM_TARGET __attribute__((target("aes,pclmul,ssse3")))
+
+namespace {
+
+FIZZ_AESGCM_TARGET inline __m128i load(const uint8_t* in) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+}
+
+FIZZ_AESGCM_TARGET inline void store(uint8_t* out, __m128i block) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), block);
+}
+
+// Reverses all 16 bytes, converting between the wire and the bit reflected
+// GHASH representation.
+FIZZ_AESGCM_TARGET inline __m128i byteSwap(__m128i block) {
+  return _mm_shuffle_epi8(
+      block,
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// Reverses the last 4 bytes so that the big endian block counter can be
+// incremented with a 32 bit add. The mask is its own inverse.
+FIZZ_AESGCM_TARGET inline __m128i counterSwap(__m128i block) {
+  return _mm_shuffle_epi8(
+      block,
+      _mm_set_epi8(12, 13, 14, 15, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+FIZZ_AESGCM_TARGET inline __m128i counterOne() {
+  return _mm_set_epi32(1, 0, 0, 0);
+}
+
+FIZZ_AESGCM_TARGET inline __m128i expandAssist128(
+    __m128i key,
+    __m128i assist) {
+  assist = _mm_shuffle_epi32(assist, 0xff);
+  auto tmp = _mm_slli_si128(key, 4);
+  key = _mm_xor_si128(key, tmp);
+  tmp = _mm_slli_si128(tmp, 4);
+  key = _mm_xor_si128(key, tmp);
+  tmp = _mm_slli_si128(tmp, 4);
+  key = _mm_xor_si128(key, tmp);
+  return _mm_xor_si128(key, assist);
+}
+
+FIZZ_AESGCM_TARGET inline __m128i expandAssist256(__m128i odd, __m128i even) {
+  auto assist = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(even, 0x00), 0xaa);
+  auto tmp = _mm_slli_si128(odd, 4);
+  odd = _mm_xor_si128(odd, tmp);
+  tmp = _mm_slli_si128(tmp, 4);
+  odd = _mm_xor_si128(odd, tmp);
+  tmp = _mm_slli_si128(tmp, 4);
+  odd = _mm_xor_si128(odd, tmp);
+  return _mm_xor_si128(odd, assist);
+}
+
+FIZZ_AESGCM_TARGET void expandKey128(const uint8_t* key, uint8_t* out) {
+  __m128i k[11];
+  k[0] = load(key);
+  k[1] = expandAssist128(k[0], _mm_aeskeygenassist_si128(k[0], 0x01));
+  k[2] = expandAssist128(k[1], _mm_aeskeygenassist_si128(k[1], 0x02));
+  k[3] = expandAssist128(k[2], _mm_aeskeygenassist_si128(k[2], 0x04));
+  k[4] = expandAssist128(k[3], _mm_aeskeygenassist_si128(k[3], 0x08));
+  k[5] = expandAssist128(k[4], _mm_aeskeygenassist_si128(k[4], 0x10));
+  k[6] = expandAssist128(k[5], _mm_aeskeygenassist_si128(k[5], 0x20));
+  k[7] = expandAssist128(k[6], _mm_aeskeygenassist_si128(k[6], 0x40));
+  k[8] = expandAssist128(k[7], _mm_aeskeygenassist_si128(k[7], 0x80));
+  k[9] = expandAssist128(k[8], _mm_aeskeygenassist_si128(k[8], 0x1b));
+  k[10] = expandAssist128(k[9], _mm_aeskeygenassist_si128(k[9], 0x36));
+  for (size_t i = 0; i < 11; ++i) {
+    store(out + i * 16, k[i]);
+  }
+}
+
+FIZZ_AESGCM_TARGET void expandKey256(const uint8_t* key, uint8_t* out) {
+  __m128i k[15];
+  k[0] = load(key);
+  k[1] = load(key + 16);
+  k[2] = expandAssist128(k[0], _mm_aeskeygenassist_si128(k[1], 0x01));
+  k[3] = expandAssist256(k[1], k[2]);
+  k[4] = expandAssist128(k[2], _mm_aeskeygenassist_si128(k[3], 0x02));
+  k[5] = expandAssist256(k[3], k[4]);
+  k[6] = expandAssist128(k[4], _mm_aeskeygenassist_si128(k[5], 0x04));
+  k[7] = expandAssist256(k[5], k[6]);
+  k[8] = expandAssist128(k[6], _mm_aeskeygenassist_si128(k[7], 0x08));
+  k[9] = expandAssist256(k[7], k[8]);
+  k[10] = expandAssist128(k[8], _mm_aeskeygenassist_si128(k[9], 0x10));
+  k[11] = expandAssist256(k[9], k[10]);
+  k[12] = expandAssist128(k[10], _mm_aeskeygenassist_si128(k[11], 0x20));
+  k[13] = expandAssist256(k[11], k[12]);
+  k[14] = expandAssist128(k[12], _mm_aeskeygenassist_si128(k[13], 0x40));
+  for (size_t i = 0; i < 15; ++i) {
+    store(out + i * 16, k[i]);
+  }
+}
+
+struct RoundKeys {
+  FIZZ_AESGCM_TARGET RoundKeys(const uint8_t* roundKeys, size_t numRounds)
+      : rounds(numRounds) {
+    for (size_t i = 0; i <= rounds; ++i) {
+      keys[i] = load(roundKeys + i * 16);
+    }
+  }
+
+  __m128i keys[15];
+  size_t rounds;
+};
+
+FIZZ_AESGCM_TARGET inline __m128i aesEncrypt(
+    const RoundKeys& k,
+    __m128i block) {
+  block = _mm_xor_si128(block, k.keys[0]);
+  for (size_t i = 1; i < k.rounds; ++i) {
+    block = _mm_aesenc_si128(block, k.keys[i]);
+  }
+  return _mm_aesenclast_si128(block, k.keys[k.rounds]);
+}
+
+FIZZ_AESGCM_TARGET inline void aesEncrypt4(const RoundKeys& k, __m128i* b) {
+  b[0] = _mm_xor_si128(b[0], k.keys[0]);
+  b[1] = _mm_xor_si128(b[1], k.keys[0]);
+  b[2] = _mm_xor_si128(b[2], k.keys[0]);
+  b[3] = _mm_xor_si128(b[3], k.keys[0]);
+  for (size_t i = 1; i < k.rounds; ++i) {
+    b[0] = _mm_aesenc_si128(b[0], k.keys[i]);
+    b[1] = _mm_aesenc_si128(b[1], k.keys[i]);
+    b[2] = _mm_aesenc_si128(b[2], k.keys[i]);
+    b[3] = _mm_aesenc_si128(b[3], k.keys[i]);
+  }
+  b[0] = _mm_aesenclast_si128(b[0], k.keys[k.rounds]);
+  b[1] = _mm_aesenclast_si128(b[1], k.keys[k.rounds]);
+  b[2] = _mm_aesenclast_si128(b[2], k.keys[k.rounds]);
+  b[3] = _mm_aesenclast_si128(b[3], k.keys[k.rounds]);
+}
+
+// Accumulates the unreduced 256 bit carry-less product of a and b into lo/hi.
+FIZZ_AESGCM_TARGET inline void
+clmulAccumulate(__m128i a, __m128i b, __m128i& lo, __m128i& hi) {
+  auto low = _mm_clmulepi64_si128(a, b, 0x00);
+  auto mid = _mm_xor_si128(
+      _mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+  auto high = _mm_clmulepi64_si128(a, b, 0x11);
+  lo = _mm_xor_si128(lo, _mm_xor_si128(low, _mm_slli_si128(mid, 8)));
+  hi = _mm_xor_si128(hi, _mm_xor_si128(high, _mm_srli_si128(mid, 8)));
+}
+
+// Shifts the 256 bit product left by one bit (to account for the bit
+// reflection) and reduces it modulo x^128 + x^7 + x^2 + x + 1.
+FIZZ_AESGCM_TARGET inline __m128i reduce(__m128i lo, __m128i hi) {
+  auto carryLo = _mm_srli_epi32(lo, 31);
+  auto carryHi = _mm_srli_epi32(hi, 31);
+  lo = _mm_slli_epi32(lo, 1);
+  hi = _mm_slli_epi32(hi, 1);
+  auto carryOut = _mm_srli_si128(carryLo, 12);
+  carryHi = _mm_slli_si128(carryHi, 4);
+  carryLo = _mm_slli_si128(carryLo, 4);
+  lo = _mm_or_si128(lo, carryLo);
+  hi = _mm_or_si128(hi, carryHi);
+  hi = _mm_or_si128(hi, carryOut);
+
+  auto a = _mm_slli_epi32(lo, 31);
+  auto b = _mm_slli_epi32(lo, 30);
+  auto c = _mm_slli_epi32(lo, 25);
+  a = _mm_xor_si128(a, b);
+  a = _mm_xor_si128(a, c);
+  b = _mm_srli_si128(a, 4);
+  a = _mm_slli_si128(a, 12);
+  lo = _mm_xor_si128(lo, a);
+
+  auto d = _mm_srli_epi32(lo, 1);
+  auto e = _mm_srli_epi32(lo, 2);
+  auto f = _mm_srli_epi32(lo, 7);
+  d = _mm_xor_si128(d, e);
+  d = _mm_xor_si128(d, f);
+  d = _mm_xor_si128(d, b);
+  lo = _mm_xor_si128(lo, d);
+  return _mm_xor_si128(hi, lo);
+}
+
+FIZZ_AESGCM_TARGET inline __m128i gfmul(__m128i a, __m128i b) {
+  auto lo = _mm_setzero_si128();
+  auto hi = _mm_setzero_si128();
+  clmulAccumulate(a, b, lo, hi);
+  return reduce(lo, hi);
+}
+
+struct HashKeys {
+  FIZZ_AESGCM_TARGET explicit HashKeys(const uint8_t* hashKeys)
+      : h1(load(hashKeys)),
+        h2(load(hashKeys + 16)),
+        h3(load(hashKeys + 32)),
+        h4(load(hashKeys + 48)) {}
+
+  __m128i h1;
+  __m128i h2;
+  __m128i h3;
+  __m128i h4;
+};
+
+// Folds four (wire format) blocks into the hash with a single reduction.
+FIZZ_AESGCM_TARGET inline __m128i
+ghash4(const HashKeys& h, __m128i x, const __m128i* blocks) {
+  auto lo = _mm_setzero_si128();
+  auto hi = _mm_setzero_si128();
+  clmulAccumulate(_mm_xor_si128(x, byteSwap(blocks[0])), h.h4, lo, hi);
+  clmulAccumulate(byteSwap(blocks[1]), h.h3, lo, hi);
+  clmulAccumulate(byteSwap(blocks[2]), h.h2, lo, hi);
+  clmulAccumulate(byteSwap(blocks[3]), h.h1, lo, hi);
+  return reduce(lo, hi);
+}
+
+FIZZ_AESGCM_TARGET void initHashKeys(
+    const uint8_t* roundKeys,
+    size_t rounds,
+    uint8_t* hashKeys) {
+  RoundKeys k(roundKeys, rounds);
+  auto h1 = byteSwap(aesEncrypt(k, _mm_setzero_si128()));
+  auto h2 = gfmul(h1, h1);
+  auto h3 = gfmul(h2, h1);
+  auto h4 = gfmul(h3, h1);
+  store(hashKeys, h1);
+  store(hashKeys + 16, h2);
+  store(hashKeys + 32, h3);
+  store(hashKeys + 48, h4);
+}
+
+FIZZ_AESGCM_TARGET void encryptBlock(
+    const uint8_t* roundKeys,
+    size_t rounds,
+    const uint8_t* in,
+    uint8_t* out) {
+  RoundKeys k(roundKeys, rounds);
+  store(out, aesEncrypt(k, load(in)));
+}
+
+FIZZ_AESGCM_TARGET void ghashBlocks(
+    const uint8_t* hashKeys,
+    uint8_t* hash,
+    const uint8_t* in,
+    size_t blocks) {
+  HashKeys h(hashKeys);
+  auto x = load(hash);
+  while (blocks >= 4) {
+    __m128i b[4] = {load(in), load(in + 16), load(in + 32), load(in + 48)};
+    x = ghash4(h, x, b);
+    in += 64;
+    blocks -= 4;
+  }
+  while (blocks > 0) {
+    x = gfmul(_mm_xor_si128(x, byteSwap(load(in))), h.h1);
+    in += 16;
+    blocks--;
+  }
+  store(hash, x);
+}
+
+// Counter mode over whole blocks, with GHASH over the ciphertext stitched into
+// the same loop. When encrypting, the GHASH of each group of four blocks is
+// deferred to the next iteration so that it overlaps with the AES rounds
+// rather than waiting on them.
+FIZZ_AESGCM_TARGET void ctrBlocks(
+    const uint8_t* roundKeys,
+    size_t rounds,
+    const uint8_t* hashKeys,
+    uint8_t* counter,
+    uint8_t* hash,
+    uint8_t* out,
+    const uint8_t* in,
+    size_t blocks,
+    bool encrypt) {
+  RoundKeys k(roundKeys, rounds);
+  HashKeys h(hashKeys);
+  auto x = load(hash);
+  auto ctr = counterSwap(load(counter));
+  auto one = counterOne();
+
+  __m128i pending[4];
+  bool havePending = false;
+  while (blocks >= 4) {
+    __m128i b[4];
+    for (size_t i = 0; i < 4; ++i) {
+      b[i] = counterSwap(ctr);
+      ctr = _mm_add_epi32(ctr, one);
+    }
+    __m128i data[4] = {load(in), load(in + 16), load(in + 32), load(in + 48)};
+    if (!encrypt) {
+      x = ghash4(h, x, data);
+    } else if (havePending) {
+      x = ghash4(h, x, pending);
+    }
+    aesEncrypt4(k, b);
+    for (size_t i = 0; i < 4; ++i) {
+      b[i] = _mm_xor_si128(b[i], data[i]);
+      store(out + i * 16, b[i]);
+    }
+    if (encrypt) {
+      for (size_t i = 0; i < 4; ++i) {
+        pending[i] = b[i];
+      }
+      havePending = true;
+    }
+    in += 64;
+    out += 64;
+    blocks -= 4;
+  }
+  if (havePending) {
+    x = ghash4(h, x, pending);
+  }
+  while (blocks > 0) {
+    auto data = load(in);
+    auto block = _mm_xor_si128(aesEncrypt(k, counterSwap(ctr)), data);
+    ctr = _mm_add_epi32(ctr, one);
+    store(out, block);
+    auto cipherBlock = encrypt ? block : data;
+    x = gfmul(_mm_xor_si128(x, byteSwap(cipherBlock)), h.h1);
+    in += 16;
+    out += 16;
+    blocks--;
+  }
+  store(counter, counterSwap(ctr));
+  store(hash, x);
+}
+
+constexpr size_t kBlock = AESGCMKernel::kBlockSize;
+constexpr size_t kLanes = 4;
+
+// Folds len bytes into the hash a block at a time, zero padding the last one.
+FIZZ_AESGCM_TARGET inline __m128i
+ghashPadded(__m128i h1, __m128i x, const uint8_t* in, size_t len) {
+  while (len >= kBlock) {
+    x = gfmul(_mm_xor_si128(x, byteSwap(load(in))), h1);
+    in += kBlock;
+    len -= kBlock;
+  }
+  if (len > 0) {
+    std::array<uint8_t, kBlock> block{};
+    memcpy(block.data(), in, len);
+    x = gfmul(_mm_xor_si128(x, byteSwap(load(block.data()))), h1);
+  }
+  return x;
+}
+
+// Encrypts up to kLanes records side by side. Lanes without a record, and
+// lanes whose record has run out of data, still go through the AES rounds
+// with the others but their output is ignored.
+FIZZ_AESGCM_TARGET void encryptLanes(
+    const uint8_t* roundKeys,
+    size_t rounds,
+    const uint8_t* hashKeys,
+    const AESGCMKernel::Record* records,
+    size_t count) {
+  RoundKeys k(roundKeys, rounds);
+  HashKeys h(hashKeys);
+  auto one = counterOne();
+
+  // Y0 = IV || 0^31 || 1 gives each record's tag mask, its data starts at
+  // Y0 + 1.
+  __m128i mask[kLanes];
+  __m128i ctr[kLanes];
+  __m128i x[kLanes];
+  size_t maxLength = 0;
+  for (size_t i = 0; i < kLanes; ++i) {
+    mask[i] = _mm_setzero_si128();
+    x[i] = _mm_setzero_si128();
+  }
+  for (size_t i = 0; i < count; ++i) {
+    const auto& record = records[i];
+    std::array<uint8_t, kBlock> y0{};
+    memcpy(y0.data(), record.iv, AESGCMKernel::kIVLength);
+    y0[15] = 1;
+    mask[i] = load(y0.data());
+    x[i] = ghashPadded(h.h1, x[i], record.aad.data(), record.aad.size());
+    maxLength = std::max(maxLength, record.length);
+  }
+  for (size_t i = 0; i < kLanes; ++i) {
+    ctr[i] = _mm_add_epi32(counterSwap(mask[i]), one);
+  }
+  aesEncrypt4(k, mask);
+
+  for (size_t offset = 0; offset < maxLength; offset += kBlock) {
+    __m128i b[kLanes];
+    for (size_t i = 0; i < kLanes; ++i) {
+      b[i] = counterSwap(ctr[i]);
+      ctr[i] = _mm_add_epi32(ctr[i], one);
+    }
+    aesEncrypt4(k, b);
+    for (size_t i = 0; i < count; ++i) {
+      const auto& record = records[i];
+      if (offset >= record.length) {
+        continue;
+      }
+      auto len = std::min(kBlock, record.length - offset);
+      __m128i cipherBlock;
+      if (len == kBlock) {
+        cipherBlock = _mm_xor_si128(b[i], load(record.in + offset));
+        store(record.out + offset, cipherBlock);
+      } else {
+        // The ciphertext of the final partial block is hashed zero padded.
+        std::array<uint8_t, kBlock> block{};
+        memcpy(block.data(), record.in + offset, len);
+        store(block.data(), _mm_xor_si128(b[i], load(block.data())));
+        memcpy(record.out + offset, block.data(), len);
+        memset(block.data() + len, 0, kBlock - len);
+        cipherBlock = load(block.data());
+      }
+      x[i] = gfmul(_mm_xor_si128(x[i], byteSwap(cipherBlock)), h.h1);
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    const auto& record = records[i];
+    std::array<uint8_t, kBlock> lengths;
+    auto aadBits = static_cast<uint64_t>(record.aad.size()) * 8;
+    auto dataBits = static_cast<uint64_t>(record.length) * 8;
+    for (size_t j = 0; j < 8; ++j) {
+      lengths[7 - j] = static_cast<uint8_t>(aadBits >> (8 * j));
+      lengths[15 - j] = static_cast<uint8_t>(dataBits >> (8 * j));
+    }
+    x[i] = gfmul(_mm_xor_si128(x[i], byteSwap(load(lengths.data()))), h.h1);
+    store(record.tag, _mm_xor_si128(byteSwap(x[i]), mask[i]));
+  }
+}
+
+void incrementCounter(uint8_t* counter) {
+  for (size_t i = AESGCMKernel::kBlockSize; i > AESGCMKernel::kIVLength; --i) {
+    if (++counter[i - 1] != 0) {
+      break;
+    }
+  }
+}
+} // namespace
+
+bool AESGCMKernel::isSupported() {
+  static const bool supported = [] {
+    folly::CpuId cpu;
+    return cpu.aes() && cpu.pclmuldq() && cpu.ssse3();
+  }();
+  return supported;
+}
+
+void AESGCMKernel::setKey(folly::ByteRange key) {
+  if (key.size() == 16) {
+    rounds_ = 10;
+    expandKey128(key.data(), roundKeys_.data());
+  } else if (key.size() == 32) {
+    rounds_ = 14;
+    expandKey256(key.data(), roundKeys_.data());
+  } else {
+    throw std::runtime_error("Invalid key");
+  }
+  initHashKeys(roundKeys_.data(), rounds_, hashKeys_.data());
+}
+
+void AESGCMKernel::encryptRecords(const Record* records, size_t count) const {
+  while (count > 0) {
+    auto lanes = std::min(count, kLanes);
+    encryptLanes(roundKeys_.data(), rounds_, hashKeys_.data(), records, lanes);
+    records += lanes;
+    count -= lanes;
+  }
+}
+
+AESGCMKernel::Stream::Stream(const AESGCMKernel& kernel, folly::ByteRange iv)
+    : kernel_(kernel) {
+  if (iv.size() != kIVLength) {
+    throw std::runtime_error("Invalid IV");
+  }
+  // Y0 = IV || 0^31 || 1 is used for the tag, data starts at Y0 + 1.
+  memcpy(counter_.data(), iv.data(), kIVLength);
+  counter_[12] = 0;
+  counter_[13] = 0;
+  counter_[14] = 0;
+  counter_[15] = 1;
+  encryptBlock(
+      kernel_.roundKeys_.data(),
+      kernel_.rounds_,
+      counter_.data(),
+      tagMask_.data());
+  incrementCounter(counter_.data());
+  hash_.fill(0);
+}
+
+AESGCMKernel::Stream::~Stream() {
+  CryptoUtils::clean(folly::range(keystream_));
+  CryptoUtils::clean(folly::range(tagMask_));
+}
+
+void AESGCMKernel::Stream::aad(const uint8_t* in, size_t len) {
+  if (dataStarted_) {
+    throw std::runtime_error("aad after data");
+  }
+  aadLen_ += len;
+  if (partialLen_ > 0) {
+    auto toCopy = std::min(len, kBlockSize - partialLen_);
+    memcpy(partial_.data() + partialLen_, in, toCopy);
+    partialLen_ += toCopy;
+    in += toCopy;
+    len -= toCopy;
+    if (partialLen_ < kBlockSize) {
+      return;
+    }
+    ghashBlocks(kernel_.hashKeys_.data(), hash_.data(), partial_.data(), 1);
+    partialLen_ = 0;
+  }
+  auto blocks = len / kBlockSize;
+  if (blocks > 0) {
+    ghashBlocks(kernel_.hashKeys_.data(), hash_.data(), in, blocks);
+    in += blocks * kBlockSize;
+    len -= blocks * kBlockSize;
+  }
+  if (len > 0) {
+    memcpy(partial_.data(), in, len);
+    partialLen_ = len;
+  }
+}
+
+void AESGCMKernel::Stream::encrypt(
+    uint8_t* out,
+    const uint8_t* in,
+    size_t len) {
+  crypt(out, in, len, true);
+}
+
+void AESGCMKernel::Stream::decrypt(
+    uint8_t* out,
+    const uint8_t* in,
+    size_t len) {
+  crypt(out, in, len, false);
+}
+
+void AESGCMKernel::Stream::crypt(
+    uint8_t* out,
+    const uint8_t* in,
+    size_t len,
+    bool encrypt) {
+  if (!dataStarted_) {
+    // The associated data is zero padded to a whole block.
+    flushPartial();
+    dataStarted_ = true;
+  }
+  dataLen_ += len;
+
+  // While processing data, partial_ holds the ciphertext of the current block
+  // and partialLen_ bytes of keystream_ have been used.
+  auto xorPartial = [&](size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      auto inByte = in[i];
+      auto outByte = static_cast<uint8_t>(inByte ^ keystream_[partialLen_]);
+      out[i] = outByte;
+      partial_[partialLen_++] = encrypt ? outByte : inByte;
+    }
+    in += count;
+    out += count;
+    len -= count;
+  };
+
+  if (partialLen_ > 0) {
+    xorPartial(std::min(len, kBlockSize - partialLen_));
+    if (partialLen_ < kBlockSize) {
+      return;
+    }
+    ghashBlocks(kernel_.hashKeys_.data(), hash_.data(), partial_.data(), 1);
+    partialLen_ = 0;
+  }
+
+  auto blocks = len / kBlockSize;
+  if (blocks > 0) {
+    ctrBlocks(
+        kernel_.roundKeys_.data(),
+        kernel_.rounds_,
+        kernel_.hashKeys_.data(),
+        counter_.data(),
+        hash_.data(),
+        out,
+        in,
+        blocks,
+        encrypt);
+    in += blocks * kBlockSize;
+    out += blocks * kBlockSize;
+    len -= blocks * kBlockSize;
+  }
+
+  if (len > 0) {
+    encryptBlock(
+        kernel_.roundKeys_.data(),
+        kernel_.rounds_,
+        counter_.data(),
+        keystream_.data());
+    incrementCounter(counter_.data());
+    xorPartial(len);
+  }
+}
+
+void AESGCMKernel::Stream::flushPartial() {
+  if (partialLen_ > 0) {
+    memset(partial_.data() + partialLen_, 0, kBlockSize - partialLen_);
+    ghashBlocks(kernel_.hashKeys_.data(), hash_.data(), partial_.data(), 1);
+    partialLen_ = 0;
+  }
+}
+
+void AESGCMKernel::Stream::finish(folly::MutableByteRange tag) {
+  if (tag.size() != kTagLength) {
+    throw std::runtime_error("Invalid tag length");
+  }
+  flushPartial();
+  std::array<uint8_t, kBlockSize> lengths;
+  auto aadBits = aadLen_ * 8;
+  auto dataBits = dataLen_ * 8;
+  for (size_t i = 0; i < 8; ++i) {
+    lengths[7 - i] = static_cast<uint8_t>(aadBits >> (8 * i));
+    lengths[15 - i] = static_cast<uint8_t>(dataBits >> (8 * i));
+  }
+  ghashBlocks(kernel_.hashKeys_.data(), hash_.data(), lengths.data(), 1);
+  for (size_t i = 0; i < kTagLength; ++i) {
+    tag[i] = hash_[kBlockSize - 1 - i] ^ tagMask_[i];
+  }
+}
+
+#else
+
+bool AESGCMKernel::isSupported() {
+  return false;
+}
+
+void AESGCMKernel::setKey(folly::ByteRange) {
+  throw std::runtime_error("aes-gcm kernel not supported");
+}
+
+void AESGCMKernel::encryptRecords(const Record*, size_t) const {
+  throw std::runtime_error("aes-gcm kernel not supported");
+}
+
+AESGCMKernel::Stream::Stream(const AESGCMKernel& kernel, folly::ByteRange)
+    : kernel_(kernel) {
+  throw std::runtime_error("aes-gcm kernel not supported");
+}
+
+AESGCMKernel::Stream::~Stream() = default;
+
+void AESGCMKernel::Stream::aad(const uint8_t*, size_t) {}
+
+void AESGCMKernel::Stream::encrypt(uint8_t*, const uint8_t*, size_t) {}
+
+void AESGCMKernel::Stream::decrypt(uint8_t*, const uint8_t*, size_t) {}
+
+void AESGCMKernel::Stream::finish(folly::MutableByteRange) {}
+
+#endif
+
+AESGCMKernel::~AESGCMKernel() {
+  CryptoUtils::clean(folly::range(roundKeys_));
+  CryptoUtils::clean(folly::range(hashKeys_));
+}
+} // namespace fizz
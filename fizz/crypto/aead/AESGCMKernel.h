@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+
+#include <array>
+#include <cstdint>
+
+namespace fizz {
+
+/**
+ * AES-GCM (RFC 5288) implemented directly with AES-NI and PCLMULQDQ instead of
+ * going through EVP. Counter mode and GHASH are stitched four blocks at a
+ * time.
+ *
+ * The kernel may only be used if isSupported() returns true.
+ */
+class AESGCMKernel {
+ public:
+  static constexpr size_t kBlockSize = 16;
+  static constexpr size_t kIVLength = 12;
+  static constexpr size_t kTagLength = 16;
+
+  /**
+   * Returns whether the running CPU has the instructions this kernel needs.
+   */
+  static bool isSupported();
+
+  AESGCMKernel() = default;
+  ~AESGCMKernel();
+
+  AESGCMKernel(const AESGCMKernel&) = delete;
+  AESGCMKernel& operator=(const AESGCMKernel&) = delete;
+
+  /**
+   * Expands a 16 or 32 byte AES key.
+   */
+  void setKey(folly::ByteRange key);
+
+  /**
+   * A record for encryptRecords(). iv is kIVLength bytes and tag receives
+   * kTagLength bytes. out may be the same buffer as in.
+   */
+  struct Record {
+    const uint8_t* iv;
+    folly::ByteRange aad;
+    const uint8_t* in;
+    uint8_t* out;
+    size_t length;
+    uint8_t* tag;
+  };
+
+  /**
+   * Encrypts count independent records in one pass. Up to four records are
+   * processed together: each step runs the AES rounds for one block of every
+   * record at once and folds each ciphertext block into its own record's
+   * GHASH, so the records' dependency chains overlap rather than running back
+   * to back. The result is the same as encrypting each record with a Stream.
+   */
+  void encryptRecords(const Record* records, size_t count) const;
+
+  /**
+   * State for a single encryption or decryption. All associated data must be
+   * supplied before any plaintext or ciphertext.
+   */
+  class Stream {
+   public:
+    Stream(const AESGCMKernel& kernel, folly::ByteRange iv);
+    ~Stream();
+
+    Stream(const Stream&) = delete;
+    Stream& operator=(const Stream&) = delete;
+
+    void aad(const uint8_t* in, size_t len);
+
+    // in and out may be the same buffer.
+    void encrypt(uint8_t* out, const uint8_t* in, size_t len);
+    void decrypt(uint8_t* out, const uint8_t* in, size_t len);
+
+    void finish(folly::MutableByteRange tag);
+
+   private:
+    void crypt(uint8_t* out, const uint8_t* in, size_t len, bool encrypt);
+    void flushPartial();
+
+    const AESGCMKernel& kernel_;
+    alignas(16) std::array<uint8_t, kBlockSize> counter_;
+    alignas(16) std::array<uint8_t, kBlockSize> tagMask_;
+    alignas(16) std::array<uint8_t, kBlockSize> hash_;
+    alignas(16) std::array<uint8_t, kBlockSize> keystream_;
+    alignas(16) std::array<uint8_t, kBlockSize> partial_;
+    size_t partialLen_{0};
+    uint64_t aadLen_{0};
+    uint64_t dataLen_{0};
+    bool dataStarted_{false};
+  };
+
+ private:
+  // Round keys for up to 14 rounds (AES-256).
+  alignas(16) std::array<uint8_t, 15 * kBlockSize> roundKeys_;
+  // H, H^2, H^3, H^4 in the bit reflected representation used for GHASH.
+  alignas(16) std::array<uint8_t, 4 * kBlockSize> hashKeys_;
+  size_t rounds_{0};
+};
+} // namespace fizz
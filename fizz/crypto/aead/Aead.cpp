@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/aead/Aead.h>
+
+#include <fizz/crypto/aead/IOBufUtil.h>
+
+namespace fizz {
+
+namespace {
+
+void copyToIov(
+    const folly::IOBuf& buf,
+    folly::Range<const struct iovec*> output) {
+  // Wrapped buffers are never modified, they just give us a chain to walk.
+  auto out = folly::IOBuf::wrapIov(output.data(), output.size());
+  transformBuffer(
+      buf, *out, [](uint8_t* dest, const uint8_t* src, size_t len) {
+        memcpy(dest, src, len);
+      });
+}
+} // namespace
+
+void Aead::encryptIov(
+    folly::Range<const struct iovec*> input,
+    folly::Range<const struct iovec*> output,
+    folly::MutableByteRange tag,
+    folly::ByteRange associatedData,
+    uint64_t seqNum) const {
+  auto inputLength = iovLength(input);
+  if (iovLength(output) != inputLength ||
+      tag.size() != getCipherOverhead()) {
+    throw std::runtime_error("Invalid iov");
+  }
+  // The wrapped input is not owned, so encrypt() has to copy it rather than
+  // overwriting it in place.
+  auto plaintext = folly::IOBuf::wrapIov(input.data(), input.size());
+  auto adBuf = folly::IOBuf::wrapBufferAsValue(associatedData);
+  auto ciphertext = encrypt(std::move(plaintext), &adBuf, seqNum);
+  if (ciphertext->computeChainDataLength() != inputLength + tag.size()) {
+    throw std::runtime_error("Unexpected ciphertext length");
+  }
+  trimBytes(*ciphertext, tag);
+  copyToIov(*ciphertext, output);
+}
+
+void Aead::batchEncryptIov(folly::Range<const AeadIovRecord*> records) const {
+  for (const auto& record : records) {
+    encryptIov(
+        record.input,
+        record.output,
+        record.tag,
+        record.associatedData,
+        record.seqNum);
+  }
+}
+
+bool Aead::tryDecryptIov(
+    folly::Range<const struct iovec*> input,
+    folly::Range<const struct iovec*> output,
+    folly::ByteRange tag,
+    folly::ByteRange associatedData,
+    uint64_t seqNum) const {
+  auto inputLength = iovLength(input);
+  if (iovLength(output) != inputLength ||
+      tag.size() != getCipherOverhead()) {
+    throw std::runtime_error("Invalid iov");
+  }
+  auto ciphertext = folly::IOBuf::wrapIov(input.data(), input.size());
+  ciphertext->prependChain(folly::IOBuf::wrapBuffer(tag));
+  auto adBuf = folly::IOBuf::wrapBufferAsValue(associatedData);
+  auto plaintext = tryDecrypt(std::move(ciphertext), &adBuf, seqNum);
+  if (!plaintext) {
+    return false;
+  }
+  if ((*plaintext)->computeChainDataLength() != inputLength) {
+    throw std::runtime_error("Unexpected plaintext length");
+  }
+  copyToIov(**plaintext, output);
+  return true;
+}
+} // namespace fizz
@@ -9,7 +9,9 @@
 #pragma once
 
 #include <folly/Optional.h>
+#include <folly/Range.h>
 #include <folly/io/IOBuf.h>
+#include <folly/portability/SysUio.h>
 
 namespace fizz {
 
@@ -18,6 +20,18 @@ struct TrafficKey {
   std::unique_ptr<folly::IOBuf> iv;
 };
 
+/**
+ * A single record passed to Aead::batchEncryptIov(). The fields are the
+ * arguments of the matching Aead::encryptIov() call.
+ */
+struct AeadIovRecord {
+  folly::Range<const struct iovec*> input;
+  folly::Range<const struct iovec*> output;
+  folly::MutableByteRange tag;
+  folly::ByteRange associatedData;
+  uint64_t seqNum{0};
+};
+
 /**
  * Interface for aead algorithms (RFC 5116).
  */
@@ -83,6 +97,50 @@ class Aead {
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const = 0;
 
+  /**
+   * Encrypts the bytes described by input into output. output must describe
+   * exactly as many bytes as input, though they may be split differently, and
+   * may be the same list to encrypt in place. tag must be getCipherOverhead()
+   * bytes long. The default implementation copies through encrypt(). Will
+   * throw on error.
+   */
+  virtual void encryptIov(
+      folly::Range<const struct iovec*> input,
+      folly::Range<const struct iovec*> output,
+      folly::MutableByteRange tag,
+      folly::ByteRange associatedData,
+      uint64_t seqNum) const;
+
+  /**
+   * Encrypts each record as encryptIov() would. Implementations may interleave
+   * the work of several records; the default encrypts them one at a time, in
+   * order. Will throw on error.
+   */
+  virtual void batchEncryptIov(
+      folly::Range<const AeadIovRecord*> records) const;
+
+  /**
+   * Decrypts the bytes described by input into output and checks them against
+   * tag, with the same layout rules as encryptIov(). Returns false if the
+   * ciphertext does not decrypt successfully, in which case the contents of
+   * output are unspecified. The default implementation copies through
+   * tryDecrypt().
+   */
+  virtual bool tryDecryptIov(
+      folly::Range<const struct iovec*> input,
+      folly::Range<const struct iovec*> output,
+      folly::ByteRange tag,
+      folly::ByteRange associatedData,
+      uint64_t seqNum) const;
+
+  /**
+   * Returns true if encryptIov() and tryDecryptIov() work on the given buffers
+   * directly and never allocate.
+   */
+  virtual bool supportsZeroCopyIov() const {
+    return false;
+  }
+
   /**
    * Returns the number of bytes the aead will add to the plaintext (size of
    * ciphertext - size of plaintext).
@@ -0,0 +1,726 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/aead/ChaCha20Poly1305Kernel.h>
+
+#include <fizz/crypto/Utils.h>
+#include <folly/CpuId.h>
+#include <folly/Portability.h>
+#include <folly/lang/Bits.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if FOLLY_X64 && !defined(_MSC_VER)
+#define FIZZ_HAVE_CHACHA_KERNEL 1
+#include <immintrin.h>
+#else
+#define FIZZ_HAVE_CHACHA_KERNEL 0
+#endif
+
+namespace fizz {
+
+constexpr size_t ChaCha20Poly1305Kernel::kKeyLength;
+constexpr size_t ChaCha20Poly1305Kernel::kIVLength;
+constexpr size_t ChaCha20Poly1305Kernel::kTagLength;
+constexpr size_t ChaCha20Poly1305Kernel::kBlockSize;
+
+#if FIZZ_HAVE_CHACHA_KERNEL
+
+#define FIZZ_CHACHA_TARGET __attribute__((target("avx2")))
+
+namespace {
+
+constexpr uint64_t kMask44 = 0xfffffffffff;
+constexpr uint64_t kMask42 = 0x3ffffffffff;
+constexpr size_t kWideBlocks = 8;
+// Below this many blocks the scalar block function is faster than generating
+// a full set of wide blocks.
+constexpr size_t kMinWideTailBlocks = 2;
+
+using uint128_t = unsigned __int128;
+
+inline uint32_t loadLE32(const uint8_t* in) {
+  uint32_t v;
+  memcpy(&v, in, sizeof(v));
+  return folly::Endian::little(v);
+}
+
+inline uint64_t loadLE64(const uint8_t* in) {
+  uint64_t v;
+  memcpy(&v, in, sizeof(v));
+  return folly::Endian::little(v);
+}
+
+inline void storeLE32(uint8_t* out, uint32_t v) {
+  v = folly::Endian::little(v);
+  memcpy(out, &v, sizeof(v));
+}
+
+inline void storeLE64(uint8_t* out, uint64_t v) {
+  v = folly::Endian::little(v);
+  memcpy(out, &v, sizeof(v));
+}
+
+inline uint32_t rotl(uint32_t v, int n) {
+  return (v << n) | (v >> (32 - n));
+}
+
+inline void quarterRound(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d) {
+  a += b;
+  d = rotl(d ^ a, 16);
+  c += d;
+  b = rotl(b ^ c, 12);
+  a += b;
+  d = rotl(d ^ a, 8);
+  c += d;
+  b = rotl(b ^ c, 7);
+}
+
+void chachaBlock(const std::array<uint32_t, 16>& state, uint8_t* out) {
+  auto x = state;
+  for (size_t i = 0; i < 10; ++i) {
+    quarterRound(x[0], x[4], x[8], x[12]);
+    quarterRound(x[1], x[5], x[9], x[13]);
+    quarterRound(x[2], x[6], x[10], x[14]);
+    quarterRound(x[3], x[7], x[11], x[15]);
+    quarterRound(x[0], x[5], x[10], x[15]);
+    quarterRound(x[1], x[6], x[11], x[12]);
+    quarterRound(x[2], x[7], x[8], x[13]);
+    quarterRound(x[3], x[4], x[9], x[14]);
+  }
+  for (size_t i = 0; i < 16; ++i) {
+    storeLE32(out + i * 4, x[i] + state[i]);
+  }
+}
+
+FIZZ_CHACHA_TARGET inline __m256i rotl16(__m256i v) {
+  return _mm256_shuffle_epi8(
+      v,
+      _mm256_setr_epi8(
+          2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+          2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+}
+
+FIZZ_CHACHA_TARGET inline __m256i rotl8(__m256i v) {
+  return _mm256_shuffle_epi8(
+      v,
+      _mm256_setr_epi8(
+          3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+          3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14));
+}
+
+template <int N>
+FIZZ_CHACHA_TARGET inline __m256i rotl(__m256i v) {
+  return _mm256_or_si256(_mm256_slli_epi32(v, N), _mm256_srli_epi32(v, 32 - N));
+}
+
+FIZZ_CHACHA_TARGET inline void
+quarterRound(__m256i& a, __m256i& b, __m256i& c, __m256i& d) {
+  a = _mm256_add_epi32(a, b);
+  d = rotl16(_mm256_xor_si256(d, a));
+  c = _mm256_add_epi32(c, d);
+  b = rotl<12>(_mm256_xor_si256(b, c));
+  a = _mm256_add_epi32(a, b);
+  d = rotl8(_mm256_xor_si256(d, a));
+  c = _mm256_add_epi32(c, d);
+  b = rotl<7>(_mm256_xor_si256(b, c));
+}
+
+FIZZ_CHACHA_TARGET inline void
+xorStore(uint8_t* out, const uint8_t* in, __m256i keystream) {
+  auto data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+  _mm256_storeu_si256(
+      reinterpret_cast<__m256i*>(out), _mm256_xor_si256(data, keystream));
+}
+
+// Runs the block function on eight states held one word per register in orig.
+// Afterwards g[k + j] holds words k..k+3 of block j in its low lane and of
+// block j + 4 in its high lane.
+FIZZ_CHACHA_TARGET inline void chachaRounds8(const __m256i* orig, __m256i* g) {
+  __m256i x[16];
+  for (size_t i = 0; i < 16; ++i) {
+    x[i] = orig[i];
+  }
+  for (size_t i = 0; i < 10; ++i) {
+    quarterRound(x[0], x[4], x[8], x[12]);
+    quarterRound(x[1], x[5], x[9], x[13]);
+    quarterRound(x[2], x[6], x[10], x[14]);
+    quarterRound(x[3], x[7], x[11], x[15]);
+    quarterRound(x[0], x[5], x[10], x[15]);
+    quarterRound(x[1], x[6], x[11], x[12]);
+    quarterRound(x[2], x[7], x[8], x[13]);
+    quarterRound(x[3], x[4], x[9], x[14]);
+  }
+  for (size_t i = 0; i < 16; ++i) {
+    x[i] = _mm256_add_epi32(x[i], orig[i]);
+  }
+
+  for (size_t k = 0; k < 16; k += 4) {
+    auto t0 = _mm256_unpacklo_epi32(x[k], x[k + 1]);
+    auto t1 = _mm256_unpacklo_epi32(x[k + 2], x[k + 3]);
+    auto t2 = _mm256_unpackhi_epi32(x[k], x[k + 1]);
+    auto t3 = _mm256_unpackhi_epi32(x[k + 2], x[k + 3]);
+    g[k] = _mm256_unpacklo_epi64(t0, t1);
+    g[k + 1] = _mm256_unpackhi_epi64(t0, t1);
+    g[k + 2] = _mm256_unpacklo_epi64(t2, t3);
+    g[k + 3] = _mm256_unpackhi_epi64(t2, t3);
+  }
+}
+
+// Xors the eight blocks left in g by chachaRounds8() with in, in block order.
+FIZZ_CHACHA_TARGET inline void
+xorBlocks8(const __m256i* g, uint8_t* out, const uint8_t* in) {
+  for (size_t j = 0; j < 4; ++j) {
+    auto low = j * 64;
+    auto high = (j + 4) * 64;
+    xorStore(
+        out + low, in + low, _mm256_permute2x128_si256(g[j], g[j + 4], 0x20));
+    xorStore(
+        out + low + 32,
+        in + low + 32,
+        _mm256_permute2x128_si256(g[j + 8], g[j + 12], 0x20));
+    xorStore(
+        out + high,
+        in + high,
+        _mm256_permute2x128_si256(g[j], g[j + 4], 0x31));
+    xorStore(
+        out + high + 32,
+        in + high + 32,
+        _mm256_permute2x128_si256(g[j + 8], g[j + 12], 0x31));
+  }
+}
+
+// Encrypts kWideBlocks consecutive blocks starting at the counter in state.
+// Each register holds one state word for all eight blocks, the output is
+// transposed back into block order before being xored with the input.
+FIZZ_CHACHA_TARGET void chachaBlocks8(
+    const std::array<uint32_t, 16>& state,
+    uint8_t* out,
+    const uint8_t* in) {
+  __m256i orig[16];
+  for (size_t i = 0; i < 16; ++i) {
+    orig[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+  }
+  orig[12] =
+      _mm256_add_epi32(orig[12], _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+  __m256i g[16];
+  chachaRounds8(orig, g);
+  xorBlocks8(g, out, in);
+}
+
+// Words 12 to 15 (block counter and nonce) of one block in a chachaLanes8()
+// call.
+using Lane = std::array<uint32_t, 4>;
+
+// Generates one keystream block for each of kWideBlocks lanes into out, in
+// lane order. The lanes share the constants and key in words 0 to 11 of state
+// but are otherwise independent, so they may belong to different records.
+FIZZ_CHACHA_TARGET void chachaLanes8(
+    const std::array<uint32_t, 16>& state,
+    const std::array<Lane, kWideBlocks>& lanes,
+    uint8_t* out) {
+  __m256i orig[16];
+  for (size_t i = 0; i < 12; ++i) {
+    orig[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    orig[12 + i] = _mm256_setr_epi32(
+        static_cast<int>(lanes[0][i]),
+        static_cast<int>(lanes[1][i]),
+        static_cast<int>(lanes[2][i]),
+        static_cast<int>(lanes[3][i]),
+        static_cast<int>(lanes[4][i]),
+        static_cast<int>(lanes[5][i]),
+        static_cast<int>(lanes[6][i]),
+        static_cast<int>(lanes[7][i]));
+  }
+
+  __m256i g[16];
+  chachaRounds8(orig, g);
+  memset(out, 0, ChaCha20Poly1305Kernel::kBlockSize * kWideBlocks);
+  xorBlocks8(g, out, out);
+}
+
+void polyBlocks(
+    const std::array<uint64_t, 3>& r,
+    std::array<uint64_t, 3>& h,
+    const uint8_t* in,
+    size_t blocks) {
+  constexpr uint64_t hibit = static_cast<uint64_t>(1) << 40;
+  auto s1 = r[1] * (5 << 2);
+  auto s2 = r[2] * (5 << 2);
+  auto h0 = h[0];
+  auto h1 = h[1];
+  auto h2 = h[2];
+  while (blocks > 0) {
+    auto t0 = loadLE64(in);
+    auto t1 = loadLE64(in + 8);
+    h0 += t0 & kMask44;
+    h1 += ((t0 >> 44) | (t1 << 20)) & kMask44;
+    h2 += ((t1 >> 24) & kMask42) | hibit;
+
+    auto d0 = static_cast<uint128_t>(h0) * r[0] +
+        static_cast<uint128_t>(h1) * s2 + static_cast<uint128_t>(h2) * s1;
+    auto d1 = static_cast<uint128_t>(h0) * r[1] +
+        static_cast<uint128_t>(h1) * r[0] + static_cast<uint128_t>(h2) * s2;
+    auto d2 = static_cast<uint128_t>(h0) * r[2] +
+        static_cast<uint128_t>(h1) * r[1] + static_cast<uint128_t>(h2) * r[0];
+
+    auto c = static_cast<uint64_t>(d0 >> 44);
+    h0 = static_cast<uint64_t>(d0) & kMask44;
+    d1 += c;
+    c = static_cast<uint64_t>(d1 >> 44);
+    h1 = static_cast<uint64_t>(d1) & kMask44;
+    d2 += c;
+    c = static_cast<uint64_t>(d2 >> 42);
+    h2 = static_cast<uint64_t>(d2) & kMask42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= kMask44;
+    h1 += c;
+
+    in += 16;
+    blocks--;
+  }
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+}
+
+// Folds len bytes into the mac, zero padding them to a multiple of 16 bytes.
+void polyPadded(
+    const std::array<uint64_t, 3>& r,
+    std::array<uint64_t, 3>& h,
+    const uint8_t* in,
+    size_t len) {
+  auto blocks = len / 16;
+  polyBlocks(r, h, in, blocks);
+  if (len % 16 > 0) {
+    std::array<uint8_t, 16> block{};
+    memcpy(block.data(), in + blocks * 16, len % 16);
+    polyBlocks(r, h, block.data(), 1);
+  }
+}
+
+// Derives the Poly1305 key (r, s) from the first 32 bytes of a block 0
+// keystream.
+void polyKey(
+    const uint8_t* keystream,
+    std::array<uint64_t, 3>& r,
+    std::array<uint64_t, 2>& s) {
+  auto t0 = loadLE64(keystream);
+  auto t1 = loadLE64(keystream + 8);
+  r[0] = t0 & 0xffc0fffffff;
+  r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffff;
+  r[2] = (t1 >> 24) & 0x00ffffffc0f;
+  s[0] = loadLE64(keystream + 16);
+  s[1] = loadLE64(keystream + 24);
+}
+
+// Folds in the lengths block and writes the 16 byte tag.
+void polyFinish(
+    const std::array<uint64_t, 3>& r,
+    const std::array<uint64_t, 2>& s,
+    std::array<uint64_t, 3>& h,
+    uint64_t aadLen,
+    uint64_t dataLen,
+    uint8_t* tag) {
+  std::array<uint8_t, 16> lengths;
+  storeLE64(lengths.data(), aadLen);
+  storeLE64(lengths.data() + 8, dataLen);
+  polyBlocks(r, h, lengths.data(), 1);
+
+  // Fully carry h.
+  auto h0 = h[0];
+  auto h1 = h[1];
+  auto h2 = h[2];
+  uint64_t c = h1 >> 44;
+  h1 &= kMask44;
+  h2 += c;
+  c = h2 >> 42;
+  h2 &= kMask42;
+  h0 += c * 5;
+  c = h0 >> 44;
+  h0 &= kMask44;
+  h1 += c;
+  c = h1 >> 44;
+  h1 &= kMask44;
+  h2 += c;
+  c = h2 >> 42;
+  h2 &= kMask42;
+  h0 += c * 5;
+  c = h0 >> 44;
+  h0 &= kMask44;
+  h1 += c;
+
+  // Compute h - p and select it in constant time if h >= p.
+  auto g0 = h0 + 5;
+  c = g0 >> 44;
+  g0 &= kMask44;
+  auto g1 = h1 + c;
+  c = g1 >> 44;
+  g1 &= kMask44;
+  auto g2 = h2 + c - (static_cast<uint64_t>(1) << 42);
+  c = (g2 >> 63) - 1;
+  g0 &= c;
+  g1 &= c;
+  g2 &= c;
+  c = ~c;
+  h0 = (h0 & c) | g0;
+  h1 = (h1 & c) | g1;
+  h2 = (h2 & c) | g2;
+
+  // tag = (h + s) mod 2^128
+  auto t0 = s[0];
+  auto t1 = s[1];
+  h0 += t0 & kMask44;
+  c = h0 >> 44;
+  h0 &= kMask44;
+  h1 += (((t0 >> 44) | (t1 << 20)) & kMask44) + c;
+  c = h1 >> 44;
+  h1 &= kMask44;
+  h2 += ((t1 >> 24) & kMask42) + c;
+  h2 &= kMask42;
+
+  storeLE64(tag, h0 | (h1 << 44));
+  storeLE64(tag + 8, (h1 >> 20) | (h2 << 24));
+}
+} // namespace
+
+bool ChaCha20Poly1305Kernel::isSupported() {
+  static const bool supported = [] { return folly::CpuId().avx2(); }();
+  return supported;
+}
+
+void ChaCha20Poly1305Kernel::setKey(folly::ByteRange key) {
+  if (key.size() != kKeyLength) {
+    throw std::runtime_error("Invalid key");
+  }
+  for (size_t i = 0; i < key_.size(); ++i) {
+    key_[i] = loadLE32(key.data() + i * 4);
+  }
+}
+
+void ChaCha20Poly1305Kernel::encryptRecords(
+    const Record* records,
+    size_t count) const {
+  std::array<uint32_t, 16> state;
+  state[0] = 0x61707865;
+  state[1] = 0x3320646e;
+  state[2] = 0x79622d32;
+  state[3] = 0x6b206574;
+  for (size_t i = 0; i < key_.size(); ++i) {
+    state[4 + i] = key_[i];
+  }
+
+  struct Mac {
+    std::array<uint64_t, 3> r;
+    std::array<uint64_t, 2> s;
+    std::array<uint64_t, 3> h;
+  };
+  std::array<Mac, kWideBlocks> macs;
+  std::array<Lane, kWideBlocks> lanes{};
+  std::array<std::pair<size_t, uint32_t>, kWideBlocks> jobs;
+  std::array<uint8_t, kBlockSize * kWideBlocks> keystream;
+  size_t pending = 0;
+
+  // Block 0 of a record is its Poly1305 key, block n > 0 covers bytes
+  // (n - 1) * 64 to n * 64 of its data.
+  auto run = [&](size_t begin) {
+    if (pending > kMinWideTailBlocks) {
+      chachaLanes8(state, lanes, keystream.data());
+    } else {
+      for (size_t i = 0; i < pending; ++i) {
+        std::copy(lanes[i].begin(), lanes[i].end(), state.begin() + 12);
+        chachaBlock(state, keystream.data() + i * kBlockSize);
+      }
+    }
+    for (size_t i = 0; i < pending; ++i) {
+      auto recordIndex = jobs[i].first;
+      auto block = jobs[i].second;
+      auto ks = keystream.data() + i * kBlockSize;
+      const auto& record = records[begin + recordIndex];
+      if (block == 0) {
+        auto& mac = macs[recordIndex];
+        polyKey(ks, mac.r, mac.s);
+        mac.h.fill(0);
+        continue;
+      }
+      auto offset = (block - 1) * kBlockSize;
+      auto len = record.length - offset;
+      if (len > kBlockSize) {
+        len = kBlockSize;
+      }
+      for (size_t j = 0; j < len; ++j) {
+        record.out[offset + j] = record.in[offset + j] ^ ks[j];
+      }
+    }
+    pending = 0;
+  };
+
+  // Records are taken kWideBlocks at a time so that their macs fit on the
+  // stack, their blocks are packed into lanes across record boundaries.
+  for (size_t begin = 0; begin < count; begin += kWideBlocks) {
+    auto groupSize = std::min<size_t>(kWideBlocks, count - begin);
+    for (size_t i = 0; i < groupSize; ++i) {
+      const auto& record = records[begin + i];
+      auto blocks = (record.length + kBlockSize - 1) / kBlockSize;
+      for (size_t block = 0; block <= blocks; ++block) {
+        lanes[pending] = {static_cast<uint32_t>(block),
+                          loadLE32(record.iv),
+                          loadLE32(record.iv + 4),
+                          loadLE32(record.iv + 8)};
+        jobs[pending] = {i, static_cast<uint32_t>(block)};
+        if (++pending == kWideBlocks) {
+          run(begin);
+        }
+      }
+    }
+    if (pending > 0) {
+      run(begin);
+    }
+
+    for (size_t i = 0; i < groupSize; ++i) {
+      const auto& record = records[begin + i];
+      auto& mac = macs[i];
+      polyPadded(mac.r, mac.h, record.aad.data(), record.aad.size());
+      polyPadded(mac.r, mac.h, record.out, record.length);
+      polyFinish(
+          mac.r, mac.s, mac.h, record.aad.size(), record.length, record.tag);
+    }
+  }
+
+  CryptoUtils::clean(folly::range(keystream));
+  CryptoUtils::clean(folly::MutableByteRange(
+      reinterpret_cast<uint8_t*>(state.data()), sizeof(state)));
+  CryptoUtils::clean(folly::MutableByteRange(
+      reinterpret_cast<uint8_t*>(macs.data()), sizeof(macs)));
+}
+
+ChaCha20Poly1305Kernel::Stream::Stream(
+    const ChaCha20Poly1305Kernel& kernel,
+    folly::ByteRange iv) {
+  if (iv.size() != kIVLength) {
+    throw std::runtime_error("Invalid IV");
+  }
+  state_[0] = 0x61707865;
+  state_[1] = 0x3320646e;
+  state_[2] = 0x79622d32;
+  state_[3] = 0x6b206574;
+  for (size_t i = 0; i < kernel.key_.size(); ++i) {
+    state_[4 + i] = kernel.key_[i];
+  }
+  state_[12] = 0;
+  state_[13] = loadLE32(iv.data());
+  state_[14] = loadLE32(iv.data() + 4);
+  state_[15] = loadLE32(iv.data() + 8);
+
+  // The first block is used for the one time Poly1305 key, data starts at
+  // block 1.
+  chachaBlock(state_, keystream_.data());
+  polyKey(keystream_.data(), r_, s_);
+  h_.fill(0);
+  state_[12] = 1;
+}
+
+ChaCha20Poly1305Kernel::Stream::~Stream() {
+  CryptoUtils::clean(folly::range(keystream_));
+  CryptoUtils::clean(folly::MutableByteRange(
+      reinterpret_cast<uint8_t*>(state_.data()), sizeof(state_)));
+  CryptoUtils::clean(folly::MutableByteRange(
+      reinterpret_cast<uint8_t*>(r_.data()), sizeof(r_)));
+  CryptoUtils::clean(folly::MutableByteRange(
+      reinterpret_cast<uint8_t*>(s_.data()), sizeof(s_)));
+}
+
+void ChaCha20Poly1305Kernel::Stream::aad(const uint8_t* in, size_t len) {
+  if (dataStarted_) {
+    throw std::runtime_error("aad after data");
+  }
+  aadLen_ += len;
+  macUpdate(in, len);
+}
+
+void ChaCha20Poly1305Kernel::Stream::encrypt(
+    uint8_t* out,
+    const uint8_t* in,
+    size_t len) {
+  crypt(out, in, len, true);
+}
+
+void ChaCha20Poly1305Kernel::Stream::decrypt(
+    uint8_t* out,
+    const uint8_t* in,
+    size_t len) {
+  crypt(out, in, len, false);
+}
+
+void ChaCha20Poly1305Kernel::Stream::crypt(
+    uint8_t* out,
+    const uint8_t* in,
+    size_t len,
+    bool encrypt) {
+  if (!dataStarted_) {
+    // The associated data is zero padded to a multiple of 16 bytes.
+    macPad();
+    dataStarted_ = true;
+  }
+  dataLen_ += len;
+
+  // The mac is always over the ciphertext, which for decryption has to be
+  // read before it may be overwritten.
+  auto xorKeystream = [&](const uint8_t* keystream, size_t count) {
+    if (!encrypt) {
+      macUpdate(in, count);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      out[i] = in[i] ^ keystream[i];
+    }
+    if (encrypt) {
+      macUpdate(out, count);
+    }
+    in += count;
+    out += count;
+    len -= count;
+  };
+
+  if (keystreamUsed_ < kBlockSize) {
+    auto count = std::min(len, kBlockSize - keystreamUsed_);
+    xorKeystream(keystream_.data() + keystreamUsed_, count);
+    keystreamUsed_ += count;
+  }
+
+  while (len >= kBlockSize * kWideBlocks) {
+    auto count = kBlockSize * kWideBlocks;
+    if (!encrypt) {
+      macUpdate(in, count);
+    }
+    chachaBlocks8(state_, out, in);
+    if (encrypt) {
+      macUpdate(out, count);
+    }
+    state_[12] += kWideBlocks;
+    in += count;
+    out += count;
+    len -= count;
+  }
+
+  if (len > kBlockSize * kMinWideTailBlocks) {
+    // Generate the tail with one wide call and keep the keystream of a final
+    // partial block for the next call.
+    std::array<uint8_t, kBlockSize * kWideBlocks> keystream{};
+    chachaBlocks8(state_, keystream.data(), keystream.data());
+    auto blocks = (len + kBlockSize - 1) / kBlockSize;
+    state_[12] += blocks;
+    auto count = len;
+    xorKeystream(keystream.data(), count);
+    keystreamUsed_ = count - (blocks - 1) * kBlockSize;
+    memcpy(
+        keystream_.data(),
+        keystream.data() + (blocks - 1) * kBlockSize,
+        kBlockSize);
+    CryptoUtils::clean(folly::range(keystream));
+  }
+
+  while (len > 0) {
+    chachaBlock(state_, keystream_.data());
+    state_[12]++;
+    auto count = std::min(len, kBlockSize);
+    xorKeystream(keystream_.data(), count);
+    keystreamUsed_ = count;
+  }
+}
+
+void ChaCha20Poly1305Kernel::Stream::macUpdate(const uint8_t* in, size_t len) {
+  if (macBuffered_ > 0) {
+    auto toCopy = std::min(len, macBuffer_.size() - macBuffered_);
+    memcpy(macBuffer_.data() + macBuffered_, in, toCopy);
+    macBuffered_ += toCopy;
+    in += toCopy;
+    len -= toCopy;
+    if (macBuffered_ < macBuffer_.size()) {
+      return;
+    }
+    polyBlocks(r_, h_, macBuffer_.data(), 1);
+    macBuffered_ = 0;
+  }
+  auto blocks = len / 16;
+  if (blocks > 0) {
+    polyBlocks(r_, h_, in, blocks);
+    in += blocks * 16;
+    len -= blocks * 16;
+  }
+  if (len > 0) {
+    memcpy(macBuffer_.data(), in, len);
+    macBuffered_ = len;
+  }
+}
+
+void ChaCha20Poly1305Kernel::Stream::macPad() {
+  if (macBuffered_ > 0) {
+    memset(
+        macBuffer_.data() + macBuffered_, 0, macBuffer_.size() - macBuffered_);
+    polyBlocks(r_, h_, macBuffer_.data(), 1);
+    macBuffered_ = 0;
+  }
+}
+
+void ChaCha20Poly1305Kernel::Stream::finish(folly::MutableByteRange tag) {
+  if (tag.size() != kTagLength) {
+    throw std::runtime_error("Invalid tag length");
+  }
+  macPad();
+  polyFinish(r_, s_, h_, aadLen_, dataLen_, tag.data());
+}
+
+#else
+
+bool ChaCha20Poly1305Kernel::isSupported() {
+  return false;
+}
+
+void ChaCha20Poly1305Kernel::setKey(folly::ByteRange) {
+  throw std::runtime_error("chacha20-poly1305 kernel not supported");
+}
+
+void ChaCha20Poly1305Kernel::encryptRecords(const Record*, size_t) const {
+  throw std::runtime_error("chacha20-poly1305 kernel not supported");
+}
+
+ChaCha20Poly1305Kernel::Stream::Stream(
+    const ChaCha20Poly1305Kernel&,
+    folly::ByteRange) {
+  throw std::runtime_error("chacha20-poly1305 kernel not supported");
+}
+
+ChaCha20Poly1305Kernel::Stream::~Stream() = default;
+
+void ChaCha20Poly1305Kernel::Stream::aad(const uint8_t*, size_t) {}
+
+void ChaCha20Poly1305Kernel::Stream::encrypt(
+    uint8_t*,
+    const uint8_t*,
+    size_t) {}
+
+void ChaCha20Poly1305Kernel::Stream::decrypt(
+    uint8_t*,
+    const uint8_t*,
+    size_t) {}
+
+void ChaCha20Poly1305Kernel::Stream::finish(folly::MutableByteRange) {}
+
+#endif
+
+ChaCha20Poly1305Kernel::~ChaCha20Poly1305Kernel() {
+  CryptoUtils::clean(folly::MutableByteRange(
+      reinterpret_cast<uint8_t*>(key_.data()), sizeof(key_)));
+}
+} // namespace fizz
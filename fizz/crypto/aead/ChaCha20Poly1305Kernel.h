@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+
+#include <array>
+#include <cstdint>
+
+namespace fizz {
+
+/**
+ * ChaCha20-Poly1305 (RFC 8439) implemented directly instead of going through
+ * EVP. Bulk keystream is generated eight blocks at a time with AVX2, Poly1305
+ * uses 64 bit limbs.
+ *
+ * The kernel may only be used if isSupported() returns true.
+ */
+class ChaCha20Poly1305Kernel {
+ public:
+  static constexpr size_t kKeyLength = 32;
+  static constexpr size_t kIVLength = 12;
+  static constexpr size_t kTagLength = 16;
+  static constexpr size_t kBlockSize = 64;
+
+  /**
+   * Returns whether the running CPU has the instructions this kernel needs.
+   */
+  static bool isSupported();
+
+  ChaCha20Poly1305Kernel() = default;
+  ~ChaCha20Poly1305Kernel();
+
+  ChaCha20Poly1305Kernel(const ChaCha20Poly1305Kernel&) = delete;
+  ChaCha20Poly1305Kernel& operator=(const ChaCha20Poly1305Kernel&) = delete;
+
+  void setKey(folly::ByteRange key);
+
+  /**
+   * A record for encryptRecords(). iv is kIVLength bytes and tag receives
+   * kTagLength bytes. out may be the same buffer as in.
+   */
+  struct Record {
+    const uint8_t* iv;
+    folly::ByteRange aad;
+    const uint8_t* in;
+    uint8_t* out;
+    size_t length;
+    uint8_t* tag;
+  };
+
+  /**
+   * Encrypts count independent records in one pass. The keystream blocks of
+   * all the records, including the block each record's Poly1305 key comes
+   * from, are packed eight to a wide call regardless of which record they
+   * belong to, so short records don't each pay for a mostly empty wide call
+   * or fall back to the scalar block function. The result is the same as
+   * encrypting each record with a Stream.
+   */
+  void encryptRecords(const Record* records, size_t count) const;
+
+  /**
+   * State for a single encryption or decryption. All associated data must be
+   * supplied before any plaintext or ciphertext.
+   */
+  class Stream {
+   public:
+    Stream(const ChaCha20Poly1305Kernel& kernel, folly::ByteRange iv);
+    ~Stream();
+
+    Stream(const Stream&) = delete;
+    Stream& operator=(const Stream&) = delete;
+
+    void aad(const uint8_t* in, size_t len);
+
+    // in and out may be the same buffer.
+    void encrypt(uint8_t* out, const uint8_t* in, size_t len);
+    void decrypt(uint8_t* out, const uint8_t* in, size_t len);
+
+    void finish(folly::MutableByteRange tag);
+
+   private:
+    void crypt(uint8_t* out, const uint8_t* in, size_t len, bool encrypt);
+    void macUpdate(const uint8_t* in, size_t len);
+    void macPad();
+
+    std::array<uint32_t, 16> state_;
+    std::array<uint8_t, kBlockSize> keystream_;
+    size_t keystreamUsed_{kBlockSize};
+
+    // Poly1305 key (r, s) and accumulator, in 44/44/42 bit limbs.
+    std::array<uint64_t, 3> r_;
+    std::array<uint64_t, 2> s_;
+    std::array<uint64_t, 3> h_;
+    std::array<uint8_t, 16> macBuffer_;
+    size_t macBuffered_{0};
+
+    uint64_t aadLen_{0};
+    uint64_t dataLen_{0};
+    bool dataStarted_{false};
+  };
+
+ private:
+  std::array<uint32_t, 8> key_;
+};
+} // namespace fizz
@@ -43,6 +43,14 @@ void trimStart(IOBuf& buf, size_t toTrim) {
   } while (toTrim > 0 && currentBuffer != &buf);
 }
 
+size_t iovLength(Range<const struct iovec*> iov) {
+  size_t length = 0;
+  for (const auto& current : iov) {
+    length += current.iov_len;
+  }
+  return length;
+}
+
 void XOR(ByteRange first, MutableByteRange second) {
   CHECK_EQ(first.size(), second.size());
   for (size_t i = 0; i < first.size(); ++i) {
@@ -11,6 +11,7 @@
 #include <folly/Range.h>
 #include <folly/io/Cursor.h>
 #include <folly/io/IOBuf.h>
+#include <folly/portability/SysUio.h>
 #include <algorithm>
 
 namespace fizz {
@@ -70,6 +71,46 @@ void transformBuffer(const folly::IOBuf& in, folly::IOBuf& out, Func func) {
   } while (current != &in);
 }
 
+/**
+ * Returns the total number of bytes described by iov.
+ */
+size_t iovLength(folly::Range<const struct iovec*> iov);
+
+/**
+ * Same as transformBuffer() but walks caller owned scatter/gather lists
+ * instead of IOBuf chains. We assume that the caller ensures that out size >=
+ * in size. in and out may be the same list, in which case the Func needs to
+ * be able to work in place.
+ */
+template <typename Func>
+void transformIov(
+    folly::Range<const struct iovec*> in,
+    folly::Range<const struct iovec*> out,
+    Func func) {
+  auto currentOut = out.begin();
+  size_t offset = 0;
+
+  for (const auto& current : in) {
+    auto data = static_cast<const uint8_t*>(current.iov_base);
+    size_t currentLength = current.iov_len;
+
+    while (currentLength != 0) {
+      if (offset == currentOut->iov_len) {
+        offset = 0;
+        ++currentOut;
+        continue;
+      }
+      size_t selected = std::min(currentOut->iov_len - offset, currentLength);
+      func(
+          static_cast<uint8_t*>(currentOut->iov_base) + offset,
+          data + (current.iov_len - currentLength),
+          selected);
+      currentLength -= selected;
+      offset += selected;
+    }
+  }
+}
+
 /**
  * Useful when we need to run a function that performs operations in chunks
  * and transforms data from in -> out, regardless of whether in or out is
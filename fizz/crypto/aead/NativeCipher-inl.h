@@ -0,0 +1,248 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/Utils.h>
+#include <folly/small_vector.h>
+
+namespace fizz {
+
+template <typename Impl>
+void NativeCipher<Impl>::setKey(TrafficKey trafficKey) {
+  auto key = trafficKey.key->coalesce();
+  auto iv = trafficKey.iv->coalesce();
+  if (key.size() != Impl::kKeyLength) {
+    throw std::runtime_error("Invalid key");
+  }
+  if (iv.size() != Impl::kIVLength) {
+    throw std::runtime_error("Invalid IV");
+  }
+  kernel_.setKey(key);
+  memcpy(trafficIv_.data(), iv.data(), iv.size());
+  fallback_.setKey(std::move(trafficKey));
+}
+
+template <typename Impl>
+std::unique_ptr<folly::IOBuf> NativeCipher<Impl>::encrypt(
+    std::unique_ptr<folly::IOBuf>&& plaintext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  auto inputLength = plaintext->computeChainDataLength();
+  if (inputLength > Impl::kMaxKernelLength) {
+    return fallback_.encrypt(std::move(plaintext), associatedData, seqNum);
+  }
+
+  std::unique_ptr<folly::IOBuf> output;
+  folly::IOBuf* input;
+  if (plaintext->isShared()) {
+    // create enough to also fit the tag and headroom
+    output = folly::IOBuf::create(headroom_ + inputLength + Impl::kTagLength);
+    output->advance(headroom_);
+    output->append(inputLength);
+    input = plaintext.get();
+  } else {
+    output = std::move(plaintext);
+    input = output.get();
+  }
+
+  auto iv = createIV(seqNum);
+  typename Impl::Kernel::Stream stream(kernel_, folly::range(iv));
+  if (associatedData) {
+    for (auto current : *associatedData) {
+      stream.aad(current.data(), current.size());
+    }
+  }
+  transformBuffer(
+      *input, *output, [&](uint8_t* cipher, const uint8_t* plain, size_t len) {
+        stream.encrypt(cipher, plain, len);
+      });
+
+  // output is always something we can modify
+  auto lastBuf = output->prev();
+  if (lastBuf->tailroom() < Impl::kTagLength) {
+    auto tag = folly::IOBuf::create(Impl::kTagLength);
+    tag->append(Impl::kTagLength);
+    stream.finish(folly::MutableByteRange(tag->writableData(), tag->length()));
+    output->prependChain(std::move(tag));
+  } else {
+    lastBuf->append(Impl::kTagLength);
+    stream.finish(folly::MutableByteRange(
+        lastBuf->writableTail() - Impl::kTagLength, Impl::kTagLength));
+  }
+  return output;
+}
+
+template <typename Impl>
+folly::Optional<std::unique_ptr<folly::IOBuf>> NativeCipher<Impl>::tryDecrypt(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  auto inputLength = ciphertext->computeChainDataLength();
+  if (inputLength < Impl::kTagLength) {
+    return folly::none;
+  }
+  inputLength -= Impl::kTagLength;
+  if (inputLength > Impl::kMaxKernelLength) {
+    return fallback_.tryDecrypt(
+        std::move(ciphertext), associatedData, seqNum);
+  }
+
+  std::array<uint8_t, Impl::kTagLength> tag;
+  trimBytes(*ciphertext, folly::range(tag));
+
+  folly::IOBuf* input;
+  std::unique_ptr<folly::IOBuf> output;
+  if (ciphertext->isShared()) {
+    // If in is shared, then we have to make a copy of it.
+    output = folly::IOBuf::create(inputLength);
+    output->append(inputLength);
+    input = ciphertext.get();
+  } else {
+    // If in is not shared we can do decryption in-place.
+    output = std::move(ciphertext);
+    input = output.get();
+  }
+
+  auto iv = createIV(seqNum);
+  typename Impl::Kernel::Stream stream(kernel_, folly::range(iv));
+  if (associatedData) {
+    for (auto current : *associatedData) {
+      stream.aad(current.data(), current.size());
+    }
+  }
+  transformBuffer(
+      *input, *output, [&](uint8_t* plain, const uint8_t* cipher, size_t len) {
+        stream.decrypt(plain, cipher, len);
+      });
+
+  std::array<uint8_t, Impl::kTagLength> expectedTag;
+  stream.finish(folly::range(expectedTag));
+  if (!CryptoUtils::equal(folly::range(tag), folly::range(expectedTag))) {
+    return folly::none;
+  }
+  return std::move(output);
+}
+
+template <typename Impl>
+void NativeCipher<Impl>::encryptIov(
+    folly::Range<const struct iovec*> input,
+    folly::Range<const struct iovec*> output,
+    folly::MutableByteRange tag,
+    folly::ByteRange associatedData,
+    uint64_t seqNum) const {
+  auto inputLength = iovLength(input);
+  if (inputLength > Impl::kMaxKernelLength) {
+    return fallback_.encryptIov(input, output, tag, associatedData, seqNum);
+  }
+  if (iovLength(output) != inputLength || tag.size() != Impl::kTagLength) {
+    throw std::runtime_error("Invalid iov");
+  }
+
+  auto iv = createIV(seqNum);
+  typename Impl::Kernel::Stream stream(kernel_, folly::range(iv));
+  if (!associatedData.empty()) {
+    stream.aad(associatedData.data(), associatedData.size());
+  }
+  transformIov(
+      input, output, [&](uint8_t* cipher, const uint8_t* plain, size_t len) {
+        stream.encrypt(cipher, plain, len);
+      });
+  stream.finish(tag);
+}
+
+template <typename Impl>
+void NativeCipher<Impl>::batchEncryptIov(
+    folly::Range<const AeadIovRecord*> records) const {
+  folly::small_vector<std::array<uint8_t, Impl::kIVLength>, 8> ivs;
+  folly::small_vector<typename Impl::Kernel::Record, 8> kernelRecords;
+  // The kernel records point into ivs, so it must never reallocate.
+  ivs.reserve(records.size());
+  for (const auto& record : records) {
+    auto length = iovLength(record.input);
+    if (length > Impl::kMaxKernelLength || record.output.size() != 1) {
+      encryptIov(
+          record.input,
+          record.output,
+          record.tag,
+          record.associatedData,
+          record.seqNum);
+      continue;
+    }
+    if (record.output[0].iov_len != length ||
+        record.tag.size() != Impl::kTagLength) {
+      throw std::runtime_error("Invalid iov");
+    }
+
+    auto out = static_cast<uint8_t*>(record.output[0].iov_base);
+    const uint8_t* in;
+    if (record.input.size() == 1) {
+      in = static_cast<const uint8_t*>(record.input[0].iov_base);
+    } else {
+      // Gather the input into the output and encrypt it there.
+      auto pos = out;
+      for (const auto& current : record.input) {
+        memcpy(pos, current.iov_base, current.iov_len);
+        pos += current.iov_len;
+      }
+      in = out;
+    }
+    ivs.push_back(createIV(record.seqNum));
+    kernelRecords.push_back({ivs.back().data(),
+                             record.associatedData,
+                             in,
+                             out,
+                             length,
+                             record.tag.data()});
+  }
+  if (!kernelRecords.empty()) {
+    kernel_.encryptRecords(kernelRecords.data(), kernelRecords.size());
+  }
+}
+
+template <typename Impl>
+bool NativeCipher<Impl>::tryDecryptIov(
+    folly::Range<const struct iovec*> input,
+    folly::Range<const struct iovec*> output,
+    folly::ByteRange tag,
+    folly::ByteRange associatedData,
+    uint64_t seqNum) const {
+  auto inputLength = iovLength(input);
+  if (inputLength > Impl::kMaxKernelLength) {
+    return fallback_.tryDecryptIov(
+        input, output, tag, associatedData, seqNum);
+  }
+  if (iovLength(output) != inputLength || tag.size() != Impl::kTagLength) {
+    throw std::runtime_error("Invalid iov");
+  }
+
+  auto iv = createIV(seqNum);
+  typename Impl::Kernel::Stream stream(kernel_, folly::range(iv));
+  if (!associatedData.empty()) {
+    stream.aad(associatedData.data(), associatedData.size());
+  }
+  transformIov(
+      input, output, [&](uint8_t* plain, const uint8_t* cipher, size_t len) {
+        stream.decrypt(plain, cipher, len);
+      });
+
+  std::array<uint8_t, Impl::kTagLength> expectedTag;
+  stream.finish(folly::range(expectedTag));
+  return CryptoUtils::equal(tag, folly::range(expectedTag));
+}
+
+template <typename Impl>
+std::array<uint8_t, Impl::kIVLength> NativeCipher<Impl>::createIV(
+    uint64_t seqNum) const {
+  std::array<uint8_t, Impl::kIVLength> iv;
+  uint64_t bigEndianSeqNum = folly::Endian::big(seqNum);
+  const size_t prefixLength = Impl::kIVLength - sizeof(uint64_t);
+  memset(iv.data(), 0, prefixLength);
+  memcpy(iv.data() + prefixLength, &bigEndianSeqNum, 8);
+  XOR(folly::range(trafficIv_), folly::range(iv));
+  return iv;
+}
+} // namespace fizz
@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/aead/AESGCM128.h>
+#include <fizz/crypto/aead/AESGCM256.h>
+#include <fizz/crypto/aead/AESGCMKernel.h>
+#include <fizz/crypto/aead/Aead.h>
+#include <fizz/crypto/aead/ChaCha20Poly1305.h>
+#include <fizz/crypto/aead/ChaCha20Poly1305Kernel.h>
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+
+namespace fizz {
+
+struct NativeAESGCM128 {
+  using Kernel = AESGCMKernel;
+  using Fallback = AESGCM128;
+
+  static const size_t kKeyLength{16};
+  static const size_t kIVLength{12};
+  static const size_t kTagLength{16};
+  static const size_t kMaxKernelLength{1024};
+};
+
+struct NativeAESGCM256 {
+  using Kernel = AESGCMKernel;
+  using Fallback = AESGCM256;
+
+  static const size_t kKeyLength{32};
+  static const size_t kIVLength{12};
+  static const size_t kTagLength{16};
+  static const size_t kMaxKernelLength{1024};
+};
+
+struct NativeChaCha20Poly1305 {
+  using Kernel = ChaCha20Poly1305Kernel;
+  using Fallback = ChaCha20Poly1305;
+
+  static const size_t kKeyLength{32};
+  static const size_t kIVLength{12};
+  static const size_t kTagLength{16};
+  static const size_t kMaxKernelLength{512};
+};
+
+/**
+ * Aead implementation that calls a native kernel directly rather than going
+ * through EVP, avoiding the per-record EVP setup cost that dominates small
+ * records.
+ *
+ * The template struct requires the following parameters:
+ *   - Kernel: the native implementation (see AESGCMKernel)
+ *   - Fallback: EVPImpl for OpenSSLEVPCipher
+ *   - kKeyLength: length of key required
+ *   - kIVLength: length of iv required
+ *   - kTagLength: authentication tag length
+ *   - kMaxKernelLength: records with more plaintext than this are passed to
+ *         the EVP implementation, whose bulk routines are faster
+ *
+ * Only construct this if isSupported() returns true.
+ */
+template <typename Impl>
+class NativeCipher : public Aead {
+  static_assert(Impl::kIVLength >= sizeof(uint64_t), "iv too small");
+
+ public:
+  static bool isSupported() {
+    return Impl::Kernel::isSupported();
+  }
+
+  NativeCipher() = default;
+  ~NativeCipher() override = default;
+
+  void setKey(TrafficKey trafficKey) override;
+
+  size_t keyLength() const override {
+    return Impl::kKeyLength;
+  }
+
+  size_t ivLength() const override {
+    return Impl::kIVLength;
+  }
+
+  // Same buffer handling as OpenSSLEVPCipher::encrypt().
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  void encryptIov(
+      folly::Range<const struct iovec*> input,
+      folly::Range<const struct iovec*> output,
+      folly::MutableByteRange tag,
+      folly::ByteRange associatedData,
+      uint64_t seqNum) const override;
+
+  // Records of at most kMaxKernelLength bytes with a single output buffer are
+  // handed to the kernel together (see AESGCMKernel::encryptRecords()), the
+  // rest go through encryptIov().
+  void batchEncryptIov(
+      folly::Range<const AeadIovRecord*> records) const override;
+
+  bool tryDecryptIov(
+      folly::Range<const struct iovec*> input,
+      folly::Range<const struct iovec*> output,
+      folly::ByteRange tag,
+      folly::ByteRange associatedData,
+      uint64_t seqNum) const override;
+
+  bool supportsZeroCopyIov() const override {
+    return true;
+  }
+
+  size_t getCipherOverhead() const override {
+    return Impl::kTagLength;
+  }
+
+  void setEncryptedBufferHeadroom(size_t headroom) override {
+    headroom_ = headroom;
+    fallback_.setEncryptedBufferHeadroom(headroom);
+  }
+
+ private:
+  std::array<uint8_t, Impl::kIVLength> createIV(uint64_t seqNum) const;
+
+  typename Impl::Kernel kernel_;
+  std::array<uint8_t, Impl::kIVLength> trafficIv_;
+  size_t headroom_{5};
+
+  OpenSSLEVPCipher<typename Impl::Fallback> fallback_;
+};
+} // namespace fizz
+#include <fizz/crypto/aead/NativeCipher-inl.h>
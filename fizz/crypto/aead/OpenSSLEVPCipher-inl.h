@@ -24,6 +24,22 @@ std::unique_ptr<folly::IOBuf> evpEncrypt(
     bool useBlockOps,
     size_t headroom,
     EVP_CIPHER_CTX* encryptCtx);
+
+void evpEncryptIov(
+    folly::Range<const struct iovec*> input,
+    folly::Range<const struct iovec*> output,
+    folly::MutableByteRange tag,
+    folly::ByteRange associatedData,
+    folly::ByteRange iv,
+    EVP_CIPHER_CTX* encryptCtx);
+
+bool evpDecryptIov(
+    folly::Range<const struct iovec*> input,
+    folly::Range<const struct iovec*> output,
+    folly::ByteRange tag,
+    folly::ByteRange associatedData,
+    folly::ByteRange iv,
+    EVP_CIPHER_CTX* decryptCtx);
 } // namespace detail
 
 template <typename EVPImpl>
@@ -146,6 +162,42 @@ OpenSSLEVPCipher<EVPImpl>::tryDecrypt(
       decryptCtx_.get());
 }
 
+template <typename EVPImpl>
+void OpenSSLEVPCipher<EVPImpl>::encryptIov(
+    folly::Range<const struct iovec*> input,
+    folly::Range<const struct iovec*> output,
+    folly::MutableByteRange tag,
+    folly::ByteRange associatedData,
+    uint64_t seqNum) const {
+  if (EVPImpl::kOperatesInBlocks) {
+    return Aead::encryptIov(input, output, tag, associatedData, seqNum);
+  }
+  if (tag.size() != EVPImpl::kTagLength) {
+    throw std::runtime_error("Invalid tag");
+  }
+  auto iv = createIV(seqNum);
+  detail::evpEncryptIov(
+      input, output, tag, associatedData, iv, encryptCtx_.get());
+}
+
+template <typename EVPImpl>
+bool OpenSSLEVPCipher<EVPImpl>::tryDecryptIov(
+    folly::Range<const struct iovec*> input,
+    folly::Range<const struct iovec*> output,
+    folly::ByteRange tag,
+    folly::ByteRange associatedData,
+    uint64_t seqNum) const {
+  if (EVPImpl::kOperatesInBlocks) {
+    return Aead::tryDecryptIov(input, output, tag, associatedData, seqNum);
+  }
+  if (tag.size() != EVPImpl::kTagLength) {
+    throw std::runtime_error("Invalid tag");
+  }
+  auto iv = createIV(seqNum);
+  return detail::evpDecryptIov(
+      input, output, tag, associatedData, iv, decryptCtx_.get());
+}
+
 template <typename EVPImpl>
 size_t OpenSSLEVPCipher<EVPImpl>::getCipherOverhead() const {
   return EVPImpl::kTagLength;
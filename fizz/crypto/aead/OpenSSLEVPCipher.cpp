@@ -319,5 +319,113 @@ folly::Optional<std::unique_ptr<folly::IOBuf>> evpDecrypt(
   }
   return std::move(output);
 }
+
+void evpEncryptIov(
+    folly::Range<const struct iovec*> input,
+    folly::Range<const struct iovec*> output,
+    folly::MutableByteRange tag,
+    folly::ByteRange associatedData,
+    folly::ByteRange iv,
+    EVP_CIPHER_CTX* encryptCtx) {
+  if (iovLength(input) != iovLength(output)) {
+    throw std::runtime_error("Invalid iov");
+  }
+  if (associatedData.size() > std::numeric_limits<int>::max()) {
+    throw std::runtime_error("too much associated data");
+  }
+
+  if (EVP_EncryptInit_ex(encryptCtx, nullptr, nullptr, nullptr, iv.data()) !=
+      1) {
+    throw std::runtime_error("Encryption error");
+  }
+
+  int outLen = 0;
+  if (!associatedData.empty() &&
+      EVP_EncryptUpdate(
+          encryptCtx,
+          nullptr,
+          &outLen,
+          associatedData.data(),
+          static_cast<int>(associatedData.size())) != 1) {
+    throw std::runtime_error("Encryption error");
+  }
+
+  transformIov(
+      input, output, [&](uint8_t* cipher, const uint8_t* plain, size_t len) {
+        if (len > std::numeric_limits<int>::max()) {
+          throw std::runtime_error("Encryption error: too much plain text");
+        }
+        if (EVP_EncryptUpdate(
+                encryptCtx, cipher, &outLen, plain, static_cast<int>(len)) !=
+            1) {
+          throw std::runtime_error("Encryption error");
+        }
+      });
+
+  // We don't expect any writes at the end
+  std::array<uint8_t, 16> block;
+  if (EVP_EncryptFinal_ex(encryptCtx, block.data(), &outLen) != 1) {
+    throw std::runtime_error("Encryption error");
+  }
+  if (EVP_CIPHER_CTX_ctrl(
+          encryptCtx, EVP_CTRL_GCM_GET_TAG, tag.size(), tag.begin()) != 1) {
+    throw std::runtime_error("Encryption error");
+  }
+}
+
+bool evpDecryptIov(
+    folly::Range<const struct iovec*> input,
+    folly::Range<const struct iovec*> output,
+    folly::ByteRange tag,
+    folly::ByteRange associatedData,
+    folly::ByteRange iv,
+    EVP_CIPHER_CTX* decryptCtx) {
+  if (iovLength(input) != iovLength(output)) {
+    throw std::runtime_error("Invalid iov");
+  }
+  if (associatedData.size() > std::numeric_limits<int>::max()) {
+    throw std::runtime_error("too much associated data");
+  }
+
+  if (EVP_DecryptInit_ex(decryptCtx, nullptr, nullptr, nullptr, iv.data()) !=
+      1) {
+    throw std::runtime_error("Decryption error");
+  }
+
+  int outLen = 0;
+  if (!associatedData.empty() &&
+      EVP_DecryptUpdate(
+          decryptCtx,
+          nullptr,
+          &outLen,
+          associatedData.data(),
+          static_cast<int>(associatedData.size())) != 1) {
+    throw std::runtime_error("Decryption error");
+  }
+
+  transformIov(
+      input, output, [&](uint8_t* plain, const uint8_t* cipher, size_t len) {
+        if (len > std::numeric_limits<int>::max()) {
+          throw std::runtime_error("Decryption error: too much cipher text");
+        }
+        if (EVP_DecryptUpdate(
+                decryptCtx, plain, &outLen, cipher, static_cast<int>(len)) !=
+            1) {
+          throw std::runtime_error("Decryption error");
+        }
+      });
+
+  // OpenSSL only reads the tag, it just takes a non const pointer.
+  if (EVP_CIPHER_CTX_ctrl(
+          decryptCtx,
+          EVP_CTRL_GCM_SET_TAG,
+          tag.size(),
+          const_cast<uint8_t*>(tag.begin())) != 1) {
+    throw std::runtime_error("Decryption error");
+  }
+  // We don't expect any writes at the end
+  std::array<uint8_t, 16> block;
+  return EVP_DecryptFinal_ex(decryptCtx, block.data(), &outLen) == 1;
+}
 } // namespace detail
 } // namespace fizz
@@ -70,6 +70,27 @@ class OpenSSLEVPCipher : public Aead {
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const override;
 
+  // Streams each segment straight through the EVP context. Block based
+  // ciphers buffer partial blocks inside EVP, so they use the copying
+  // default instead.
+  void encryptIov(
+      folly::Range<const struct iovec*> input,
+      folly::Range<const struct iovec*> output,
+      folly::MutableByteRange tag,
+      folly::ByteRange associatedData,
+      uint64_t seqNum) const override;
+
+  bool tryDecryptIov(
+      folly::Range<const struct iovec*> input,
+      folly::Range<const struct iovec*> output,
+      folly::ByteRange tag,
+      folly::ByteRange associatedData,
+      uint64_t seqNum) const override;
+
+  bool supportsZeroCopyIov() const override {
+    return !EVPImpl::kOperatesInBlocks;
+  }
+
   size_t getCipherOverhead() const override;
 
   void setEncryptedBufferHeadroom(size_t headroom) override {
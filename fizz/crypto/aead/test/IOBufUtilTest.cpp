@@ -126,6 +126,32 @@ struct BlockWriter {
   uint8_t block[8] = {0};
 };
 
+TEST(IOBufUtilTest, TransformIov) {
+  auto in = IOBuf::copyBuffer("hello");
+  in->prependChain(IOBuf::copyBuffer("world"));
+  in->prependChain(IOBuf::create(0));
+  in->prependChain(IOBuf::copyBuffer("speak"));
+  auto inIov = in->getIov();
+
+  std::array<uint8_t, 15> outData;
+  std::array<struct iovec, 4> outIov = {{{outData.data(), 2},
+                                         {outData.data() + 2, 0},
+                                         {outData.data() + 2, 12},
+                                         {outData.data() + 14, 1}}};
+  EXPECT_EQ(iovLength(range(inIov)), 15);
+  EXPECT_EQ(iovLength(range(outIov)), 15);
+
+  transformIov(
+      range(inIov),
+      range(outIov),
+      [](uint8_t* out, const uint8_t* input, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+          out[i] = input[i] + 1;
+        }
+      });
+  EXPECT_EQ(std::string(outData.begin(), outData.end()), "ifmmpxpsmetqfbl");
+}
+
 TEST(IOBufUtilTest, TransformBufferBlocks) {
   // 2 blocks of size 8
   auto buf = IOBuf::copyBuffer("0000111122223333");
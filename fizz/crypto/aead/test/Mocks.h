@@ -68,6 +68,37 @@ class MockAead : public Aead {
     return _tryDecrypt(ciphertext, associatedData, seqNum);
   }
 
+  MOCK_CONST_METHOD5(
+      encryptIov,
+      void(
+          folly::Range<const struct iovec*> input,
+          folly::Range<const struct iovec*> output,
+          folly::MutableByteRange tag,
+          folly::ByteRange associatedData,
+          uint64_t seqNum));
+
+  // Records the batch and then encrypts it record by record, so that tests
+  // can set expectations on either.
+  MOCK_CONST_METHOD1(
+      _batchEncryptIov,
+      void(folly::Range<const AeadIovRecord*> records));
+  void batchEncryptIov(
+      folly::Range<const AeadIovRecord*> records) const override {
+    _batchEncryptIov(records);
+    Aead::batchEncryptIov(records);
+  }
+
+  MOCK_CONST_METHOD5(
+      tryDecryptIov,
+      bool(
+          folly::Range<const struct iovec*> input,
+          folly::Range<const struct iovec*> output,
+          folly::ByteRange tag,
+          folly::ByteRange associatedData,
+          uint64_t seqNum));
+
+  MOCK_CONST_METHOD0(supportsZeroCopyIov, bool());
+
   void setDefaults() {
     ON_CALL(*this, _encrypt(_, _, _)).WillByDefault(InvokeWithoutArgs([]() {
       return folly::IOBuf::copyBuffer("ciphertext");
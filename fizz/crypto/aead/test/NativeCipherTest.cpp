@@ -0,0 +1,451 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/portability/GTest.h>
+
+#include <fizz/crypto/aead/AESGCM128.h>
+#include <fizz/crypto/aead/AESGCM256.h>
+#include <fizz/crypto/aead/ChaCha20Poly1305.h>
+#include <fizz/crypto/aead/NativeCipher.h>
+#include <fizz/crypto/aead/test/TestUtil.h>
+#include <fizz/record/Types.h>
+#include <folly/Random.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+struct NativeParams {
+  CipherSuite cipher;
+  size_t length;
+  size_t chunks;
+};
+
+class NativeCipherTest : public ::testing::TestWithParam<NativeParams> {
+ protected:
+  void SetUp() override {
+    switch (GetParam().cipher) {
+      case CipherSuite::TLS_AES_128_GCM_SHA256:
+        makeCiphers<NativeAESGCM128>();
+        break;
+      case CipherSuite::TLS_AES_256_GCM_SHA384:
+        makeCiphers<NativeAESGCM256>();
+        break;
+      case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
+        makeCiphers<NativeChaCha20Poly1305>();
+        break;
+      default:
+        throw std::runtime_error("Invalid cipher");
+    }
+  }
+
+  template <typename Impl>
+  void makeCiphers() {
+    if (!NativeCipher<Impl>::isSupported()) {
+      LOG(INFO) << "Native cipher not supported on this CPU, skipping";
+      return;
+    }
+    native_ = std::make_unique<NativeCipher<Impl>>();
+    evp_ = std::make_unique<OpenSSLEVPCipher<typename Impl::Fallback>>();
+    auto key = randomBuf(Impl::kKeyLength);
+    auto iv = randomBuf(Impl::kIVLength);
+    native_->setKey({key->clone(), iv->clone()});
+    evp_->setKey({std::move(key), std::move(iv)});
+  }
+
+  static std::unique_ptr<IOBuf> randomBuf(size_t len) {
+    auto buf = IOBuf::create(len);
+    buf->append(len);
+    Random::secureRandom(buf->writableData(), len);
+    return buf;
+  }
+
+  std::unique_ptr<IOBuf> plaintext() {
+    auto buf = randomBuf(GetParam().length);
+    if (GetParam().chunks == 1) {
+      return buf;
+    }
+    return chunkIOBuf(std::move(buf), GetParam().chunks);
+  }
+
+  std::unique_ptr<Aead> native_;
+  std::unique_ptr<Aead> evp_;
+};
+
+TEST_P(NativeCipherTest, TestMatchesEVP) {
+  if (!native_) {
+    return;
+  }
+  auto aad = chunkIOBuf(randomBuf(13), 3);
+  auto input = plaintext();
+  auto expected = evp_->encrypt(input->clone(), aad.get(), 7);
+  auto out = native_->encrypt(std::move(input), aad.get(), 7);
+  EXPECT_TRUE(IOBufEqualTo()(expected, out));
+}
+
+TEST_P(NativeCipherTest, TestSharedInput) {
+  if (!native_) {
+    return;
+  }
+  auto input = plaintext();
+  auto copy = input->clone();
+  copy->unshare();
+  auto expected = evp_->encrypt(input->clone(), nullptr, 0);
+  auto out = native_->encrypt(input->clone(), nullptr, 0);
+  EXPECT_TRUE(IOBufEqualTo()(expected, out));
+  // the shared input must not have been encrypted in place
+  EXPECT_TRUE(IOBufEqualTo()(copy, input));
+}
+
+TEST_P(NativeCipherTest, TestRoundTrip) {
+  if (!native_) {
+    return;
+  }
+  auto aad = randomBuf(5);
+  auto input = plaintext();
+  auto copy = input->clone();
+  copy->unshare();
+  auto ciphertext = native_->encrypt(std::move(input), aad.get(), 3);
+  auto chunked = chunkIOBuf(ciphertext->clone(), 4);
+  auto fromEvp = evp_->decrypt(std::move(chunked), aad.get(), 3);
+  EXPECT_TRUE(IOBufEqualTo()(copy, fromEvp));
+  auto out = native_->decrypt(std::move(ciphertext), aad.get(), 3);
+  EXPECT_TRUE(IOBufEqualTo()(copy, out));
+}
+
+TEST_P(NativeCipherTest, TestDecryptTampered) {
+  if (!native_) {
+    return;
+  }
+  auto ciphertext = native_->encrypt(plaintext(), nullptr, 1);
+  ciphertext->coalesce();
+  ciphertext->writableData()[0] ^= 0x01;
+  EXPECT_FALSE(native_->tryDecrypt(std::move(ciphertext), nullptr, 1));
+}
+
+TEST_P(NativeCipherTest, TestDecryptWrongSeqNum) {
+  if (!native_) {
+    return;
+  }
+  auto ciphertext = native_->encrypt(plaintext(), nullptr, 1);
+  EXPECT_FALSE(native_->tryDecrypt(std::move(ciphertext), nullptr, 2));
+}
+
+TEST_P(NativeCipherTest, TestIovMatchesEVP) {
+  if (!native_) {
+    return;
+  }
+  auto aad = randomBuf(13);
+  auto input = plaintext();
+  auto expected = evp_->encrypt(input->clone(), aad.get(), 5);
+  auto output = randomBuf(GetParam().length);
+  auto inputIov = input->getIov();
+  auto outputIov = output->getIov();
+  auto tag = randomBuf(native_->getCipherOverhead());
+  native_->encryptIov(
+      range(inputIov),
+      range(outputIov),
+      MutableByteRange(tag->writableData(), tag->length()),
+      aad->coalesce(),
+      5);
+  output->prependChain(std::move(tag));
+  EXPECT_TRUE(IOBufEqualTo()(expected, output));
+}
+
+TEST_P(NativeCipherTest, TestIovRoundTrip) {
+  if (!native_) {
+    return;
+  }
+  auto aad = randomBuf(5);
+  auto data = plaintext();
+  auto copy = data->clone();
+  copy->unshare();
+  auto iov = data->getIov();
+  std::vector<uint8_t> tag(native_->getCipherOverhead());
+  native_->encryptIov(range(iov), range(iov), range(tag), aad->coalesce(), 9);
+  EXPECT_TRUE(native_->tryDecryptIov(
+      range(iov), range(iov), range(tag), aad->coalesce(), 9));
+  EXPECT_TRUE(IOBufEqualTo()(copy, data));
+  EXPECT_FALSE(native_->tryDecryptIov(
+      range(iov), range(iov), range(tag), aad->coalesce(), 10));
+}
+
+TEST_P(NativeCipherTest, TestBatchEncryptIovMatchesEVP) {
+  if (!native_) {
+    return;
+  }
+  // More records than the kernels take at once, of different lengths, with
+  // and without associated data, in place and into a separate buffer.
+  constexpr size_t kRecords = 9;
+  auto aad = randomBuf(5);
+  std::vector<std::unique_ptr<IOBuf>> expected;
+  std::vector<std::unique_ptr<IOBuf>> outputs;
+  std::vector<std::unique_ptr<IOBuf>> inputs;
+  std::vector<std::unique_ptr<IOBuf>> tags;
+  std::vector<fbvector<struct iovec>> inputIovs;
+  std::vector<fbvector<struct iovec>> outputIovs;
+  std::vector<AeadIovRecord> records(kRecords);
+  // The records point into the iovecs.
+  inputIovs.reserve(kRecords);
+  outputIovs.reserve(kRecords);
+  for (size_t i = 0; i < kRecords; ++i) {
+    auto length = 1 + GetParam().length * (i + 1) / kRecords;
+    auto input = randomBuf(length);
+    if (GetParam().chunks > 1) {
+      input = chunkIOBuf(std::move(input), GetParam().chunks);
+    }
+    bool withAad = i % 3 != 0;
+    expected.push_back(
+        evp_->encrypt(input->clone(), withAad ? aad.get() : nullptr, i));
+    if (i % 2 == 0) {
+      outputs.push_back(std::move(input));
+      inputs.push_back(nullptr);
+      inputIovs.push_back(outputs.back()->getIov());
+    } else {
+      inputs.push_back(std::move(input));
+      outputs.push_back(randomBuf(length));
+      inputIovs.push_back(inputs.back()->getIov());
+    }
+    outputIovs.push_back(outputs.back()->getIov());
+    tags.push_back(randomBuf(native_->getCipherOverhead()));
+
+    records[i].input = range(inputIovs.back());
+    records[i].output = range(outputIovs.back());
+    records[i].tag =
+        MutableByteRange(tags.back()->writableData(), tags.back()->length());
+    records[i].associatedData = withAad ? aad->coalesce() : ByteRange();
+    records[i].seqNum = i;
+  }
+  native_->batchEncryptIov(range(records));
+  for (size_t i = 0; i < kRecords; ++i) {
+    outputs[i]->prependChain(std::move(tags[i]));
+    EXPECT_TRUE(IOBufEqualTo()(expected[i], outputs[i]));
+  }
+}
+
+std::vector<NativeParams> getParams() {
+  std::vector<NativeParams> params;
+  for (auto cipher :
+       {CipherSuite::TLS_AES_128_GCM_SHA256,
+        CipherSuite::TLS_AES_256_GCM_SHA384,
+        CipherSuite::TLS_CHACHA20_POLY1305_SHA256}) {
+    for (size_t length :
+         {1, 15, 16, 17, 63, 64, 65, 100, 511, 512, 513, 1024, 1025, 5000}) {
+      for (size_t chunks : {1, 3, 7}) {
+        params.push_back({cipher, length, chunks});
+      }
+    }
+  }
+  return params;
+}
+
+INSTANTIATE_TEST_CASE_P(
+    NativeCiphers,
+    NativeCipherTest,
+    ::testing::ValuesIn(getParams()));
+
+struct NativeVector {
+  CipherSuite cipher;
+  std::string key;
+  std::string iv;
+  std::string aad;
+  std::string plaintext;
+  std::string ciphertext;
+};
+
+class NativeCipherVectorTest : public ::testing::TestWithParam<NativeVector> {
+ protected:
+  void SetUp() override {
+    switch (GetParam().cipher) {
+      case CipherSuite::TLS_AES_128_GCM_SHA256:
+        makeCipher<NativeAESGCM128>();
+        break;
+      case CipherSuite::TLS_AES_256_GCM_SHA384:
+        makeCipher<NativeAESGCM256>();
+        break;
+      case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
+        makeCipher<NativeChaCha20Poly1305>();
+        break;
+      default:
+        throw std::runtime_error("Invalid cipher");
+    }
+  }
+
+  template <typename Impl>
+  void makeCipher() {
+    if (!NativeCipher<Impl>::isSupported()) {
+      LOG(INFO) << "Native cipher not supported on this CPU, skipping";
+      return;
+    }
+    native_ = std::make_unique<NativeCipher<Impl>>();
+    native_->setKey({toIOBuf(GetParam().key), toIOBuf(GetParam().iv)});
+  }
+
+  std::unique_ptr<IOBuf> aad() {
+    if (GetParam().aad.empty()) {
+      return nullptr;
+    }
+    return toIOBuf(GetParam().aad);
+  }
+
+  std::unique_ptr<Aead> native_;
+};
+
+TEST_P(NativeCipherVectorTest, TestEncrypt) {
+  if (!native_) {
+    return;
+  }
+  auto aadBuf = aad();
+  auto out = native_->encrypt(toIOBuf(GetParam().plaintext), aadBuf.get(), 0);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().ciphertext), out));
+}
+
+TEST_P(NativeCipherVectorTest, TestDecrypt) {
+  if (!native_) {
+    return;
+  }
+  auto aadBuf = aad();
+  auto out = native_->tryDecrypt(
+      chunkIOBuf(toIOBuf(GetParam().ciphertext), 3), aadBuf.get(), 0);
+  ASSERT_TRUE(out.hasValue());
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), *out));
+}
+
+// Test cases 1-4 and 13-16 of the GCM specification (McGrew and Viega).
+INSTANTIATE_TEST_CASE_P(
+    AESGCMTestVectors,
+    NativeCipherVectorTest,
+    ::testing::Values(
+        NativeVector{CipherSuite::TLS_AES_128_GCM_SHA256,
+                     "00000000000000000000000000000000",
+                     "000000000000000000000000",
+                     "",
+                     "",
+                     "58e2fccefa7e3061367f1d57a4e7455a"},
+        NativeVector{CipherSuite::TLS_AES_128_GCM_SHA256,
+                     "00000000000000000000000000000000",
+                     "000000000000000000000000",
+                     "",
+                     "00000000000000000000000000000000",
+                     "0388dace60b6a392f328c2b971b2fe78"
+                     "ab6e47d42cec13bdf53a67b21257bddf"},
+        NativeVector{CipherSuite::TLS_AES_128_GCM_SHA256,
+                     "feffe9928665731c6d6a8f9467308308",
+                     "cafebabefacedbaddecaf888",
+                     "",
+                     "d9313225f88406e5a55909c5aff5269a"
+                     "86a7a9531534f7da2e4c303d8a318a72"
+                     "1c3c0c95956809532fcf0e2449a6b525"
+                     "b16aedf5aa0de657ba637b391aafd255",
+                     "42831ec2217774244b7221b784d0d49c"
+                     "e3aa212f2c02a4e035c17e2329aca12e"
+                     "21d514b25466931c7d8f6a5aac84aa05"
+                     "1ba30b396a0aac973d58e091473f5985"
+                     "4d5c2af327cd64a62cf35abd2ba6fab4"},
+        NativeVector{CipherSuite::TLS_AES_128_GCM_SHA256,
+                     "feffe9928665731c6d6a8f9467308308",
+                     "cafebabefacedbaddecaf888",
+                     "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+                     "d9313225f88406e5a55909c5aff5269a"
+                     "86a7a9531534f7da2e4c303d8a318a72"
+                     "1c3c0c95956809532fcf0e2449a6b525"
+                     "b16aedf5aa0de657ba637b39",
+                     "42831ec2217774244b7221b784d0d49c"
+                     "e3aa212f2c02a4e035c17e2329aca12e"
+                     "21d514b25466931c7d8f6a5aac84aa05"
+                     "1ba30b396a0aac973d58e091"
+                     "5bc94fbc3221a5db94fae95ae7121a47"},
+        NativeVector{CipherSuite::TLS_AES_256_GCM_SHA384,
+                     "00000000000000000000000000000000"
+                     "00000000000000000000000000000000",
+                     "000000000000000000000000",
+                     "",
+                     "",
+                     "530f8afbc74536b9a963b4f1c4cb738b"},
+        NativeVector{CipherSuite::TLS_AES_256_GCM_SHA384,
+                     "00000000000000000000000000000000"
+                     "00000000000000000000000000000000",
+                     "000000000000000000000000",
+                     "",
+                     "00000000000000000000000000000000",
+                     "cea7403d4d606b6e074ec5d3baf39d18"
+                     "d0d1c8a799996bf0265b98b5d48ab919"},
+        NativeVector{CipherSuite::TLS_AES_256_GCM_SHA384,
+                     "feffe9928665731c6d6a8f9467308308"
+                     "feffe9928665731c6d6a8f9467308308",
+                     "cafebabefacedbaddecaf888",
+                     "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+                     "d9313225f88406e5a55909c5aff5269a"
+                     "86a7a9531534f7da2e4c303d8a318a72"
+                     "1c3c0c95956809532fcf0e2449a6b525"
+                     "b16aedf5aa0de657ba637b39",
+                     "522dc1f099567d07f47f37a32a84427d"
+                     "643a8cdcbfe5c0c97598a2bd2555d1aa"
+                     "8cb08e48590dbb3da7b08b1056828838"
+                     "c5f61e6393ba7a0abcc9f662"
+                     "76fc6ece0f4e1768cddf8853bb2d551b"}));
+
+// RFC 8439 section 2.8.2, and the same without associated data.
+INSTANTIATE_TEST_CASE_P(
+    ChaChaTestVectors,
+    NativeCipherVectorTest,
+    ::testing::Values(
+        NativeVector{CipherSuite::TLS_CHACHA20_POLY1305_SHA256,
+                     "808182838485868788898a8b8c8d8e8f"
+                     "909192939495969798999a9b9c9d9e9f",
+                     "070000004041424344454647",
+                     "50515253c0c1c2c3c4c5c6c7",
+                     "4c616469657320616e642047656e746c"
+                     "656d656e206f662074686520636c6173"
+                     "73206f66202739393a20496620492063"
+                     "6f756c64206f6666657220796f75206f"
+                     "6e6c79206f6e652074697020666f7220"
+                     "746865206675747572652c2073756e73"
+                     "637265656e20776f756c642062652069"
+                     "742e",
+                     "d31a8d34648e60db7b86afbc53ef7ec2"
+                     "a4aded51296e08fea9e2b5a736ee62d6"
+                     "3dbea45e8ca9671282fafb69da92728b"
+                     "1a71de0a9e060b2905d6a5b67ecd3b36"
+                     "92ddbd7f2d778b8c9803aee328091b58"
+                     "fab324e4fad675945585808b4831d7bc"
+                     "3ff4def08e4b7a9de576d26586cec64b"
+                     "6116"
+                     "1ae10b594f09e26a7e902ecbd0600691"},
+        NativeVector{CipherSuite::TLS_CHACHA20_POLY1305_SHA256,
+                     "808182838485868788898a8b8c8d8e8f"
+                     "909192939495969798999a9b9c9d9e9f",
+                     "070000004041424344454647",
+                     "",
+                     "4c616469657320616e642047656e746c"
+                     "656d656e206f662074686520636c6173"
+                     "73206f66202739393a20496620492063"
+                     "6f756c64206f6666657220796f75206f"
+                     "6e6c79206f6e652074697020666f7220"
+                     "746865206675747572652c2073756e73"
+                     "637265656e20776f756c642062652069"
+                     "742e",
+                     "d31a8d34648e60db7b86afbc53ef7ec2"
+                     "a4aded51296e08fea9e2b5a736ee62d6"
+                     "3dbea45e8ca9671282fafb69da92728b"
+                     "1a71de0a9e060b2905d6a5b67ecd3b36"
+                     "92ddbd7f2d778b8c9803aee328091b58"
+                     "fab324e4fad675945585808b4831d7bc"
+                     "3ff4def08e4b7a9de576d26586cec64b"
+                     "6116"
+                     "6a23a4681fd59456aea1d29f82477216"},
+        NativeVector{CipherSuite::TLS_CHACHA20_POLY1305_SHA256,
+                     "9a97f65b9b4c721b960a672145fca8d4"
+                     "e32e67f9111ea979ce9c4826806aeee6",
+                     "000000003de9c0da2bd7f91e",
+                     "",
+                     "",
+                     "5a6e21f4ba6dbee57380e79e79c30def"}));
+} // namespace test
+} // namespace fizz
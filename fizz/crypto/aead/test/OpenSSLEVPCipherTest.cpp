@@ -215,6 +215,80 @@ TEST_P(OpenSSLEVPCipherTest, TestEncryptChunkedAad) {
   callEncrypt(cipher, GetParam(), nullptr, std::move(chunkedAad));
 }
 
+TEST_P(OpenSSLEVPCipherTest, TestEncryptIov) {
+  auto cipher = getCipher(GetParam());
+  auto aad = toIOBuf(GetParam().aad);
+  auto data = chunkIOBuf(toIOBuf(GetParam().plaintext), 3);
+  auto iov = data->getIov();
+  std::vector<uint8_t> tag(cipher->getCipherOverhead());
+  cipher->encryptIov(
+      range(iov), range(iov), range(tag), aad->coalesce(), GetParam().seqNum);
+  data->prependChain(IOBuf::copyBuffer(tag.data(), tag.size()));
+  bool valid = IOBufEqualTo()(toIOBuf(GetParam().ciphertext), data);
+  EXPECT_EQ(valid, GetParam().valid);
+}
+
+TEST_P(OpenSSLEVPCipherTest, TestEncryptIovOutOfPlace) {
+  auto cipher = getCipher(GetParam());
+  auto aad = toIOBuf(GetParam().aad);
+  auto input = toIOBuf(GetParam().plaintext);
+  auto inputCopy = copyBuffer(*input);
+  auto output = chunkIOBuf(toIOBuf(GetParam().plaintext), 3);
+  auto inputIov = input->getIov();
+  auto outputIov = output->getIov();
+  std::vector<uint8_t> tag(cipher->getCipherOverhead());
+  cipher->encryptIov(
+      range(inputIov),
+      range(outputIov),
+      range(tag),
+      aad->coalesce(),
+      GetParam().seqNum);
+  output->prependChain(IOBuf::copyBuffer(tag.data(), tag.size()));
+  bool valid = IOBufEqualTo()(toIOBuf(GetParam().ciphertext), output);
+  EXPECT_EQ(valid, GetParam().valid);
+  EXPECT_TRUE(IOBufEqualTo()(inputCopy, input));
+}
+
+TEST_P(OpenSSLEVPCipherTest, TestEncryptIovMismatchedLength) {
+  auto cipher = getCipher(GetParam());
+  auto input = toIOBuf(GetParam().plaintext);
+  auto output = IOBuf::create(input->length() + 1);
+  output->append(input->length() + 1);
+  auto inputIov = input->getIov();
+  auto outputIov = output->getIov();
+  std::vector<uint8_t> tag(cipher->getCipherOverhead());
+  EXPECT_THROW(
+      cipher->encryptIov(
+          range(inputIov),
+          range(outputIov),
+          range(tag),
+          ByteRange(),
+          GetParam().seqNum),
+      std::runtime_error);
+}
+
+TEST_P(OpenSSLEVPCipherTest, TestDecryptIov) {
+  auto cipher = getCipher(GetParam());
+  auto aad = toIOBuf(GetParam().aad);
+  auto data = toIOBuf(GetParam().ciphertext);
+  std::vector<uint8_t> tag(cipher->getCipherOverhead());
+  if (data->length() < tag.size()) {
+    EXPECT_FALSE(GetParam().valid);
+    return;
+  }
+  trimBytes(*data, range(tag));
+  data = chunkIOBuf(std::move(data), 3);
+  auto iov = data->getIov();
+  auto decrypted = cipher->tryDecryptIov(
+      range(iov), range(iov), range(tag), aad->coalesce(), GetParam().seqNum);
+  if (decrypted) {
+    EXPECT_TRUE(GetParam().valid);
+    EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), data));
+  } else {
+    EXPECT_FALSE(GetParam().valid);
+  }
+}
+
 TEST_P(OpenSSLEVPCipherTest, TestDecrypt) {
   auto cipher = getCipher(GetParam());
   callDecrypt(cipher, GetParam());
@@ -44,6 +44,13 @@ class OpenSSLKeyExchange : public KeyExchange {
     return keyExchange_.generateSharedSecret(key);
   }
 
+  /**
+   * Returns the key pair, which is empty until generateKeyPair() is called.
+   */
+  const folly::ssl::EvpPkeyUniquePtr& getKey() const {
+    return keyExchange_.getKey();
+  }
+
  private:
   detail::OpenSSLECKeyExchange<T> keyExchange_;
 };
@@ -55,6 +55,85 @@ std::unique_ptr<folly::IOBuf> generateEvpSharedSecret(
   return buf;
 }
 
+std::vector<folly::Try<std::unique_ptr<folly::IOBuf>>>
+generateECSharedSecrets(
+    int curveNid,
+    const std::vector<std::pair<EVP_PKEY*, EVP_PKEY*>>& keys) {
+  using Result = folly::Try<std::unique_ptr<folly::IOBuf>>;
+  std::vector<Result> results(keys.size());
+  auto fail = [&results](size_t i, const char* error) {
+    results[i] = Result(folly::make_exception_wrapper<std::runtime_error>(
+        std::string(error) + ": " + getOpenSSLError()));
+  };
+
+  folly::ssl::EcGroupUniquePtr curve(EC_GROUP_new_by_curve_name(curveNid));
+  folly::ssl::BNCtxUniquePtr ctx(BN_CTX_new());
+  if (!curve || !ctx) {
+    throw std::runtime_error("Error initializing curve");
+  }
+  auto secretLen = (EC_GROUP_get_degree(curve.get()) + 7) / 8;
+
+  // priv * peer for each pair, left in projective coordinates.
+  std::vector<folly::ssl::EcPointUniquePtr> products(keys.size());
+  std::vector<EC_POINT*> batch;
+  batch.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto key = EVP_PKEY_get0_EC_KEY(keys[i].first);
+    auto peerKey = EVP_PKEY_get0_EC_KEY(keys[i].second);
+    if (!key || !peerKey || !EC_KEY_get0_private_key(key) ||
+        EC_GROUP_cmp(EC_KEY_get0_group(key), curve.get(), ctx.get()) != 0 ||
+        EC_GROUP_cmp(EC_KEY_get0_group(peerKey), curve.get(), ctx.get()) !=
+            0) {
+      fail(i, "Invalid key");
+      continue;
+    }
+    folly::ssl::EcPointUniquePtr product(EC_POINT_new(curve.get()));
+    if (!product ||
+        EC_POINT_mul(
+            curve.get(),
+            product.get(),
+            nullptr,
+            EC_KEY_get0_public_key(peerKey),
+            EC_KEY_get0_private_key(key),
+            ctx.get()) != 1 ||
+        EC_POINT_is_at_infinity(curve.get(), product.get()) == 1) {
+      fail(i, "Error deriving key");
+      continue;
+    }
+    batch.push_back(product.get());
+    products[i] = std::move(product);
+  }
+
+  // Montgomery's trick: one inversion for every point in the batch.
+  if (!batch.empty() &&
+      EC_POINTs_make_affine(
+          curve.get(), batch.size(), batch.data(), ctx.get()) != 1) {
+    throw std::runtime_error("Error converting points: " + getOpenSSLError());
+  }
+
+  folly::ssl::BIGNUMUniquePtr x(BN_new());
+  if (!x) {
+    throw std::runtime_error("Error allocating bignum");
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (!products[i]) {
+      continue;
+    }
+    auto secret = folly::IOBuf::create(secretLen);
+    if (EC_POINT_get_affine_coordinates_GFp(
+            curve.get(), products[i].get(), x.get(), nullptr, ctx.get()) !=
+            1 ||
+        BN_bn2binpad(x.get(), secret->writableData(), secretLen) !=
+            static_cast<int>(secretLen)) {
+      fail(i, "Error deriving key");
+      continue;
+    }
+    secret->append(secretLen);
+    results[i] = Result(std::move(secret));
+  }
+  return results;
+}
+
 folly::ssl::EvpPkeyUniquePtr generateECKeyPair(int curveNid) {
   folly::ssl::EcKeyUniquePtr ecParamKey(EC_KEY_new_by_curve_name(curveNid));
   folly::ssl::EvpPkeyUniquePtr params(EVP_PKEY_new());
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <folly/Range.h>
+#include <folly/Try.h>
 #include <folly/io/IOBuf.h>
 #include <folly/ssl/OpenSSLPtrTypes.h>
 
@@ -53,6 +54,19 @@ std::unique_ptr<folly::IOBuf> generateEvpSharedSecret(
     const folly::ssl::EvpPkeyUniquePtr& key,
     const folly::ssl::EvpPkeyUniquePtr& peerKey);
 
+/**
+ * Generates the shared secrets of several EC key pairs on curveNid with their
+ * peer keys, as generateEvpSharedSecret() would one by one. Each scalar
+ * multiplication is still done separately, but converting the results back to
+ * affine coordinates shares a single field inversion across the batch.
+ *
+ * Results are in the order of keys; a pair that fails doesn't fail the others.
+ */
+std::vector<folly::Try<std::unique_ptr<folly::IOBuf>>>
+generateECSharedSecrets(
+    int curveNid,
+    const std::vector<std::pair<EVP_PKEY*, EVP_PKEY*>>& keys);
+
 /**
  * Returns the current error in the thread queue as a string.
  */
@@ -40,5 +40,46 @@ TEST(ValidateECKey, WrongCurve) {
   EXPECT_THROW(
       detail::validateECKey(key, NID_X9_62_prime239v3), std::runtime_error);
 }
+TEST(GenerateECSharedSecrets, MatchesEvp) {
+  for (auto curveNid : {NID_X9_62_prime256v1, NID_secp384r1, NID_secp521r1}) {
+    std::vector<EvpPkeyUniquePtr> ours;
+    std::vector<EvpPkeyUniquePtr> peers;
+    std::vector<std::pair<EVP_PKEY*, EVP_PKEY*>> keys;
+    for (size_t i = 0; i < 5; ++i) {
+      ours.push_back(detail::generateECKeyPair(curveNid));
+      peers.push_back(detail::generateECKeyPair(curveNid));
+      keys.emplace_back(ours.back().get(), peers.back().get());
+    }
+    auto secrets = detail::generateECSharedSecrets(curveNid, keys);
+    ASSERT_EQ(secrets.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      EXPECT_TRUE(IOBufEqualTo()(
+          *secrets[i], detail::generateEvpSharedSecret(ours[i], peers[i])));
+    }
+  }
+}
+
+TEST(GenerateECSharedSecrets, BadPairFailsAlone) {
+  auto key = detail::generateECKeyPair(NID_X9_62_prime256v1);
+  auto peer = detail::generateECKeyPair(NID_X9_62_prime256v1);
+  auto otherCurve = detail::generateECKeyPair(NID_secp384r1);
+  auto rsa = getPrivateKey(kRSAKey);
+  auto secrets = detail::generateECSharedSecrets(
+      NID_X9_62_prime256v1,
+      {{key.get(), peer.get()},
+       {key.get(), otherCurve.get()},
+       {rsa.get(), peer.get()},
+       {peer.get(), key.get()}});
+  ASSERT_EQ(secrets.size(), 4);
+  EXPECT_TRUE(secrets[0].hasValue());
+  EXPECT_TRUE(secrets[1].hasException());
+  EXPECT_TRUE(secrets[2].hasException());
+  EXPECT_TRUE(IOBufEqualTo()(*secrets[0], *secrets[3]));
+}
+
+TEST(GenerateECSharedSecrets, Empty) {
+  EXPECT_TRUE(
+      detail::generateECSharedSecrets(NID_X9_62_prime256v1, {}).empty());
+}
 } // namespace test
 } // namespace fizz
@@ -0,0 +1,160 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/signature/ECDSANoncePool.h>
+
+#include <fizz/crypto/Utils.h>
+#include <fizz/crypto/openssl/OpenSSLKeyUtils.h>
+#include <folly/ScopeGuard.h>
+#include <folly/portability/Unistd.h>
+#include <openssl/rand.h>
+
+#include <array>
+
+namespace fizz {
+
+namespace {
+
+// Random bytes mixed into each nonce along with the private key.
+constexpr size_t kNonceEntropy = 32;
+
+folly::Optional<ECDSANonce> makeNonce(const EC_KEY* key, BN_CTX* ctx) {
+  auto group = EC_KEY_get0_group(key);
+  folly::ssl::BIGNUMUniquePtr order(BN_new());
+  folly::ssl::BIGNUMUniquePtr k(BN_new());
+  folly::ssl::BIGNUMUniquePtr x(BN_new());
+  folly::ssl::BIGNUMUniquePtr exponent(BN_new());
+  folly::ssl::EcPointUniquePtr point(EC_POINT_new(group));
+  ECDSANonce nonce{folly::ssl::BIGNUMUniquePtr(BN_new()),
+                   folly::ssl::BIGNUMUniquePtr(BN_new())};
+  if (!order || !k || !x || !exponent || !point || !nonce.kinv ||
+      !nonce.r || EC_GROUP_get_order(group, order.get(), ctx) != 1) {
+    return folly::none;
+  }
+
+  std::array<uint8_t, kNonceEntropy> entropy;
+  SCOPE_EXIT {
+    CryptoUtils::clean(folly::range(entropy));
+  };
+  do {
+    if (RAND_bytes(entropy.data(), entropy.size()) != 1 ||
+        BN_generate_dsa_nonce(
+            k.get(),
+            order.get(),
+            EC_KEY_get0_private_key(key),
+            entropy.data(),
+            entropy.size(),
+            ctx) != 1) {
+      return folly::none;
+    }
+    BN_set_flags(k.get(), BN_FLG_CONSTTIME);
+    if (!EC_POINT_mul(group, point.get(), k.get(), nullptr, nullptr, ctx) ||
+        EC_POINT_get_affine_coordinates_GFp(
+            group, point.get(), x.get(), nullptr, ctx) != 1 ||
+        BN_nnmod(nonce.r.get(), x.get(), order.get(), ctx) != 1) {
+      return folly::none;
+    }
+  } while (BN_is_zero(nonce.r.get()));
+
+  // n is prime, so k^-1 = k^(n - 2) mod n, which unlike BN_mod_inverse() can
+  // be computed in constant time.
+  if (!BN_copy(exponent.get(), order.get()) ||
+      BN_sub_word(exponent.get(), 2) != 1 ||
+      BN_mod_exp_mont_consttime(
+          nonce.kinv.get(),
+          k.get(),
+          exponent.get(),
+          order.get(),
+          ctx,
+          nullptr) != 1) {
+    return folly::none;
+  }
+  BN_clear(k.get());
+  return nonce;
+}
+} // namespace
+
+ECDSANoncePool::ECDSANoncePool(
+    const folly::ssl::EvpPkeyUniquePtr& key,
+    size_t depth)
+    : key_(EVP_PKEY_get1_EC_KEY(key.get())),
+      depth_(depth),
+      pid_(getpid()),
+      cv_(std::make_unique<std::condition_variable>()) {
+  if (!key_ || !EC_KEY_get0_private_key(key_.get())) {
+    throw std::runtime_error("ECDSA nonces need an EC private key");
+  }
+  thread_ = std::make_unique<std::thread>([this]() { run(); });
+}
+
+ECDSANoncePool::~ECDSANoncePool() {
+  if (forked()) {
+    cv_.release();
+    thread_.release();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_->notify_all();
+  thread_->join();
+}
+
+folly::Optional<ECDSANonce> ECDSANoncePool::take() {
+  if (forked()) {
+    // These nonces are the parent's too, and the refill thread didn't
+    // survive the fork.
+    return folly::none;
+  }
+  folly::Optional<ECDSANonce> nonce;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (nonces_.empty()) {
+      return folly::none;
+    }
+    nonce = std::move(nonces_.front());
+    nonces_.pop_front();
+  }
+  cv_->notify_all();
+  return nonce;
+}
+
+size_t ECDSANoncePool::available() const {
+  if (forked()) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  return nonces_.size();
+}
+
+bool ECDSANoncePool::forked() const {
+  return getpid() != pid_;
+}
+
+void ECDSANoncePool::run() {
+  folly::ssl::BNCtxUniquePtr ctx(BN_CTX_new());
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_->wait(lock, [this]() { return stop_ || nonces_.size() < depth_; });
+    if (stop_) {
+      return;
+    }
+    lock.unlock();
+    auto nonce = ctx ? makeNonce(key_.get(), ctx.get()) : folly::none;
+    lock.lock();
+    if (!nonce) {
+      // Signatures fall back to computing their own nonce.
+      LOG(ERROR) << "Failed to precompute ECDSA nonce: "
+                 << detail::getOpenSSLError();
+      return;
+    }
+    nonces_.push_back(std::move(*nonce));
+  }
+}
+} // namespace fizz
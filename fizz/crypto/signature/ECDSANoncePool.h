@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/portability/SysTypes.h>
+#include <folly/ssl/OpenSSLPtrTypes.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace fizz {
+
+/**
+ * The message independent part of an ECDSA signature: k^-1 mod n and
+ * r = (kG).x mod n for a random nonce k.
+ */
+struct ECDSANonce {
+  folly::ssl::BIGNUMUniquePtr kinv;
+  folly::ssl::BIGNUMUniquePtr r;
+};
+
+/**
+ * Precomputes ECDSA nonces for one EC private key on a background thread, so
+ * that signing with one of them is only a hash and a few modular operations
+ * instead of a fixed-base scalar multiplication.
+ *
+ * Each k is derived with BN_generate_dsa_nonce() from the private key and
+ * fresh random bytes, so a weak random number generator alone does not
+ * reveal the key. Each nonce is handed out at most once: signing two
+ * messages with the same nonce reveals the private key.
+ *
+ * A forked child never draws from a pool created by its parent. The pool
+ * then behaves as if it were empty, without touching its lock, which the
+ * refill thread may have held at the time of the fork.
+ */
+class ECDSANoncePool {
+ public:
+  static constexpr size_t kDefaultDepth = 64;
+
+  /**
+   * key must be an EC private key; it is shared, not copied.
+   */
+  explicit ECDSANoncePool(
+      const folly::ssl::EvpPkeyUniquePtr& key,
+      size_t depth = kDefaultDepth);
+
+  ~ECDSANoncePool();
+
+  ECDSANoncePool(const ECDSANoncePool&) = delete;
+  ECDSANoncePool& operator=(const ECDSANoncePool&) = delete;
+
+  /**
+   * Returns a precomputed nonce, or none if the pool is currently empty.
+   */
+  folly::Optional<ECDSANonce> take();
+
+  /**
+   * Returns how many nonces are ready.
+   */
+  size_t available() const;
+
+ private:
+  void run();
+
+  bool forked() const;
+
+  folly::ssl::EcKeyUniquePtr key_;
+  size_t depth_;
+  pid_t pid_;
+
+  mutable std::mutex mutex_;
+  std::deque<ECDSANonce> nonces_;
+  bool stop_{false};
+
+  // Leaked in a forked child: the thread is gone, and destroying a condition
+  // variable it was waiting on would wait for it forever.
+  std::unique_ptr<std::condition_variable> cv_;
+  std::unique_ptr<std::thread> thread_;
+};
+} // namespace fizz
@@ -19,6 +19,16 @@ std::unique_ptr<folly::IOBuf> ecSign(
     const folly::ssl::EvpPkeyUniquePtr& pkey,
     int hashNid);
 
+/**
+ * Signs with a nonce from noncePool if one is ready and falls back to ecSign()
+ * otherwise.
+ */
+std::unique_ptr<folly::IOBuf> ecSign(
+    folly::ByteRange data,
+    const folly::ssl::EvpPkeyUniquePtr& pkey,
+    int hashNid,
+    ECDSANoncePool* noncePool);
+
 void ecVerify(
     folly::ByteRange data,
     folly::ByteRange signature,
@@ -74,7 +84,8 @@ inline std::unique_ptr<folly::IOBuf> OpenSSLSignature<Type>::sign(
     case KeyType::P256:
     case KeyType::P384:
     case KeyType::P521:
-      return detail::ecSign(data, pkey_, SigAlg<Scheme>::HashNid);
+      return detail::ecSign(
+          data, pkey_, SigAlg<Scheme>::HashNid, noncePool_.get());
     case KeyType::RSA:
       return detail::rsaPssSign(data, pkey_, SigAlg<Scheme>::HashNid);
   }
@@ -98,11 +109,18 @@ inline void OpenSSLSignature<Type>::verify(
   folly::assume_unreachable();
 }
 
+template <KeyType Type>
+inline void OpenSSLSignature<Type>::usePrecomputedNonces(size_t depth) {
+  static_assert(Type != KeyType::RSA, "Precomputed nonces are ECDSA only");
+  noncePool_ = std::make_unique<ECDSANoncePool>(pkey_, depth);
+}
+
 template <>
 inline void OpenSSLSignature<KeyType::P256>::setKey(
     folly::ssl::EvpPkeyUniquePtr pkey) {
   detail::validateECKey(pkey, NID_X9_62_prime256v1);
   pkey_ = std::move(pkey);
+  noncePool_.reset();
 }
 
 template <>
@@ -110,6 +128,7 @@ inline void OpenSSLSignature<KeyType::P384>::setKey(
     folly::ssl::EvpPkeyUniquePtr pkey) {
   detail::validateECKey(pkey, NID_secp384r1);
   pkey_ = std::move(pkey);
+  noncePool_.reset();
 }
 
 template <>
@@ -117,6 +136,7 @@ inline void OpenSSLSignature<KeyType::P521>::setKey(
     folly::ssl::EvpPkeyUniquePtr pkey) {
   detail::validateECKey(pkey, NID_secp521r1);
   pkey_ = std::move(pkey);
+  noncePool_.reset();
 }
 
 template <>
@@ -126,5 +146,6 @@ inline void OpenSSLSignature<KeyType::RSA>::setKey(
     throw std::runtime_error("key not rsa");
   }
   pkey_ = std::move(pkey);
+  noncePool_.reset();
 }
 } // namespace fizz
@@ -13,6 +13,8 @@
 #include <folly/ScopeGuard.h>
 #include <folly/ssl/OpenSSLPtrTypes.h>
 
+#include <array>
+
 using namespace folly;
 using namespace folly::ssl;
 
@@ -56,6 +58,52 @@ std::unique_ptr<folly::IOBuf> ecSign(
   return out;
 }
 
+std::unique_ptr<folly::IOBuf> ecSign(
+    folly::ByteRange data,
+    const folly::ssl::EvpPkeyUniquePtr& pkey,
+    int hashNid,
+    ECDSANoncePool* noncePool) {
+  auto nonce = noncePool ? noncePool->take() : folly::none;
+  if (!nonce) {
+    return ecSign(data, pkey, hashNid);
+  }
+
+  std::array<uint8_t, EVP_MAX_MD_SIZE> digest;
+  unsigned int digestLen = 0;
+  if (EVP_Digest(
+          data.data(),
+          data.size(),
+          digest.data(),
+          &digestLen,
+          getHash(hashNid),
+          nullptr) != 1) {
+    throw std::runtime_error(
+        to<std::string>("Could not hash data ", getOpenSSLError()));
+  }
+
+  EcdsaSigUniquePtr sig(ECDSA_do_sign_ex(
+      digest.data(),
+      digestLen,
+      nonce->kinv.get(),
+      nonce->r.get(),
+      EVP_PKEY_get0_EC_KEY(pkey.get())));
+  if (!sig) {
+    // Vanishingly unlikely (s == 0), but the nonce is spent either way.
+    ERR_clear_error();
+    return ecSign(data, pkey, hashNid);
+  }
+
+  auto sigLen = i2d_ECDSA_SIG(sig.get(), nullptr);
+  if (sigLen <= 0) {
+    throw std::runtime_error("Failed to encode signature");
+  }
+  auto out = folly::IOBuf::create(sigLen);
+  auto outData = out->writableData();
+  i2d_ECDSA_SIG(sig.get(), &outData);
+  out->append(sigLen);
+  return out;
+}
+
 void ecVerify(
     folly::ByteRange data,
     folly::ByteRange signature,
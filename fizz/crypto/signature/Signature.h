@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <fizz/crypto/signature/ECDSANoncePool.h>
 #include <fizz/record/Types.h>
 #include <folly/Range.h>
 #include <folly/ssl/OpenSSLPtrTypes.h>
@@ -24,6 +25,14 @@ class OpenSSLSignature {
  public:
   void setKey(folly::ssl::EvpPkeyUniquePtr pkey);
 
+  /**
+   * Precomputes up to depth ECDSA nonces for the current key on a background
+   * thread and signs with them while they last. Only valid for EC keys.
+   *
+   * setKey() must be called before with a private key.
+   */
+  void usePrecomputedNonces(size_t depth = ECDSANoncePool::kDefaultDepth);
+
   /**
    * Returns a signature of data.
    *
@@ -46,6 +55,7 @@ class OpenSSLSignature {
 
  private:
   folly::ssl::EvpPkeyUniquePtr pkey_;
+  std::unique_ptr<ECDSANoncePool> noncePool_;
 };
 } // namespace fizz
 
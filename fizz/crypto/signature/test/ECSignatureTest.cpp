@@ -11,6 +11,10 @@
 #include <fizz/crypto/ECCurve.h>
 #include <fizz/crypto/signature/Signature.h>
 #include <folly/String.h>
+#include <folly/portability/Unistd.h>
+
+#include <sys/wait.h>
+#include <thread>
 
 using namespace folly;
 using namespace folly::ssl;
@@ -178,6 +182,103 @@ TEST_P(ECDSA521Test, TestSignature) {
   }
 }
 
+static void waitForNonces(const ECDSANoncePool& pool, size_t count) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (pool.available() < count) {
+    ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+TEST_P(ECDSA256Test, TestSignatureWithNoncePool) {
+  auto key = getKey(P256::curveNid, GetParam());
+  ECDSANoncePool pool(key, 2);
+  waitForNonces(pool, 2);
+
+  auto msg = IOBuf::copyBuffer(GetParam().msg);
+  auto sig1 = detail::ecSign(msg->coalesce(), key, NID_sha256, &pool);
+  auto sig2 = detail::ecSign(msg->coalesce(), key, NID_sha256, &pool);
+  detail::ecVerify(msg->coalesce(), sig1->coalesce(), key, NID_sha256);
+  detail::ecVerify(msg->coalesce(), sig2->coalesce(), key, NID_sha256);
+  // Each nonce is only used once.
+  EXPECT_FALSE(IOBufEqualTo()(sig1, sig2));
+
+  modifySig(sig1.get());
+  EXPECT_THROW(
+      detail::ecVerify(msg->coalesce(), sig1->coalesce(), key, NID_sha256),
+      std::runtime_error);
+}
+
+TEST_P(ECDSA256Test, TestSignatureEmptyNoncePool) {
+  auto key = getKey(P256::curveNid, GetParam());
+  ECDSANoncePool pool(key, 0);
+  EXPECT_FALSE(pool.take().hasValue());
+
+  auto msg = IOBuf::copyBuffer(GetParam().msg);
+  auto sig = detail::ecSign(msg->coalesce(), key, NID_sha256, &pool);
+  detail::ecVerify(msg->coalesce(), sig->coalesce(), key, NID_sha256);
+}
+
+TEST_P(ECDSA384Test, TestSignatureWithPrecomputedNonces) {
+  auto key = getKey(P384::curveNid, GetParam());
+  OpenSSLSignature<KeyType::P384> ecdsa;
+  ecdsa.setKey(std::move(key));
+  ecdsa.usePrecomputedNonces(4);
+  for (size_t i = 0; i < 8; i++) {
+    std::string msg = GetParam().msg;
+    auto sig = ecdsa.sign<SignatureScheme::ecdsa_secp384r1_sha384>(
+        IOBuf::copyBuffer(msg)->coalesce());
+    ecdsa.verify<SignatureScheme::ecdsa_secp384r1_sha384>(
+        IOBuf::copyBuffer(msg)->coalesce(), sig->coalesce());
+  }
+}
+
+TEST_P(ECDSA256Test, TestNoncePoolForkedChild) {
+  auto key = getKey(P256::curveNid, GetParam());
+  auto pool = std::make_unique<ECDSANoncePool>(key, 2);
+  waitForNonces(*pool, 2);
+  // Fork while the refill thread is running so that it may hold the lock.
+  ASSERT_TRUE(pool->take().hasValue());
+
+  auto pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    // The parent's nonces must not be used, and neither taking nor
+    // destroying the pool may block on the missing refill thread.
+    int status = 0;
+    if (pool->take().hasValue() || pool->available() != 0) {
+      status = 1;
+    }
+    try {
+      auto msg = IOBuf::copyBuffer(GetParam().msg);
+      auto sig = detail::ecSign(msg->coalesce(), key, NID_sha256, pool.get());
+      detail::ecVerify(msg->coalesce(), sig->coalesce(), key, NID_sha256);
+    } catch (const std::exception&) {
+      status = 1;
+    }
+    pool.reset();
+    _exit(status);
+  }
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+
+  waitForNonces(*pool, 2);
+  EXPECT_TRUE(pool->take().hasValue());
+}
+
+TEST(ECDSANoncePoolTest, TestPublicKeyOnly) {
+  EcKeyUniquePtr privateKey(EC_KEY_new_by_curve_name(P256::curveNid));
+  EC_KEY_generate_key(privateKey.get());
+  EcKeyUniquePtr ecKey(EC_KEY_new_by_curve_name(P256::curveNid));
+  EC_KEY_set_public_key(
+      ecKey.get(), EC_KEY_get0_public_key(privateKey.get()));
+  EvpPkeyUniquePtr pkey(EVP_PKEY_new());
+  EVP_PKEY_set1_EC_KEY(pkey.get(), ecKey.get());
+  EXPECT_THROW(ECDSANoncePool(pkey, 1), std::runtime_error);
+}
+
 // Test vector from https://tools.ietf.org/html/rfc6979#appendix-A.2.5
 // We can't test those directly since we'd need to use the more complicated
 // API of actually setting k and dealing with ECDSA_sig objects directly.
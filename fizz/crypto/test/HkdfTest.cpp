@@ -11,6 +11,8 @@
 #include <fizz/crypto/Hkdf.h>
 #include <fizz/crypto/Sha256.h>
 #include <fizz/crypto/test/TestUtil.h>
+#include <fizz/record/Types.h>
+#include <folly/String.h>
 
 using namespace testing;
 using namespace folly;
@@ -43,6 +45,57 @@ TEST_P(HkdfTest, TestHkdfSha256Expand) {
   EXPECT_FALSE(memcmp(actualOkm->data(), expectedOkm->data(), outputBytes));
 }
 
+TEST_P(HkdfTest, TestKeyedHkdfSha256Expand) {
+  auto ikm = toIOBuf(GetParam().ikm);
+  auto salt = toIOBuf(GetParam().salt);
+  auto info = toIOBuf(GetParam().info);
+  size_t outputBytes = GetParam().outputBytes;
+  auto expectedOkm = toIOBuf(GetParam().okm);
+
+  auto prk = HkdfImpl<Sha256>().extract(salt->coalesce(), ikm->coalesce());
+  KeyedHkdf<Sha256> hkdf(range(prk));
+  std::vector<uint8_t> okm(outputBytes);
+  hkdf.expand(info->coalesce(), range(okm));
+  EXPECT_EQ(hexlify(range(okm)), hexlify(expectedOkm->coalesce()));
+
+  // Expanding again reuses the keyed HMAC state.
+  std::vector<uint8_t> again(outputBytes);
+  auto chainedInfo = IOBuf::create(0);
+  auto infoRange = info->coalesce();
+  for (size_t i = 0; i < infoRange.size(); ++i) {
+    chainedInfo->prependChain(IOBuf::copyBuffer(infoRange.data() + i, 1));
+  }
+  hkdf.expand(*chainedInfo, range(again));
+  EXPECT_EQ(hexlify(range(again)), hexlify(expectedOkm->coalesce()));
+}
+
+TEST(KeyedHkdfTest, TestExpandLabel) {
+  std::vector<uint8_t> secret(Sha256::HashLen, 0x44);
+  auto context = IOBuf::copyBuffer("context");
+  KeyedHkdf<Sha256> hkdf(range(secret));
+  for (auto length : {12, 16, 32, 48}) {
+    HkdfLabel label = {static_cast<uint16_t>(length), "key", context->clone()};
+    auto expected = HkdfImpl<Sha256>().expand(
+        range(secret),
+        *encodeHkdfLabel(std::move(label), "tls13 "),
+        length);
+    std::vector<uint8_t> out(length);
+    hkdf.expandLabel("tls13 ", "key", context->coalesce(), range(out));
+    EXPECT_EQ(hexlify(range(out)), hexlify(expected->coalesce()));
+  }
+}
+
+TEST(KeyedHkdfTest, TestExpandTooLong) {
+  std::vector<uint8_t> secret(Sha256::HashLen);
+  KeyedHkdf<Sha256> hkdf(range(secret));
+  std::vector<uint8_t> out(255 * Sha256::HashLen + 1);
+  EXPECT_THROW(hkdf.expand(ByteRange(), range(out)), std::runtime_error);
+  std::string label(0xff, 'a');
+  EXPECT_THROW(
+      hkdf.expandLabel("tls13 ", label, ByteRange(), range(out).subpiece(0, 1)),
+      std::runtime_error);
+}
+
 // Test cases from https://tools.ietf.org/html/rfc5869
 INSTANTIATE_TEST_CASE_P(
     TestVectors,
@@ -10,6 +10,7 @@
 
 #include <fizz/crypto/KeyDerivation.h>
 #include <fizz/crypto/Sha256.h>
+#include <fizz/crypto/Sha384.h>
 #include <folly/String.h>
 #include <folly/io/IOBuf.h>
 
@@ -45,6 +46,30 @@ TEST_P(KeyDerivationTest, ExpandLabel) {
   EXPECT_EQ(GetParam().result, hexOut);
 }
 
+TEST(KeyDerivation, ExpandLabelSwitchingSecrets) {
+  // The deriver keeps the last secret keyed, make sure switching back and
+  // forth between secrets doesn't mix them up.
+  std::vector<uint8_t> secret1(Sha256::HashLen, 1);
+  std::vector<uint8_t> secret2(Sha256::HashLen, 2);
+  auto deriver = KeyDerivationImpl<Sha256>(kHkdfLabelPrefix.str());
+  auto key1 = deriver.expandLabel(range(secret1), "key", nullptr, 16);
+  auto key2 = deriver.expandLabel(range(secret2), "key", nullptr, 16);
+  auto iv1 = deriver.expandLabel(range(secret1), "iv", nullptr, 12);
+  EXPECT_FALSE(IOBufEqualTo()(key1, key2));
+
+  auto fresh = KeyDerivationImpl<Sha256>(kHkdfLabelPrefix.str());
+  EXPECT_TRUE(IOBufEqualTo()(
+      key1, fresh.expandLabel(range(secret1), "key", nullptr, 16)));
+  EXPECT_TRUE(IOBufEqualTo()(
+      key2,
+      KeyDerivationImpl<Sha256>(kHkdfLabelPrefix.str())
+          .expandLabel(range(secret2), "key", nullptr, 16)));
+  EXPECT_TRUE(IOBufEqualTo()(
+      iv1,
+      KeyDerivationImpl<Sha256>(kHkdfLabelPrefix.str())
+          .expandLabel(range(secret1), "iv", nullptr, 12)));
+}
+
 TEST(KeyDerivation, DeriveSecret) {
   // dummy prk
   std::vector<uint8_t> secret(
@@ -55,6 +80,90 @@ TEST(KeyDerivation, DeriveSecret) {
   deriver.deriveSecret(range(secret), "hey", range(messageHash));
 }
 
+namespace {
+struct QuicHkdfLabelPrefix {
+  static constexpr StringPiece value() {
+    return "quic ";
+  }
+};
+
+constexpr auto kEncodedKey = encodeHkdfLabelName("tls13 ", "key");
+static_assert(kEncodedKey.size == 10, "length byte, prefix and label");
+static_assert(kEncodedKey.data[0] == 9, "prefix and label length");
+static_assert(kEncodedKey.data[1] == 't', "prefix first");
+static_assert(kEncodedKey.data[7] == 'k', "label after prefix");
+} // namespace
+
+TEST(KeyDerivation, LabelTableMatchesEncodeHkdfLabel) {
+  for (const auto& entry : HkdfLabelTable<>::kLabels) {
+    HkdfLabel label = {32, entry.label.str(), IOBuf::create(0)};
+    auto encoded = encodeHkdfLabel(std::move(label), kHkdfLabelPrefix.str());
+    // Drop the output length in front and the context length behind.
+    auto bytes = encoded->coalesce();
+    bytes.advance(2);
+    bytes.pop_back();
+    EXPECT_EQ(hexlify(entry.encoded()), hexlify(bytes));
+    EXPECT_EQ(HkdfLabelTable<>::find(entry.label), &entry);
+  }
+  EXPECT_EQ(HkdfLabelTable<>::find("unknown"), nullptr);
+}
+
+TEST(KeyDerivation, ExpandLabelTableAndRuntimeEncodingsMatch) {
+  std::vector<uint8_t> secret(Sha256::HashLen, 0x44);
+  auto context = IOBuf::copyBuffer("context");
+  auto deriver = KeyDerivationImpl<Sha256>(kHkdfLabelPrefix.str());
+  for (auto label : {"c hs traffic", "key", "not in the table"}) {
+    std::vector<uint8_t> expected(16);
+    KeyedHkdf<Sha256>(range(secret))
+        .expandLabel(
+            kHkdfLabelPrefix, label, context->coalesce(), range(expected));
+    auto out = deriver.expandLabel(range(secret), label, context->clone(), 16);
+    EXPECT_EQ(hexlify(range(expected)), hexlify(out->coalesce()));
+  }
+}
+
+TEST(KeyDerivation, ExpandLabelCustomPrefix) {
+  std::vector<uint8_t> secret(Sha256::HashLen, 0x44);
+  auto runtime = KeyDerivationImpl<Sha256>("quic ");
+  auto table =
+      KeyDerivationImpl<Sha256>(HkdfLabelTable<QuicHkdfLabelPrefix>());
+  for (auto label : {"key", "iv", "not in the table"}) {
+    EXPECT_TRUE(IOBufEqualTo()(
+        runtime.expandLabel(range(secret), label, nullptr, 16),
+        table.expandLabel(range(secret), label, nullptr, 16)));
+  }
+  EXPECT_FALSE(IOBufEqualTo()(
+      runtime.expandLabel(range(secret), "key", nullptr, 16),
+      KeyDerivationImpl<Sha256>(kHkdfLabelPrefix.str())
+          .expandLabel(range(secret), "key", nullptr, 16)));
+}
+
+template <typename Hash>
+std::vector<uint8_t> computeNoPskDerivedSecret(KeyDerivationImpl<Hash>& kd) {
+  std::vector<uint8_t> zeros(Hash::HashLen, 0);
+  auto earlySecret = kd.hkdfExtract(range(zeros), range(zeros));
+  return kd.deriveSecret(range(earlySecret), "derived", kd.blankHash());
+}
+
+TEST(KeyDerivation, NoPskDerivedSecret) {
+  auto sha256 = KeyDerivationImpl<Sha256>(kHkdfLabelPrefix.str());
+  EXPECT_EQ(sha256.noPskDerivedSecret(), computeNoPskDerivedSecret(sha256));
+  // From the TLS 1.3 key schedule with Sha256 and no PSK.
+  EXPECT_EQ(
+      hexlify(range(sha256.noPskDerivedSecret())),
+      "6f2615a108c702c5678f54fc9dbab69716c076189c48250cebeac3576c3611ba");
+
+  auto sha384 = KeyDerivationImpl<Sha384>(kHkdfLabelPrefix.str());
+  EXPECT_EQ(sha384.noPskDerivedSecret(), computeNoPskDerivedSecret(sha384));
+
+  auto runtime = KeyDerivationImpl<Sha256>("quic ");
+  auto table =
+      KeyDerivationImpl<Sha256>(HkdfLabelTable<QuicHkdfLabelPrefix>());
+  EXPECT_EQ(runtime.noPskDerivedSecret(), computeNoPskDerivedSecret(runtime));
+  EXPECT_EQ(table.noPskDerivedSecret(), runtime.noPskDerivedSecret());
+  EXPECT_NE(table.noPskDerivedSecret(), sha256.noPskDerivedSecret());
+}
+
 TEST(KeyDerivation, Sha256BlankHash) {
   std::vector<uint8_t> computed(
       KeyDerivationImpl<Sha256>(kHkdfLabelPrefix.str()).hashLength());
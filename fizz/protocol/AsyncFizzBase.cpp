@@ -10,6 +10,11 @@
 
 #include <folly/Conv.h>
 #include <folly/io/Cursor.h>
+#include <folly/portability/SysMman.h>
+#include <folly/portability/SysStat.h>
+#include <folly/portability/Unistd.h>
+
+#include <system_error>
 
 namespace fizz {
 
@@ -27,16 +32,152 @@ static const uint32_t kMaxReadSize = 4000;
  */
 static const uint32_t kMaxBufSize = 64 * 1024;
 
+namespace {
+/**
+ * Reports the outcome of a single coalesced write to every write it was made
+ * up of.
+ */
+class CoalescedWriteCallback
+    : public folly::AsyncTransportWrapper::WriteCallback {
+ public:
+  explicit CoalescedWriteCallback(
+      std::vector<folly::AsyncTransportWrapper::WriteCallback*> callbacks)
+      : callbacks_(std::move(callbacks)) {}
+
+  void writeSuccess() noexcept override {
+    for (auto callback : callbacks_) {
+      callback->writeSuccess();
+    }
+    delete this;
+  }
+
+  void writeErr(size_t /* bytesWritten */, const AsyncSocketException& ex)
+      noexcept override {
+    for (auto callback : callbacks_) {
+      callback->writeErr(0, ex);
+    }
+    delete this;
+  }
+
+ private:
+  std::vector<folly::AsyncTransportWrapper::WriteCallback*> callbacks_;
+};
+
+/**
+ * Returns flags without the ones that only describe the end of a write, CORK
+ * and EOR. Coalesced writes take those from the last write.
+ */
+folly::WriteFlags withoutEndOfWriteFlags(folly::WriteFlags flags) {
+  return folly::unSet(
+      folly::unSet(flags, folly::WriteFlags::CORK), folly::WriteFlags::EOR);
+}
+
+void unmapFile(void* addr, void* length) {
+  munmap(addr, reinterpret_cast<size_t>(length));
+}
+
+/**
+ * Maps length bytes of fd starting at offset into an IOBuf. The mapping is
+ * private and writable so that encrypting it in place copies the pages rather
+ * than modifying the file. Throws if the range doesn't lie within the file,
+ * since touching a mapped page past its end raises SIGBUS.
+ */
+std::unique_ptr<folly::IOBuf> mapFile(int fd, off_t offset, size_t length) {
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    throw std::system_error(errno, std::system_category(), "fstat() failed");
+  }
+  if (offset < 0 || offset > st.st_size ||
+      length > static_cast<size_t>(st.st_size - offset)) {
+    throw std::runtime_error("range past end of file");
+  }
+  if (length == 0) {
+    return folly::IOBuf::create(0);
+  }
+  static const off_t pageSize = sysconf(_SC_PAGESIZE);
+  size_t pageOffset = offset % pageSize;
+  size_t mapLength = length + pageOffset;
+  auto addr = mmap(
+      nullptr,
+      mapLength,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE,
+      fd,
+      offset - pageOffset);
+  if (addr == MAP_FAILED) {
+    throw std::system_error(errno, std::system_category(), "mmap() failed");
+  }
+  auto buf = folly::IOBuf::takeOwnership(
+      addr, mapLength, &unmapFile, reinterpret_cast<void*>(mapLength));
+  buf->trimStart(pageOffset);
+  return buf;
+}
+} // namespace
+
+/**
+ * Runs an operation on a kTLS socket once the writes queued on the transport
+ * ahead of it have been sent, since the transport completes writes in order.
+ */
+class AsyncFizzBase::KTLSBarrier
+    : public folly::AsyncTransportWrapper::WriteCallback {
+ public:
+  KTLSBarrier(
+      AsyncFizzBase& transport,
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      folly::Function<void()> op)
+      : transport_(transport), callback_(callback), op_(std::move(op)) {}
+
+  void writeSuccess() noexcept override {
+    DelayedDestruction::DestructorGuard dg(&transport_);
+    try {
+      op_();
+    } catch (const std::exception& e) {
+      AsyncSocketException ex(
+          AsyncSocketException::INTERNAL_ERROR,
+          folly::to<std::string>("kTLS write failed: ", e.what()));
+      if (callback_) {
+        callback_->writeErr(0, ex);
+      }
+      transport_.transportError(ex);
+      delete this;
+      return;
+    }
+    if (callback_) {
+      callback_->writeSuccess();
+    }
+    delete this;
+  }
+
+  void writeErr(size_t /* bytesWritten */, const AsyncSocketException& ex)
+      noexcept override {
+    if (callback_) {
+      callback_->writeErr(0, ex);
+    }
+    delete this;
+  }
+
+ private:
+  AsyncFizzBase& transport_;
+  folly::AsyncTransportWrapper::WriteCallback* callback_;
+  folly::Function<void()> op_;
+};
+
 AsyncFizzBase::AsyncFizzBase(folly::AsyncTransportWrapper::UniquePtr transport)
     : folly::WriteChainAsyncTransportWrapper<folly::AsyncTransportWrapper>(
           std::move(transport)),
-      handshakeTimeout_(*this, transport_->getEventBase()) {}
+      handshakeTimeout_(*this, transport_->getEventBase()),
+      flushTimeout_(*this, transport_->getEventBase()),
+      flushLoopCallback_(*this),
+      ktlsLoopCallback_(*this) {}
 
 AsyncFizzBase::~AsyncFizzBase() {
   transport_->setReadCB(nullptr);
 }
 
 void AsyncFizzBase::destroy() {
+  AsyncSocketException ase(
+      AsyncSocketException::END_OF_FILE, "socket closed locally");
+  failCoalescedWrites(ase);
   transport_->closeNow();
   transport_->setReadCB(nullptr);
   DelayedDestruction::destroy();
@@ -72,9 +213,192 @@ void AsyncFizzBase::writeChain(
     folly::WriteFlags flags) {
   appBytesWritten_ += buf->computeChainDataLength();
 
-  // TODO: break up buf into multiple records
+  if (!writeCoalescing_) {
+    // TODO: break up buf into multiple records
+    writeAppData(callback, std::move(buf), flags);
+    return;
+  }
 
-  writeAppData(callback, std::move(buf), flags);
+  DelayedDestruction::DestructorGuard dg(this);
+  if ((!coalescedWrites_.empty() || !coalescedCallbacks_.empty()) &&
+      withoutEndOfWriteFlags(flags) !=
+          withoutEndOfWriteFlags(coalescedFlags_)) {
+    // Only writes whose other flags match are coalesced, so that none of them
+    // are dropped or applied to data they weren't passed with.
+    writeCoalesced(coalescedFlags_);
+  }
+  coalescedWrites_.append(std::move(buf));
+  if (callback) {
+    coalescedCallbacks_.push_back(callback);
+  }
+  coalescedFlags_ = flags;
+
+  auto evb = transport_->getEventBase();
+  if (!evb ||
+      coalescedWrites_.chainLength() >= writeCoalescing_->maxBufferedBytes ||
+      folly::isSet(flags, folly::WriteFlags::EOR)) {
+    writeCoalesced(flags);
+  } else if (folly::isSet(flags, folly::WriteFlags::CORK)) {
+    if (!flushTimeout_.isScheduled()) {
+      flushTimeout_.scheduleTimeout(writeCoalescing_->flushTimeout);
+    }
+  } else if (!flushLoopCallback_.isLoopCallbackScheduled()) {
+    evb->runInLoop(&flushLoopCallback_);
+  }
+}
+
+void AsyncFizzBase::flushCoalescedWrites() {
+  // Nothing more is coming for now, so there is no point in asking the
+  // transport to hold on to the data.
+  writeCoalesced(folly::unSet(coalescedFlags_, folly::WriteFlags::CORK));
+}
+
+void AsyncFizzBase::writeCoalesced(folly::WriteFlags flags) {
+  flushTimeout_.cancelTimeout();
+  flushLoopCallback_.cancelLoopCallback();
+  if (coalescedWrites_.empty() && coalescedCallbacks_.empty()) {
+    return;
+  }
+
+  DelayedDestruction::DestructorGuard dg(this);
+  auto data = coalescedWrites_.move();
+  if (!data) {
+    data = folly::IOBuf::create(0);
+  }
+  auto callbacks = std::move(coalescedCallbacks_);
+  coalescedCallbacks_.clear();
+  coalescedFlags_ = folly::WriteFlags::NONE;
+
+  folly::AsyncTransportWrapper::WriteCallback* callback = nullptr;
+  if (callbacks.size() == 1) {
+    callback = callbacks.front();
+  } else if (callbacks.size() > 1) {
+    callback = new CoalescedWriteCallback(std::move(callbacks));
+  }
+  writeAppData(callback, std::move(data), flags);
+}
+
+void AsyncFizzBase::failCoalescedWrites(const AsyncSocketException& ex) {
+  flushTimeout_.cancelTimeout();
+  flushLoopCallback_.cancelLoopCallback();
+  coalescedWrites_.move();
+  coalescedFlags_ = folly::WriteFlags::NONE;
+  auto callbacks = std::move(coalescedCallbacks_);
+  coalescedCallbacks_.clear();
+  for (auto callback : callbacks) {
+    callback->writeErr(0, ex);
+  }
+}
+
+void AsyncFizzBase::writeFile(
+    folly::AsyncTransportWrapper::WriteCallback* callback,
+    int fd,
+    off_t offset,
+    size_t length,
+    folly::WriteFlags flags) {
+  std::unique_ptr<folly::IOBuf> buf;
+  try {
+    buf = mapFile(fd, offset, length);
+  } catch (const std::exception& e) {
+    if (callback) {
+      callback->writeErr(
+          0,
+          AsyncSocketException(
+              AsyncSocketException::BAD_ARGS,
+              folly::to<std::string>("writeFile() failed: ", e.what())));
+    }
+    return;
+  }
+  writeChain(callback, std::move(buf), flags);
+}
+
+void AsyncFizzBase::startKTLSOffload() {
+  auto evb = transport_->getEventBase();
+  if (!ktlsOffload_ || isKTLSOffloaded() || !evb) {
+    return;
+  }
+  // The derived class is still processing actions, so give it until the end
+  // of the loop to finish with its write record layer.
+  if (!ktlsLoopCallback_.isLoopCallbackScheduled()) {
+    evb->runInLoop(&ktlsLoopCallback_);
+  }
+}
+
+void AsyncFizzBase::tryKTLSOffload() {
+  if (!ktlsOffload_ || isKTLSOffloaded() || !good()) {
+    return;
+  }
+  auto socket = getUnderlyingTransport<folly::AsyncSocket>();
+  if (!socket || socket->getFd() < 0) {
+    VLOG(4) << "kTLS offload requires an AsyncSocket";
+    return;
+  }
+  if (!KTLS::isRekeySupported()) {
+    // The peer may request a key update at any time, and the kernel would
+    // have no way to switch to the new key.
+    VLOG(4) << "kTLS offload requires kernel support for key updates";
+    return;
+  }
+  if (socket->getRawBytesBuffered() != 0) {
+    // Records still queued on the socket have already been encrypted, so the
+    // kernel must not take over until they have been sent.
+    writeKTLSBarrier(nullptr, [this] { startKTLSOffload(); });
+    return;
+  }
+
+  auto fd = socket->getFd();
+  try {
+    if (offloadWriteRecordLayer(fd)) {
+      ktlsFd_ = fd;
+      socket->setSendMsgParamCB(KTLS::getSendMsgParamsCallback());
+    }
+  } catch (const std::exception& e) {
+    VLOG(4) << "kTLS offload failed: " << e.what();
+  }
+}
+
+void AsyncFizzBase::writeToKTLSSocket(WriteToSocket& data) {
+  DCHECK(isKTLSOffloaded());
+  for (size_t i = 0; i < data.contents.size(); ++i) {
+    auto& content = data.contents[i];
+    auto last = i + 1 == data.contents.size();
+    auto callback = last ? data.callback : nullptr;
+    if (content.contentType == ContentType::application_data) {
+      auto flags = data.flags;
+      if (!last) {
+        flags |= folly::WriteFlags::CORK;
+      }
+      transport_->writeChain(callback, std::move(content.data), flags);
+    } else {
+      // Anything else has to carry its record type, or the kernel would send
+      // it as application data. The kernel refuses MSG_MORE on such writes,
+      // so they are never corked.
+      auto type = content.contentType;
+      transport_->writeChain(
+          callback, std::move(content.data), KTLS::recordTypeFlags(type));
+      if (type == ContentType::handshake && pendingKTLSRekey_) {
+        auto fd = ktlsFd_;
+        auto params = std::move(*pendingKTLSRekey_);
+        pendingKTLSRekey_.clear();
+        writeKTLSBarrier(nullptr, [fd, params = std::move(params)]() {
+          KTLS::setTxKey(fd, params);
+        });
+      }
+    }
+  }
+}
+
+void AsyncFizzBase::rekeyKTLS(KTLSParams params) {
+  DCHECK(isKTLSOffloaded());
+  pendingKTLSRekey_ = std::move(params);
+}
+
+void AsyncFizzBase::writeKTLSBarrier(
+    folly::AsyncTransportWrapper::WriteCallback* callback,
+    folly::Function<void()> op) {
+  transport_->writeChain(
+      new KTLSBarrier(*this, callback, std::move(op)),
+      folly::IOBuf::create(0));
 }
 
 size_t AsyncFizzBase::getAppBytesWritten() const {
@@ -85,6 +409,21 @@ size_t AsyncFizzBase::getAppBytesReceived() const {
   return appBytesReceived_;
 }
 
+void AsyncFizzBase::configureWriteRecordLayer(
+    WriteRecordLayer* writeRecordLayer) {
+  if (!dynamicRecordSizing_ ||
+      writeRecordLayer == configuredWriteRecordLayer_) {
+    return;
+  }
+  configuredWriteRecordLayer_ = writeRecordLayer;
+  auto encryptedWriteRecordLayer =
+      dynamic_cast<EncryptedWriteRecordLayer*>(writeRecordLayer);
+  if (encryptedWriteRecordLayer) {
+    encryptedWriteRecordLayer->setDynamicRecordSizing(
+        *dynamicRecordSizing_, recordSizingState_);
+  }
+}
+
 void AsyncFizzBase::startTransportReads() {
   transport_->setReadCB(this);
 }
@@ -8,8 +8,12 @@
 
 #pragma once
 
+#include <fizz/protocol/Actions.h>
+#include <fizz/protocol/KTLS.h>
 #include <fizz/protocol/KeyScheduler.h>
+#include <fizz/record/EncryptedRecordLayer.h>
 #include <fizz/record/Types.h>
+#include <folly/Function.h>
 #include <folly/io/IOBufQueue.h>
 #include <folly/io/async/AsyncSocket.h>
 #include <folly/io/async/WriteChainAsyncTransportWrapper.h>
@@ -46,6 +50,16 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
     AsyncFizzBase& transport_;
   };
 
+  /**
+   * Settings for coalescing small app writes, see setWriteCoalescing().
+   */
+  struct WriteCoalescing {
+    // Coalesced writes are flushed as soon as this many bytes are buffered.
+    size_t maxBufferedBytes{kMaxPlaintextRecordSize};
+    // Writes flagged with WriteFlags::CORK are held for at most this long.
+    std::chrono::milliseconds flushTimeout{5};
+  };
+
   class SecretCallback {
    public:
     virtual ~SecretCallback() = default;
@@ -156,6 +170,7 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
   }
   void attachEventBase(folly::EventBase* eventBase) override {
     handshakeTimeout_.attachEventBase(eventBase);
+    flushTimeout_.attachEventBase(eventBase);
     transport_->attachEventBase(eventBase);
     // we want to avoid setting a read cb on a bad transport (i.e. closed or
     // disconnected) unless we have a read callback we can pass the errors to.
@@ -164,7 +179,10 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
     }
   }
   void detachEventBase() override {
+    flushCoalescedWrites();
+    ktlsLoopCallback_.cancelLoopCallback();
     handshakeTimeout_.detachEventBase();
+    flushTimeout_.detachEventBase();
     transport_->setReadCB(nullptr);
     transport_->detachEventBase();
   }
@@ -210,7 +228,122 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
     return closeTransportOnCloseNotify_;
   }
 
+  /**
+   * Coalesce app writes rather than encrypting and writing each one as it is
+   * made, so that many small writes share records and socket writes. Writes
+   * are flushed together at the end of the current event loop iteration,
+   * except that writes flagged with WriteFlags::CORK wait for more data for up
+   * to flushTimeout. A write flagged with WriteFlags::EOR, or one that brings
+   * the buffered data up to maxBufferedBytes, flushes immediately. CORK and
+   * EOR are taken from the last write of a batch; a write whose other flags
+   * differ from those of the buffered writes flushes them first. Buffered
+   * writes that haven't been flushed when the transport is destroyed fail.
+   */
+  void setWriteCoalescing(WriteCoalescing settings) {
+    writeCoalescing_ = std::move(settings);
+  }
+
+  /**
+   * Size the app data records written on this connection dynamically, see
+   * DynamicRecordSizing. Applies to the current write record layer as well as
+   * any installed later (e.g. after a key update). Layers installed later carry
+   * on ramping up from where the layer they replace left off.
+   */
+  void setDynamicRecordSizing(DynamicRecordSizing settings) {
+    dynamicRecordSizing_ = std::move(settings);
+    configuredWriteRecordLayer_ = nullptr;
+    updateWriteRecordLayer();
+  }
+
+  /**
+   * Hand the encryption of this connection's writes to the kernel (kTLS) once
+   * the handshake is complete. This only happens if the transport is a TCP
+   * AsyncSocket, the cipher is supported, the kernel can switch keys when the
+   * peer requests a key update (see KTLS::isRekeySupported()) and it accepts
+   * the keys; otherwise writes keep being encrypted in user space. Reads are
+   * always decrypted in user space, see KTLS.
+   */
+  void setKTLSOffload(bool enabled) {
+    ktlsOffload_ = enabled;
+  }
+
+  /**
+   * Returns true once writes are being encrypted by the kernel.
+   */
+  bool isKTLSOffloaded() const {
+    return ktlsFd_ >= 0;
+  }
+
+  /**
+   * Writes length bytes of the file fd, starting at offset. The file is mapped
+   * rather than read into a buffer, so it is never read() into user space
+   * memory, and with kTLS offload it isn't encrypted in user space either;
+   * the socket still copies the data out of the mapping when sending it. The
+   * callback fails with BAD_ARGS if the range extends past the end of the
+   * file. The file must not be truncated until the write completes.
+   */
+  void writeFile(
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      int fd,
+      off_t offset,
+      size_t length,
+      folly::WriteFlags flags = folly::WriteFlags::NONE);
+
  protected:
+  /**
+   * Interface for the derived class to apply the write record layer settings
+   * to its current write record layer. Called when the settings change, and
+   * the derived class should call it whenever its write record layer may have
+   * been replaced.
+   */
+  virtual void updateWriteRecordLayer() {}
+
+  /**
+   * Applies the write record layer settings to writeRecordLayer, unless it is
+   * the layer they were last applied to.
+   */
+  void configureWriteRecordLayer(WriteRecordLayer* writeRecordLayer);
+
+  /**
+   * Hands any coalesced writes to writeAppData(). The derived class should
+   * call this before closing gracefully.
+   */
+  void flushCoalescedWrites();
+
+  /**
+   * Fails any coalesced writes that have not been handed to writeAppData()
+   * yet.
+   */
+  void failCoalescedWrites(const folly::AsyncSocketException& ex);
+
+  /**
+   * Starts handing writes to the kernel if kTLS offload is enabled. The
+   * derived class should call this once the handshake is complete.
+   */
+  void startKTLSOffload();
+
+  /**
+   * Interface for the derived class to hand the encryption of its writes to
+   * the kernel with KTLS::enableTx() and replace its write record layer with a
+   * KTLSWriteRecordLayer. Returns false if that isn't possible right now.
+   */
+  virtual bool offloadWriteRecordLayer(int /* fd */) {
+    return false;
+  }
+
+  /**
+   * Writes the records of data to the transport once writes are encrypted by
+   * the kernel.
+   */
+  void writeToKTLSSocket(WriteToSocket& data);
+
+  /**
+   * Switches the kernel to params right after the next handshake record is
+   * written, which is the KeyUpdate announcing the new key. The derived class
+   * should call this when its write key changes.
+   */
+  void rekeyKTLS(KTLSParams params);
+
   /**
    * Start reading raw data from the transport.
    */
@@ -280,10 +413,63 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
       size_t bytesWritten,
       const folly::AsyncSocketException& ex) noexcept override;
 
+  class FlushTimeout : public folly::AsyncTimeout {
+   public:
+    FlushTimeout(AsyncFizzBase& transport, folly::EventBase* eventBase)
+        : folly::AsyncTimeout(eventBase), transport_(transport) {}
+
+    void timeoutExpired() noexcept override {
+      transport_.flushCoalescedWrites();
+    }
+
+   private:
+    AsyncFizzBase& transport_;
+  };
+
+  class FlushLoopCallback : public folly::EventBase::LoopCallback {
+   public:
+    explicit FlushLoopCallback(AsyncFizzBase& transport)
+        : transport_(transport) {}
+
+    void runLoopCallback() noexcept override {
+      transport_.flushCoalescedWrites();
+    }
+
+   private:
+    AsyncFizzBase& transport_;
+  };
+
+  class KTLSLoopCallback : public folly::EventBase::LoopCallback {
+   public:
+    explicit KTLSLoopCallback(AsyncFizzBase& transport)
+        : transport_(transport) {}
+
+    void runLoopCallback() noexcept override {
+      transport_.tryKTLSOffload();
+    }
+
+   private:
+    AsyncFizzBase& transport_;
+  };
+
+  class KTLSBarrier;
+
   void checkBufLen();
 
   void handshakeTimeoutExpired() noexcept;
 
+  void writeCoalesced(folly::WriteFlags flags);
+
+  void tryKTLSOffload();
+
+  /**
+   * Runs op once everything already written to the transport has been sent,
+   * then completes callback.
+   */
+  void writeKTLSBarrier(
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      folly::Function<void()> op);
+
   ReadCallback* readCallback_{nullptr};
   std::unique_ptr<folly::IOBuf> appDataBuf_;
 
@@ -294,5 +480,24 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
 
   bool closeTransportOnCloseNotify_{true};
   SecretCallback* secretCallback_{nullptr};
+
+  folly::Optional<DynamicRecordSizing> dynamicRecordSizing_;
+  std::shared_ptr<RecordSizingState> recordSizingState_{
+      std::make_shared<RecordSizingState>()};
+  // Only compared against, never dereferenced: it may have been freed since.
+  const WriteRecordLayer* configuredWriteRecordLayer_{nullptr};
+
+  folly::Optional<WriteCoalescing> writeCoalescing_;
+  folly::IOBufQueue coalescedWrites_{folly::IOBufQueue::cacheChainLength()};
+  std::vector<folly::AsyncTransportWrapper::WriteCallback*>
+      coalescedCallbacks_;
+  folly::WriteFlags coalescedFlags_{folly::WriteFlags::NONE};
+  FlushTimeout flushTimeout_;
+  FlushLoopCallback flushLoopCallback_;
+
+  bool ktlsOffload_{false};
+  int ktlsFd_{-1};
+  folly::Optional<KTLSParams> pendingKTLSRekey_;
+  KTLSLoopCallback ktlsLoopCallback_;
 };
 } // namespace fizz
@@ -48,6 +48,8 @@ SelfCertImpl<T>::SelfCertImpl(
   // TODO: more strict validation of chaining requirements.
   signature_.setKey(std::move(pkey));
   certs_ = std::move(certs);
+  certMessage_ = CertUtils::getCertMessage(certs_, nullptr);
+  encodedCertMessage_ = encodeHandshake(getCertMessage());
   for (const auto& compressor : compressors) {
     compressedCerts_[compressor->getAlgorithm()] =
         compressor->compress(getCertMessage());
@@ -68,8 +70,13 @@ std::vector<std::string> SelfCertImpl<T>::getAltIdentities() const {
 template <KeyType T>
 CertificateMsg SelfCertImpl<T>::getCertMessage(
     Buf certificateRequestContext) const {
-  return CertUtils::getCertMessage(
-      certs_, std::move(certificateRequestContext));
+  return CertUtils::cloneCertMessage(
+      certMessage_, std::move(certificateRequestContext));
+}
+
+template <KeyType T>
+Buf SelfCertImpl<T>::getEncodedCertMessage() const {
+  return encodedCertMessage_->clone();
 }
 
 template <KeyType T>
@@ -84,6 +84,25 @@ CertificateMsg CertUtils::getCertMessage(
   return msg;
 }
 
+CertificateMsg CertUtils::cloneCertMessage(
+    const CertificateMsg& src,
+    Buf certificateRequestContext) {
+  CertificateMsg msg;
+  msg.certificate_request_context = std::move(certificateRequestContext);
+  for (const auto& srcEntry : src.certificate_list) {
+    CertificateEntry entry;
+    entry.cert_data = srcEntry.cert_data->clone();
+    for (const auto& ext : srcEntry.extensions) {
+      Extension extension;
+      extension.extension_type = ext.extension_type;
+      extension.extension_data = ext.extension_data->clone();
+      entry.extensions.push_back(std::move(extension));
+    }
+    msg.certificate_list.push_back(std::move(entry));
+  }
+  return msg;
+}
+
 std::unique_ptr<PeerCert> CertUtils::makePeerCert(Buf certData) {
   if (certData->empty()) {
     throw std::runtime_error("empty peer cert");
@@ -52,6 +52,14 @@ class SelfCert : public Cert {
   virtual CertificateMsg getCertMessage(
       Buf certificateRequestContext = nullptr) const = 0;
 
+  /**
+   * Returns the encoded Certificate handshake message with an empty
+   * certificate request context. May share its buffer with other callers.
+   */
+  virtual Buf getEncodedCertMessage() const {
+    return encodeHandshake(getCertMessage());
+  }
+
   virtual CompressedCertificate getCompressedCert(
       CertificateCompressionAlgorithm algo) const = 0;
 
@@ -90,6 +98,14 @@ class CertUtils {
       const std::vector<folly::ssl::X509UniquePtr>& certs,
       Buf certificateRequestContext);
 
+  /**
+   * Clones a certificate message, sharing the underlying cert data, but with
+   * a different request context.
+   */
+  static CertificateMsg cloneCertMessage(
+      const CertificateMsg& src,
+      Buf certificateRequestContext);
+
   template <KeyType T>
   static std::vector<SignatureScheme> getSigSchemes();
 
@@ -155,6 +171,11 @@ class SelfCertImpl : public SelfCert {
   CertificateMsg getCertMessage(
       Buf certificateRequestContext = nullptr) const override;
 
+  /**
+   * Returns a clone of the message encoded at construction.
+   */
+  Buf getEncodedCertMessage() const override;
+
   CompressedCertificate getCompressedCert(
       CertificateCompressionAlgorithm algo) const override;
 
@@ -165,9 +186,20 @@ class SelfCertImpl : public SelfCert {
 
   folly::ssl::X509UniquePtr getX509() const override;
 
+  /**
+   * Signs with ECDSA nonces precomputed on a background thread, falling back
+   * to regular signing whenever none is ready. Not available for RSA.
+   */
+  void usePrecomputedNonces(size_t depth = ECDSANoncePool::kDefaultDepth) {
+    signature_.usePrecomputedNonces(depth);
+  }
+
  private:
   OpenSSLSignature<T> signature_;
   std::vector<folly::ssl::X509UniquePtr> certs_;
+  // DER encoded chain, without request context.
+  CertificateMsg certMessage_;
+  Buf encodedCertMessage_;
   std::map<CertificateCompressionAlgorithm, CompressedCertificate>
       compressedCerts_;
 };
@@ -7,8 +7,12 @@
  */
 
 #include <fizz/protocol/DefaultCertificateVerifier.h>
+
+#include <fizz/crypto/Sha256.h>
 #include <folly/ssl/OpenSSLCertUtils.h>
 
+#include <array>
+
 namespace fizz {
 
 struct STACK_OF_X509_deleter {
@@ -28,6 +32,96 @@ DefaultCertificateVerifier::createFromCAFile(
 
 void DefaultCertificateVerifier::verify(
     const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) const {
+  if (!cache_) {
+    return verifyChain(certs);
+  }
+  if (certs.empty()) {
+    throw std::runtime_error("no certificates to verify");
+  }
+
+  std::vector<folly::ssl::X509UniquePtr> x509s;
+  for (const auto& cert : certs) {
+    x509s.push_back(cert->getX509());
+  }
+  auto hash = getChainHash(x509s);
+  auto now = std::chrono::system_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    auto it = cache_->entries.find(hash);
+    if (it != cache_->entries.end()) {
+      if (now < it->second) {
+        return;
+      }
+      cache_->entries.erase(hash);
+    }
+  }
+
+  verifyChain(certs);
+
+  auto expiry = now + cache_->ttl;
+  for (const auto& x509 : x509s) {
+    expiry =
+        std::min(expiry, folly::ssl::OpenSSLCertUtils::getNotAfterTime(*x509));
+  }
+  if (expiry <= now || cache_->maxEntries == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(cache_->mutex);
+  cache_->entries.set(std::move(hash), expiry);
+}
+
+void DefaultCertificateVerifier::setVerificationCache(
+    std::chrono::seconds ttl,
+    size_t maxEntries) {
+  cache_ = std::make_unique<VerificationCache>(ttl, maxEntries);
+}
+
+void DefaultCertificateVerifier::clearVerificationCache() {
+  if (cache_) {
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    cache_->entries.clear();
+  }
+}
+
+std::string DefaultCertificateVerifier::getChainHash(
+    const std::vector<folly::ssl::X509UniquePtr>& certs) {
+  Sha256 sha;
+  sha.hash_init();
+  // Most certs fit in here, so hashing a chain usually doesn't allocate.
+  std::array<uint8_t, 4096> stackDer;
+  std::unique_ptr<uint8_t[]> heapDer;
+  for (const auto& cert : certs) {
+    int len = i2d_X509(cert.get(), nullptr);
+    if (len < 0) {
+      throw std::runtime_error("Error computing length");
+    }
+    auto der = stackDer.data();
+    if (static_cast<size_t>(len) > stackDer.size()) {
+      heapDer.reset(new uint8_t[len]);
+      der = heapDer.get();
+    }
+    auto derData = der;
+    if (i2d_X509(cert.get(), &derData) != len) {
+      throw std::runtime_error("Error converting cert to DER");
+    }
+    // Length prefix each cert so that chains can't collide by shifting
+    // bytes between adjacent certs.
+    std::array<uint8_t, 4> prefix{{static_cast<uint8_t>(len >> 24),
+                                   static_cast<uint8_t>(len >> 16),
+                                   static_cast<uint8_t>(len >> 8),
+                                   static_cast<uint8_t>(len)}};
+    sha.hash_update(folly::range(prefix));
+    sha.hash_update(folly::ByteRange(der, len));
+  }
+  std::string hash(Sha256::HashLen, '\0');
+  sha.hash_final(folly::MutableByteRange(
+      reinterpret_cast<uint8_t*>(&hash[0]), hash.size()));
+  return hash;
+}
+
+void DefaultCertificateVerifier::verifyChain(
+    const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) const {
   if (certs.empty()) {
     throw std::runtime_error("no certificates to verify");
   }
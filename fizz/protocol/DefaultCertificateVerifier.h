@@ -9,6 +9,10 @@
 #pragma once
 
 #include <fizz/protocol/CertificateVerifier.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <chrono>
+#include <mutex>
 
 namespace fizz {
 
@@ -45,27 +49,70 @@ class DefaultCertificateVerifier : public CertificateVerifier {
 
   void setCustomVerifyCallback(X509VerifyCallback cb) {
     customVerifyCallback_ = cb;
+    clearVerificationCache();
   }
 
   void setX509Store(folly::ssl::X509StoreUniquePtr&& store) {
     x509Store_ = std::move(store);
     createAuthorities();
+    clearVerificationCache();
   }
 
+  /**
+   * Remembers successfully verified chains, keyed by a hash of their DER
+   * encoding, so that peers presenting the same chain again skip path
+   * validation. Entries last for ttl, and never past the earliest notAfter in
+   * the chain. Failed verifications are never cached. Once maxEntries chains
+   * are cached, the least recently used one is evicted.
+   *
+   * Cached chains are not rechecked against CRLs added to the store later.
+   *
+   * A cache hit skips path validation entirely, so the custom verify callback
+   * is not called for it either. Only combine the two if the callback's
+   * decision depends on nothing but the chain, and it doesn't need to see
+   * every verification (e.g. to log or count them).
+   */
+  void setVerificationCache(
+      std::chrono::seconds ttl,
+      size_t maxEntries = kDefaultVerificationCacheSize);
+
+  void clearVerificationCache();
+
   std::vector<Extension> getCertificateRequestExtensions() const override;
 
   static X509_STORE* getDefaultX509Store();
 
+  static constexpr size_t kDefaultVerificationCacheSize = 4096;
+
   static std::unique_ptr<DefaultCertificateVerifier> createFromCAFile(
       VerificationContext context,
       const std::string& caFile);
 
  private:
+  struct VerificationCache {
+    VerificationCache(std::chrono::seconds ttlIn, size_t maxEntriesIn)
+        : ttl(ttlIn), maxEntries(maxEntriesIn), entries(maxEntriesIn) {}
+
+    std::chrono::seconds ttl;
+    size_t maxEntries;
+    std::mutex mutex;
+    // Hash of the chain to when the entry expires.
+    folly::EvictingCacheMap<std::string, std::chrono::system_clock::time_point>
+        entries;
+  };
+
+  void verifyChain(
+      const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) const;
+
+  static std::string getChainHash(
+      const std::vector<folly::ssl::X509UniquePtr>& certs);
+
   void createAuthorities();
 
   CertificateAuthorities authorities_;
   VerificationContext context_;
   folly::ssl::X509StoreUniquePtr x509Store_;
   X509VerifyCallback customVerifyCallback_{nullptr};
+  std::unique_ptr<VerificationCache> cache_;
 };
 } // namespace fizz
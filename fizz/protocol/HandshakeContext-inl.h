@@ -20,22 +20,30 @@ HandshakeContextImpl<Hash>::HandshakeContextImpl(
 template <typename Hash>
 void HandshakeContextImpl<Hash>::appendToTranscript(const Buf& data) {
   hashState_.hash_update(*data);
+  contextValid_ = false;
 }
 
 template <typename Hash>
 Buf HandshakeContextImpl<Hash>::getHandshakeContext() const {
-  Hash copied(hashState_);
-  auto out = folly::IOBuf::create(Hash::HashLen);
-  out->append(Hash::HashLen);
-  folly::MutableByteRange outRange(out->writableData(), out->length());
-  copied.hash_final(outRange);
-  return out;
+  auto context = getHandshakeContextRange();
+  return folly::IOBuf::copyBuffer(context.data(), context.size());
+}
+
+template <typename Hash>
+folly::ByteRange HandshakeContextImpl<Hash>::getHandshakeContextRange() const {
+  if (!contextValid_) {
+    // Finalize a copy so that the transcript can still be appended to.
+    Hash copied(hashState_);
+    copied.hash_final(folly::range(context_));
+    contextValid_ = true;
+  }
+  return folly::range(context_);
 }
 
 template <typename Hash>
 Buf HandshakeContextImpl<Hash>::getFinishedData(
     folly::ByteRange baseKey) const {
-  auto context = getHandshakeContext();
+  auto context = getHandshakeContextRange();
   auto finishedKey =
       KeyDerivationImpl<Hash>(hkdfLabelPrefix_)
           .expandLabel(
@@ -43,7 +51,10 @@ Buf HandshakeContextImpl<Hash>::getFinishedData(
   auto data = folly::IOBuf::create(Hash::HashLen);
   data->append(Hash::HashLen);
   auto outRange = folly::MutableByteRange(data->writableData(), data->length());
-  Hash::hmac(finishedKey->coalesce(), *context, outRange);
+  Hash::hmac(
+      finishedKey->coalesce(),
+      folly::IOBuf::wrapBufferAsValue(context),
+      outRange);
   return data;
 }
 } // namespace fizz
@@ -30,6 +30,16 @@ class HandshakeContext {
    */
   virtual Buf getHandshakeContext() const = 0;
 
+  /**
+   * Returns the handshake context for the current transcript, without copying
+   * it if the implementation keeps it around. The range is valid until the
+   * transcript is next appended to or this is next called.
+   */
+  virtual folly::ByteRange getHandshakeContextRange() const {
+    context_ = getHandshakeContext();
+    return context_->coalesce();
+  }
+
   /**
    * Returns the finished verify_data from the current handshake context and
    * baseKey.
@@ -40,8 +50,18 @@ class HandshakeContext {
    * Returns the handshake context for an empty transcript.
    */
   virtual folly::ByteRange getBlankContext() const = 0;
+
+ private:
+  mutable Buf context_;
 };
 
+/**
+ * HandshakeContext using a templated hash.
+ *
+ * The digest of the transcript is computed at most once per transcript
+ * position: it is cached on first use and only recomputed after the
+ * transcript is appended to.
+ */
 template <typename Hash>
 class HandshakeContextImpl : public HandshakeContext {
  public:
@@ -51,6 +71,8 @@ class HandshakeContextImpl : public HandshakeContext {
 
   Buf getHandshakeContext() const override;
 
+  folly::ByteRange getHandshakeContextRange() const override;
+
   Buf getFinishedData(folly::ByteRange baseKey) const override;
 
   folly::ByteRange getBlankContext() const override {
@@ -60,6 +82,9 @@ class HandshakeContextImpl : public HandshakeContext {
  private:
   Hash hashState_;
   std::string hkdfLabelPrefix_;
+
+  mutable std::array<uint8_t, Hash::HashLen> context_;
+  mutable bool contextValid_{false};
 };
 } // namespace fizz
 
@@ -0,0 +1,35 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/record/EncryptedRecordLayer.h>
+
+namespace fizz {
+
+template <typename State>
+folly::Optional<KTLSParams> KTLS::getWriteParams(
+    const State& state,
+    AppTrafficSecrets writeSecret) {
+  auto writeRecordLayer =
+      dynamic_cast<const EncryptedWriteRecordLayer*>(state.writeRecordLayer());
+  if (!writeRecordLayer ||
+      writeRecordLayer->getEncryptionLevel() != EncryptionLevel::AppTraffic ||
+      !state.cipher() || !isSupported(*state.cipher()) ||
+      !state.keyScheduler()) {
+    return folly::none;
+  }
+
+  auto aead = state.context()->getFactory()->makeAead(*state.cipher());
+  auto secret = state.keyScheduler()->getSecret(writeSecret);
+  KTLSParams params;
+  params.cipher = *state.cipher();
+  params.key = state.keyScheduler()->getTrafficKey(
+      folly::range(secret.secret), aead->keyLength(), aead->ivLength());
+  params.seqNum = writeRecordLayer->getSequenceNumber();
+  return std::move(params);
+}
+} // namespace fizz
@@ -0,0 +1,274 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/KTLS.h>
+
+#include <fizz/crypto/Utils.h>
+#include <folly/ScopeGuard.h>
+#include <folly/lang/Bits.h>
+#include <folly/io/Cursor.h>
+#include <folly/portability/Sockets.h>
+#include <folly/portability/Unistd.h>
+
+#include <system_error>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/tls.h>)
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#endif
+#endif
+
+#if defined(TLS_1_3_VERSION)
+#define FIZZ_HAVE_KTLS 1
+#else
+#define FIZZ_HAVE_KTLS 0
+#endif
+
+#if FIZZ_HAVE_KTLS
+// Older libc headers don't define these.
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#endif
+
+namespace fizz {
+
+TLSContent KTLSWriteRecordLayer::write(TLSMessage&& msg) const {
+  TLSContent content;
+  content.data = std::move(msg.fragment);
+  content.contentType = msg.type;
+  content.encryptionLevel = EncryptionLevel::AppTraffic;
+  return content;
+}
+
+#if FIZZ_HAVE_KTLS
+
+namespace {
+
+template <typename Info>
+void setCryptoInfo(int fd, uint16_t cipherType, const KTLSParams& params) {
+  Info info;
+  memset(&info, 0, sizeof(info));
+  info.info.version = TLS_1_3_VERSION;
+  info.info.cipher_type = cipherType;
+
+  if (params.key.key->computeChainDataLength() != sizeof(info.key) ||
+      params.key.iv->computeChainDataLength() !=
+          sizeof(info.salt) + sizeof(info.iv)) {
+    throw std::runtime_error("Invalid kTLS key");
+  }
+  folly::io::Cursor(params.key.key.get()).pull(info.key, sizeof(info.key));
+  // The kernel splits the TLS 1.3 iv into an implicit salt and the part it
+  // xors with the sequence number.
+  folly::io::Cursor iv(params.key.iv.get());
+  iv.pull(info.salt, sizeof(info.salt));
+  iv.pull(info.iv, sizeof(info.iv));
+  uint64_t seqNum = folly::Endian::big(params.seqNum);
+  memcpy(info.rec_seq, &seqNum, sizeof(info.rec_seq));
+
+  auto ret = setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info));
+  auto err = errno;
+  CryptoUtils::clean(
+      folly::MutableByteRange(reinterpret_cast<uint8_t*>(&info), sizeof(info)));
+  if (ret != 0) {
+    throw std::system_error(
+        err, std::system_category(), "setsockopt(TLS_TX) failed");
+  }
+}
+} // namespace
+
+bool KTLS::isSupported(CipherSuite cipher) {
+  switch (cipher) {
+    case CipherSuite::TLS_AES_128_GCM_SHA256:
+      return true;
+#ifdef TLS_CIPHER_AES_GCM_256
+    case CipherSuite::TLS_AES_256_GCM_SHA384:
+      return true;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+void KTLS::enableTx(int fd, const KTLSParams& params) {
+  if (!isSupported(params.cipher)) {
+    throw std::runtime_error("Unsupported kTLS cipher");
+  }
+  if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+    throw std::system_error(
+        errno, std::system_category(), "setsockopt(TCP_ULP) failed");
+  }
+  setTxKey(fd, params);
+}
+
+void KTLS::setTxKey(int fd, const KTLSParams& params) {
+  switch (params.cipher) {
+    case CipherSuite::TLS_AES_128_GCM_SHA256:
+      return setCryptoInfo<tls12_crypto_info_aes_gcm_128>(
+          fd, TLS_CIPHER_AES_GCM_128, params);
+#ifdef TLS_CIPHER_AES_GCM_256
+    case CipherSuite::TLS_AES_256_GCM_SHA384:
+      return setCryptoInfo<tls12_crypto_info_aes_gcm_256>(
+          fd, TLS_CIPHER_AES_GCM_256, params);
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
+      return setCryptoInfo<tls12_crypto_info_chacha20_poly1305>(
+          fd, TLS_CIPHER_CHACHA20_POLY1305, params);
+#endif
+    default:
+      throw std::runtime_error("Unsupported kTLS cipher");
+  }
+}
+
+namespace {
+
+/**
+ * Returns a connected loopback TCP socket, or -1.
+ */
+int connectLoopback() {
+  auto listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0) {
+    return -1;
+  }
+  SCOPE_EXIT {
+    close(listener);
+  };
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addrLen = sizeof(addr);
+  if (bind(listener, (struct sockaddr*)&addr, addrLen) != 0 ||
+      listen(listener, 1) != 0 ||
+      getsockname(listener, (struct sockaddr*)&addr, &addrLen) != 0) {
+    return -1;
+  }
+  auto fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (connect(fd, (struct sockaddr*)&addr, addrLen) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool probeRekey() {
+  auto fd = connectLoopback();
+  if (fd < 0) {
+    return false;
+  }
+  SCOPE_EXIT {
+    close(fd);
+  };
+  KTLSParams params;
+  params.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+  params.key.key = folly::IOBuf::create(16);
+  params.key.key->append(16);
+  memset(params.key.key->writableData(), 0, 16);
+  params.key.iv = folly::IOBuf::create(12);
+  params.key.iv->append(12);
+  memset(params.key.iv->writableData(), 0, 12);
+  try {
+    KTLS::enableTx(fd, params);
+    KTLS::setTxKey(fd, params);
+  } catch (const std::exception& e) {
+    VLOG(4) << "kTLS key updates not supported: " << e.what();
+    return false;
+  }
+  return true;
+}
+
+// Write flags only use the low bits; the record type goes in the top byte.
+constexpr uint32_t kRecordTypeShift = 24;
+
+folly::Optional<uint8_t> getRecordType(folly::WriteFlags flags) {
+  auto type = static_cast<uint32_t>(flags) >> kRecordTypeShift;
+  if (type == 0) {
+    return folly::none;
+  }
+  return static_cast<uint8_t>(type);
+}
+
+class KTLSSendMsgParamsCallback
+    : public folly::AsyncSocket::SendMsgParamsCallback {
+ public:
+  void getAncillaryData(folly::WriteFlags flags, void* data) noexcept override {
+    auto recordType = getRecordType(flags);
+    if (!recordType) {
+      return;
+    }
+    auto cmsg = reinterpret_cast<struct cmsghdr*>(data);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(*recordType));
+    memcpy(CMSG_DATA(cmsg), &*recordType, sizeof(*recordType));
+  }
+
+  uint32_t getAncillaryDataSize(folly::WriteFlags flags) noexcept override {
+    return getRecordType(flags) ? CMSG_SPACE(sizeof(uint8_t)) : 0;
+  }
+};
+} // namespace
+
+bool KTLS::isRekeySupported() {
+  static const bool supported = probeRekey();
+  return supported;
+}
+
+folly::WriteFlags KTLS::recordTypeFlags(ContentType type) {
+  return static_cast<folly::WriteFlags>(
+      static_cast<uint32_t>(type) << kRecordTypeShift);
+}
+
+folly::AsyncSocket::SendMsgParamsCallback* KTLS::getSendMsgParamsCallback() {
+  static KTLSSendMsgParamsCallback callback;
+  return &callback;
+}
+
+#else
+
+bool KTLS::isSupported(CipherSuite) {
+  return false;
+}
+
+void KTLS::enableTx(int, const KTLSParams&) {
+  throw std::system_error(
+      ENOTSUP, std::system_category(), "kTLS not available");
+}
+
+void KTLS::setTxKey(int, const KTLSParams&) {
+  throw std::system_error(
+      ENOTSUP, std::system_category(), "kTLS not available");
+}
+
+bool KTLS::isRekeySupported() {
+  return false;
+}
+
+folly::WriteFlags KTLS::recordTypeFlags(ContentType) {
+  return folly::WriteFlags::NONE;
+}
+
+folly::AsyncSocket::SendMsgParamsCallback* KTLS::getSendMsgParamsCallback() {
+  static folly::AsyncSocket::SendMsgParamsCallback callback;
+  return &callback;
+}
+
+#endif
+} // namespace fizz
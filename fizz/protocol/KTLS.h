@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/aead/Aead.h>
+#include <fizz/protocol/KeyScheduler.h>
+#include <fizz/record/RecordLayer.h>
+#include <fizz/record/Types.h>
+#include <folly/io/async/AsyncSocket.h>
+
+namespace fizz {
+
+/**
+ * Key material for the kernel to encrypt a connection's writes with.
+ */
+struct KTLSParams {
+  CipherSuite cipher;
+  TrafficKey key;
+  uint64_t seqNum{0};
+};
+
+/**
+ * Write record layer used once encryption of a connection's writes has been
+ * handed to the kernel. Records are passed through as plaintext and the
+ * kernel frames and encrypts them; records that are not application data
+ * have to be written with KTLS::recordTypeFlags() to keep their content type.
+ */
+class KTLSWriteRecordLayer : public WriteRecordLayer {
+ public:
+  TLSContent write(TLSMessage&& msg) const override;
+
+  EncryptionLevel getEncryptionLevel() const override {
+    return EncryptionLevel::AppTraffic;
+  }
+};
+
+/**
+ * Linux kernel TLS (kTLS) support. Only the transmit direction is offloaded,
+ * so that post-handshake messages from the peer (key updates, tickets and
+ * alerts) keep being processed by the user space read record layer.
+ */
+class KTLS {
+ public:
+  /**
+   * Returns true if this build can hand writes encrypted with cipher to the
+   * kernel. The kernel may still refuse at runtime.
+   */
+  static bool isSupported(CipherSuite cipher);
+
+  /**
+   * Returns the parameters for handing the writes of a connection in state to
+   * the kernel, or none if its current write record layer can't be. The
+   * record layer must be an EncryptedWriteRecordLayer, whose sequence number
+   * the kernel will carry on from.
+   */
+  template <typename State>
+  static folly::Optional<KTLSParams> getWriteParams(
+      const State& state,
+      AppTrafficSecrets writeSecret);
+
+  /**
+   * Attaches the kernel TLS module to the TCP socket fd and hands it the
+   * encryption of everything written to fd from now on. Throws
+   * std::system_error on failure.
+   */
+  static void enableTx(int fd, const KTLSParams& params);
+
+  /**
+   * Replaces the key that writes on fd are encrypted with after enableTx().
+   * Only kernels that support TLS 1.3 key updates accept this. Throws
+   * std::system_error on failure.
+   */
+  static void setTxKey(int fd, const KTLSParams& params);
+
+  /**
+   * Returns true if the kernel accepts setTxKey(), without which a connection
+   * whose writes it encrypts can't answer a key update requested by the peer.
+   * Probed once, by setting the key of a loopback connection twice.
+   */
+  static bool isRekeySupported();
+
+  /**
+   * Returns the write flags that make an AsyncSocket using
+   * getSendMsgParamsCallback() write data as records of the given content
+   * type instead of application data. These writes are queued and retried by
+   * the socket like any other, so they stay in order with application data.
+   * Data the socket can only write partially is split over several records of
+   * the same type.
+   */
+  static folly::WriteFlags recordTypeFlags(ContentType type);
+
+  /**
+   * Returns the SendMsgParamsCallback to install on an AsyncSocket after
+   * enableTx(), which attaches the record type of writes made with
+   * recordTypeFlags() to them. It replaces any callback installed before.
+   */
+  static folly::AsyncSocket::SendMsgParamsCallback* getSendMsgParamsCallback();
+};
+} // namespace fizz
+
+#include <fizz/protocol/KTLS-inl.h>
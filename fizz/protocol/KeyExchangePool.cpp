@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/KeyExchangePool.h>
+
+#include <fizz/protocol/OpenSSLFactory.h>
+#include <folly/portability/Unistd.h>
+
+namespace fizz {
+
+namespace {
+
+/**
+ * Wraps a key exchange whose key pair was generated by the pool. The first
+ * generateKeyPair() adopts that key pair; any later call generates a new one
+ * as usual.
+ */
+class PregeneratedKeyExchange : public KeyExchange {
+ public:
+  explicit PregeneratedKeyExchange(std::unique_ptr<KeyExchange> kex)
+      : kex_(std::move(kex)) {}
+
+  void generateKeyPair() override {
+    if (pregenerated_) {
+      pregenerated_ = false;
+      return;
+    }
+    kex_->generateKeyPair();
+  }
+
+  std::unique_ptr<folly::IOBuf> getKeyShare() const override {
+    return kex_->getKeyShare();
+  }
+
+  std::unique_ptr<folly::IOBuf> generateSharedSecret(
+      folly::ByteRange keyShare) const override {
+    return kex_->generateSharedSecret(keyShare);
+  }
+
+  const KeyExchange& wrapped() const {
+    return *kex_;
+  }
+
+ private:
+  std::unique_ptr<KeyExchange> kex_;
+  bool pregenerated_{true};
+};
+} // namespace
+
+KeyExchangePool::KeyExchangePool(
+    std::vector<NamedGroup> groups,
+    KeyExchangeMaker makeKeyExchange,
+    size_t depth)
+    : makeKeyExchange_(std::move(makeKeyExchange)),
+      depth_(depth),
+      pid_(getpid()),
+      cv_(std::make_unique<std::condition_variable>()) {
+  for (auto group : groups) {
+    pools_[group];
+  }
+  thread_ = std::make_unique<std::thread>([this]() { run(); });
+}
+
+KeyExchangePool::KeyExchangePool(size_t depth)
+    : KeyExchangePool(
+          {NamedGroup::x25519,
+           NamedGroup::secp256r1,
+           NamedGroup::secp384r1,
+           NamedGroup::secp521r1},
+          [factory = std::make_shared<OpenSSLFactory>()](NamedGroup group) {
+            // Qualified so that this never draws from a pool itself.
+            return factory->Factory::makeKeyExchange(group);
+          },
+          depth) {}
+
+KeyExchangePool::~KeyExchangePool() {
+  if (forked()) {
+    cv_.release();
+    thread_.release();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_->notify_all();
+  thread_->join();
+}
+
+std::unique_ptr<KeyExchange> KeyExchangePool::take(NamedGroup group) {
+  if (forked()) {
+    return nullptr;
+  }
+  std::unique_ptr<KeyExchange> kex;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pools_.find(group);
+    if (it == pools_.end() || it->second.empty()) {
+      return nullptr;
+    }
+    kex = std::move(it->second.front());
+    it->second.pop_front();
+  }
+  cv_->notify_all();
+  return std::make_unique<PregeneratedKeyExchange>(std::move(kex));
+}
+
+size_t KeyExchangePool::available(NamedGroup group) const {
+  if (forked()) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = pools_.find(group);
+  return it == pools_.end() ? 0 : it->second.size();
+}
+
+const KeyExchange& KeyExchangePool::unwrap(const KeyExchange& kex) {
+  auto pregenerated = dynamic_cast<const PregeneratedKeyExchange*>(&kex);
+  return pregenerated ? pregenerated->wrapped() : kex;
+}
+
+bool KeyExchangePool::forked() const {
+  return getpid() != pid_;
+}
+
+void KeyExchangePool::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // Refill whichever group is the emptiest first.
+    auto next = pools_.end();
+    for (auto it = pools_.begin(); it != pools_.end(); ++it) {
+      if (it->second.size() < depth_ &&
+          (next == pools_.end() || it->second.size() < next->second.size())) {
+        next = it;
+      }
+    }
+    if (stop_) {
+      return;
+    }
+    if (next == pools_.end()) {
+      cv_->wait(lock);
+      continue;
+    }
+
+    auto group = next->first;
+    lock.unlock();
+    std::unique_ptr<KeyExchange> kex;
+    try {
+      kex = makeKeyExchange_(group);
+      kex->generateKeyPair();
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "Failed to pregenerate key pair for "
+                 << toString(group) << ": " << ex.what();
+      kex = nullptr;
+    }
+    lock.lock();
+    if (!kex) {
+      // Leave this group to be generated inline rather than spin on it.
+      pools_.erase(group);
+      continue;
+    }
+    pools_[group].push_back(std::move(kex));
+  }
+}
+} // namespace fizz
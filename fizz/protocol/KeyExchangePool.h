@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/exchange/KeyExchange.h>
+#include <fizz/record/Types.h>
+#include <folly/portability/SysTypes.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace fizz {
+
+/**
+ * Keeps ephemeral key pairs generated ahead of time, so that the expensive
+ * part of a key exchange happens on a background thread instead of while a
+ * handshake is waiting on it.
+ *
+ * The background thread refills each group to depth key pairs as they are
+ * taken. Each key pair is handed out at most once.
+ *
+ * A forked child never draws from a pool created by its parent: the key pairs
+ * are the parent's too, and the refill thread does not exist in the child.
+ * The pool then behaves as if it were empty, without touching its lock,
+ * which the refill thread may have held at the time of the fork.
+ */
+class KeyExchangePool {
+ public:
+  using KeyExchangeMaker =
+      std::function<std::unique_ptr<KeyExchange>(NamedGroup)>;
+
+  static constexpr size_t kDefaultDepth = 32;
+
+  /**
+   * makeKeyExchange creates the (empty) key exchanges to generate key pairs
+   * with, and must be safe to call from the background thread.
+   */
+  KeyExchangePool(
+      std::vector<NamedGroup> groups,
+      KeyExchangeMaker makeKeyExchange,
+      size_t depth = kDefaultDepth);
+
+  /**
+   * Pool for x25519, secp256r1, secp384r1 and secp521r1 using the key
+   * exchanges of the default Factory.
+   */
+  explicit KeyExchangePool(size_t depth = kDefaultDepth);
+
+  /**
+   * Stops the background thread. Key exchanges already taken stay valid. In a
+   * forked child this only frees the key pairs.
+   */
+  ~KeyExchangePool();
+
+  KeyExchangePool(const KeyExchangePool&) = delete;
+  KeyExchangePool& operator=(const KeyExchangePool&) = delete;
+
+  /**
+   * Returns a key exchange with a pregenerated key pair, or nullptr if group
+   * isn't pooled or its pool is currently empty.
+   *
+   * The first call to generateKeyPair() on the returned key exchange keeps
+   * the pregenerated key pair instead of generating a new one, so callers
+   * use it exactly like a key exchange they created themselves.
+   */
+  std::unique_ptr<KeyExchange> take(NamedGroup group);
+
+  /**
+   * Returns how many key pairs are ready for group.
+   */
+  size_t available(NamedGroup group) const;
+
+  /**
+   * Returns the key exchange that a key exchange returned by take() wraps, or
+   * kex itself if it didn't come from a pool.
+   */
+  static const KeyExchange& unwrap(const KeyExchange& kex);
+
+ private:
+  void run();
+
+  bool forked() const;
+
+  KeyExchangeMaker makeKeyExchange_;
+  size_t depth_;
+  pid_t pid_;
+
+  mutable std::mutex mutex_;
+  std::map<NamedGroup, std::deque<std::unique_ptr<KeyExchange>>> pools_;
+  bool stop_{false};
+
+  // Leaked in a forked child: the thread is gone, and destroying a condition
+  // variable it was waiting on would wait for it forever.
+  std::unique_ptr<std::condition_variable> cv_;
+  std::unique_ptr<std::thread> thread_;
+};
+} // namespace fizz
@@ -49,9 +49,11 @@ void KeyScheduler::deriveHandshakeSecret() {
 
 void KeyScheduler::deriveHandshakeSecret(folly::ByteRange ecdhe) {
   if (!secret_) {
-    auto zeros = std::vector<uint8_t>(deriver_->hashLength(), 0);
-    secret_ = EarlySecret{
-        deriver_->hkdfExtract(folly::range(zeros), folly::range(zeros))};
+    // Without a PSK everything before the extract with ecdhe is a constant.
+    auto preSecret = deriver_->noPskDerivedSecret();
+    secret_ =
+        HandshakeSecret{deriver_->hkdfExtract(folly::range(preSecret), ecdhe)};
+    return;
   }
 
   auto& earlySecret = boost::get<EarlySecret>(*secret_);
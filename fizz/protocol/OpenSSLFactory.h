@@ -10,12 +10,32 @@
 
 #include <fizz/crypto/Sha256.h>
 #include <fizz/crypto/Sha384.h>
+#include <fizz/crypto/aead/NativeCipher.h>
 #include <fizz/protocol/Factory.h>
+#include <fizz/protocol/KeyExchangePool.h>
+#include <fizz/protocol/PeerCertCache.h>
 
 namespace fizz {
 
 class OpenSSLFactory : public Factory {
  public:
+  std::unique_ptr<EncryptedReadRecordLayer> makeEncryptedReadRecordLayer(
+      EncryptionLevel encryptionLevel) const override {
+    auto readRecordLayer =
+        Factory::makeEncryptedReadRecordLayer(encryptionLevel);
+    readRecordLayer->setBatchAppData(batchAppData_);
+    return readRecordLayer;
+  }
+
+  std::unique_ptr<EncryptedWriteRecordLayer> makeEncryptedWriteRecordLayer(
+      EncryptionLevel encryptionLevel) const override {
+    auto writeRecordLayer =
+        Factory::makeEncryptedWriteRecordLayer(encryptionLevel);
+    writeRecordLayer->setUseRecordBufferPool(useRecordBufferPool_);
+    writeRecordLayer->setContiguousOutput(contiguousRecordOutput_);
+    return writeRecordLayer;
+  }
+
   std::unique_ptr<KeyDerivation> makeKeyDeriver(
       CipherSuite cipher) const override {
     switch (cipher) {
@@ -43,5 +63,107 @@ class OpenSSLFactory : public Factory {
         throw std::runtime_error("hs: not implemented");
     }
   }
+
+  std::unique_ptr<KeyExchange> makeKeyExchange(
+      NamedGroup group) const override {
+    if (keyExchangePool_) {
+      auto kex = keyExchangePool_->take(group);
+      if (kex) {
+        return kex;
+      }
+    }
+    return Factory::makeKeyExchange(group);
+  }
+
+  std::shared_ptr<PeerCert> makePeerCert(Buf certData) const override {
+    if (peerCertCache_) {
+      return peerCertCache_->makePeerCert(std::move(certData));
+    }
+    return Factory::makePeerCert(std::move(certData));
+  }
+
+  std::unique_ptr<Aead> makeAead(CipherSuite cipher) const override {
+    if (useNativeAead_) {
+      switch (cipher) {
+        case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
+          if (NativeCipher<NativeChaCha20Poly1305>::isSupported()) {
+            return std::make_unique<NativeCipher<NativeChaCha20Poly1305>>();
+          }
+          break;
+        case CipherSuite::TLS_AES_128_GCM_SHA256:
+          if (NativeCipher<NativeAESGCM128>::isSupported()) {
+            return std::make_unique<NativeCipher<NativeAESGCM128>>();
+          }
+          break;
+        case CipherSuite::TLS_AES_256_GCM_SHA384:
+          if (NativeCipher<NativeAESGCM256>::isSupported()) {
+            return std::make_unique<NativeCipher<NativeAESGCM256>>();
+          }
+          break;
+        default:
+          break;
+      }
+    }
+    return Factory::makeAead(cipher);
+  }
+
+  /**
+   * Use the native AES-GCM and ChaCha20-Poly1305 kernels instead of EVP when
+   * the CPU supports them. Ciphers without a usable kernel still use EVP.
+   */
+  void setUseNativeAead(bool enabled) {
+    useNativeAead_ = enabled;
+  }
+
+  /**
+   * Have encrypted read record layers decrypt every complete application data
+   * record available and deliver them as a single AppData event. See
+   * ReadRecordLayer::setBatchAppData().
+   */
+  void setBatchAppData(bool enabled) {
+    batchAppData_ = enabled;
+  }
+
+  /**
+   * Have encrypted write record layers write each record into a pooled
+   * buffer. See EncryptedWriteRecordLayer::setUseRecordBufferPool().
+   */
+  void setUseRecordBufferPool(bool enabled) {
+    useRecordBufferPool_ = enabled;
+  }
+
+  /**
+   * Have encrypted write record layers write all the records of a message into
+   * a single buffer. See EncryptedWriteRecordLayer::setContiguousOutput().
+   */
+  void setContiguousRecordOutput(bool enabled) {
+    contiguousRecordOutput_ = enabled;
+  }
+
+  /**
+   * Hand out key exchanges with key pairs pregenerated by pool when it has
+   * one ready, and create them as usual otherwise. The pool may be shared
+   * between factories.
+   */
+  void setKeyExchangePool(std::shared_ptr<KeyExchangePool> pool) {
+    keyExchangePool_ = std::move(pool);
+  }
+
+  /**
+   * Share parsed peer certificates through cache, so that certificates seen
+   * on several connections are parsed and held only once. The cache may be
+   * shared between factories.
+   */
+  void setPeerCertCache(std::shared_ptr<PeerCertCache> cache) {
+    peerCertCache_ = std::move(cache);
+  }
+
+ private:
+  bool useNativeAead_{false};
+  bool batchAppData_{false};
+  bool useRecordBufferPool_{false};
+  bool contiguousRecordOutput_{false};
+  std::shared_ptr<KeyExchangePool> keyExchangePool_;
+  std::shared_ptr<PeerCertCache> peerCertCache_;
 };
 } // namespace fizz
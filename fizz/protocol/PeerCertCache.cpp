@@ -0,0 +1,68 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/PeerCertCache.h>
+
+#include <fizz/crypto/Sha256.h>
+
+namespace fizz {
+
+PeerCertCache::PeerCertCache(size_t maxEntries, size_t numShards) {
+  if (numShards == 0) {
+    throw std::runtime_error("peer cert cache needs at least one shard");
+  }
+  auto shardEntries = std::max<size_t>(maxEntries / numShards, 1);
+  for (size_t i = 0; i < numShards; i++) {
+    shards_.push_back(std::make_unique<Shard>(shardEntries));
+  }
+}
+
+std::shared_ptr<PeerCert> PeerCertCache::makePeerCert(Buf certData) {
+  if (certData->empty()) {
+    throw std::runtime_error("empty peer cert");
+  }
+  std::string hash(Sha256::HashLen, '\0');
+  Sha256::hash(
+      *certData,
+      folly::MutableByteRange(
+          reinterpret_cast<uint8_t*>(&hash[0]), hash.size()));
+  size_t shardIndex = 0;
+  for (size_t i = 0; i < sizeof(size_t); i++) {
+    shardIndex = (shardIndex << 8) | static_cast<uint8_t>(hash[i]);
+  }
+  auto& shard = *shards_[shardIndex % shards_.size()];
+
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.certs.find(hash);
+    if (it != shard.certs.end()) {
+      return it->second;
+    }
+  }
+
+  // Parse outside the lock. If another connection raced us here, keep its
+  // copy so that everyone shares the same one.
+  std::shared_ptr<PeerCert> cert = CertUtils::makePeerCert(std::move(certData));
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.certs.find(hash);
+  if (it != shard.certs.end()) {
+    return it->second;
+  }
+  shard.certs.set(std::move(hash), cert);
+  return cert;
+}
+
+size_t PeerCertCache::size() const {
+  size_t total = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    total += shard->certs.size();
+  }
+  return total;
+}
+} // namespace fizz
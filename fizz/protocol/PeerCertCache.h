@@ -0,0 +1,57 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/Certificate.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <mutex>
+
+namespace fizz {
+
+/**
+ * Interns parsed peer certificates by a hash of their DER encoding, so that
+ * connections receiving the same certificate share a single PeerCert instead
+ * of each parsing and holding their own copy.
+ *
+ * The cache is split into shards, each with its own lock and its own LRU
+ * bound of maxEntries / numShards certificates. Certificates that fail to
+ * parse are not cached.
+ */
+class PeerCertCache {
+ public:
+  static constexpr size_t kDefaultMaxEntries = 16384;
+  static constexpr size_t kDefaultNumShards = 16;
+
+  explicit PeerCertCache(
+      size_t maxEntries = kDefaultMaxEntries,
+      size_t numShards = kDefaultNumShards);
+
+  /**
+   * Returns the cached PeerCert for certData, parsing and caching it if it
+   * isn't cached yet. Throws like CertUtils::makePeerCert() on bad data.
+   */
+  std::shared_ptr<PeerCert> makePeerCert(Buf certData);
+
+  /**
+   * Returns the number of cached certificates.
+   */
+  size_t size() const;
+
+ private:
+  struct Shard {
+    explicit Shard(size_t maxEntries) : certs(maxEntries) {}
+
+    std::mutex mutex;
+    folly::EvictingCacheMap<std::string, std::shared_ptr<PeerCert>> certs;
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+} // namespace fizz
@@ -0,0 +1,123 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/SharedSecretBatcher.h>
+
+#include <fizz/crypto/ECCurve.h>
+#include <fizz/crypto/exchange/OpenSSLKeyExchange.h>
+#include <fizz/protocol/KeyExchangePool.h>
+#include <folly/io/async/EventBaseLocal.h>
+
+namespace fizz {
+
+SharedSecretBatcher::SharedSecretBatcher(folly::EventBase* evb) : evb_(evb) {}
+
+SharedSecretBatcher::~SharedSecretBatcher() {
+  cancelLoopCallback();
+  for (auto& request : pending_) {
+    request.promise.setException(
+        std::runtime_error("shared secret batcher destroyed"));
+  }
+}
+
+SharedSecretBatcher& SharedSecretBatcher::get(folly::EventBase* evb) {
+  // Leaked so that it outlives every EventBase that holds a batcher.
+  static auto batchers = new folly::EventBaseLocal<SharedSecretBatcher>();
+  return batchers->getOrCreate(*evb, evb);
+}
+
+folly::Future<std::unique_ptr<folly::IOBuf>>
+SharedSecretBatcher::generateSharedSecret(
+    const KeyExchange& kex,
+    folly::ByteRange keyShare) {
+  if (pending_.empty()) {
+    evb_->runInLoop(this);
+  }
+  Request request{&kex, folly::IOBuf::copyBuffer(keyShare), {}};
+  auto future = request.promise.getFuture();
+  pending_.push_back(std::move(request));
+  return future;
+}
+
+void SharedSecretBatcher::runLoopCallback() noexcept {
+  flush();
+}
+
+void SharedSecretBatcher::flush() {
+  cancelLoopCallback();
+  // Anything requested while fulfilling these goes in the next batch.
+  auto requests = std::move(pending_);
+  pending_.clear();
+
+  std::vector<Request> p256;
+  std::vector<Request> p384;
+  std::vector<Request> p521;
+  std::vector<Request> others;
+  for (auto& request : requests) {
+    request.kex = &KeyExchangePool::unwrap(*request.kex);
+    if (dynamic_cast<const OpenSSLKeyExchange<P256>*>(request.kex)) {
+      p256.push_back(std::move(request));
+    } else if (dynamic_cast<const OpenSSLKeyExchange<P384>*>(request.kex)) {
+      p384.push_back(std::move(request));
+    } else if (dynamic_cast<const OpenSSLKeyExchange<P521>*>(request.kex)) {
+      p521.push_back(std::move(request));
+    } else {
+      others.push_back(std::move(request));
+    }
+  }
+
+  runECBatch<P256>(p256);
+  runECBatch<P384>(p384);
+  runECBatch<P521>(p521);
+  for (auto& request : others) {
+    request.promise.setWith([&request]() {
+      return request.kex->generateSharedSecret(request.keyShare->coalesce());
+    });
+  }
+}
+
+template <class T>
+void SharedSecretBatcher::runECBatch(std::vector<Request>& requests) {
+  if (requests.empty()) {
+    return;
+  }
+
+  // Decoding validates each peer share; a bad one only fails its request.
+  std::vector<folly::ssl::EvpPkeyUniquePtr> peerKeys(requests.size());
+  std::vector<std::pair<EVP_PKEY*, EVP_PKEY*>> keys;
+  std::vector<size_t> indexes;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    auto kex = static_cast<const OpenSSLKeyExchange<T>*>(requests[i].kex);
+    try {
+      if (!kex->getKey()) {
+        throw std::runtime_error("Key not generated");
+      }
+      peerKeys[i] = detail::OpenSSLECKeyDecoder<T>::decode(
+          requests[i].keyShare->coalesce());
+    } catch (const std::exception& ex) {
+      requests[i].promise.setException(
+          folly::exception_wrapper(std::current_exception(), ex));
+      continue;
+    }
+    keys.emplace_back(kex->getKey().get(), peerKeys[i].get());
+    indexes.push_back(i);
+  }
+
+  try {
+    auto secrets = detail::generateECSharedSecrets(T::curveNid, keys);
+    for (size_t i = 0; i < indexes.size(); ++i) {
+      requests[indexes[i]].promise.setTry(std::move(secrets[i]));
+    }
+  } catch (const std::exception& ex) {
+    auto ew = folly::exception_wrapper(std::current_exception(), ex);
+    for (auto i : indexes) {
+      requests[i].promise.setException(ew);
+    }
+  }
+}
+} // namespace fizz
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/exchange/KeyExchange.h>
+#include <folly/futures/Future.h>
+#include <folly/io/async/EventBase.h>
+
+#include <vector>
+
+namespace fizz {
+
+/**
+ * Gathers the shared secret computations requested during one EventBase loop
+ * iteration and runs them together at the end of it, which lets connection
+ * storms share work between handshakes.
+ *
+ * Requests for OpenSSL EC key exchanges (secp256r1, secp384r1, secp521r1) on
+ * the same curve are computed as one batch with a single field inversion
+ * between them (see detail::generateECSharedSecrets()). Any other key
+ * exchange, including x25519, is computed on its own within the batch. Key
+ * exchanges taken from a KeyExchangePool are batched like the ones they wrap.
+ *
+ * Futures are fulfilled on the EventBase before the loop iteration ends, so
+ * handshakes resume in the same iteration they asked in.
+ *
+ * Must only be used from the EventBase's thread.
+ */
+class SharedSecretBatcher : private folly::EventBase::LoopCallback {
+ public:
+  explicit SharedSecretBatcher(folly::EventBase* evb);
+
+  /**
+   * Fails any requests that haven't been computed yet.
+   */
+  ~SharedSecretBatcher() override;
+
+  /**
+   * Returns the batcher for evb, creating it on first use. It lives as long as
+   * evb does.
+   */
+  static SharedSecretBatcher& get(folly::EventBase* evb);
+
+  /**
+   * Returns kex.generateSharedSecret(keyShare) once the batch it is in has
+   * run. kex must stay alive until then; keyShare is copied.
+   */
+  folly::Future<std::unique_ptr<folly::IOBuf>> generateSharedSecret(
+      const KeyExchange& kex,
+      folly::ByteRange keyShare);
+
+  /**
+   * Computes the pending requests now instead of at the end of the loop.
+   */
+  void flush();
+
+  size_t pending() const {
+    return pending_.size();
+  }
+
+ private:
+  struct Request {
+    const KeyExchange* kex;
+    std::unique_ptr<folly::IOBuf> keyShare;
+    folly::Promise<std::unique_ptr<folly::IOBuf>> promise;
+  };
+
+  void runLoopCallback() noexcept override;
+
+  template <class T>
+  static void runECBatch(std::vector<Request>& requests);
+
+  folly::EventBase* evb_;
+  std::vector<Request> pending_;
+};
+} // namespace fizz
@@ -151,6 +151,38 @@ TEST(CertTest, GetCertMessage) {
   EXPECT_EQ(X509_cmp(firstEncodedCert.get(), certCopy.get()), 0);
 }
 
+TEST(CertTest, GetCertMessageWithContext) {
+  std::vector<folly::ssl::X509UniquePtr> certs;
+  certs.push_back(getCert(kP256Certificate));
+  SelfCertImpl<KeyType::P256> certificate(
+      getPrivateKey(kP256Key), std::move(certs));
+  auto msg = certificate.getCertMessage(IOBuf::copyBuffer("context"));
+  EXPECT_TRUE(IOBufEqualTo()(
+      msg.certificate_request_context, IOBuf::copyBuffer("context")));
+  ASSERT_EQ(msg.certificate_list.size(), 1);
+
+  // Later messages are unaffected.
+  auto next = certificate.getCertMessage();
+  EXPECT_FALSE(next.certificate_request_context);
+  EXPECT_TRUE(IOBufEqualTo()(
+      msg.certificate_list[0].cert_data, next.certificate_list[0].cert_data));
+}
+
+TEST(CertTest, GetEncodedCertMessage) {
+  std::vector<folly::ssl::X509UniquePtr> certs;
+  certs.push_back(getCert(kP256Certificate));
+  SelfCertImpl<KeyType::P256> certificate(
+      getPrivateKey(kP256Key), std::move(certs));
+  auto encoded = certificate.getEncodedCertMessage();
+  EXPECT_TRUE(
+      IOBufEqualTo()(encoded, encodeHandshake(certificate.getCertMessage())));
+
+  // Clones of the same encoding.
+  auto again = certificate.getEncodedCertMessage();
+  EXPECT_TRUE(encoded->isShared());
+  EXPECT_EQ(encoded->data(), again->data());
+}
+
 // example taken from https://tlswg.github.io/tls13-spec/#certificate-verify
 TEST(CertTest, PrepareSignData) {
   std::array<uint8_t, 32> toBeSigned;
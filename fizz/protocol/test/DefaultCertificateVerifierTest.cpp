@@ -41,12 +41,21 @@ class DefaultCertificateVerifierTest : public testing::Test {
     return ok;
   }
 
+  static int countingCallback(int ok, X509_STORE_CTX*) {
+    callbackCount_++;
+    return ok;
+  }
+
  protected:
+  static size_t callbackCount_;
+
   CertAndKey rootCertAndKey_;
   CertAndKey leafCertAndKey_;
   std::unique_ptr<DefaultCertificateVerifier> verifier_;
 };
 
+size_t DefaultCertificateVerifierTest::callbackCount_;
+
 TEST_F(DefaultCertificateVerifierTest, TestVerifySuccess) {
   verifier_->verify({getPeerCert(leafCertAndKey_)});
 }
@@ -102,5 +111,90 @@ TEST_F(DefaultCertificateVerifierTest, TestVerifyWithBadRoot) {
       verifier_->verify({getPeerCert(subleaf), getPeerCert(subauth)}),
       std::runtime_error);
 }
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCacheHit) {
+  auto subauth = createCert("subauth", true, &rootCertAndKey_);
+  auto subleaf = createCert("subleaf", false, &subauth);
+  verifier_->setCustomVerifyCallback(
+      &DefaultCertificateVerifierTest::countingCallback);
+  verifier_->setVerificationCache(std::chrono::seconds(60));
+
+  callbackCount_ = 0;
+  verifier_->verify({getPeerCert(subleaf), getPeerCert(subauth)});
+  EXPECT_GT(callbackCount_, 0);
+
+  // Same chain, decoded again, is served from the cache.
+  callbackCount_ = 0;
+  verifier_->verify({getPeerCert(subleaf), getPeerCert(subauth)});
+  EXPECT_EQ(callbackCount_, 0);
+
+  // A different chain is not.
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  EXPECT_GT(callbackCount_, 0);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCacheFailure) {
+  auto subauth = createCert("subauth", true, &rootCertAndKey_);
+  auto subleaf = createCert("subleaf", false, &subauth);
+  verifier_->setVerificationCache(std::chrono::seconds(60));
+  EXPECT_THROW(verifier_->verify({getPeerCert(subleaf)}), std::runtime_error);
+  EXPECT_THROW(verifier_->verify({getPeerCert(subleaf)}), std::runtime_error);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCacheZeroTtl) {
+  verifier_->setCustomVerifyCallback(
+      &DefaultCertificateVerifierTest::countingCallback);
+  verifier_->setVerificationCache(std::chrono::seconds(0));
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  callbackCount_ = 0;
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  EXPECT_GT(callbackCount_, 0);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCacheStoreChange) {
+  verifier_->setVerificationCache(std::chrono::seconds(60));
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+
+  // The cached result doesn't survive a store that no longer trusts the root.
+  folly::ssl::X509StoreUniquePtr store(X509_STORE_new());
+  verifier_->setX509Store(std::move(store));
+  EXPECT_THROW(
+      verifier_->verify({getPeerCert(leafCertAndKey_)}), std::runtime_error);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCacheEviction) {
+  verifier_->setCustomVerifyCallback(
+      &DefaultCertificateVerifierTest::countingCallback);
+  verifier_->setVerificationCache(std::chrono::seconds(60), 1);
+  auto otherLeaf = createCert("leaf2", false, &rootCertAndKey_);
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  verifier_->verify({getPeerCert(otherLeaf)});
+
+  callbackCount_ = 0;
+  verifier_->verify({getPeerCert(otherLeaf)});
+  EXPECT_EQ(callbackCount_, 0);
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  EXPECT_GT(callbackCount_, 0);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCacheEvictsLru) {
+  verifier_->setCustomVerifyCallback(
+      &DefaultCertificateVerifierTest::countingCallback);
+  verifier_->setVerificationCache(std::chrono::seconds(60), 2);
+  auto leaf2 = createCert("leaf2", false, &rootCertAndKey_);
+  auto leaf3 = createCert("leaf3", false, &rootCertAndKey_);
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  verifier_->verify({getPeerCert(leaf2)});
+  // Hitting the first chain makes leaf2 the least recently used.
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  verifier_->verify({getPeerCert(leaf3)});
+
+  callbackCount_ = 0;
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  verifier_->verify({getPeerCert(leaf3)});
+  EXPECT_EQ(callbackCount_, 0);
+  verifier_->verify({getPeerCert(leaf2)});
+  EXPECT_GT(callbackCount_, 0);
+}
 } // namespace test
 } // namespace fizz
@@ -10,6 +10,7 @@
 
 #include <fizz/crypto/Sha256.h>
 #include <fizz/protocol/HandshakeContext.h>
+#include <folly/String.h>
 
 using namespace folly;
 using namespace testing;
@@ -33,6 +34,54 @@ TEST_F(HandshakeContextTest, TestHandshakeContextMultiple) {
   context.getHandshakeContext();
 }
 
+TEST_F(HandshakeContextTest, TestHandshakeContextCached) {
+  HandshakeContextImpl<Sha256> context(kHkdfLabelPrefix.str());
+  context.appendToTranscript(folly::IOBuf::copyBuffer("ClientHello"));
+  auto first = context.getHandshakeContext();
+  auto digest = context.getHandshakeContextRange();
+  EXPECT_EQ(digest.data(), context.getHandshakeContextRange().data());
+  EXPECT_EQ(hexlify(digest), hexlify(first->coalesce()));
+
+  context.appendToTranscript(folly::IOBuf::copyBuffer("ServerHello"));
+  auto second = context.getHandshakeContext();
+  EXPECT_FALSE(folly::IOBufEqualTo()(first, second));
+
+  HandshakeContextImpl<Sha256> fresh(kHkdfLabelPrefix.str());
+  fresh.appendToTranscript(folly::IOBuf::copyBuffer("ClientHelloServerHello"));
+  EXPECT_TRUE(folly::IOBufEqualTo()(second, fresh.getHandshakeContext()));
+}
+
+namespace {
+class BufOnlyHandshakeContext : public HandshakeContext {
+ public:
+  void appendToTranscript(const Buf&) override {}
+
+  Buf getHandshakeContext() const override {
+    return folly::IOBuf::copyBuffer("context");
+  }
+
+  Buf getFinishedData(folly::ByteRange) const override {
+    return nullptr;
+  }
+
+  folly::ByteRange getBlankContext() const override {
+    return folly::ByteRange();
+  }
+};
+} // namespace
+
+TEST_F(HandshakeContextTest, TestHandshakeContextRange) {
+  HandshakeContextImpl<Sha256> context(kHkdfLabelPrefix.str());
+  context.appendToTranscript(folly::IOBuf::copyBuffer("ClientHello"));
+  const HandshakeContext& base = context;
+  EXPECT_EQ(
+      base.getHandshakeContextRange().data(),
+      context.getHandshakeContextRange().data());
+
+  BufOnlyHandshakeContext bufOnly;
+  EXPECT_EQ(StringPiece(bufOnly.getHandshakeContextRange()), "context");
+}
+
 TEST_F(HandshakeContextTest, TestFinished) {
   HandshakeContextImpl<Sha256> context(kHkdfLabelPrefix.str());
   context.appendToTranscript(folly::IOBuf::copyBuffer("ClientHello"));
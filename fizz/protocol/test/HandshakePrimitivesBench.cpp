@@ -0,0 +1,281 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <fizz/crypto/Hkdf.h>
+#include <fizz/crypto/Sha256.h>
+#include <fizz/crypto/Sha384.h>
+#include <fizz/crypto/exchange/ECCurveKeyExchange.h>
+#include <fizz/crypto/exchange/X25519.h>
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/Certificate.h>
+#include <fizz/protocol/HandshakeContext.h>
+
+using namespace fizz;
+using namespace fizz::test;
+
+namespace {
+
+// Roughly the size of a transcript hash being signed.
+constexpr size_t kToBeSignedSize = 32;
+// Roughly the size of a handshake message added to the transcript.
+constexpr size_t kTranscriptMessageSize = 512;
+
+template <class KeyExchangeType>
+void keyExchangeGenerate(size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    KeyExchangeType kex;
+    kex.generateKeyPair();
+    folly::doNotOptimizeAway(kex);
+  }
+}
+
+template <class KeyExchangeType>
+void keyExchangeSharedSecret(size_t n) {
+  std::unique_ptr<folly::IOBuf> peerShare;
+  KeyExchangeType kex;
+  BENCHMARK_SUSPEND {
+    KeyExchangeType peer;
+    peer.generateKeyPair();
+    peerShare = peer.getKeyShare();
+    peerShare->coalesce();
+    kex.generateKeyPair();
+  }
+  for (size_t i = 0; i < n; ++i) {
+    auto secret = kex.generateSharedSecret(peerShare->coalesce());
+    folly::doNotOptimizeAway(secret);
+  }
+}
+
+template <KeyType T>
+void certSign(
+    size_t n,
+    folly::StringPiece key,
+    folly::StringPiece cert,
+    SignatureScheme scheme) {
+  std::unique_ptr<SelfCertImpl<T>> selfCert;
+  std::vector<uint8_t> toBeSigned(kToBeSignedSize, 0x44);
+  BENCHMARK_SUSPEND {
+    std::vector<folly::ssl::X509UniquePtr> certs;
+    certs.push_back(getCert(cert));
+    selfCert = std::make_unique<SelfCertImpl<T>>(
+        getPrivateKey(key), std::move(certs));
+  }
+  for (size_t i = 0; i < n; ++i) {
+    auto signature = selfCert->sign(
+        scheme, CertificateVerifyContext::Server, folly::range(toBeSigned));
+    folly::doNotOptimizeAway(signature);
+  }
+}
+
+template <KeyType T>
+void certVerify(
+    size_t n,
+    folly::StringPiece key,
+    folly::StringPiece cert,
+    SignatureScheme scheme) {
+  std::unique_ptr<PeerCertImpl<T>> peerCert;
+  std::unique_ptr<folly::IOBuf> signature;
+  std::vector<uint8_t> toBeSigned(kToBeSignedSize, 0x44);
+  BENCHMARK_SUSPEND {
+    std::vector<folly::ssl::X509UniquePtr> certs;
+    certs.push_back(getCert(cert));
+    SelfCertImpl<T> selfCert(getPrivateKey(key), std::move(certs));
+    signature = selfCert.sign(
+        scheme, CertificateVerifyContext::Server, folly::range(toBeSigned));
+    signature->coalesce();
+    peerCert = std::make_unique<PeerCertImpl<T>>(getCert(cert));
+  }
+  for (size_t i = 0; i < n; ++i) {
+    peerCert->verify(
+        scheme,
+        CertificateVerifyContext::Server,
+        folly::range(toBeSigned),
+        signature->coalesce());
+  }
+}
+
+template <class Hash>
+void hkdfExtract(size_t n) {
+  std::vector<uint8_t> salt(Hash::HashLen, 0x11);
+  std::vector<uint8_t> ikm(Hash::HashLen, 0x22);
+  HkdfImpl<Hash> hkdf;
+  for (size_t i = 0; i < n; ++i) {
+    auto prk = hkdf.extract(folly::range(salt), folly::range(ikm));
+    folly::doNotOptimizeAway(prk);
+  }
+}
+
+template <class Hash>
+void hkdfExpand(size_t n) {
+  std::vector<uint8_t> prk(Hash::HashLen, 0x33);
+  auto info = folly::IOBuf::copyBuffer("tls13 c hs traffic");
+  HkdfImpl<Hash> hkdf;
+  for (size_t i = 0; i < n; ++i) {
+    auto okm = hkdf.expand(folly::range(prk), *info, Hash::HashLen);
+    folly::doNotOptimizeAway(okm);
+  }
+}
+
+template <class Hash>
+void handshakeContextAppend(size_t n) {
+  HandshakeContextImpl<Hash> context(kHkdfLabelPrefix.str());
+  auto message =
+      folly::IOBuf::copyBuffer(std::string(kTranscriptMessageSize, 'm'));
+  for (size_t i = 0; i < n; ++i) {
+    context.appendToTranscript(message);
+  }
+  folly::doNotOptimizeAway(context);
+}
+
+template <class Hash>
+void handshakeContextGet(size_t n) {
+  HandshakeContextImpl<Hash> context(kHkdfLabelPrefix.str());
+  auto message =
+      folly::IOBuf::copyBuffer(std::string(kTranscriptMessageSize, 'm'));
+  for (size_t i = 0; i < n; ++i) {
+    // Append each time so that every call finalizes a new digest.
+    context.appendToTranscript(message);
+    auto digest = context.getHandshakeContext();
+    folly::doNotOptimizeAway(digest);
+  }
+}
+
+template <class Hash>
+void handshakeContextFinished(size_t n) {
+  HandshakeContextImpl<Hash> context(kHkdfLabelPrefix.str());
+  context.appendToTranscript(
+      folly::IOBuf::copyBuffer(std::string(kTranscriptMessageSize, 'm')));
+  std::vector<uint8_t> baseKey(Hash::HashLen, 0x55);
+  for (size_t i = 0; i < n; ++i) {
+    auto finished = context.getFinishedData(folly::range(baseKey));
+    folly::doNotOptimizeAway(finished);
+  }
+}
+} // namespace
+
+BENCHMARK(x25519Generate, n) {
+  keyExchangeGenerate<X25519KeyExchange>(n);
+}
+
+BENCHMARK(x25519SharedSecret, n) {
+  keyExchangeSharedSecret<X25519KeyExchange>(n);
+}
+
+BENCHMARK(p256Generate, n) {
+  keyExchangeGenerate<OpenSSLKeyExchange<P256>>(n);
+}
+
+BENCHMARK(p256SharedSecret, n) {
+  keyExchangeSharedSecret<OpenSSLKeyExchange<P256>>(n);
+}
+
+BENCHMARK(p384Generate, n) {
+  keyExchangeGenerate<OpenSSLKeyExchange<P384>>(n);
+}
+
+BENCHMARK(p384SharedSecret, n) {
+  keyExchangeSharedSecret<OpenSSLKeyExchange<P384>>(n);
+}
+
+BENCHMARK(p521Generate, n) {
+  keyExchangeGenerate<OpenSSLKeyExchange<P521>>(n);
+}
+
+BENCHMARK(p521SharedSecret, n) {
+  keyExchangeSharedSecret<OpenSSLKeyExchange<P521>>(n);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(signEcdsaSecp256r1Sha256, n) {
+  certSign<KeyType::P256>(
+      n, kP256Key, kP256Certificate, SignatureScheme::ecdsa_secp256r1_sha256);
+}
+
+BENCHMARK(verifyEcdsaSecp256r1Sha256, n) {
+  certVerify<KeyType::P256>(
+      n, kP256Key, kP256Certificate, SignatureScheme::ecdsa_secp256r1_sha256);
+}
+
+BENCHMARK(signEcdsaSecp384r1Sha384, n) {
+  certSign<KeyType::P384>(
+      n, kP384Key, kP384Certificate, SignatureScheme::ecdsa_secp384r1_sha384);
+}
+
+BENCHMARK(verifyEcdsaSecp384r1Sha384, n) {
+  certVerify<KeyType::P384>(
+      n, kP384Key, kP384Certificate, SignatureScheme::ecdsa_secp384r1_sha384);
+}
+
+BENCHMARK(signEcdsaSecp521r1Sha512, n) {
+  certSign<KeyType::P521>(
+      n, kP521Key, kP521Certificate, SignatureScheme::ecdsa_secp521r1_sha512);
+}
+
+BENCHMARK(verifyEcdsaSecp521r1Sha512, n) {
+  certVerify<KeyType::P521>(
+      n, kP521Key, kP521Certificate, SignatureScheme::ecdsa_secp521r1_sha512);
+}
+
+BENCHMARK(signRsaPssSha256, n) {
+  certSign<KeyType::RSA>(
+      n, kRSAKey, kRSACertificate, SignatureScheme::rsa_pss_sha256);
+}
+
+BENCHMARK(verifyRsaPssSha256, n) {
+  certVerify<KeyType::RSA>(
+      n, kRSAKey, kRSACertificate, SignatureScheme::rsa_pss_sha256);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(hkdfExtractSha256, n) {
+  hkdfExtract<Sha256>(n);
+}
+
+BENCHMARK(hkdfExpandSha256, n) {
+  hkdfExpand<Sha256>(n);
+}
+
+BENCHMARK(hkdfExtractSha384, n) {
+  hkdfExtract<Sha384>(n);
+}
+
+BENCHMARK(hkdfExpandSha384, n) {
+  hkdfExpand<Sha384>(n);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(handshakeContextAppendSha256, n) {
+  handshakeContextAppend<Sha256>(n);
+}
+
+BENCHMARK(handshakeContextGetSha256, n) {
+  handshakeContextGet<Sha256>(n);
+}
+
+BENCHMARK(handshakeContextFinishedSha256, n) {
+  handshakeContextFinished<Sha256>(n);
+}
+
+BENCHMARK(handshakeContextAppendSha384, n) {
+  handshakeContextAppend<Sha384>(n);
+}
+
+BENCHMARK(handshakeContextGetSha384, n) {
+  handshakeContextGet<Sha384>(n);
+}
+
+BENCHMARK(handshakeContextFinishedSha384, n) {
+  handshakeContextFinished<Sha384>(n);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,475 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+
+#include <fizz/protocol/KTLS.h>
+
+#include <fizz/protocol/OpenSSLFactory.h>
+#include <fizz/protocol/Protocol.h>
+#include <fizz/protocol/test/Matchers.h>
+#include <fizz/protocol/test/Mocks.h>
+#include <fizz/server/AsyncFizzServer.h>
+#include <fizz/server/State.h>
+#include <fizz/server/test/Mocks.h>
+#include <folly/Random.h>
+#include <folly/io/async/AsyncSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/portability/Fcntl.h>
+#include <folly/portability/Sockets.h>
+#include <folly/portability/Unistd.h>
+
+#include <thread>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+static constexpr auto kCipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+
+class KTLSServerStateMachine : public server::test::MockServerStateMachine {
+ public:
+  KTLSServerStateMachine() {
+    instance = this;
+  }
+  static KTLSServerStateMachine* instance;
+};
+KTLSServerStateMachine* KTLSServerStateMachine::instance;
+
+template <typename... Args>
+server::AsyncActions serverActions(Args&&... act) {
+  return server::detail::actions(std::forward<Args>(act)...);
+}
+
+class KTLSTest : public Test {
+ protected:
+  void SetUp() override {
+    key_.key = randomBuf(16);
+    key_.iv = randomBuf(12);
+
+    auto listener = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(listener, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    ASSERT_EQ(bind(listener, (struct sockaddr*)&addr, addrLen), 0);
+    ASSERT_EQ(listen(listener, 1), 0);
+    ASSERT_EQ(getsockname(listener, (struct sockaddr*)&addr, &addrLen), 0);
+    writeFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(writeFd_, (struct sockaddr*)&addr, addrLen), 0);
+    readFd_ = accept(listener, nullptr, nullptr);
+    ASSERT_GE(readFd_, 0);
+    close(listener);
+
+    setReadKey(key_);
+  }
+
+  void TearDown() override {
+    if (writeFd_ >= 0) {
+      close(writeFd_);
+    }
+    close(readFd_);
+  }
+
+  static std::unique_ptr<IOBuf> randomBuf(size_t len) {
+    auto buf = IOBuf::create(len);
+    buf->append(len);
+    Random::secureRandom(buf->writableData(), len);
+    return buf;
+  }
+
+  std::unique_ptr<Aead> makeAead() {
+    return makeAead(key_);
+  }
+
+  static std::unique_ptr<Aead> makeAead(const TrafficKey& key) {
+    auto aead = OpenSSLFactory().makeAead(kCipher);
+    aead->setKey({key.key->clone(), key.iv->clone()});
+    return aead;
+  }
+
+  /**
+   * Decrypts the records read after this with key.
+   */
+  void setReadKey(const TrafficKey& key) {
+    read_ =
+        std::make_unique<EncryptedReadRecordLayer>(EncryptionLevel::AppTraffic);
+    read_->setProtocolVersion(ProtocolVersion::tls_1_3);
+    read_->setAead(folly::ByteRange(), makeAead(key));
+  }
+
+  /**
+   * Sets up newState as a connection accepting data whose writes are
+   * encrypted with key.
+   */
+  static void setWriteKey(server::State& newState, const TrafficKey& key) {
+    auto scheduler = std::make_unique<MockKeyScheduler>();
+    ON_CALL(*scheduler, getSecret(AppTrafficSecrets::ServerAppTraffic))
+        .WillByDefault(InvokeWithoutArgs([]() {
+          return DerivedSecret(
+              std::vector<uint8_t>({'s', 'a', 't'}),
+              AppTrafficSecrets::ServerAppTraffic);
+        }));
+    std::shared_ptr<IOBuf> keyBuf = key.key->clone();
+    std::shared_ptr<IOBuf> ivBuf = key.iv->clone();
+    ON_CALL(*scheduler, getTrafficKey(_, _, _))
+        .WillByDefault(InvokeWithoutArgs([keyBuf, ivBuf]() {
+          return TrafficKey{keyBuf->clone(), ivBuf->clone()};
+        }));
+    newState.keyScheduler() = std::move(scheduler);
+    auto write = std::make_unique<EncryptedWriteRecordLayer>(
+        EncryptionLevel::AppTraffic);
+    write->setProtocolVersion(ProtocolVersion::tls_1_3);
+    write->setAead(folly::ByteRange(), makeAead(key));
+    newState.writeRecordLayer() = std::move(write);
+  }
+
+  /**
+   * Returns false if the kernel doesn't support kTLS, in which case the test
+   * can't run.
+   */
+  bool enableTx(uint64_t seqNum) {
+    KTLSParams params;
+    params.cipher = kCipher;
+    params.key = {key_.key->clone(), key_.iv->clone()};
+    params.seqNum = seqNum;
+    try {
+      KTLS::enableTx(writeFd_, params);
+    } catch (const std::system_error& e) {
+      LOG(INFO) << "kTLS not available: " << e.what();
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Hands writeFd_ to a non-blocking AsyncSocket set up for kTLS writes.
+   */
+  AsyncSocket::UniquePtr makeSocket(EventBase& evb) {
+    EXPECT_EQ(fcntl(writeFd_, F_SETFL, O_NONBLOCK), 0);
+    AsyncSocket::UniquePtr socket(new AsyncSocket(&evb, writeFd_));
+    writeFd_ = -1;
+    socket->setSendMsgParamCB(KTLS::getSendMsgParamsCallback());
+    return socket;
+  }
+
+  TLSMessage readMessage() {
+    while (true) {
+      auto msg = read_->read(readBuf_);
+      if (msg) {
+        return std::move(*msg);
+      }
+      auto buf = IOBuf::create(4096);
+      auto len = recv(readFd_, buf->writableData(), buf->capacity(), 0);
+      if (len <= 0) {
+        throw std::runtime_error("read failed");
+      }
+      buf->append(len);
+      readBuf_.append(std::move(buf));
+    }
+  }
+
+  TrafficKey key_;
+  int writeFd_{-1};
+  int readFd_{-1};
+  std::unique_ptr<EncryptedReadRecordLayer> read_;
+  IOBufQueue readBuf_{IOBufQueue::cacheChainLength()};
+};
+
+TEST_F(KTLSTest, TestWriteRecordLayer) {
+  KTLSWriteRecordLayer write;
+  auto content = write.writeAppData(IOBuf::copyBuffer("appdata"));
+  EXPECT_EQ(content.contentType, ContentType::application_data);
+  EXPECT_EQ(content.encryptionLevel, EncryptionLevel::AppTraffic);
+  EXPECT_TRUE(IOBufEqualTo()(content.data, IOBuf::copyBuffer("appdata")));
+
+  content = write.writeAlert(Alert(AlertDescription::close_notify));
+  EXPECT_EQ(content.contentType, ContentType::alert);
+}
+
+TEST_F(KTLSTest, TestGetWriteParams) {
+  server::State state;
+  state.context() = std::make_shared<server::FizzServerContext>();
+  state.cipher() = kCipher;
+  auto scheduler = std::make_unique<MockKeyScheduler>();
+  EXPECT_CALL(*scheduler, getSecret(AppTrafficSecrets::ServerAppTraffic))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return DerivedSecret(
+            std::vector<uint8_t>({'s', 'e', 'c', 'r', 'e', 't'}),
+            AppTrafficSecrets::ServerAppTraffic);
+      }));
+  EXPECT_CALL(*scheduler, getTrafficKey(RangeMatches("secret"), 16, 12))
+      .WillOnce(InvokeWithoutArgs([this]() {
+        return TrafficKey{key_.key->clone(), key_.iv->clone()};
+      }));
+  state.keyScheduler() = std::move(scheduler);
+  auto write =
+      std::make_unique<EncryptedWriteRecordLayer>(EncryptionLevel::AppTraffic);
+  write->setAead(folly::ByteRange(), makeAead());
+  write->writeAppData(IOBuf::copyBuffer("appdata"));
+  state.writeRecordLayer() = std::move(write);
+
+  auto params =
+      KTLS::getWriteParams(state, AppTrafficSecrets::ServerAppTraffic);
+  ASSERT_TRUE(params.hasValue());
+  EXPECT_EQ(params->cipher, kCipher);
+  EXPECT_TRUE(IOBufEqualTo()(params->key.key, key_.key));
+  EXPECT_TRUE(IOBufEqualTo()(params->key.iv, key_.iv));
+  EXPECT_EQ(params->seqNum, 1);
+}
+
+TEST_F(KTLSTest, TestGetWriteParamsNotEncrypted) {
+  server::State state;
+  state.context() = std::make_shared<server::FizzServerContext>();
+  state.cipher() = kCipher;
+  state.keyScheduler() = std::make_unique<MockKeyScheduler>();
+  state.writeRecordLayer() = std::make_unique<KTLSWriteRecordLayer>();
+  EXPECT_FALSE(
+      KTLS::getWriteParams(state, AppTrafficSecrets::ServerAppTraffic)
+          .hasValue());
+}
+
+TEST_F(KTLSTest, TestUnsupportedCipher) {
+  auto cipher = CipherSuite::TLS_AES_128_OCB_SHA256_EXPERIMENTAL;
+  EXPECT_FALSE(KTLS::isSupported(cipher));
+  KTLSParams params;
+  params.cipher = cipher;
+  EXPECT_THROW(KTLS::enableTx(writeFd_, params), std::exception);
+}
+
+TEST_F(KTLSTest, TestEnableTx) {
+  // The first record is encrypted in user space and the kernel carries on
+  // from its sequence number.
+  EncryptedWriteRecordLayer write(EncryptionLevel::AppTraffic);
+  write.setAead(folly::ByteRange(), makeAead());
+  auto record = write.writeAppData(IOBuf::copyBuffer("userspace"));
+  auto data = record.data->coalesce();
+  ASSERT_EQ(send(writeFd_, data.data(), data.size(), 0), (ssize_t)data.size());
+
+  if (!enableTx(write.getSequenceNumber())) {
+    return;
+  }
+  std::string kernel("kernel");
+  ASSERT_EQ(
+      send(writeFd_, kernel.data(), kernel.size(), 0), (ssize_t)kernel.size());
+
+  auto msg = readMessage();
+  EXPECT_EQ(msg.type, ContentType::application_data);
+  EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("userspace")));
+  msg = readMessage();
+  EXPECT_EQ(msg.type, ContentType::application_data);
+  EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("kernel")));
+}
+
+TEST_F(KTLSTest, TestSetTxKey) {
+  if (!enableTx(0)) {
+    return;
+  }
+  std::string before("before");
+  ASSERT_EQ(
+      send(writeFd_, before.data(), before.size(), 0), (ssize_t)before.size());
+
+  KTLSParams params;
+  params.cipher = kCipher;
+  params.key = {randomBuf(16), randomBuf(12)};
+  try {
+    KTLS::setTxKey(writeFd_, params);
+  } catch (const std::system_error& e) {
+    LOG(INFO) << "kTLS key updates not available: " << e.what();
+    EXPECT_FALSE(KTLS::isRekeySupported());
+    return;
+  }
+  EXPECT_TRUE(KTLS::isRekeySupported());
+  std::string after("after");
+  ASSERT_EQ(
+      send(writeFd_, after.data(), after.size(), 0), (ssize_t)after.size());
+
+  auto msg = readMessage();
+  EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("before")));
+  setReadKey(params.key);
+  msg = readMessage();
+  EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("after")));
+}
+
+TEST_F(KTLSTest, TestPeerKeyUpdate) {
+  EventBase evb;
+  ASSERT_EQ(fcntl(writeFd_, F_SETFL, O_NONBLOCK), 0);
+  AsyncSocket::UniquePtr socket(new AsyncSocket(&evb, writeFd_));
+  writeFd_ = -1;
+  auto context = std::make_shared<server::FizzServerContext>();
+  AsyncFizzServerT<KTLSServerStateMachine>::UniquePtr server(
+      new AsyncFizzServerT<KTLSServerStateMachine>(
+          std::move(socket),
+          context,
+          std::make_shared<server::test::MockServerExtensions>()));
+  auto machine = KTLSServerStateMachine::instance;
+  server->setKTLSOffload(true);
+
+  server::test::MockHandshakeCallbackT<KTLSServerStateMachine> callback;
+  EXPECT_CALL(*machine, _processAccept(_, &evb, _, _))
+      .WillOnce(InvokeWithoutArgs([]() { return serverActions(); }));
+  server->accept(&callback);
+
+  EXPECT_CALL(*machine, _processSocketData(_, _))
+      .WillOnce(Invoke([this, context](const server::State&, IOBufQueue& q) {
+        q.clear();
+        return serverActions(
+            [this, context](server::State& newState) {
+              newState.context() = context;
+              newState.state() = server::StateEnum::AcceptingData;
+              newState.version() = ProtocolVersion::tls_1_3;
+              newState.cipher() = kCipher;
+              setWriteKey(newState, key_);
+            },
+            ReportHandshakeSuccess(),
+            WaitForData());
+      }));
+  EXPECT_CALL(callback, _fizzHandshakeSuccess());
+  std::string chlo("ClientHello");
+  ASSERT_EQ(send(readFd_, chlo.data(), chlo.size(), 0), (ssize_t)chlo.size());
+  evb.loopOnce();
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  // A kernel that can't switch keys must never be handed the writes.
+  if (!KTLS::isRekeySupported()) {
+    EXPECT_FALSE(server->isKTLSOffloaded());
+  } else {
+    EXPECT_TRUE(server->isKTLSOffloaded());
+  }
+
+  // The peer requests a key update: the response is written with the current
+  // key and everything after it with the new one, as in ServerProtocol.
+  TrafficKey newKey{randomBuf(16), randomBuf(12)};
+  EXPECT_CALL(*machine, _processSocketData(_, _))
+      .WillOnce(Invoke([&newKey](const server::State& state, IOBufQueue& q) {
+        q.clear();
+        WriteToSocket write;
+        write.contents.emplace_back(state.writeRecordLayer()->writeHandshake(
+            Protocol::getKeyUpdated(KeyUpdateRequest::update_not_requested)));
+        return serverActions(
+            [&newKey](server::State& newState) {
+              setWriteKey(newState, newKey);
+            },
+            std::move(write),
+            WaitForData());
+      }));
+  std::string keyUpdate("KeyUpdate");
+  ASSERT_EQ(
+      send(readFd_, keyUpdate.data(), keyUpdate.size(), 0),
+      (ssize_t)keyUpdate.size());
+  evb.loopOnce();
+
+  EXPECT_CALL(*machine, _processAppWrite(_, _))
+      .WillOnce(Invoke([](const server::State& state, AppWrite& appWrite) {
+        WriteToSocket write;
+        write.callback = appWrite.callback;
+        write.contents.emplace_back(
+            state.writeRecordLayer()->writeAppData(std::move(appWrite.data)));
+        write.flags = appWrite.flags;
+        return serverActions(std::move(write));
+      }));
+  server->writeChain(nullptr, IOBuf::copyBuffer("after"));
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_TRUE(server->good());
+
+  auto msg = readMessage();
+  EXPECT_EQ(msg.type, ContentType::handshake);
+  EXPECT_TRUE(IOBufEqualTo()(
+      msg.fragment,
+      Protocol::getKeyUpdated(KeyUpdateRequest::update_not_requested)));
+  setReadKey(newKey);
+  msg = readMessage();
+  EXPECT_EQ(msg.type, ContentType::application_data);
+  EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("after")));
+
+  EXPECT_CALL(*machine, _processAppCloseImmediate(_))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return server::detail::actions([](server::State& newState) {
+          newState.state() = server::StateEnum::Error;
+        });
+      }));
+  server.reset();
+}
+
+TEST_F(KTLSTest, TestRecordTypeFlags) {
+  if (!enableTx(0)) {
+    return;
+  }
+  EventBase evb;
+  auto socket = makeSocket(evb);
+
+  auto alert = encode(Alert(AlertDescription::close_notify));
+  socket->writeChain(
+      nullptr, alert->clone(), KTLS::recordTypeFlags(ContentType::alert));
+  socket->writeChain(nullptr, IOBuf::copyBuffer("appdata"));
+  evb.loop();
+
+  auto msg = readMessage();
+  EXPECT_EQ(msg.type, ContentType::alert);
+  EXPECT_TRUE(IOBufEqualTo()(msg.fragment, alert));
+  msg = readMessage();
+  EXPECT_EQ(msg.type, ContentType::application_data);
+  EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("appdata")));
+}
+
+TEST_F(KTLSTest, TestRecordTypeFlagsSendBufferFull) {
+  int bufSize = 16 * 1024;
+  ASSERT_EQ(
+      setsockopt(writeFd_, SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof(bufSize)),
+      0);
+  ASSERT_EQ(
+      setsockopt(readFd_, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize)),
+      0);
+  if (!enableTx(0)) {
+    return;
+  }
+  EventBase evb;
+  auto socket = makeSocket(evb);
+
+  // Nobody is reading yet, so most of this stays queued on the socket and the
+  // alert behind it can't be written right away.
+  constexpr size_t kBulkSize = 1024 * 1024;
+  socket->writeChain(nullptr, randomBuf(kBulkSize));
+  ASSERT_GT(socket->getRawBytesBuffered(), 0);
+  auto alert = encode(Alert(AlertDescription::close_notify));
+  socket->writeChain(
+      nullptr, alert->clone(), KTLS::recordTypeFlags(ContentType::alert));
+  socket->writeChain(nullptr, IOBuf::copyBuffer("after"));
+  EXPECT_TRUE(socket->good());
+
+  size_t appDataBefore = 0;
+  std::vector<TLSMessage> after;
+  std::thread reader([&]() {
+    while (true) {
+      auto msg = readMessage();
+      if (!after.empty() || msg.type != ContentType::application_data) {
+        after.push_back(std::move(msg));
+        if (after.size() == 2) {
+          return;
+        }
+      } else {
+        appDataBefore += msg.fragment->computeChainDataLength();
+      }
+    }
+  });
+  evb.loop();
+  reader.join();
+
+  EXPECT_TRUE(socket->good());
+  EXPECT_EQ(appDataBefore, kBulkSize);
+  EXPECT_EQ(after[0].type, ContentType::alert);
+  EXPECT_TRUE(IOBufEqualTo()(after[0].fragment, alert));
+  EXPECT_EQ(after[1].type, ContentType::application_data);
+  EXPECT_TRUE(IOBufEqualTo()(after[1].fragment, IOBuf::copyBuffer("after")));
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,167 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/portability/GTest.h>
+
+#include <fizz/crypto/exchange/X25519.h>
+#include <fizz/protocol/KeyExchangePool.h>
+#include <fizz/protocol/OpenSSLFactory.h>
+#include <folly/portability/Unistd.h>
+
+#include <sys/wait.h>
+#include <chrono>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+static std::unique_ptr<KeyExchange> makeX25519(NamedGroup) {
+  return std::make_unique<X25519KeyExchange>();
+}
+
+static void waitForAvailable(
+    const KeyExchangePool& pool,
+    NamedGroup group,
+    size_t count) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (pool.available(group) < count) {
+    ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+TEST(KeyExchangePoolTest, TestRefill) {
+  KeyExchangePool pool({NamedGroup::x25519}, makeX25519, 2);
+  waitForAvailable(pool, NamedGroup::x25519, 2);
+  EXPECT_EQ(pool.available(NamedGroup::x25519), 2);
+
+  auto kex = pool.take(NamedGroup::x25519);
+  ASSERT_TRUE(kex);
+  // Refilled in the background.
+  waitForAvailable(pool, NamedGroup::x25519, 2);
+}
+
+TEST(KeyExchangePoolTest, TestPregeneratedKeyPair) {
+  KeyExchangePool pool({NamedGroup::x25519}, makeX25519, 1);
+  waitForAvailable(pool, NamedGroup::x25519, 1);
+  auto kex = pool.take(NamedGroup::x25519);
+  ASSERT_TRUE(kex);
+
+  // The first generateKeyPair() keeps the pregenerated key pair.
+  auto share = kex->getKeyShare();
+  kex->generateKeyPair();
+  EXPECT_TRUE(IOBufEqualTo()(share, kex->getKeyShare()));
+
+  X25519KeyExchange peer;
+  peer.generateKeyPair();
+  EXPECT_TRUE(IOBufEqualTo()(
+      kex->generateSharedSecret(peer.getKeyShare()->coalesce()),
+      peer.generateSharedSecret(share->coalesce())));
+
+  // Later calls generate a new one.
+  kex->generateKeyPair();
+  EXPECT_FALSE(IOBufEqualTo()(share, kex->getKeyShare()));
+}
+
+TEST(KeyExchangePoolTest, TestEachKeyPairTakenOnce) {
+  KeyExchangePool pool({NamedGroup::x25519}, makeX25519, 4);
+  waitForAvailable(pool, NamedGroup::x25519, 4);
+  auto kex1 = pool.take(NamedGroup::x25519);
+  auto kex2 = pool.take(NamedGroup::x25519);
+  ASSERT_TRUE(kex1 && kex2);
+  EXPECT_FALSE(IOBufEqualTo()(kex1->getKeyShare(), kex2->getKeyShare()));
+}
+
+TEST(KeyExchangePoolTest, TestUnpooledGroup) {
+  KeyExchangePool pool({NamedGroup::x25519}, makeX25519, 1);
+  EXPECT_EQ(pool.take(NamedGroup::secp256r1), nullptr);
+  EXPECT_EQ(pool.available(NamedGroup::secp256r1), 0);
+}
+
+TEST(KeyExchangePoolTest, TestFailingGroupDropped) {
+  KeyExchangePool pool(
+      {NamedGroup::x25519, NamedGroup::secp256r1},
+      [](NamedGroup group) -> std::unique_ptr<KeyExchange> {
+        if (group == NamedGroup::secp256r1) {
+          throw std::runtime_error("unsupported");
+        }
+        return std::make_unique<X25519KeyExchange>();
+      },
+      1);
+  waitForAvailable(pool, NamedGroup::x25519, 1);
+  EXPECT_EQ(pool.take(NamedGroup::secp256r1), nullptr);
+}
+
+TEST(KeyExchangePoolTest, TestDefaultGroups) {
+  KeyExchangePool pool(1);
+  for (auto group :
+       {NamedGroup::x25519,
+        NamedGroup::secp256r1,
+        NamedGroup::secp384r1,
+        NamedGroup::secp521r1}) {
+    waitForAvailable(pool, group, 1);
+    auto kex = pool.take(group);
+    ASSERT_TRUE(kex);
+    kex->generateKeyPair();
+    EXPECT_TRUE(
+        kex->generateSharedSecret(kex->getKeyShare()->coalesce()) != nullptr);
+  }
+}
+
+TEST(KeyExchangePoolTest, TestForkedChild) {
+  auto pool = std::make_unique<KeyExchangePool>(
+      std::vector<NamedGroup>{NamedGroup::x25519}, makeX25519, 2);
+  waitForAvailable(*pool, NamedGroup::x25519, 2);
+  // Fork while the refill thread is running so that it may hold the lock.
+  auto kex = pool->take(NamedGroup::x25519);
+  ASSERT_TRUE(kex);
+
+  auto pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    // The parent's key pairs must not be handed out, and neither taking nor
+    // destroying the pool may block on the missing refill thread.
+    int status = 0;
+    if (pool->take(NamedGroup::x25519) ||
+        pool->available(NamedGroup::x25519) != 0) {
+      status = 1;
+    }
+    pool.reset();
+    _exit(status);
+  }
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+
+  // The parent keeps using the pool as before.
+  waitForAvailable(*pool, NamedGroup::x25519, 2);
+  EXPECT_TRUE(pool->take(NamedGroup::x25519));
+}
+
+TEST(KeyExchangePoolTest, TestFactory) {
+  auto pool = std::make_shared<KeyExchangePool>(
+      std::vector<NamedGroup>{NamedGroup::x25519}, makeX25519, 1);
+  waitForAvailable(*pool, NamedGroup::x25519, 1);
+  OpenSSLFactory factory;
+  factory.setKeyExchangePool(pool);
+
+  // The pooled key pair is used as is.
+  auto pooled = factory.makeKeyExchange(NamedGroup::x25519);
+  auto share = pooled->getKeyShare();
+  pooled->generateKeyPair();
+  EXPECT_TRUE(IOBufEqualTo()(share, pooled->getKeyShare()));
+
+  // Groups the pool doesn't have are created as usual.
+  auto unpooled = factory.makeKeyExchange(NamedGroup::secp256r1);
+  unpooled->generateKeyPair();
+  EXPECT_TRUE(unpooled->getKeyShare() != nullptr);
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/portability/GTest.h>
+
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/PeerCertCache.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+static Buf getCertData(StringPiece pem) {
+  std::vector<ssl::X509UniquePtr> certs;
+  certs.push_back(getCert(pem));
+  auto msg = CertUtils::getCertMessage(certs, nullptr);
+  return std::move(msg.certificate_list.front().cert_data);
+}
+
+TEST(PeerCertCacheTest, TestSameCertShared) {
+  PeerCertCache cache;
+  auto cert1 = cache.makePeerCert(getCertData(kP256Certificate));
+  auto cert2 = cache.makePeerCert(getCertData(kP256Certificate));
+  EXPECT_EQ(cert1, cert2);
+  EXPECT_EQ(cache.size(), 1);
+
+  auto cert3 = cache.makePeerCert(getCertData(kP384Certificate));
+  EXPECT_NE(cert1, cert3);
+  EXPECT_EQ(cache.size(), 2);
+}
+
+TEST(PeerCertCacheTest, TestChainedCertData) {
+  PeerCertCache cache;
+  auto data = getCertData(kP256Certificate);
+  auto chained = data->clone();
+  // Split the same bytes over two buffers.
+  auto tail = IOBuf::copyBuffer(data->data() + 10, data->length() - 10);
+  chained->trimEnd(data->length() - 10);
+  chained->prependChain(std::move(tail));
+
+  auto cert1 = cache.makePeerCert(std::move(data));
+  auto cert2 = cache.makePeerCert(std::move(chained));
+  EXPECT_EQ(cert1, cert2);
+}
+
+TEST(PeerCertCacheTest, TestBadCertNotCached) {
+  PeerCertCache cache;
+  EXPECT_THROW(
+      cache.makePeerCert(IOBuf::copyBuffer("junk")), std::runtime_error);
+  EXPECT_THROW(cache.makePeerCert(IOBuf::create(0)), std::runtime_error);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(PeerCertCacheTest, TestEviction) {
+  PeerCertCache cache(1, 1);
+  auto cert1 = cache.makePeerCert(getCertData(kP256Certificate));
+  cache.makePeerCert(getCertData(kP384Certificate));
+  EXPECT_EQ(cache.size(), 1);
+
+  // Evicted entries stay alive for their users, but are parsed again.
+  auto cert2 = cache.makePeerCert(getCertData(kP256Certificate));
+  EXPECT_NE(cert1, cert2);
+  EXPECT_EQ(cert1->getIdentity(), cert2->getIdentity());
+}
+} // namespace test
+} // namespace fizz
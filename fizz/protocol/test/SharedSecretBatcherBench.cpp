@@ -0,0 +1,126 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <fizz/crypto/exchange/ECCurveKeyExchange.h>
+#include <fizz/protocol/SharedSecretBatcher.h>
+
+using namespace fizz;
+
+namespace {
+
+template <class KeyExchangeType>
+struct KeyPairs {
+  explicit KeyPairs(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      ours.push_back(std::make_unique<KeyExchangeType>());
+      ours.back()->generateKeyPair();
+      KeyExchangeType peer;
+      peer.generateKeyPair();
+      peerShares.push_back(peer.getKeyShare());
+      peerShares.back()->coalesce();
+    }
+  }
+
+  std::vector<std::unique_ptr<KeyExchangeType>> ours;
+  std::vector<std::unique_ptr<folly::IOBuf>> peerShares;
+};
+
+template <class KeyExchangeType>
+void sharedSecretIndividual(size_t n, size_t batchSize) {
+  folly::Optional<KeyPairs<KeyExchangeType>> keys;
+  BENCHMARK_SUSPEND {
+    keys.emplace(batchSize);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    auto j = i % batchSize;
+    auto secret =
+        keys->ours[j]->generateSharedSecret(keys->peerShares[j]->coalesce());
+    folly::doNotOptimizeAway(secret);
+  }
+}
+
+template <class KeyExchangeType>
+void sharedSecretBatched(size_t n, size_t batchSize) {
+  folly::Optional<KeyPairs<KeyExchangeType>> keys;
+  folly::EventBase evb;
+  SharedSecretBatcher batcher(&evb);
+  std::vector<folly::Future<std::unique_ptr<folly::IOBuf>>> secrets;
+  BENCHMARK_SUSPEND {
+    keys.emplace(batchSize);
+    secrets.reserve(batchSize);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    auto j = i % batchSize;
+    secrets.push_back(batcher.generateSharedSecret(
+        *keys->ours[j], keys->peerShares[j]->coalesce()));
+    if (j == batchSize - 1 || i == n - 1) {
+      batcher.flush();
+      for (auto& secret : secrets) {
+        folly::doNotOptimizeAway(std::move(secret).get());
+      }
+      secrets.clear();
+    }
+  }
+}
+} // namespace
+
+BENCHMARK(sharedSecretIndividualP256, n) {
+  sharedSecretIndividual<OpenSSLKeyExchange<P256>>(n, 16);
+}
+
+BENCHMARK_RELATIVE(sharedSecretBatchedP256x4, n) {
+  sharedSecretBatched<OpenSSLKeyExchange<P256>>(n, 4);
+}
+
+BENCHMARK_RELATIVE(sharedSecretBatchedP256x16, n) {
+  sharedSecretBatched<OpenSSLKeyExchange<P256>>(n, 16);
+}
+
+BENCHMARK_RELATIVE(sharedSecretBatchedP256x64, n) {
+  sharedSecretBatched<OpenSSLKeyExchange<P256>>(n, 64);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(sharedSecretIndividualP384, n) {
+  sharedSecretIndividual<OpenSSLKeyExchange<P384>>(n, 16);
+}
+
+BENCHMARK_RELATIVE(sharedSecretBatchedP384x4, n) {
+  sharedSecretBatched<OpenSSLKeyExchange<P384>>(n, 4);
+}
+
+BENCHMARK_RELATIVE(sharedSecretBatchedP384x16, n) {
+  sharedSecretBatched<OpenSSLKeyExchange<P384>>(n, 16);
+}
+
+BENCHMARK_RELATIVE(sharedSecretBatchedP384x64, n) {
+  sharedSecretBatched<OpenSSLKeyExchange<P384>>(n, 64);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(sharedSecretIndividualP521, n) {
+  sharedSecretIndividual<OpenSSLKeyExchange<P521>>(n, 16);
+}
+
+BENCHMARK_RELATIVE(sharedSecretBatchedP521x4, n) {
+  sharedSecretBatched<OpenSSLKeyExchange<P521>>(n, 4);
+}
+
+BENCHMARK_RELATIVE(sharedSecretBatchedP521x16, n) {
+  sharedSecretBatched<OpenSSLKeyExchange<P521>>(n, 16);
+}
+
+BENCHMARK_RELATIVE(sharedSecretBatchedP521x64, n) {
+  sharedSecretBatched<OpenSSLKeyExchange<P521>>(n, 64);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/portability/GTest.h>
+
+#include <fizz/crypto/exchange/ECCurveKeyExchange.h>
+#include <fizz/crypto/exchange/X25519.h>
+#include <fizz/protocol/KeyExchangePool.h>
+#include <fizz/protocol/SharedSecretBatcher.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+class SharedSecretBatcherTest : public testing::Test {
+ protected:
+  template <class T>
+  std::unique_ptr<KeyExchange> makeKex() {
+    auto kex = std::make_unique<T>();
+    kex->generateKeyPair();
+    return std::move(kex);
+  }
+
+  EventBase evb_;
+  SharedSecretBatcher batcher_{&evb_};
+};
+
+TEST_F(SharedSecretBatcherTest, TestBatchedInOneLoop) {
+  std::vector<std::unique_ptr<KeyExchange>> ours;
+  std::vector<std::unique_ptr<KeyExchange>> peers;
+  for (size_t i = 0; i < 3; ++i) {
+    ours.push_back(makeKex<OpenSSLKeyExchange<P256>>());
+    peers.push_back(makeKex<OpenSSLKeyExchange<P256>>());
+    ours.push_back(makeKex<OpenSSLKeyExchange<P384>>());
+    peers.push_back(makeKex<OpenSSLKeyExchange<P384>>());
+    ours.push_back(makeKex<X25519KeyExchange>());
+    peers.push_back(makeKex<X25519KeyExchange>());
+  }
+
+  std::vector<Future<std::unique_ptr<IOBuf>>> secrets;
+  for (size_t i = 0; i < ours.size(); ++i) {
+    secrets.push_back(batcher_.generateSharedSecret(
+        *ours[i], peers[i]->getKeyShare()->coalesce()));
+  }
+  EXPECT_EQ(batcher_.pending(), ours.size());
+  for (auto& secret : secrets) {
+    EXPECT_FALSE(secret.isReady());
+  }
+
+  evb_.loopOnce();
+  EXPECT_EQ(batcher_.pending(), 0);
+  for (size_t i = 0; i < ours.size(); ++i) {
+    ASSERT_TRUE(secrets[i].isReady());
+    EXPECT_TRUE(IOBufEqualTo()(
+        std::move(secrets[i]).get(),
+        peers[i]->generateSharedSecret(ours[i]->getKeyShare()->coalesce())));
+  }
+}
+
+TEST_F(SharedSecretBatcherTest, TestBadShareFailsAlone) {
+  auto good = makeKex<OpenSSLKeyExchange<P256>>();
+  auto bad = makeKex<OpenSSLKeyExchange<P256>>();
+  auto peer = makeKex<OpenSSLKeyExchange<P256>>();
+  auto goodSecret = batcher_.generateSharedSecret(
+      *good, peer->getKeyShare()->coalesce());
+  auto badSecret =
+      batcher_.generateSharedSecret(*bad, StringPiece("not a point"));
+  auto x25519 = makeKex<X25519KeyExchange>();
+  auto badX25519Secret =
+      batcher_.generateSharedSecret(*x25519, StringPiece("short"));
+
+  evb_.loopOnce();
+  EXPECT_TRUE(IOBufEqualTo()(
+      std::move(goodSecret).get(),
+      peer->generateSharedSecret(good->getKeyShare()->coalesce())));
+  EXPECT_THROW(std::move(badSecret).get(), std::runtime_error);
+  EXPECT_THROW(std::move(badX25519Secret).get(), std::runtime_error);
+}
+
+TEST_F(SharedSecretBatcherTest, TestPooledKeyExchange) {
+  KeyExchangePool pool(
+      {NamedGroup::secp256r1},
+      [](NamedGroup) { return std::make_unique<OpenSSLKeyExchange<P256>>(); },
+      1);
+  std::unique_ptr<KeyExchange> kex;
+  while (!(kex = pool.take(NamedGroup::secp256r1))) {
+    std::this_thread::yield();
+  }
+  kex->generateKeyPair();
+  EXPECT_NE(&KeyExchangePool::unwrap(*kex), kex.get());
+  EXPECT_TRUE(dynamic_cast<const OpenSSLKeyExchange<P256>*>(
+      &KeyExchangePool::unwrap(*kex)));
+
+  auto peer = makeKex<OpenSSLKeyExchange<P256>>();
+  auto secret =
+      batcher_.generateSharedSecret(*kex, peer->getKeyShare()->coalesce());
+  evb_.loopOnce();
+  EXPECT_TRUE(IOBufEqualTo()(
+      std::move(secret).get(),
+      peer->generateSharedSecret(kex->getKeyShare()->coalesce())));
+}
+
+TEST_F(SharedSecretBatcherTest, TestGetPerEventBase) {
+  EventBase otherEvb;
+  auto& batcher = SharedSecretBatcher::get(&evb_);
+  EXPECT_EQ(&SharedSecretBatcher::get(&evb_), &batcher);
+  EXPECT_NE(&SharedSecretBatcher::get(&otherEvb), &batcher);
+}
+
+TEST_F(SharedSecretBatcherTest, TestFlush) {
+  auto kex = makeKex<X25519KeyExchange>();
+  auto peer = makeKex<X25519KeyExchange>();
+  auto secret =
+      batcher_.generateSharedSecret(*kex, peer->getKeyShare()->coalesce());
+  batcher_.flush();
+  EXPECT_TRUE(secret.isReady());
+  EXPECT_EQ(batcher_.pending(), 0);
+}
+
+TEST_F(SharedSecretBatcherTest, TestDestroyedWithPending) {
+  auto kex = makeKex<X25519KeyExchange>();
+  auto peer = makeKex<X25519KeyExchange>();
+  auto batcher = std::make_unique<SharedSecretBatcher>(&evb_);
+  auto secret =
+      batcher->generateSharedSecret(*kex, peer->getKeyShare()->coalesce());
+  batcher.reset();
+  EXPECT_THROW(std::move(secret).get(), std::runtime_error);
+  evb_.loopOnce(EVLOOP_NONBLOCK);
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,134 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+
+namespace fizz {
+
+inline ClientHelloView::ClientHelloView(ClientHello chlo)
+    : chlo_(std::move(chlo)),
+      deferredExtensions_(std::move(chlo_.deferredExtensions)) {
+  if (deferredExtensions_) {
+    // Only copies if the ClientHello spanned records.
+    deferredExtensions_->coalesce();
+    folly::io::Cursor cursor(deferredExtensions_.get());
+    while (!cursor.isAtEnd()) {
+      Entry entry;
+      entry.type = static_cast<ExtensionType>(
+          cursor.readBE<typename std::underlying_type<ExtensionType>::type>());
+      entry.length = cursor.readBE<uint16_t>();
+      entry.offset = cursor - deferredExtensions_.get();
+      cursor.skip(entry.length);
+      entries_.push_back(entry);
+    }
+  } else {
+    entries_.reserve(chlo_.extensions.size());
+    for (size_t i = 0; i < chlo_.extensions.size(); ++i) {
+      entries_.push_back({chlo_.extensions[i].extension_type, i, 0});
+    }
+  }
+
+  index_.reserve(entries_.size());
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    index_.push_back(i);
+  }
+  // Stable so that the first of any duplicates is found, as with
+  // fizz::findExtension(). Duplicates are rejected later in the handshake.
+  std::stable_sort(index_.begin(), index_.end(), [this](size_t a, size_t b) {
+    return entries_[a].type < entries_[b].type;
+  });
+}
+
+inline const ClientHello& ClientHelloView::clientHelloWithExtensions() const {
+  if (deferredExtensions_ && !extensionsFilled_) {
+    for (const auto& entry : entries_) {
+      Extension ext;
+      ext.extension_type = entry.type;
+      ext.extension_data = getEntryData(entry);
+      chlo_.extensions.push_back(std::move(ext));
+    }
+    extensionsFilled_ = true;
+  }
+  return chlo_;
+}
+
+inline const ClientHelloView::Entry* ClientHelloView::findEntry(
+    ExtensionType type) const {
+  auto it = std::lower_bound(
+      index_.begin(), index_.end(), type, [this](size_t i, ExtensionType t) {
+        return entries_[i].type < t;
+      });
+  if (it == index_.end() || entries_[*it].type != type) {
+    return nullptr;
+  }
+  return &entries_[*it];
+}
+
+inline Buf ClientHelloView::getEntryData(const Entry& entry) const {
+  if (!deferredExtensions_) {
+    return chlo_.extensions[entry.offset].extension_data->clone();
+  }
+  auto data = deferredExtensions_->cloneOne();
+  data->trimStart(entry.offset);
+  data->trimEnd(data->length() - entry.length);
+  return data;
+}
+
+inline Buf ClientHelloView::getExtensionData(ExtensionType type) const {
+  auto entry = findEntry(type);
+  if (!entry) {
+    return nullptr;
+  }
+  return getEntryData(*entry);
+}
+
+inline std::vector<ExtensionType> ClientHelloView::getExtensionTypes() const {
+  std::vector<ExtensionType> types;
+  types.reserve(entries_.size());
+  for (const auto& entry : entries_) {
+    types.push_back(entry.type);
+  }
+  return types;
+}
+
+inline void ClientHelloView::checkDuplicateExtensions() const {
+  for (size_t i = 1; i < index_.size(); ++i) {
+    if (entries_[index_[i - 1]].type == entries_[index_[i]].type) {
+      throw FizzException(
+          "duplicate extension", AlertDescription::illegal_parameter);
+    }
+  }
+}
+
+inline size_t ClientHelloView::getBinderLength() const {
+  if (entries_.empty() ||
+      entries_.back().type != ExtensionType::pre_shared_key) {
+    throw FizzException(
+        "psk not at end of client hello", AlertDescription::decode_error);
+  }
+  return fizz::getBinderLength(*getEntryData(entries_.back()));
+}
+
+template <class T>
+const folly::Optional<T>& ClientHelloView::getExtension() const {
+  auto& decoded = std::get<Decoded<T>>(decoded_);
+  if (!decoded.decoded) {
+    auto data = getExtensionData(T::extension_type);
+    if (data) {
+      folly::io::Cursor cs{data.get()};
+      auto value = fizz::getExtension<T>(cs);
+      if (!cs.isAtEnd()) {
+        throw std::runtime_error("didn't read entire extension");
+      }
+      decoded.value = std::move(value);
+    }
+    decoded.decoded = true;
+  }
+  return decoded.value;
+}
+} // namespace fizz
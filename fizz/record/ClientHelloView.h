@@ -0,0 +1,133 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/Extensions.h>
+
+#include <tuple>
+
+namespace fizz {
+
+/**
+ * A ClientHello with its extensions indexed by type, so that looking one up
+ * doesn't search the extension list, and decoded lazily, so that each
+ * extension the server asks for is parsed at most once however many times it
+ * is asked for.
+ *
+ * If the read record layer deferred decoding the extensions (see
+ * ReadRecordLayer::setDeferClientHelloExtensions()), the index is built by
+ * walking the extension bytes as received, and only the extensions that are
+ * asked for are ever copied out of them. Otherwise it indexes the decoded
+ * extension list. Either way the index is built in a single pass when the
+ * ClientHello is wrapped. The ClientHello is owned so that the view can be
+ * moved along with it.
+ */
+class ClientHelloView {
+ public:
+  explicit ClientHelloView(ClientHello chlo);
+
+  ClientHelloView(ClientHelloView&&) = default;
+  ClientHelloView& operator=(ClientHelloView&&) = default;
+
+  /**
+   * Returns the ClientHello. If its extensions were deferred, its extensions
+   * list is empty; read them through the view instead.
+   */
+  const ClientHello& clientHello() const {
+    return chlo_;
+  }
+
+  /**
+   * Returns the ClientHello with its extensions list filled in, decoding every
+   * deferred extension on the first call. Only for code that needs the whole
+   * ClientHello, such as ServerExtensions.
+   */
+  const ClientHello& clientHelloWithExtensions() const;
+
+  /**
+   * Returns the first extension of type T::extension_type, or none if the
+   * client didn't send one. The extension is decoded on the first call and the
+   * result is returned by every later call. Throws if the extension can't be
+   * decoded.
+   *
+   * T must be one of the client extensions the server handshake reads, listed
+   * in DecodedExtensions.
+   */
+  template <class T>
+  const folly::Optional<T>& getExtension() const;
+
+  /**
+   * Returns the data of the first extension of the given type as received, or
+   * nullptr. The data is shared with the ClientHello rather than copied.
+   */
+  Buf getExtensionData(ExtensionType type) const;
+
+  /**
+   * Returns the types of the extensions in the order they were received.
+   */
+  std::vector<ExtensionType> getExtensionTypes() const;
+
+  /**
+   * Throws if the client sent any extension type more than once.
+   */
+  void checkDuplicateExtensions() const;
+
+  /**
+   * Returns the length of the binders at the end of the ClientHello, see
+   * fizz::getBinderLength().
+   */
+  size_t getBinderLength() const;
+
+ private:
+  template <class T>
+  struct Decoded {
+    bool decoded{false};
+    folly::Optional<T> value;
+  };
+
+  using DecodedExtensions = std::tuple<
+      Decoded<SupportedVersions>,
+      Decoded<ServerNameList>,
+      Decoded<SupportedGroups>,
+      Decoded<ClientKeyShare>,
+      Decoded<PskKeyExchangeModes>,
+      Decoded<SignatureAlgorithms>,
+      Decoded<Cookie>,
+      Decoded<ClientPresharedKey>,
+      Decoded<ClientEarlyData>,
+      Decoded<ProtocolNameList>,
+      Decoded<CertificateCompressionAlgorithms>>;
+
+  struct Entry {
+    ExtensionType type;
+    // With deferred extensions, where the extension data starts in
+    // deferredExtensions_ and how long it is. Otherwise offset is the
+    // extension's position in chlo_.extensions.
+    size_t offset;
+    size_t length;
+  };
+
+  const Entry* findEntry(ExtensionType type) const;
+  Buf getEntryData(const Entry& entry) const;
+
+  mutable ClientHello chlo_;
+  Buf deferredExtensions_;
+  mutable bool extensionsFilled_{false};
+
+  // The extensions in the order they were received.
+  std::vector<Entry> entries_;
+  // Positions in entries_, sorted by extension type. Positions stay valid when
+  // the view is moved.
+  std::vector<size_t> index_;
+
+  mutable DecodedExtensions decoded_;
+};
+} // namespace fizz
+
+#include <fizz/record/ClientHelloView-inl.h>
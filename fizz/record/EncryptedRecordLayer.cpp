@@ -8,6 +8,8 @@
 
 #include <fizz/record/EncryptedRecordLayer.h>
 #include <fizz/crypto/aead/IOBufUtil.h>
+#include <fizz/record/RecordBufferPool.h>
+#include <folly/small_vector.h>
 
 namespace fizz {
 
@@ -18,6 +20,180 @@ using ProtocolVersionType =
 static constexpr uint16_t kMaxEncryptedRecordSize = 0x4000 + 256; // 16k + 256
 static constexpr size_t kEncryptedHeaderSize =
     sizeof(ContentType) + sizeof(ProtocolVersion) + sizeof(uint16_t);
+static constexpr size_t kMaxInPlaceTagSize = 16;
+
+using IovVector = folly::small_vector<struct iovec, 4>;
+
+static void fillIov(const folly::IOBuf& buf, IovVector& iov) {
+  iov.clear();
+  for (auto current : buf) {
+    iov.push_back({const_cast<uint8_t*>(current.data()), current.size()});
+  }
+}
+
+// When we own every buffer of a record, we hand them to the aead as iovecs and
+// have it work in place, rather than going through the IOBuf interface and its
+// bookkeeping.
+static bool canUseIov(const Aead& aead, const folly::IOBuf& buf) {
+  return aead.supportsZeroCopyIov() && !buf.isShared() &&
+      aead.getCipherOverhead() <= kMaxInPlaceTagSize;
+}
+
+static size_t getEncryptedRecordSize(size_t length, size_t tagLength) {
+  // Currently we never send padding.
+  return kEncryptedHeaderSize + length + sizeof(ContentType) + tagLength;
+}
+
+namespace {
+
+// Collects the records of a write so that they are all handed to the aead in
+// a single Aead::batchEncryptIov() call, which lets it interleave them.
+class RecordBatch {
+ public:
+  explicit RecordBatch(const Aead& aead) : aead_(aead) {}
+
+  // Adds a record encrypting the bytes of buf in place, with the tag appended
+  // to its last buffer, which must have room for it.
+  void addInPlace(
+      folly::IOBuf& buf,
+      folly::ByteRange associatedData,
+      uint64_t seqNum) {
+    auto begin = iov_.size();
+    for (auto current : buf) {
+      iov_.push_back({const_cast<uint8_t*>(current.data()), current.size()});
+    }
+    auto tagLength = aead_.getCipherOverhead();
+    auto lastBuf = buf.prev();
+    lastBuf->append(tagLength);
+    folly::MutableByteRange tag(lastBuf->writableTail() - tagLength, tagLength);
+    entries_.push_back(
+        {begin, iov_.size(), begin, iov_.size(), tag, associatedData, seqNum});
+  }
+
+  // Adds a record encrypting the next length bytes of cursor followed by
+  // innerType into output, with the tag following it.
+  void add(
+      folly::io::Cursor& cursor,
+      size_t length,
+      const ContentTypeType* innerType,
+      uint8_t* output,
+      folly::ByteRange associatedData,
+      uint64_t seqNum) {
+    auto begin = iov_.size();
+    for (auto remaining = length; remaining > 0;) {
+      auto bytes = cursor.peekBytes();
+      auto chunk = std::min(bytes.size(), remaining);
+      iov_.push_back({const_cast<uint8_t*>(bytes.data()), chunk});
+      cursor.skip(chunk);
+      remaining -= chunk;
+    }
+    iov_.push_back(
+        {const_cast<ContentTypeType*>(innerType), sizeof(ContentType)});
+    auto plaintextLength = length + sizeof(ContentType);
+    iov_.push_back({output, plaintextLength});
+    entries_.push_back(
+        {begin,
+         iov_.size() - 1,
+         iov_.size() - 1,
+         iov_.size(),
+         folly::MutableByteRange(
+             output + plaintextLength, aead_.getCipherOverhead()),
+         associatedData,
+         seqNum});
+  }
+
+  void encrypt() {
+    if (entries_.empty()) {
+      return;
+    }
+    // iov_ is complete, so ranges into it stay valid.
+    folly::small_vector<AeadIovRecord, 4> records;
+    for (const auto& entry : entries_) {
+      AeadIovRecord record;
+      record.input = folly::Range<const struct iovec*>(
+          iov_.data() + entry.inputBegin, iov_.data() + entry.inputEnd);
+      record.output = folly::Range<const struct iovec*>(
+          iov_.data() + entry.outputBegin, iov_.data() + entry.outputEnd);
+      record.tag = entry.tag;
+      record.associatedData = entry.associatedData;
+      record.seqNum = entry.seqNum;
+      records.push_back(record);
+    }
+    aead_.batchEncryptIov(
+        folly::Range<const AeadIovRecord*>(records.data(), records.size()));
+  }
+
+ private:
+  struct Entry {
+    size_t inputBegin;
+    size_t inputEnd;
+    size_t outputBegin;
+    size_t outputEnd;
+    folly::MutableByteRange tag;
+    folly::ByteRange associatedData;
+    uint64_t seqNum;
+  };
+
+  const Aead& aead_;
+  IovVector iov_;
+  folly::small_vector<Entry, 4> entries_;
+};
+} // namespace
+
+static void writeHeader(uint8_t* out, size_t ciphertextLength) {
+  auto header = folly::IOBuf::wrapBufferAsValue(out, kEncryptedHeaderSize);
+  header.clear();
+  folly::io::Appender appender(&header, 0);
+  appender.writeBE(static_cast<ContentTypeType>(ContentType::application_data));
+  appender.writeBE(static_cast<ProtocolVersionType>(ProtocolVersion::tls_1_2));
+  appender.writeBE<uint16_t>(ciphertextLength);
+}
+
+// Writes the header of a record encrypting the next length bytes of cursor
+// into out, which must have room for getEncryptedRecordSize() bytes, and adds
+// the record to batch.
+static void addRecord(
+    RecordBatch& batch,
+    const Aead& aead,
+    folly::io::Cursor& cursor,
+    size_t length,
+    const ContentTypeType* innerType,
+    bool useAdditionalData,
+    uint64_t seqNum,
+    uint8_t* out) {
+  auto plaintextLength = length + sizeof(ContentType);
+  writeHeader(out, plaintextLength + aead.getCipherOverhead());
+  batch.add(
+      cursor,
+      length,
+      innerType,
+      out + kEncryptedHeaderSize,
+      useAdditionalData ? folly::ByteRange(out, kEncryptedHeaderSize)
+                        : folly::ByteRange(),
+      seqNum);
+}
+
+static folly::Optional<Buf> decryptInPlace(
+    const Aead& aead,
+    Buf encrypted,
+    folly::ByteRange associatedData,
+    uint64_t seqNum) {
+  auto tagLength = aead.getCipherOverhead();
+  if (encrypted->computeChainDataLength() < tagLength) {
+    return folly::none;
+  }
+  std::array<uint8_t, kMaxInPlaceTagSize> tagData;
+  folly::MutableByteRange tag(tagData.data(), tagLength);
+  trimBytes(*encrypted, tag);
+
+  IovVector iov;
+  fillIov(*encrypted, iov);
+  folly::Range<const struct iovec*> data(iov.data(), iov.size());
+  if (!aead.tryDecryptIov(data, data, tag, associatedData, seqNum)) {
+    return folly::none;
+  }
+  return std::move(encrypted);
+}
 
 EncryptedReadRecordLayer::EncryptedReadRecordLayer(
     EncryptionLevel encryptionLevel)
@@ -87,6 +263,23 @@ folly::Optional<Buf> EncryptedReadRecordLayer::getDecryptedBuf(
     if (seqNum_ == std::numeric_limits<uint64_t>::max()) {
       throw std::runtime_error("max read seq num");
     }
+    if (canUseIov(*aead_, *encrypted)) {
+      auto decrypted = decryptInPlace(
+          *aead_,
+          std::move(encrypted),
+          useAdditionalData_ ? folly::range(ad).castToConst()
+                             : folly::ByteRange(),
+          seqNum_);
+      if (decrypted) {
+        seqNum_++;
+        skipFailedDecryption_ = false;
+        return decrypted;
+      } else if (skipFailedDecryption_) {
+        continue;
+      } else {
+        throw std::runtime_error("decryption failed");
+      }
+    }
     if (skipFailedDecryption_) {
       auto decryptAttempt = aead_->tryDecrypt(
           std::move(encrypted), useAdditionalData_ ? &adBuf : nullptr, seqNum_);
@@ -167,12 +360,24 @@ EncryptedWriteRecordLayer::EncryptedWriteRecordLayer(
     : encryptionLevel_(encryptionLevel) {}
 
 TLSContent EncryptedWriteRecordLayer::write(TLSMessage&& msg) const {
-  folly::IOBufQueue queue;
+  if (contiguousOutput_ && msg.fragment) {
+    return writeContiguous(std::move(msg));
+  }
+  if (useRecordBufferPool_ && msg.fragment &&
+      aead_->supportsZeroCopyIov() &&
+      aead_->getCipherOverhead() <= RecordBufferPool::kMaxTagSize) {
+    return writePooled(std::move(msg));
+  }
+
+  checkIdle();
+  folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
   queue.append(std::move(msg.fragment));
-  std::unique_ptr<folly::IOBuf> outBuf;
-  std::array<uint8_t, kEncryptedHeaderSize> headerBuf;
-  auto header = folly::IOBuf::wrapBufferAsValue(folly::range(headerBuf));
   aead_->setEncryptedBufferHeadroom(kEncryptedHeaderSize);
+  auto tagLength = aead_->getCipherOverhead();
+
+  // Split the whole message first so that the headers have a fixed home while
+  // the records encrypted in place wait for the batch below.
+  folly::small_vector<Buf, 4> records;
   while (!queue.empty()) {
     auto dataBuf = getBufToEncrypt(queue);
     // Currently we never send padding.
@@ -185,42 +390,60 @@ TLSContent EncryptedWriteRecordLayer::write(TLSMessage&& msg) const {
       appender.writeBE(static_cast<ContentTypeType>(msg.type));
     } else {
       // not enough or shared - let's add enough for the tag as well
-      auto encryptedFooter = folly::IOBuf::create(
-          sizeof(ContentType) + aead_->getCipherOverhead());
+      auto encryptedFooter =
+          folly::IOBuf::create(sizeof(ContentType) + tagLength);
       folly::io::Appender appender(encryptedFooter.get(), 0);
       appender.writeBE(static_cast<ContentTypeType>(msg.type));
       dataBuf->prependChain(std::move(encryptedFooter));
     }
+    records.push_back(std::move(dataBuf));
+  }
+  if (records.size() > std::numeric_limits<uint64_t>::max() - seqNum_) {
+    throw std::runtime_error("max write seq num");
+  }
 
-    if (seqNum_ == std::numeric_limits<uint64_t>::max()) {
-      throw std::runtime_error("max write seq num");
-    }
-
+  folly::small_vector<std::array<uint8_t, kEncryptedHeaderSize>, 4> headers(
+      records.size());
+  RecordBatch batch(*aead_);
+  for (size_t i = 0; i < records.size(); ++i) {
+    auto& dataBuf = records[i];
     // we will either be able to memcpy directly into the ciphertext or
     // need to create a new buf to insert before the ciphertext but we need
     // it for additional data
-    header.clear();
-    folly::io::Appender appender(&header, 0);
-    appender.writeBE(
-        static_cast<ContentTypeType>(ContentType::application_data));
-    appender.writeBE(
-        static_cast<ProtocolVersionType>(ProtocolVersion::tls_1_2));
-    auto ciphertextLength =
-        dataBuf->computeChainDataLength() + aead_->getCipherOverhead();
-    appender.writeBE<uint16_t>(ciphertextLength);
-
-    auto cipherText = aead_->encrypt(
-        std::move(dataBuf), useAdditionalData_ ? &header : nullptr, seqNum_++);
+    writeHeader(
+        headers[i].data(), dataBuf->computeChainDataLength() + tagLength);
+    auto headerRange = folly::range(headers[i]).castToConst();
+
+    if (canUseIov(*aead_, *dataBuf) &&
+        dataBuf->prev()->tailroom() >= tagLength) {
+      // Records we own with room for the tag are encrypted in place.
+      batch.addInPlace(
+          *dataBuf,
+          useAdditionalData_ ? headerRange : folly::ByteRange(),
+          seqNum_++);
+    } else {
+      auto header = folly::IOBuf::wrapBufferAsValue(headerRange);
+      dataBuf = aead_->encrypt(
+          std::move(dataBuf),
+          useAdditionalData_ ? &header : nullptr,
+          seqNum_++);
+    }
+  }
+  batch.encrypt();
 
+  std::unique_ptr<folly::IOBuf> outBuf;
+  for (size_t i = 0; i < records.size(); ++i) {
+    auto& cipherText = records[i];
+    const auto& header = headers[i];
     std::unique_ptr<folly::IOBuf> record;
     if (!cipherText->isShared() &&
         cipherText->headroom() >= kEncryptedHeaderSize) {
       // prepend and then write it in
       cipherText->prepend(kEncryptedHeaderSize);
-      memcpy(cipherText->writableData(), header.data(), header.length());
+      memcpy(cipherText->writableData(), header.data(), header.size());
       record = std::move(cipherText);
     } else {
-      record = folly::IOBuf::copyBuffer(header.data(), header.length());
+      record = folly::IOBuf::copyBuffer(header.data(), header.size());
       record->prependChain(std::move(cipherText));
     }
 
@@ -242,14 +465,139 @@ TLSContent EncryptedWriteRecordLayer::write(TLSMessage&& msg) const {
   return content;
 }
 
+TLSContent EncryptedWriteRecordLayer::writePooled(TLSMessage&& msg) const {
+  checkIdle();
+  auto tagLength = aead_->getCipherOverhead();
+  auto innerType = static_cast<ContentTypeType>(msg.type);
+  folly::io::Cursor cursor(msg.fragment.get());
+  auto remaining = cursor.totalLength();
+  RecordBatch batch(*aead_);
+  std::unique_ptr<folly::IOBuf> outBuf;
+  while (remaining > 0) {
+    // Walk the fragment rather than splitting it.
+    auto length = getRecordLength(cursor.peekBytes().size(), remaining);
+    remaining -= length;
+
+    if (seqNum_ == std::numeric_limits<uint64_t>::max()) {
+      throw std::runtime_error("max write seq num");
+    }
+
+    auto record =
+        RecordBufferPool::get(getEncryptedRecordSize(length, tagLength));
+    addRecord(
+        batch,
+        *aead_,
+        cursor,
+        length,
+        &innerType,
+        useAdditionalData_,
+        seqNum_++,
+        record->writableTail());
+    record->append(getEncryptedRecordSize(length, tagLength));
+
+    if (!outBuf) {
+      outBuf = std::move(record);
+    } else {
+      outBuf->prependChain(std::move(record));
+    }
+  }
+  batch.encrypt();
+
+  if (!outBuf) {
+    outBuf = folly::IOBuf::create(0);
+  }
+
+  TLSContent content;
+  content.data = std::move(outBuf);
+  content.contentType = msg.type;
+  content.encryptionLevel = encryptionLevel_;
+  return content;
+}
+
+TLSContent EncryptedWriteRecordLayer::writeContiguous(TLSMessage&& msg) const {
+  checkIdle();
+  auto tagLength = aead_->getCipherOverhead();
+  auto innerType = static_cast<ContentTypeType>(msg.type);
+
+  // Split the fragment into records first so that the output can be sized.
+  folly::small_vector<size_t, 4> lengths;
+  size_t outputLength = 0;
+  folly::io::Cursor cursor(msg.fragment.get());
+  while (!cursor.isAtEnd()) {
+    auto length =
+        getRecordLength(cursor.peekBytes().size(), cursor.totalLength());
+    cursor.skip(length);
+    lengths.push_back(length);
+    outputLength += getEncryptedRecordSize(length, tagLength);
+  }
+  if (lengths.size() > std::numeric_limits<uint64_t>::max() - seqNum_) {
+    throw std::runtime_error("max write seq num");
+  }
+
+  auto outBuf = folly::IOBuf::create(outputLength);
+  cursor.reset(msg.fragment.get());
+  RecordBatch batch(*aead_);
+  for (auto length : lengths) {
+    addRecord(
+        batch,
+        *aead_,
+        cursor,
+        length,
+        &innerType,
+        useAdditionalData_,
+        seqNum_++,
+        outBuf->writableTail());
+    outBuf->append(getEncryptedRecordSize(length, tagLength));
+  }
+  batch.encrypt();
+
+  TLSContent content;
+  content.data = std::move(outBuf);
+  content.contentType = msg.type;
+  content.encryptionLevel = encryptionLevel_;
+  return content;
+}
+
 Buf EncryptedWriteRecordLayer::getBufToEncrypt(folly::IOBufQueue& queue) const {
-  if (queue.front()->length() > maxRecord_) {
-    return queue.splitAtMost(maxRecord_);
-  } else if (queue.front()->length() >= desiredMinRecord_) {
-    return queue.pop_front();
+  return queue.split(
+      getRecordLength(queue.front()->length(), queue.chainLength()));
+}
+
+size_t EncryptedWriteRecordLayer::getRecordLength(
+    size_t frontLength,
+    size_t totalLength) const {
+  size_t maxRecord = maxRecord_;
+  if (dynamicRecordSizing_ &&
+      recordSizingState_->bytesSinceIdle < dynamicRecordSizing_->rampUpBytes) {
+    maxRecord = std::min<size_t>(
+        maxRecord, dynamicRecordSizing_->initialRecordSize);
+  }
+  auto desiredMinRecord = std::min<size_t>(desiredMinRecord_, maxRecord);
+
+  size_t length;
+  if (frontLength > maxRecord) {
+    length = maxRecord;
+  } else if (frontLength >= desiredMinRecord) {
+    length = frontLength;
   } else {
-    return queue.splitAtMost(desiredMinRecord_);
+    length = std::min(desiredMinRecord, totalLength);
+  }
+  if (dynamicRecordSizing_) {
+    recordSizingState_->bytesSinceIdle += length;
+  }
+  return length;
+}
+
+void EncryptedWriteRecordLayer::checkIdle() const {
+  if (!dynamicRecordSizing_) {
+    return;
+  }
+  auto now = dynamicRecordSizing_->clock->getCurrentTime();
+  if (now - recordSizingState_->lastWrite >=
+      dynamicRecordSizing_->idleTimeout) {
+    recordSizingState_->bytesSinceIdle = 0;
   }
+  recordSizingState_->lastWrite = now;
 }
 
 EncryptionLevel EncryptedWriteRecordLayer::getEncryptionLevel() const {
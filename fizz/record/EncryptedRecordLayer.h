@@ -11,12 +11,36 @@
 #include <fizz/record/RecordLayer.h>
 
 #include <fizz/crypto/aead/Aead.h>
+#include <fizz/protocol/clock/SystemClock.h>
 
 namespace fizz {
 
 constexpr uint16_t kMaxPlaintextRecordSize = 0x4000; // 16k
 constexpr uint16_t kMinSuggestedRecordSize = 1500;
 
+/**
+ * Settings for dynamic record sizing. Records start out small enough to fit in
+ * a single packet, so the peer can decrypt the first one as soon as it
+ * arrives, and grow to the max record size once rampUpBytes have been written.
+ * After no writes for idleTimeout, records start out small again.
+ */
+struct DynamicRecordSizing {
+  uint16_t initialRecordSize{1400};
+  size_t rampUpBytes{1024 * 1024};
+  std::chrono::milliseconds idleTimeout{1000};
+  std::shared_ptr<const Clock> clock{std::make_shared<SystemClock>()};
+};
+
+/**
+ * How far a connection's records have grown, see DynamicRecordSizing. The
+ * write record layers a connection installs over time (e.g. on a key update)
+ * can share one, so a new layer carries on from where the last one left off.
+ */
+struct RecordSizingState {
+  size_t bytesSinceIdle{0};
+  std::chrono::system_clock::time_point lastWrite;
+};
+
 class EncryptedReadRecordLayer : public ReadRecordLayer {
  public:
   ~EncryptedReadRecordLayer() override = default;
@@ -90,16 +114,70 @@ class EncryptedWriteRecordLayer : public WriteRecordLayer {
     desiredMinRecord_ = size;
   }
 
+  /**
+   * Size records dynamically rather than always filling them up to the max
+   * record size. Replacing the settings keeps the count of bytes written since
+   * the connection was last idle. If state is given, it is shared with the
+   * other layers it was given to rather than starting from scratch.
+   */
+  void setDynamicRecordSizing(
+      DynamicRecordSizing settings,
+      std::shared_ptr<RecordSizingState> state = nullptr) {
+    CHECK_GT(settings.initialRecordSize, 0);
+    dynamicRecordSizing_ = std::move(settings);
+    if (state) {
+      recordSizingState_ = std::move(state);
+    } else if (!recordSizingState_) {
+      recordSizingState_ = std::make_shared<RecordSizingState>();
+    }
+  }
+
+  /**
+   * Write each record into its own buffer from RecordBufferPool, encrypting
+   * straight out of the fragment, rather than chaining the header, tag and
+   * footer around the fragment's buffers. Only takes effect with an aead that
+   * supports zero copy iovecs.
+   */
+  void setUseRecordBufferPool(bool enabled) {
+    useRecordBufferPool_ = enabled;
+  }
+
+  /**
+   * Write all the records of a message into one buffer sized for them up
+   * front, encrypting straight out of the fragment, so that each write is a
+   * single iovec however many records it spans. Takes precedence over
+   * setUseRecordBufferPool().
+   */
+  void setContiguousOutput(bool enabled) {
+    contiguousOutput_ = enabled;
+  }
+
   EncryptionLevel getEncryptionLevel() const override;
 
+  /**
+   * Returns the sequence number the next record will be written with.
+   */
+  uint64_t getSequenceNumber() const {
+    return seqNum_;
+  }
+
  private:
   Buf getBufToEncrypt(folly::IOBufQueue& queue) const;
+  size_t getRecordLength(size_t frontLength, size_t totalLength) const;
+  void checkIdle() const;
+  TLSContent writePooled(TLSMessage&& msg) const;
+  TLSContent writeContiguous(TLSMessage&& msg) const;
 
   std::unique_ptr<Aead> aead_;
+  bool useRecordBufferPool_{false};
+  bool contiguousOutput_{false};
 
   uint16_t maxRecord_{kMaxPlaintextRecordSize};
   uint16_t desiredMinRecord_{kMinSuggestedRecordSize};
 
+  folly::Optional<DynamicRecordSizing> dynamicRecordSizing_;
+  std::shared_ptr<RecordSizingState> recordSizingState_;
+
   mutable uint64_t seqNum_{0};
   EncryptionLevel encryptionLevel_;
 };
@@ -344,7 +344,11 @@ inline size_t getBinderLength(const ClientHello& chlo) {
     throw FizzException(
         "psk not at end of client hello", AlertDescription::decode_error);
   }
-  folly::io::Cursor cursor(chlo.extensions.back().extension_data.get());
+  return getBinderLength(*chlo.extensions.back().extension_data);
+}
+
+inline size_t getBinderLength(const folly::IOBuf& pskExtensionData) {
+  folly::io::Cursor cursor(&pskExtensionData);
   uint16_t identitiesLen;
   detail::read(identitiesLen, cursor);
   cursor.skip(identitiesLen);
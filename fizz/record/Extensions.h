@@ -152,6 +152,12 @@ std::vector<Extension>::const_iterator findExtension(
     ExtensionType type);
 
 size_t getBinderLength(const ClientHello& chlo);
+
+/**
+ * Returns the length of the binders at the end of a ClientHello, given the
+ * data of its pre_shared_key extension.
+ */
+size_t getBinderLength(const folly::IOBuf& pskExtensionData);
 } // namespace fizz
 
 #include <fizz/record/Extensions-inl.h>
@@ -0,0 +1,309 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+namespace fizz {
+namespace detail {
+
+template <class N>
+struct LengthPrefixSize {
+  static constexpr size_t value = sizeof(N);
+};
+
+template <>
+struct LengthPrefixSize<bits24> {
+  static constexpr size_t value = bits24::size;
+};
+
+template <class N>
+void writeLengthAt(size_t length, uint8_t* out) {
+  auto lengthBE = folly::Endian::big(folly::to<N>(length));
+  memcpy(out, &lengthBE, sizeof(N));
+}
+
+template <>
+inline void writeLengthAt<bits24>(size_t length, uint8_t* out) {
+  checkWithin24bits<size_t>(length);
+  auto lengthBE = folly::Endian::big(static_cast<uint32_t>(length));
+  memcpy(out, reinterpret_cast<uint8_t*>(&lengthBE) + 1, bits24::size);
+}
+
+/**
+ * Writes the data of an extension, without its type and length. Extensions
+ * whose data is always the same size set kFixedSize and kSize so that their
+ * length can be written up front.
+ *
+ * Extensions without a writer of their own are encoded on their own with
+ * encodeExtension() and copied in.
+ */
+template <class T>
+struct ExtensionDataWriter {
+  static constexpr bool kFixedSize = false;
+  static void write(const T& extension, folly::io::Appender& out) {
+    auto encoded = encodeExtension(extension);
+    for (auto range : *encoded.extension_data) {
+      out.push(range.data(), range.size());
+    }
+  }
+};
+
+template <>
+struct ExtensionDataWriter<ServerSupportedVersions> {
+  static constexpr bool kFixedSize = true;
+  static constexpr uint16_t kSize = sizeof(ProtocolVersion);
+  static void write(
+      const ServerSupportedVersions& versions,
+      folly::io::Appender& out) {
+    detail::write(versions.selected_version, out);
+  }
+};
+
+template <>
+struct ExtensionDataWriter<ServerPresharedKey> {
+  static constexpr bool kFixedSize = true;
+  static constexpr uint16_t kSize = sizeof(uint16_t);
+  static void write(const ServerPresharedKey& psk, folly::io::Appender& out) {
+    detail::write(psk.selected_identity, out);
+  }
+};
+
+template <>
+struct ExtensionDataWriter<HelloRetryRequestKeyShare> {
+  static constexpr bool kFixedSize = true;
+  static constexpr uint16_t kSize = sizeof(NamedGroup);
+  static void write(
+      const HelloRetryRequestKeyShare& share,
+      folly::io::Appender& out) {
+    detail::write(share.selected_group, out);
+  }
+};
+
+template <>
+struct ExtensionDataWriter<ServerEarlyData> {
+  static constexpr bool kFixedSize = true;
+  static constexpr uint16_t kSize = 0;
+  static void write(const ServerEarlyData&, folly::io::Appender&) {}
+};
+
+template <>
+struct ExtensionDataWriter<TicketEarlyData> {
+  static constexpr bool kFixedSize = true;
+  static constexpr uint16_t kSize = sizeof(uint32_t);
+  static void write(const TicketEarlyData& early, folly::io::Appender& out) {
+    detail::write(early.max_early_data_size, out);
+  }
+};
+
+template <>
+struct ExtensionDataWriter<ServerKeyShare> {
+  static constexpr bool kFixedSize = false;
+  static void write(const ServerKeyShare& share, folly::io::Appender& out) {
+    detail::write(share.server_share, out);
+  }
+};
+
+template <>
+struct ExtensionDataWriter<ProtocolNameList> {
+  static constexpr bool kFixedSize = false;
+  static void write(const ProtocolNameList& names, folly::io::Appender& out) {
+    writeVector<uint16_t>(names.protocol_name_list, out);
+  }
+};
+
+template <>
+struct ExtensionDataWriter<SignatureAlgorithms> {
+  static constexpr bool kFixedSize = false;
+  static void write(const SignatureAlgorithms& sigs, folly::io::Appender& out) {
+    writeVector<uint16_t>(sigs.supported_signature_algorithms, out);
+  }
+};
+
+template <>
+struct ExtensionDataWriter<CertificateAuthorities> {
+  static constexpr bool kFixedSize = false;
+  static void write(
+      const CertificateAuthorities& authorities,
+      folly::io::Appender& out) {
+    writeVector<uint16_t>(authorities.authorities, out);
+  }
+};
+} // namespace detail
+
+inline HandshakeEncoder::HandshakeEncoder(folly::IOBuf& arena, uint64_t growth)
+    : arena_(arena),
+      appender_(&arena, growth),
+      tail_(arena.prev()),
+      tailStart_(arena.computeChainDataLength() - arena.prev()->length()) {}
+
+template <class... Extensions>
+size_t HandshakeEncoder::encode(
+    const ServerHello& shlo,
+    const Extensions&... extensions) {
+  auto header = beginHandshake(ServerHello::handshake_type);
+  detail::write(shlo.legacy_version, appender_);
+  detail::write(shlo.random, appender_);
+  if (shlo.legacy_session_id_echo) {
+    detail::writeBuf<uint8_t>(shlo.legacy_session_id_echo, appender_);
+  }
+  detail::write(shlo.cipher_suite, appender_);
+  if (shlo.legacy_session_id_echo) {
+    detail::write(shlo.legacy_compression_method, appender_);
+  }
+  writeExtensions(shlo.extensions, extensions...);
+  return endHandshake(header);
+}
+
+template <class... Extensions>
+size_t HandshakeEncoder::encode(
+    const EncryptedExtensions& ee,
+    const Extensions&... extensions) {
+  auto header = beginHandshake(EncryptedExtensions::handshake_type);
+  writeExtensions(ee.extensions, extensions...);
+  return endHandshake(header);
+}
+
+template <class... Extensions>
+size_t HandshakeEncoder::encode(
+    const CertificateRequest& cr,
+    const Extensions&... extensions) {
+  auto header = beginHandshake(CertificateRequest::handshake_type);
+  detail::writeBuf<uint8_t>(cr.certificate_request_context, appender_);
+  writeExtensions(cr.extensions, extensions...);
+  return endHandshake(header);
+}
+
+template <class... Extensions>
+size_t HandshakeEncoder::encode(
+    const NewSessionTicket& nst,
+    const Extensions&... extensions) {
+  auto header = beginHandshake(NewSessionTicket::handshake_type);
+  detail::write(nst.ticket_lifetime, appender_);
+  detail::write(nst.ticket_age_add, appender_);
+  if (nst.ticket_nonce) {
+    detail::writeBuf<uint8_t>(nst.ticket_nonce, appender_);
+  }
+  detail::writeBuf<uint16_t>(nst.ticket, appender_);
+  writeExtensions(nst.extensions, extensions...);
+  return endHandshake(header);
+}
+
+inline size_t HandshakeEncoder::encode(const Finished& fin) {
+  // The length is known up front, so there is nothing to fill in afterwards.
+  constexpr auto handshakeType = Finished::handshake_type;
+  auto length = fin.verify_data->computeChainDataLength();
+  detail::write(handshakeType, appender_);
+  detail::writeBits24(length, appender_);
+  for (auto range : *fin.verify_data) {
+    appender_.push(range.data(), range.size());
+  }
+  return kHandshakeHeaderSize + length;
+}
+
+inline size_t HandshakeEncoder::position() {
+  auto tail = arena_.prev();
+  while (tail_ != tail) {
+    tailStart_ += tail_->length();
+    tail_ = tail_->next();
+  }
+  return tailStart_ + tail_->length();
+}
+
+inline Buf HandshakeEncoder::clone(size_t start, size_t length) const {
+  folly::io::Cursor cursor(&arena_);
+  cursor.skip(start);
+  Buf message;
+  cursor.clone(message, length);
+  return message;
+}
+
+template <class N>
+HandshakeEncoder::Prefix HandshakeEncoder::reserveLength() {
+  constexpr auto size = detail::LengthPrefixSize<N>::value;
+  // The prefix must not straddle two buffers so that it can be filled in
+  // in one go.
+  appender_.ensure(size);
+  auto data = appender_.writableData();
+  appender_.append(size);
+  return Prefix{data, position()};
+}
+
+template <class N>
+void HandshakeEncoder::fillLength(const Prefix& prefix) {
+  detail::writeLengthAt<N>(position() - prefix.start, prefix.data);
+}
+
+inline HandshakeEncoder::Prefix HandshakeEncoder::beginHandshake(
+    HandshakeType type) {
+  detail::write(type, appender_);
+  return reserveLength<detail::bits24>();
+}
+
+inline size_t HandshakeEncoder::endHandshake(const Prefix& prefix) {
+  fillLength<detail::bits24>(prefix);
+  return kHandshakeHeaderSize + position() - prefix.start;
+}
+
+template <class... Extensions>
+void HandshakeEncoder::writeExtensions(
+    const std::vector<Extension>& encoded,
+    const Extensions&... extensions) {
+  auto prefix = reserveLength<uint16_t>();
+  for (const auto& extension : encoded) {
+    writeExtension(extension);
+  }
+  using expand = int[];
+  (void)expand{0, (writeExtension(extensions), 0)...};
+  fillLength<uint16_t>(prefix);
+}
+
+inline void HandshakeEncoder::writeExtension(const Extension& extension) {
+  detail::write(extension, appender_);
+}
+
+inline void HandshakeEncoder::writeExtension(
+    const std::vector<Extension>& extensions) {
+  for (const auto& extension : extensions) {
+    writeExtension(extension);
+  }
+}
+
+template <class T>
+void HandshakeEncoder::writeExtension(const folly::Optional<T>& extension) {
+  if (extension) {
+    writeExtension(*extension);
+  }
+}
+
+template <class T>
+void HandshakeEncoder::writeExtension(const T& extension) {
+  constexpr auto extensionType = T::extension_type;
+  detail::write(extensionType, appender_);
+  writeExtensionData(
+      extension,
+      std::integral_constant<
+          bool,
+          detail::ExtensionDataWriter<T>::kFixedSize>());
+}
+
+template <class T>
+void HandshakeEncoder::writeExtensionData(
+    const T& extension,
+    std::true_type /* fixed */) {
+  using Writer = detail::ExtensionDataWriter<T>;
+  appender_.writeBE<uint16_t>(Writer::kSize);
+  Writer::write(extension, appender_);
+}
+
+template <class T>
+void HandshakeEncoder::writeExtensionData(
+    const T& extension,
+    std::false_type /* fixed */) {
+  auto prefix = reserveLength<uint16_t>();
+  detail::ExtensionDataWriter<T>::write(extension, appender_);
+  fillLength<uint16_t>(prefix);
+}
+} // namespace fizz
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/Extensions.h>
+#include <fizz/record/Types.h>
+#include <folly/Optional.h>
+#include <folly/io/Cursor.h>
+
+namespace fizz {
+
+/**
+ * Encodes server handshake messages, handshake header included, straight into
+ * a buffer provided by the caller in a single pass. Length prefixes are
+ * reserved up front and filled in once their contents have been written, so
+ * nothing is sized twice, and the caller can reuse one arena across messages
+ * and connections.
+ *
+ * Extensions can be passed as typed structs alongside the message; these are
+ * written in place after the message's own extensions instead of each being
+ * encoded into an Extension of its own first. A folly::Optional of one is
+ * skipped when empty, and a std::vector<Extension> is written as is, so
+ * callers can keep extensions in their usual order.
+ *
+ * The output is byte for byte what encodeHandshake() produces for the same
+ * message and extensions. A whole flight can be encoded into one arena, with
+ * each message carved back out with position() and clone() where it is needed
+ * on its own, such as for the transcript.
+ */
+class HandshakeEncoder {
+ public:
+  // Handshake type plus 24 bit length.
+  static constexpr size_t kHandshakeHeaderSize =
+      sizeof(HandshakeType) + detail::bits24::size;
+
+  static constexpr uint64_t kDefaultGrowth = 1024;
+
+  /**
+   * Messages are appended to arena. Nothing is allocated as long as arena has
+   * enough tailroom; otherwise buffers of at least growth bytes are chained
+   * on to it.
+   */
+  explicit HandshakeEncoder(
+      folly::IOBuf& arena,
+      uint64_t growth = kDefaultGrowth);
+
+  /**
+   * Each of these appends the encoded message to the arena and returns the
+   * number of bytes written. The message is not modified.
+   */
+  template <class... Extensions>
+  size_t encode(const ServerHello& shlo, const Extensions&... extensions);
+
+  template <class... Extensions>
+  size_t encode(const EncryptedExtensions& ee, const Extensions&... extensions);
+
+  template <class... Extensions>
+  size_t encode(const CertificateRequest& cr, const Extensions&... extensions);
+
+  template <class... Extensions>
+  size_t encode(const NewSessionTicket& nst, const Extensions&... extensions);
+
+  size_t encode(const Finished& fin);
+
+  /**
+   * Returns the length of the arena, which is where the next message will
+   * start.
+   */
+  size_t position();
+
+  /**
+   * Returns length bytes of the arena starting at start, sharing the arena's
+   * buffers rather than copying them.
+   */
+  Buf clone(size_t start, size_t length) const;
+
+ private:
+  struct Prefix {
+    uint8_t* data;
+    size_t start;
+  };
+
+  template <class N>
+  Prefix reserveLength();
+
+  template <class N>
+  void fillLength(const Prefix& prefix);
+
+  Prefix beginHandshake(HandshakeType type);
+
+  size_t endHandshake(const Prefix& prefix);
+
+  template <class... Extensions>
+  void writeExtensions(
+      const std::vector<Extension>& encoded,
+      const Extensions&... extensions);
+
+  void writeExtension(const Extension& extension);
+
+  void writeExtension(const std::vector<Extension>& extensions);
+
+  template <class T>
+  void writeExtension(const folly::Optional<T>& extension);
+
+  template <class T>
+  void writeExtension(const T& extension);
+
+  template <class T>
+  void writeExtensionData(const T& extension, std::true_type /* fixed */);
+
+  template <class T>
+  void writeExtensionData(const T& extension, std::false_type /* fixed */);
+
+  folly::IOBuf& arena_;
+  folly::io::Appender appender_;
+
+  // The appender only writes to the last buffer of the arena, so the buffers
+  // before it never change length. position() only has to add up the
+  // buffers chained on since it last ran.
+  const folly::IOBuf* tail_;
+  size_t tailStart_;
+};
+} // namespace fizz
+
+#include <fizz/record/HandshakeEncoder-inl.h>
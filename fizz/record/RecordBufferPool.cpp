@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/record/RecordBufferPool.h>
+
+#include <folly/ThreadCachedInt.h>
+
+#include <array>
+#include <vector>
+
+namespace fizz {
+
+constexpr size_t RecordBufferPool::kMaxTagSize;
+constexpr size_t RecordBufferPool::kBufferSize;
+constexpr size_t RecordBufferPool::kMinPooledSize;
+constexpr size_t RecordBufferPool::kMinSizeClassSize;
+constexpr size_t RecordBufferPool::kNumSizeClasses;
+constexpr size_t RecordBufferPool::kMaxCachedBuffers;
+
+namespace {
+
+struct Counters {
+  folly::ThreadCachedInt<uint64_t> allocated{0};
+  folly::ThreadCachedInt<uint64_t> reused{0};
+  folly::ThreadCachedInt<uint64_t> cached{0};
+  folly::ThreadCachedInt<uint64_t> freed{0};
+};
+
+Counters& counters() {
+  // Leaked, as buffers may still be released while static objects are being
+  // destroyed.
+  static auto* counters = new Counters();
+  return *counters;
+}
+
+// Set once this thread's cache has been destroyed, so that buffers freed later
+// during thread exit skip it.
+thread_local bool tlsCacheDestroyed{false};
+
+class ThreadCache {
+ public:
+  ~ThreadCache() {
+    tlsCacheDestroyed = true;
+    for (const auto& buffers : buffers_) {
+      for (auto buf : buffers) {
+        free(buf);
+        ++counters().freed;
+      }
+    }
+  }
+
+  static ThreadCache* get() {
+    if (tlsCacheDestroyed) {
+      return nullptr;
+    }
+    static thread_local ThreadCache cache;
+    return &cache;
+  }
+
+  void* pop(size_t sizeClass) {
+    auto& buffers = buffers_[sizeClass];
+    if (buffers.empty()) {
+      return nullptr;
+    }
+    auto buf = buffers.back();
+    buffers.pop_back();
+    return buf;
+  }
+
+  bool push(size_t sizeClass, void* buf) {
+    auto& buffers = buffers_[sizeClass];
+    if (buffers.size() >= RecordBufferPool::kMaxCachedBuffers) {
+      return false;
+    }
+    buffers.push_back(buf);
+    return true;
+  }
+
+ private:
+  ThreadCache() = default;
+
+  std::array<std::vector<void*>, RecordBufferPool::kNumSizeClasses> buffers_;
+};
+
+size_t getSizeClass(size_t size) {
+  size_t sizeClass = 0;
+  while (RecordBufferPool::getSizeClassSize(sizeClass) < size) {
+    ++sizeClass;
+  }
+  return sizeClass;
+}
+
+// The size class is passed as the free function's user data.
+void release(void* buf, void* userData) {
+  auto sizeClass = reinterpret_cast<uintptr_t>(userData);
+  auto cache = ThreadCache::get();
+  if (cache && cache->push(sizeClass, buf)) {
+    ++counters().cached;
+  } else {
+    free(buf);
+    ++counters().freed;
+  }
+}
+} // namespace
+
+std::unique_ptr<folly::IOBuf> RecordBufferPool::get(size_t size) {
+  if (size < kMinPooledSize) {
+    return folly::IOBuf::create(size);
+  }
+  if (size > kBufferSize) {
+    throw std::runtime_error("record too large for buffer pool");
+  }
+  auto sizeClass = getSizeClass(size);
+  auto bufferSize = getSizeClassSize(sizeClass);
+  auto cache = ThreadCache::get();
+  void* buf = cache ? cache->pop(sizeClass) : nullptr;
+  if (buf) {
+    ++counters().reused;
+  } else {
+    buf = malloc(bufferSize);
+    if (!buf) {
+      throw std::bad_alloc();
+    }
+    ++counters().allocated;
+  }
+  return folly::IOBuf::takeOwnership(
+      buf, bufferSize, 0, &release, reinterpret_cast<void*>(sizeClass));
+}
+
+RecordBufferPool::Stats RecordBufferPool::getStats() {
+  Stats stats;
+  stats.allocated = counters().allocated.readFull();
+  stats.reused = counters().reused.readFull();
+  stats.cached = counters().cached.readFull();
+  stats.freed = counters().freed.readFull();
+  return stats;
+}
+} // namespace fizz
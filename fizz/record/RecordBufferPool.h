@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/EncryptedRecordLayer.h>
+#include <folly/io/IOBuf.h>
+
+namespace fizz {
+
+/**
+ * Per-thread cache of buffers for complete encrypted records. Buffers come in
+ * a few size classes, doubling from kMinSizeClassSize up to kBufferSize, which
+ * holds a header, max plaintext, inner content type and tag, so that a short
+ * record doesn't tie up a full size buffer. Records smaller than
+ * kMinPooledSize are not worth caching and get a buffer of their own.
+ *
+ * A buffer goes back to the cache of whichever thread frees the last IOBuf
+ * referencing it, and is freed instead if that cache is full.
+ */
+class RecordBufferPool {
+ public:
+  static constexpr size_t kMaxTagSize = 16;
+  static constexpr size_t kBufferSize = sizeof(ContentType) +
+      sizeof(ProtocolVersion) + sizeof(uint16_t) + kMaxPlaintextRecordSize +
+      sizeof(ContentType) + kMaxTagSize;
+  static constexpr size_t kMinPooledSize = 1024;
+  static constexpr size_t kMinSizeClassSize = 2048;
+  static constexpr size_t kNumSizeClasses = 4;
+  // Per size class.
+  static constexpr size_t kMaxCachedBuffers = 64;
+
+  struct Stats {
+    // Buffers allocated because the thread's cache was empty.
+    uint64_t allocated{0};
+    // Buffers handed out from a thread's cache.
+    uint64_t reused{0};
+    // Buffers returned to a thread's cache.
+    uint64_t cached{0};
+    // Buffers freed because the thread's cache was full or gone.
+    uint64_t freed{0};
+  };
+
+  /**
+   * Returns the buffer size of the given size class.
+   */
+  static constexpr size_t getSizeClassSize(size_t sizeClass) {
+    return sizeClass + 1 < kNumSizeClasses ? kMinSizeClassSize << sizeClass
+                                           : kBufferSize;
+  }
+
+  /**
+   * Returns an empty IOBuf with at least size bytes of tailroom: a buffer of
+   * the smallest size class that fits, or an uncached one if size is below
+   * kMinPooledSize. size must be at most kBufferSize.
+   */
+  static std::unique_ptr<folly::IOBuf> get(size_t size = kBufferSize);
+
+  /**
+   * Returns the counters summed over all threads.
+   */
+  static Stats getStats();
+};
+} // namespace fizz
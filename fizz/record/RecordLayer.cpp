@@ -18,7 +18,8 @@ static constexpr size_t kHandshakeHeaderSize =
 folly::Optional<Param> ReadRecordLayer::readEvent(
     folly::IOBufQueue& socketBuf) {
   if (!unparsedHandshakeData_.empty()) {
-    auto param = decodeHandshakeMessage(unparsedHandshakeData_);
+    auto param = decodeHandshakeMessage(
+        unparsedHandshakeData_, deferClientHelloExtensions_);
     if (param) {
       VLOG(8) << "Received handshake message "
               << toString(boost::apply_visitor(EventVisitor(), *param));
@@ -29,7 +30,7 @@ folly::Optional<Param> ReadRecordLayer::readEvent(
   while (true) {
     // Read one record. We read one record at a time since records could cause
     // a change in the record layer.
-    auto message = read(socketBuf);
+    auto message = nextMessage(socketBuf);
     if (!message) {
       return folly::none;
     }
@@ -50,7 +51,8 @@ folly::Optional<Param> ReadRecordLayer::readEvent(
       }
       case ContentType::handshake: {
         unparsedHandshakeData_.append(std::move(message->fragment));
-        auto param = decodeHandshakeMessage(unparsedHandshakeData_);
+        auto param = decodeHandshakeMessage(
+            unparsedHandshakeData_, deferClientHelloExtensions_);
         if (param) {
           VLOG(8) << "Received handshake message "
                   << toString(boost::apply_visitor(EventVisitor(), *param));
@@ -63,6 +65,9 @@ folly::Optional<Param> ReadRecordLayer::readEvent(
         }
       }
       case ContentType::application_data:
+        if (batchAppData_) {
+          readAppDataAhead(socketBuf, message->fragment);
+        }
         return Param(AppData(std::move(message->fragment)));
       default:
         throw std::runtime_error("unknown content type");
@@ -70,6 +75,44 @@ folly::Optional<Param> ReadRecordLayer::readEvent(
   }
 }
 
+folly::Optional<TLSMessage> ReadRecordLayer::nextMessage(
+    folly::IOBufQueue& socketBuf) {
+  if (pendingError_) {
+    auto error = std::move(pendingError_);
+    pendingError_ = nullptr;
+    std::rethrow_exception(error);
+  }
+  if (pendingMessage_) {
+    auto message = std::move(pendingMessage_);
+    pendingMessage_ = folly::none;
+    return message;
+  }
+  return read(socketBuf);
+}
+
+void ReadRecordLayer::readAppDataAhead(
+    folly::IOBufQueue& socketBuf,
+    Buf& appData) {
+  while (true) {
+    folly::Optional<TLSMessage> message;
+    try {
+      message = read(socketBuf);
+    } catch (...) {
+      // Deliver what we already decrypted before reporting the error.
+      pendingError_ = std::current_exception();
+      return;
+    }
+    if (!message) {
+      return;
+    }
+    if (message->type != ContentType::application_data) {
+      pendingMessage_ = std::move(message);
+      return;
+    }
+    appData->prependChain(std::move(message->fragment));
+  }
+}
+
 template <typename T>
 static Param parse(Buf handshakeMsg, Buf original) {
   auto msg = decode<T>(std::move(handshakeMsg));
@@ -96,8 +139,28 @@ Param parse<ServerHello>(Buf handshakeMsg, Buf original) {
   }
 }
 
+static Param parseClientHelloDeferringExtensions(
+    Buf handshakeMsg,
+    Buf original) {
+  folly::io::Cursor cursor(handshakeMsg.get());
+  ClientHello chlo;
+  detail::readClientHelloPrefix(chlo, cursor);
+  // As with decode<ClientHello>, the extensions may be omitted entirely.
+  if (!cursor.isAtEnd()) {
+    uint16_t extensionsLength;
+    detail::read(extensionsLength, cursor);
+    cursor.clone(chlo.deferredExtensions, extensionsLength);
+  }
+  if (!cursor.isAtEnd()) {
+    throw std::runtime_error("didn't read entire message");
+  }
+  chlo.originalEncoding = std::move(original);
+  return std::move(chlo);
+}
+
 folly::Optional<Param> ReadRecordLayer::decodeHandshakeMessage(
-    folly::IOBufQueue& buf) {
+    folly::IOBufQueue& buf,
+    bool deferClientHelloExtensions) {
   folly::io::Cursor cursor(buf.front());
 
   if (!cursor.canAdvance(kHandshakeHeaderSize)) {
@@ -121,6 +184,10 @@ folly::Optional<Param> ReadRecordLayer::decodeHandshakeMessage(
 
   switch (handshakeType) {
     case HandshakeType::client_hello:
+      if (deferClientHelloExtensions) {
+        return parseClientHelloDeferringExtensions(
+            std::move(handshakeMsg), std::move(original));
+      }
       return parse<ClientHello>(std::move(handshakeMsg), std::move(original));
     case HandshakeType::server_hello:
       return parse<ServerHello>(std::move(handshakeMsg), std::move(original));
@@ -155,6 +222,7 @@ folly::Optional<Param> ReadRecordLayer::decodeHandshakeMessage(
 }
 
 bool ReadRecordLayer::hasUnparsedHandshakeData() const {
-  return !unparsedHandshakeData_.empty();
+  return !unparsedHandshakeData_.empty() ||
+      (pendingMessage_ && pendingMessage_->type == ContentType::handshake);
 }
 } // namespace fizz
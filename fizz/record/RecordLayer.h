@@ -13,6 +13,8 @@
 #include <folly/Optional.h>
 #include <folly/io/IOBufQueue.h>
 
+#include <exception>
+
 namespace fizz {
 
 struct TLSContent {
@@ -43,17 +45,48 @@ class ReadRecordLayer {
    */
   virtual bool hasUnparsedHandshakeData() const;
 
+  /**
+   * When enabled, readEvent() reads every complete record available after an
+   * application data record and returns them as a single AppData. It stops at
+   * the first record that is not application data and returns that one from
+   * the next call, as it may change the record layer (e.g. a key update).
+   */
+  void setBatchAppData(bool enabled) {
+    batchAppData_ = enabled;
+  }
+
+  /**
+   * When enabled, the extensions of a ClientHello read by readEvent() are left
+   * undecoded in ClientHello::deferredExtensions, for a ClientHelloView to
+   * index and decode only the ones it is asked for.
+   */
+  void setDeferClientHelloExtensions(bool enabled) {
+    deferClientHelloExtensions_ = enabled;
+  }
+
   /**
    * Returns the current encryption level of the data that the read record layer
    * can process.
    */
   virtual EncryptionLevel getEncryptionLevel() const = 0;
 
-  static folly::Optional<Param> decodeHandshakeMessage(folly::IOBufQueue& buf);
+  static folly::Optional<Param> decodeHandshakeMessage(
+      folly::IOBufQueue& buf,
+      bool deferClientHelloExtensions = false);
 
  private:
+  folly::Optional<TLSMessage> nextMessage(folly::IOBufQueue& socketBuf);
+  void readAppDataAhead(folly::IOBufQueue& socketBuf, Buf& appData);
+
   folly::IOBufQueue unparsedHandshakeData_{
       folly::IOBufQueue::cacheChainLength()};
+
+  bool batchAppData_{false};
+  bool deferClientHelloExtensions_{false};
+  // Record read ahead of an AppData batch, returned by the next readEvent().
+  folly::Optional<TLSMessage> pendingMessage_;
+  // Error hit while reading ahead, rethrown once the batch has been returned.
+  std::exception_ptr pendingError_;
 };
 
 class WriteRecordLayer {
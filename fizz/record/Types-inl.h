@@ -523,14 +523,25 @@ Buf encodeHandshake(T&& handshakeMsg) {
   return buf;
 }
 
+namespace detail {
+/**
+ * Reads the fields of a ClientHello that come before its extensions.
+ */
+inline void readClientHelloPrefix(
+    ClientHello& chlo,
+    folly::io::Cursor& cursor) {
+  read(chlo.legacy_version, cursor);
+  read(chlo.random, cursor);
+  readBuf<uint8_t>(chlo.legacy_session_id, cursor);
+  readVector<uint16_t>(chlo.cipher_suites, cursor);
+  readVector<uint8_t>(chlo.legacy_compression_methods, cursor);
+}
+} // namespace detail
+
 template <>
 inline ClientHello decode(folly::io::Cursor& cursor) {
   ClientHello chlo;
-  detail::read(chlo.legacy_version, cursor);
-  detail::read(chlo.random, cursor);
-  detail::readBuf<uint8_t>(chlo.legacy_session_id, cursor);
-  detail::readVector<uint16_t>(chlo.cipher_suites, cursor);
-  detail::readVector<uint8_t>(chlo.legacy_compression_methods, cursor);
+  detail::readClientHelloPrefix(chlo, cursor);
   // Before TLS 1.3 clients could omit the extensions section entirely. If we're
   // already at the end of the client hello we won't try and read extensions so
   // that this isn't treated as a parse error.
@@ -186,6 +186,10 @@ struct ClientHello
   std::vector<CipherSuite> cipher_suites;
   std::vector<uint8_t> legacy_compression_methods;
   std::vector<Extension> extensions;
+  // Set instead of extensions by a read record layer that defers decoding them
+  // (see ReadRecordLayer::setDeferClientHelloExtensions()): the extension list
+  // as received, without its length. Read it through a ClientHelloView.
+  Buf deferredExtensions;
 };
 
 struct ServerHello
@@ -1,19 +1,134 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
+#include <chrono>
+#include <deque>
 #include <iostream>
+#include <regex>
 #include <vector>
 
 #include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/Format.h>
 #include <folly/Random.h>
 #include <folly/init/Init.h>
+#include <folly/portability/GFlags.h>
 
 #include <fizz/crypto/Utils.h>
-#include <fizz/crypto/aead/AESGCM128.h>
-#include <fizz/crypto/aead/AESOCB128.h>
-#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+#include <fizz/protocol/OpenSSLFactory.h>
 #include <fizz/record/EncryptedRecordLayer.h>
+#include <fizz/record/RecordBufferPool.h>
+
+DEFINE_bool(native_aead, false, "Use the native aead kernels where supported");
+DEFINE_bool(
+    record_buffer_pool,
+    false,
+    "Write records into pooled buffers in the recordWrite cases");
+DEFINE_bool(
+    contiguous_output,
+    false,
+    "Write all records into one buffer in the recordWrite cases");
+DEFINE_bool(
+    throughput,
+    true,
+    "Print records/sec and bytes/sec for every case after the benchmarks");
+DEFINE_int32(throughput_ms, 200, "Time spent measuring each throughput case");
+DEFINE_string(throughput_regex, "", "Only report cases matching this regex");
 
 using namespace fizz;
 
+namespace {
+
+/**
+ * Shape of the buffers handed to the aead or record layer.
+ */
+enum class Layout {
+  // Single unshared buffer with headroom for the record header and tailroom
+  // for the content type and tag.
+  Roomy,
+  // Single unshared buffer without any spare room.
+  Tight,
+  // Unshared chain of kFragments buffers without any spare room.
+  Fragmented,
+  // Clone of a roomy buffer that is still referenced elsewhere.
+  Shared,
+};
+
+enum class Operation {
+  AeadEncrypt,
+  AeadDecrypt,
+  RecordWrite,
+  RecordRead,
+};
+
+struct CipherInfo {
+  CipherSuite suite;
+  const char* name;
+};
+
+struct BenchCase {
+  Operation operation;
+  CipherInfo cipher;
+  size_t size;
+  Layout layout;
+};
+
+constexpr size_t kHeaderRoom = 5;
+constexpr size_t kTailRoom = 17;
+constexpr size_t kFragments = 4;
+constexpr size_t kMaxThroughputBatch = 1024;
+
+const std::vector<size_t> kSizes = {32, 256, 1024, 4096, 16384};
+
+std::vector<CipherInfo> getCiphers() {
+  std::vector<CipherInfo> ciphers = {
+      {CipherSuite::TLS_AES_128_GCM_SHA256, "AESGCM128"},
+      {CipherSuite::TLS_AES_256_GCM_SHA384, "AESGCM256"},
+      {CipherSuite::TLS_CHACHA20_POLY1305_SHA256, "ChaCha20Poly1305"}};
+#if FOLLY_OPENSSL_IS_110 && !defined(OPENSSL_NO_OCB)
+  ciphers.push_back(
+      {CipherSuite::TLS_AES_128_OCB_SHA256_EXPERIMENTAL, "AESOCB128"});
+#endif
+  return ciphers;
+}
+
+std::string toString(Operation operation) {
+  switch (operation) {
+    case Operation::AeadEncrypt:
+      return "aeadEncrypt";
+    case Operation::AeadDecrypt:
+      return "aeadDecrypt";
+    case Operation::RecordWrite:
+      return "recordWrite";
+    case Operation::RecordRead:
+      return "recordRead";
+  }
+  return "unknown";
+}
+
+std::string toString(Layout layout) {
+  switch (layout) {
+    case Layout::Roomy:
+      return "roomy";
+    case Layout::Tight:
+      return "tight";
+    case Layout::Fragmented:
+      return "fragmented";
+    case Layout::Shared:
+      return "shared";
+  }
+  return "unknown";
+}
+
+std::string caseName(const BenchCase& benchCase) {
+  return folly::to<std::string>(
+      toString(benchCase.operation),
+      "_",
+      benchCase.cipher.name,
+      "_",
+      toString(benchCase.layout),
+      "_",
+      benchCase.size);
+}
+
 std::unique_ptr<folly::IOBuf> makeRandom(size_t n) {
   static const char alphanum[] =
       "0123456789"
@@ -25,92 +140,179 @@ std::unique_ptr<folly::IOBuf> makeRandom(size_t n) {
   for (size_t i = 0; i < n; ++i) {
     rv.push_back(alphanum[folly::Random::rand32() % (sizeof(alphanum) - 1)]);
   }
-  return folly::IOBuf::copyBuffer(rv, 5, 17);
+  return folly::IOBuf::copyBuffer(rv, kHeaderRoom, kTailRoom);
+}
+
+// Unlike IOBuf::create(), the capacity is exactly len so there is no tailroom.
+std::unique_ptr<folly::IOBuf> makeTight(const uint8_t* data, size_t len) {
+  auto mem = static_cast<uint8_t*>(malloc(std::max<size_t>(len, 1)));
+  memcpy(mem, data, len);
+  return folly::IOBuf::takeOwnership(mem, len);
 }
 
-std::unique_ptr<folly::IOBuf> toIOBuf(std::string hexData) {
-  std::string out;
-  CHECK(folly::unhexlify(hexData, out));
-  return folly::IOBuf::copyBuffer(out);
+std::unique_ptr<folly::IOBuf> makeKey(size_t len) {
+  auto key = folly::IOBuf::create(len);
+  for (size_t i = 0; i < len; ++i) {
+    key->writableTail()[i] = static_cast<uint8_t>(i);
+  }
+  key->append(len);
+  return key;
 }
 
-TrafficKey getKey() {
+std::unique_ptr<Aead> makeAead(CipherSuite suite) {
+  OpenSSLFactory factory;
+  factory.setUseNativeAead(FLAGS_native_aead);
+  auto aead = factory.makeAead(suite);
   TrafficKey trafficKey;
-  trafficKey.key = toIOBuf("000102030405060708090A0B0C0D0E0F");
-  trafficKey.iv = toIOBuf("000102030405060708090A0B");
-  return trafficKey;
+  trafficKey.key = makeKey(aead->keyLength());
+  trafficKey.iv = makeKey(aead->ivLength());
+  aead->setKey(std::move(trafficKey));
+  return aead;
 }
 
-void encryptGCM(uint32_t n, size_t size) {
-  std::unique_ptr<Aead> aead;
-  std::vector<fizz::TLSMessage> msgs;
-  EncryptedWriteRecordLayer write{EncryptionLevel::AppTraffic};
-  BENCHMARK_SUSPEND {
-    aead = std::make_unique<OpenSSLEVPCipher<AESGCM128>>();
-    aead->setKey(getKey());
-    write.setAead(folly::ByteRange(), std::move(aead));
-    for (size_t i = 0; i < n; ++i) {
-      TLSMessage msg{ContentType::application_data, makeRandom(size)};
-      msgs.push_back(std::move(msg));
+/**
+ * Inputs for a batch of records, built outside of the timed region, and the
+ * code that processes them.
+ */
+class BenchState {
+ public:
+  BenchState(const BenchCase& benchCase, size_t n) : benchCase_(benchCase) {
+    aad_ = folly::IOBuf::copyBuffer("\x17\x03\x03\x40\x11");
+    switch (benchCase_.operation) {
+      case Operation::AeadEncrypt:
+        aead_ = makeAead(benchCase_.cipher.suite);
+        aead_->setEncryptedBufferHeadroom(kHeaderRoom);
+        for (size_t i = 0; i < n; ++i) {
+          inputs_.push_back(shape(makeRandom(benchCase_.size)));
+        }
+        break;
+      case Operation::AeadDecrypt: {
+        auto writeAead = makeAead(benchCase_.cipher.suite);
+        aead_ = makeAead(benchCase_.cipher.suite);
+        for (size_t i = 0; i < n; ++i) {
+          inputs_.push_back(shape(writeAead->encrypt(
+              makeRandom(benchCase_.size), aad_.get(), i)));
+        }
+        break;
+      }
+      case Operation::RecordWrite:
+        write_ = std::make_unique<EncryptedWriteRecordLayer>(
+            EncryptionLevel::AppTraffic);
+        write_->setAead(
+            folly::ByteRange(), makeAead(benchCase_.cipher.suite));
+        write_->setUseRecordBufferPool(FLAGS_record_buffer_pool);
+        write_->setContiguousOutput(FLAGS_contiguous_output);
+        for (size_t i = 0; i < n; ++i) {
+          inputs_.push_back(shape(makeRandom(benchCase_.size)));
+        }
+        break;
+      case Operation::RecordRead: {
+        EncryptedWriteRecordLayer write{EncryptionLevel::AppTraffic};
+        write.setAead(folly::ByteRange(), makeAead(benchCase_.cipher.suite));
+        read_ = std::make_unique<EncryptedReadRecordLayer>(
+            EncryptionLevel::AppTraffic);
+        read_->setAead(folly::ByteRange(), makeAead(benchCase_.cipher.suite));
+        for (size_t i = 0; i < n; ++i) {
+          TLSMessage msg{ContentType::application_data,
+                         makeRandom(benchCase_.size)};
+          auto content = write.write(std::move(msg));
+          folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+          queue.append(shape(std::move(content.data)));
+          folly::doNotOptimizeAway(queue.front());
+          queues_.push_back(std::move(queue));
+        }
+        break;
+      }
     }
   }
 
-  TLSContent content;
-  for (auto& msg : msgs) {
-    content = write.write(std::move(msg));
+  void run() {
+    switch (benchCase_.operation) {
+      case Operation::AeadEncrypt:
+        for (size_t i = 0; i < inputs_.size(); ++i) {
+          auto out = aead_->encrypt(std::move(inputs_[i]), aad_.get(), i);
+          folly::doNotOptimizeAway(out);
+        }
+        break;
+      case Operation::AeadDecrypt:
+        for (size_t i = 0; i < inputs_.size(); ++i) {
+          auto out = aead_->decrypt(std::move(inputs_[i]), aad_.get(), i);
+          folly::doNotOptimizeAway(out);
+        }
+        break;
+      case Operation::RecordWrite:
+        for (auto& input : inputs_) {
+          auto content = write_->write(
+              TLSMessage{ContentType::application_data, std::move(input)});
+          folly::doNotOptimizeAway(content);
+        }
+        break;
+      case Operation::RecordRead:
+        for (auto& queue : queues_) {
+          auto msg = read_->read(queue);
+          folly::doNotOptimizeAway(msg);
+        }
+        break;
+    }
   }
-  folly::doNotOptimizeAway(content);
-}
 
-void decryptGCM(uint32_t n, size_t size) {
-  std::vector<folly::IOBufQueue> contents;
-  EncryptedReadRecordLayer read{EncryptionLevel::AppTraffic};
-  BENCHMARK_SUSPEND {
-    EncryptedWriteRecordLayer write{EncryptionLevel::AppTraffic};
-    auto writeAead = std::make_unique<OpenSSLEVPCipher<AESGCM128>>();
-    auto readAead = std::make_unique<OpenSSLEVPCipher<AESGCM128>>();
-    writeAead->setKey(getKey());
-    readAead->setKey(getKey());
-    write.setAead(folly::ByteRange(), std::move(writeAead));
-    read.setAead(folly::ByteRange(), std::move(readAead));
-    for (size_t i = 0; i < n; ++i) {
-      TLSMessage msg{ContentType::application_data, makeRandom(size)};
-      auto content = write.write(std::move(msg));
-      folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
-      queue.append(std::move(content.data));
-      folly::doNotOptimizeAway(queue.front());
-      contents.push_back(std::move(queue));
+ private:
+  std::unique_ptr<folly::IOBuf> shape(std::unique_ptr<folly::IOBuf> buf) {
+    auto data = buf->coalesce();
+    switch (benchCase_.layout) {
+      case Layout::Roomy:
+        return folly::IOBuf::copyBuffer(
+            data.data(), data.size(), kHeaderRoom, kTailRoom);
+      case Layout::Tight:
+        return makeTight(data.data(), data.size());
+      case Layout::Fragmented: {
+        auto chunkLen = data.size() / kFragments;
+        auto out = makeTight(data.data(), chunkLen);
+        for (size_t i = 1; i < kFragments; ++i) {
+          auto offset = i * chunkLen;
+          auto len = i == kFragments - 1 ? data.size() - offset : chunkLen;
+          out->prependChain(makeTight(data.data() + offset, len));
+        }
+        return out;
+      }
+      case Layout::Shared: {
+        auto original = folly::IOBuf::copyBuffer(
+            data.data(), data.size(), kHeaderRoom, kTailRoom);
+        auto clone = original->clone();
+        keepAlive_.push_back(std::move(original));
+        return clone;
+      }
     }
+    throw std::runtime_error("unknown layout");
   }
 
-  folly::Optional<TLSMessage> msg;
-  for (auto& buf : contents) {
-    msg = read.read(buf);
-  }
-  folly::doNotOptimizeAway(msg);
-}
+  BenchCase benchCase_;
+  std::unique_ptr<folly::IOBuf> aad_;
+  std::unique_ptr<Aead> aead_;
+  std::unique_ptr<EncryptedWriteRecordLayer> write_;
+  std::unique_ptr<EncryptedReadRecordLayer> read_;
+  std::vector<std::unique_ptr<folly::IOBuf>> inputs_;
+  std::vector<folly::IOBufQueue> queues_;
+  std::vector<std::unique_ptr<folly::IOBuf>> keepAlive_;
+};
 
-void decryptGCMNoRecord(uint32_t n, size_t size) {
-  std::unique_ptr<Aead> readAead;
-  folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
-  std::vector<std::unique_ptr<folly::IOBuf>> contents;
-  auto aad = folly::IOBuf::copyBuffer("aad");
-  BENCHMARK_SUSPEND {
-    auto writeAead = std::make_unique<OpenSSLEVPCipher<AESGCM128>>();
-    readAead = std::make_unique<OpenSSLEVPCipher<AESGCM128>>();
-    writeAead->setKey(getKey());
-    readAead->setKey(getKey());
-    for (size_t i = 0; i < n; ++i) {
-      auto out = writeAead->encrypt(makeRandom(size), aad.get(), 0);
-      contents.push_back(std::move(out));
+std::vector<BenchCase> getCases() {
+  std::vector<BenchCase> cases;
+  for (auto operation :
+       {Operation::AeadEncrypt,
+        Operation::AeadDecrypt,
+        Operation::RecordWrite,
+        Operation::RecordRead}) {
+    for (const auto& cipher : getCiphers()) {
+      for (auto layout :
+           {Layout::Roomy, Layout::Tight, Layout::Fragmented, Layout::Shared}) {
+        for (auto size : kSizes) {
+          cases.push_back({operation, cipher, size, layout});
+        }
+      }
     }
   }
-
-  std::unique_ptr<folly::IOBuf> in;
-  for (auto& buf : contents) {
-    in = readAead->decrypt(std::move(buf), aad.get(), 0);
-  }
-  folly::doNotOptimizeAway(in);
+  return cases;
 }
 
 void touchEveryByte(uint32_t n, size_t size) {
@@ -130,56 +332,84 @@ void touchEveryByte(uint32_t n, size_t size) {
   folly::doNotOptimizeAway(isTrue);
 }
 
-BENCHMARK_PARAM(encryptGCM, 10);
-BENCHMARK_PARAM(encryptGCM, 100);
-BENCHMARK_PARAM(encryptGCM, 1000);
-BENCHMARK_PARAM(encryptGCM, 4000);
-BENCHMARK_PARAM(encryptGCM, 8000);
-
-BENCHMARK_PARAM(decryptGCM, 10);
-BENCHMARK_PARAM(decryptGCM, 1000);
-BENCHMARK_PARAM(decryptGCM, 8000);
+void registerBenchmarks(const std::vector<BenchCase>& cases) {
+  // folly may keep the name pointer around, so keep the strings alive.
+  static std::deque<std::string> names;
+  for (const auto& benchCase : cases) {
+    names.push_back(caseName(benchCase));
+    folly::addBenchmark(
+        __FILE__, names.back().c_str(), [benchCase](unsigned iters) {
+          std::unique_ptr<BenchState> state;
+          BENCHMARK_SUSPEND {
+            state = std::make_unique<BenchState>(benchCase, iters);
+          }
+          state->run();
+          BENCHMARK_SUSPEND {
+            state.reset();
+          }
+          return iters;
+        });
+  }
+}
 
-BENCHMARK_PARAM(decryptGCMNoRecord, 10);
-BENCHMARK_PARAM(decryptGCMNoRecord, 1000);
-BENCHMARK_PARAM(decryptGCMNoRecord, 8000);
+void reportThroughput(const std::vector<BenchCase>& cases) {
+  using Clock = std::chrono::steady_clock;
+  std::regex filter(FLAGS_throughput_regex);
+  auto target = std::chrono::milliseconds(FLAGS_throughput_ms);
 
-BENCHMARK_PARAM(touchEveryByte, 10);
-BENCHMARK_PARAM(touchEveryByte, 1000);
-BENCHMARK_PARAM(touchEveryByte, 8000);
+  std::cout << folly::sformat(
+      "{:<48} {:>14} {:>14}\n", "case", "records/s", "MB/s");
+  for (const auto& benchCase : cases) {
+    auto name = caseName(benchCase);
+    if (!std::regex_search(name, filter)) {
+      continue;
+    }
 
-#if FOLLY_OPENSSL_IS_110 && !defined(OPENSSL_NO_OCB)
-void encryptOCB(uint32_t n, size_t size) {
-  std::unique_ptr<Aead> aead;
-  std::vector<fizz::TLSMessage> msgs;
-  EncryptedWriteRecordLayer write{EncryptionLevel::AppTraffic};
-  BENCHMARK_SUSPEND {
-    aead = std::make_unique<OpenSSLEVPCipher<AESOCB128>>();
-    aead->setKey(getKey());
-    write.setAead(folly::ByteRange(), std::move(aead));
-    for (size_t i = 0; i < n; ++i) {
-      TLSMessage msg{ContentType::application_data, makeRandom(size)};
-      msgs.push_back(std::move(msg));
+    Clock::duration elapsed{0};
+    size_t records = 0;
+    size_t batch = 16;
+    while (elapsed < target) {
+      BenchState state(benchCase, batch);
+      auto start = Clock::now();
+      state.run();
+      elapsed += Clock::now() - start;
+      records += batch;
+      batch = std::min(batch * 2, kMaxThroughputBatch);
     }
-  }
 
-  TLSContent content;
-  for (auto& msg : msgs) {
-    content = write.write(std::move(msg));
+    auto seconds = std::chrono::duration<double>(elapsed).count();
+    auto recordsPerSec = records / seconds;
+    auto bytesPerSec = recordsPerSec * benchCase.size;
+    std::cout << folly::sformat(
+        "{:<48} {:>14.0f} {:>14.1f}\n",
+        name,
+        recordsPerSec,
+        bytesPerSec / (1024 * 1024));
   }
-  folly::doNotOptimizeAway(content);
 }
+} // namespace
 
-BENCHMARK_PARAM(encryptOCB, 10);
-BENCHMARK_PARAM(encryptOCB, 100);
-BENCHMARK_PARAM(encryptOCB, 1000);
-BENCHMARK_PARAM(encryptOCB, 4000);
-BENCHMARK_PARAM(encryptOCB, 8000);
-#endif
+BENCHMARK_PARAM(touchEveryByte, 32);
+BENCHMARK_PARAM(touchEveryByte, 1024);
+BENCHMARK_PARAM(touchEveryByte, 16384);
 
 int main(int argc, char** argv) {
   folly::init(&argc, &argv);
   CryptoUtils::init();
+  auto cases = getCases();
+  registerBenchmarks(cases);
   folly::runBenchmarks();
+  if (FLAGS_throughput) {
+    reportThroughput(cases);
+  }
+  if (FLAGS_record_buffer_pool) {
+    auto stats = RecordBufferPool::getStats();
+    std::cout << folly::sformat(
+        "record buffers: {} allocated, {} reused, {} cached, {} freed\n",
+        stats.allocated,
+        stats.reused,
+        stats.cached,
+        stats.freed);
+  }
   return 0;
 }
@@ -11,7 +11,9 @@
 
 #include <fizz/record/EncryptedRecordLayer.h>
 
+#include <fizz/crypto/aead/IOBufUtil.h>
 #include <fizz/crypto/aead/test/Mocks.h>
+#include <fizz/protocol/clock/test/Mocks.h>
 #include <folly/String.h>
 
 using namespace folly;
@@ -250,6 +252,54 @@ TEST_F(EncryptedRecordTest, TestSkipAndRead) {
   EXPECT_TRUE(queue_.empty());
 }
 
+TEST_F(EncryptedRecordTest, TestReadInPlaceIov) {
+  addToQueue("17030100050123456789");
+  EXPECT_CALL(*readAead_, supportsZeroCopyIov()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*readAead_, getCipherOverhead()).WillRepeatedly(Return(2));
+  EXPECT_CALL(*readAead_, tryDecryptIov(_, _, _, _, 0))
+      .WillOnce(Invoke([](Range<const struct iovec*> input,
+                          Range<const struct iovec*> output,
+                          ByteRange tag,
+                          ByteRange aad,
+                          uint64_t) {
+        EXPECT_EQ(input.begin(), output.begin());
+        EXPECT_EQ(iovLength(input), 3);
+        EXPECT_EQ(hexlify(tag), "6789");
+        EXPECT_EQ(hexlify(aad), "1703010005");
+        auto plaintext = unhexlify("abcd16");
+        memcpy(output[0].iov_base, plaintext.data(), plaintext.size());
+        return true;
+      }));
+  auto msg = read_.read(queue_);
+  EXPECT_EQ(msg->type, ContentType::handshake);
+  expectSame(msg->fragment, "abcd");
+  EXPECT_TRUE(queue_.empty());
+}
+
+TEST_F(EncryptedRecordTest, TestReadInPlaceIovFailure) {
+  addToQueue("17030100050123456789");
+  EXPECT_CALL(*readAead_, supportsZeroCopyIov()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*readAead_, getCipherOverhead()).WillRepeatedly(Return(2));
+  EXPECT_CALL(*readAead_, tryDecryptIov(_, _, _, _, 0))
+      .WillOnce(Return(false));
+  EXPECT_ANY_THROW(read_.read(queue_));
+}
+
+TEST_F(EncryptedRecordTest, TestReadSharedSkipsIov) {
+  addToQueue("17030100050123456789170301000501234567aa");
+  EXPECT_CALL(*readAead_, supportsZeroCopyIov()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*readAead_, getCipherOverhead()).WillRepeatedly(Return(2));
+  // The first record is split off the shared read buffer.
+  EXPECT_CALL(*readAead_, _decrypt(_, _, 0))
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "0123456789");
+        return getBuf("abcd16");
+      }));
+  auto msg = read_.read(queue_);
+  EXPECT_EQ(msg->type, ContentType::handshake);
+  expectSame(msg->fragment, "abcd");
+}
+
 TEST_F(EncryptedRecordTest, TestWriteHandshake) {
   TLSMessage msg{ContentType::handshake, getBuf("1234567890")};
   EXPECT_CALL(*writeAead_, _encrypt(_, _, 0))
@@ -287,6 +337,247 @@ TEST_F(EncryptedRecordTest, TestWriteAppDataInPlace) {
   expectSame(buf.data, "1703030006abcd1234abcd");
 }
 
+TEST_F(EncryptedRecordTest, TestWriteInPlaceIov) {
+  TLSMessage msg{ContentType::application_data, getBuf("1234567890", 5, 17)};
+  EXPECT_CALL(*writeAead_, supportsZeroCopyIov()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*writeAead_, getCipherOverhead()).WillRepeatedly(Return(4));
+  EXPECT_CALL(*writeAead_, encryptIov(_, _, _, _, 0))
+      .WillOnce(Invoke([](Range<const struct iovec*> input,
+                          Range<const struct iovec*> output,
+                          MutableByteRange tag,
+                          ByteRange aad,
+                          uint64_t) {
+        EXPECT_EQ(input.begin(), output.begin());
+        EXPECT_EQ(input.size(), 1);
+        EXPECT_EQ(
+            hexlify(ByteRange(
+                static_cast<const uint8_t*>(input[0].iov_base),
+                input[0].iov_len)),
+            "123456789017");
+        EXPECT_EQ(hexlify(aad), "170303000a");
+        memset(output[0].iov_base, 0xaa, output[0].iov_len);
+        memset(tag.begin(), 0xbb, tag.size());
+      }));
+  auto buf = write_.write(std::move(msg));
+  EXPECT_FALSE(buf.data->isChained());
+  expectSame(buf.data, "170303000aaaaaaaaaaaaabbbbbbbb");
+}
+
+TEST_F(EncryptedRecordTest, TestWriteInPlaceIovBatched) {
+  auto data = getBuf("1234567890", 5, 17);
+  data->prependChain(getBuf("abcdef", 5, 17));
+  TLSMessage msg{ContentType::application_data, std::move(data)};
+  write_.setMinDesiredRecord(1);
+  EXPECT_CALL(*writeAead_, supportsZeroCopyIov()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*writeAead_, getCipherOverhead()).WillRepeatedly(Return(4));
+  EXPECT_CALL(*writeAead_, _batchEncryptIov(_))
+      .WillOnce(Invoke([](Range<const AeadIovRecord*> records) {
+        ASSERT_EQ(records.size(), 2);
+        EXPECT_EQ(records[0].seqNum, 0);
+        EXPECT_EQ(hexlify(records[0].associatedData), "170303000a");
+        EXPECT_EQ(records[1].seqNum, 1);
+        EXPECT_EQ(hexlify(records[1].associatedData), "1703030008");
+      }));
+  EXPECT_CALL(*writeAead_, encryptIov(_, _, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Invoke([](Range<const struct iovec*>,
+                                Range<const struct iovec*> output,
+                                MutableByteRange tag,
+                                ByteRange,
+                                uint64_t) {
+        memset(output[0].iov_base, 0xaa, output[0].iov_len);
+        memset(tag.begin(), 0xbb, tag.size());
+      }));
+  auto buf = write_.write(std::move(msg));
+  expectSame(
+      buf.data,
+      "170303000aaaaaaaaaaaaabbbbbbbb"
+      "1703030008aaaaaaaabbbbbbbb");
+}
+
+TEST_F(EncryptedRecordTest, TestWriteSharedSkipsIov) {
+  auto data = getBuf("1234567890");
+  TLSMessage msg{ContentType::application_data, data->clone()};
+  EXPECT_CALL(*writeAead_, supportsZeroCopyIov()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, 0))
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "123456789017");
+        return getBuf("abcd1234abcd");
+      }));
+  auto buf = write_.write(std::move(msg));
+  expectSame(buf.data, "1703030006abcd1234abcd");
+}
+
+TEST_F(EncryptedRecordTest, TestWritePooled) {
+  auto data = getBuf("1234567890");
+  data->prependChain(getBuf("abcdef"));
+  TLSMessage msg{ContentType::application_data, data->clone()};
+  write_.setUseRecordBufferPool(true);
+  EXPECT_CALL(*writeAead_, supportsZeroCopyIov()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*writeAead_, getCipherOverhead()).WillRepeatedly(Return(4));
+  EXPECT_CALL(*writeAead_, encryptIov(_, _, _, _, 0))
+      .WillOnce(Invoke([&](Range<const struct iovec*> input,
+                           Range<const struct iovec*> output,
+                           MutableByteRange tag,
+                           ByteRange aad,
+                           uint64_t) {
+        // encrypted straight out of the shared fragment
+        EXPECT_EQ(input.size(), 3);
+        EXPECT_EQ(input[0].iov_base, data->data());
+        EXPECT_EQ(input[0].iov_len, 5);
+        EXPECT_EQ(input[1].iov_base, data->next()->data());
+        EXPECT_EQ(input[1].iov_len, 3);
+        EXPECT_EQ(*static_cast<const uint8_t*>(input[2].iov_base), 0x17);
+        EXPECT_EQ(output.size(), 1);
+        EXPECT_EQ(output[0].iov_len, 9);
+        EXPECT_EQ(
+            static_cast<uint8_t*>(output[0].iov_base) + output[0].iov_len,
+            tag.begin());
+        EXPECT_EQ(hexlify(aad), "170303000d");
+        memset(output[0].iov_base, 0xaa, output[0].iov_len);
+        memset(tag.begin(), 0xbb, tag.size());
+      }));
+  auto buf = write_.write(std::move(msg));
+  EXPECT_FALSE(buf.data->isChained());
+  expectSame(buf.data, "170303000daaaaaaaaaaaaaaaaaabbbbbbbb");
+  expectSame(data, "1234567890abcdef");
+}
+
+TEST_F(EncryptedRecordTest, TestWritePooledFragmented) {
+  TLSMessage msg{ContentType::application_data, IOBuf::create(0x4a00)};
+  msg.fragment->append(0x4a00);
+  memset(msg.fragment->writableData(), 0x1, msg.fragment->length());
+  write_.setUseRecordBufferPool(true);
+  EXPECT_CALL(*writeAead_, supportsZeroCopyIov()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*writeAead_, getCipherOverhead()).WillRepeatedly(Return(4));
+
+  Sequence s;
+  EXPECT_CALL(*writeAead_, encryptIov(_, _, _, _, 0))
+      .InSequence(s)
+      .WillOnce(Invoke([](Range<const struct iovec*> input,
+                          Range<const struct iovec*> output,
+                          MutableByteRange,
+                          ByteRange aad,
+                          uint64_t) {
+        EXPECT_EQ(iovLength(input), 0x4001);
+        EXPECT_EQ(iovLength(output), 0x4001);
+        EXPECT_EQ(hexlify(aad), "1703034005");
+      }));
+  EXPECT_CALL(*writeAead_, encryptIov(_, _, _, _, 1))
+      .InSequence(s)
+      .WillOnce(Invoke([](Range<const struct iovec*> input,
+                          Range<const struct iovec*> output,
+                          MutableByteRange,
+                          ByteRange aad,
+                          uint64_t) {
+        EXPECT_EQ(iovLength(input), 0xa01);
+        EXPECT_EQ(iovLength(output), 0xa01);
+        EXPECT_EQ(hexlify(aad), "1703030a05");
+      }));
+  auto outBuf = write_.write(std::move(msg));
+  EXPECT_EQ(outBuf.data->countChainElements(), 2);
+  EXPECT_EQ(outBuf.data->length(), 5 + 0x4005);
+  EXPECT_EQ(outBuf.data->next()->length(), 5 + 0xa05);
+}
+
+TEST_F(EncryptedRecordTest, TestWritePooledWithoutIov) {
+  TLSMessage msg{ContentType::application_data, getBuf("1234567890")};
+  write_.setUseRecordBufferPool(true);
+  EXPECT_CALL(*writeAead_, supportsZeroCopyIov()).WillRepeatedly(Return(false));
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, 0))
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "123456789017");
+        return getBuf("abcd1234abcd");
+      }));
+  auto buf = write_.write(std::move(msg));
+  expectSame(buf.data, "1703030006abcd1234abcd");
+}
+
+TEST_F(EncryptedRecordTest, TestWriteContiguous) {
+  TLSMessage msg{ContentType::application_data, IOBuf::create(0x4a00)};
+  msg.fragment->append(0x4a00);
+  memset(msg.fragment->writableData(), 0x1, msg.fragment->length());
+  write_.setContiguousOutput(true);
+  EXPECT_CALL(*writeAead_, getCipherOverhead()).WillRepeatedly(Return(4));
+
+  Sequence s;
+  EXPECT_CALL(*writeAead_, encryptIov(_, _, _, _, 0))
+      .InSequence(s)
+      .WillOnce(Invoke([](Range<const struct iovec*> input,
+                          Range<const struct iovec*> output,
+                          MutableByteRange tag,
+                          ByteRange aad,
+                          uint64_t) {
+        EXPECT_EQ(iovLength(input), 0x4001);
+        EXPECT_EQ(iovLength(output), 0x4001);
+        EXPECT_EQ(hexlify(aad), "1703034005");
+        memset(output[0].iov_base, 0xaa, output[0].iov_len);
+        memset(tag.begin(), 0xbb, tag.size());
+      }));
+  EXPECT_CALL(*writeAead_, encryptIov(_, _, _, _, 1))
+      .InSequence(s)
+      .WillOnce(Invoke([](Range<const struct iovec*> input,
+                          Range<const struct iovec*> output,
+                          MutableByteRange tag,
+                          ByteRange aad,
+                          uint64_t) {
+        EXPECT_EQ(iovLength(input), 0xa01);
+        EXPECT_EQ(iovLength(output), 0xa01);
+        EXPECT_EQ(hexlify(aad), "1703030a05");
+        memset(output[0].iov_base, 0xcc, output[0].iov_len);
+        memset(tag.begin(), 0xdd, tag.size());
+      }));
+  auto outBuf = write_.write(std::move(msg));
+  EXPECT_FALSE(outBuf.data->isChained());
+  EXPECT_EQ(outBuf.data->length(), 5 + 0x4005 + 5 + 0xa05);
+
+  Cursor cursor(outBuf.data.get());
+  EXPECT_EQ(hexlify(cursor.readFixedString(5)), "1703034005");
+  cursor.skip(0x4000);
+  EXPECT_EQ(hexlify(cursor.readFixedString(5)), "aabbbbbbbb");
+  EXPECT_EQ(hexlify(cursor.readFixedString(5)), "1703030a05");
+  cursor.skip(0xa00);
+  EXPECT_EQ(hexlify(cursor.readFixedString(5)), "ccdddddddd");
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(EncryptedRecordTest, TestWriteContiguousChained) {
+  auto data = getBuf("1234567890");
+  data->prependChain(getBuf("abcdef"));
+  TLSMessage msg{ContentType::handshake, data->clone()};
+  write_.setContiguousOutput(true);
+  EXPECT_CALL(*writeAead_, getCipherOverhead()).WillRepeatedly(Return(4));
+  EXPECT_CALL(*writeAead_, encryptIov(_, _, _, _, 0))
+      .WillOnce(Invoke([&](Range<const struct iovec*> input,
+                           Range<const struct iovec*> output,
+                           MutableByteRange tag,
+                           ByteRange aad,
+                           uint64_t) {
+        // encrypted straight out of the shared fragment
+        EXPECT_EQ(input.size(), 3);
+        EXPECT_EQ(input[0].iov_base, data->data());
+        EXPECT_EQ(input[1].iov_base, data->next()->data());
+        EXPECT_EQ(*static_cast<const uint8_t*>(input[2].iov_base), 0x16);
+        EXPECT_EQ(output.size(), 1);
+        EXPECT_EQ(output[0].iov_len, 9);
+        EXPECT_EQ(hexlify(aad), "170303000d");
+        memset(output[0].iov_base, 0xaa, output[0].iov_len);
+        memset(tag.begin(), 0xbb, tag.size());
+      }));
+  auto buf = write_.write(std::move(msg));
+  EXPECT_EQ(buf.contentType, ContentType::handshake);
+  expectSame(buf.data, "170303000daaaaaaaaaaaaaaaaaabbbbbbbb");
+  expectSame(data, "1234567890abcdef");
+}
+
+TEST_F(EncryptedRecordTest, TestWriteContiguousEmpty) {
+  write_.setContiguousOutput(true);
+  TLSMessage msg{ContentType::application_data, folly::IOBuf::create(0)};
+  auto outBuf = write_.write(std::move(msg));
+  EXPECT_TRUE(outBuf.data->empty());
+  EXPECT_EQ(write_.getSequenceNumber(), 0);
+}
+
 TEST_F(EncryptedRecordTest, TestFragmentedWrite) {
   TLSMessage msg{ContentType::application_data, IOBuf::create(0x4a00)};
   msg.fragment->append(0x4a00);
@@ -309,6 +600,30 @@ TEST_F(EncryptedRecordTest, TestFragmentedWrite) {
   expectSame(outBuf.data, "1703034001aaaa1703030a01bbbb");
 }
 
+TEST_F(EncryptedRecordTest, TestFragmentedWriteAdditionalData) {
+  TLSMessage msg{ContentType::application_data, IOBuf::create(0x4a00)};
+  msg.fragment->append(0x4a00);
+  memset(msg.fragment->writableData(), 0x1, msg.fragment->length());
+
+  Sequence s;
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, 0))
+      .InSequence(s)
+      .WillOnce(Invoke(
+          [](std::unique_ptr<IOBuf>& /*buf*/, const IOBuf* aad, uint64_t) {
+            expectSame(aad->clone(), "1703034001");
+            return getBuf("aaaa");
+          }));
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, 1))
+      .InSequence(s)
+      .WillOnce(Invoke(
+          [](std::unique_ptr<IOBuf>& /*buf*/, const IOBuf* aad, uint64_t) {
+            expectSame(aad->clone(), "1703030a01");
+            return getBuf("bbbb");
+          }));
+  auto outBuf = write_.write(std::move(msg));
+  expectSame(outBuf.data, "1703034001aaaa1703030a01bbbb");
+}
+
 TEST_F(EncryptedRecordTest, TestWriteSplittingWholeBuf) {
   TLSMessage msg{ContentType::application_data, IOBuf::create(2000)};
   msg.fragment->append(2000);
@@ -401,5 +716,66 @@ TEST_F(EncryptedRecordTest, TestWriteMinSize) {
       }));
   write_.write(std::move(msg));
 }
+
+TEST_F(EncryptedRecordTest, TestWriteDynamicRecordSizing) {
+  auto clock = std::make_shared<MockClock>();
+  std::chrono::system_clock::time_point now(std::chrono::hours(1));
+  EXPECT_CALL(*clock, getCurrentTime()).WillRepeatedly(Invoke([&]() {
+    return now;
+  }));
+  DynamicRecordSizing settings;
+  settings.initialRecordSize = 1000;
+  settings.rampUpBytes = 2500;
+  settings.idleTimeout = std::chrono::seconds(1);
+  settings.clock = clock;
+  write_.setDynamicRecordSizing(std::move(settings));
+
+  std::vector<size_t> lengths;
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, _))
+      .WillRepeatedly(
+          Invoke([&](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+            lengths.push_back(buf->computeChainDataLength());
+            return getBuf("aaaa");
+          }));
+  auto write = [this](size_t length) {
+    TLSMessage msg{ContentType::application_data, IOBuf::create(length)};
+    msg.fragment->append(length);
+    memset(msg.fragment->writableData(), 0x1, msg.fragment->length());
+    write_.write(std::move(msg));
+  };
+
+  // one byte for footer
+  write(5000);
+  EXPECT_EQ(lengths, std::vector<size_t>({1001, 1001, 1001, 2001}));
+
+  lengths.clear();
+  now += std::chrono::milliseconds(999);
+  write(5000);
+  EXPECT_EQ(lengths, std::vector<size_t>({5001}));
+
+  lengths.clear();
+  now += std::chrono::seconds(1);
+  write(2500);
+  EXPECT_EQ(lengths, std::vector<size_t>({1001, 1001, 501}));
+}
+
+TEST_F(EncryptedRecordTest, TestWriteDynamicRecordSizingMaxRecord) {
+  write_.setMaxRecord(800);
+  DynamicRecordSizing settings;
+  settings.initialRecordSize = 1000;
+  write_.setDynamicRecordSizing(std::move(settings));
+
+  std::vector<size_t> lengths;
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, _))
+      .WillRepeatedly(
+          Invoke([&](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+            lengths.push_back(buf->computeChainDataLength());
+            return getBuf("aaaa");
+          }));
+  TLSMessage msg{ContentType::application_data, IOBuf::create(2000)};
+  msg.fragment->append(2000);
+  write_.write(std::move(msg));
+  EXPECT_EQ(lengths, std::vector<size_t>({801, 801, 401}));
+}
 } // namespace test
 } // namespace fizz
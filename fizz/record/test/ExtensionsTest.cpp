@@ -9,6 +9,7 @@
 #include <folly/portability/GMock.h>
 #include <folly/portability/GTest.h>
 
+#include <fizz/record/ClientHelloView.h>
 #include <fizz/record/Extensions.h>
 #include <fizz/record/test/ExtensionTestsBase.h>
 #include <folly/String.h>
@@ -136,5 +137,106 @@ TEST_F(ExtensionsTest, TestBadlyFormedExtension) {
   exts.push_back(std::move(ext));
   EXPECT_THROW(getExtension<ServerNameList>(exts), std::runtime_error);
 }
+
+TEST_F(ExtensionsTest, TestClientHelloView) {
+  ClientHello chlo;
+  chlo.extensions = getExtensions(alpn);
+  chlo.extensions.push_back(std::move(getExtensions(cookie).front()));
+  chlo.extensions.push_back(std::move(getExtensions(sni).front()));
+  ClientHelloView view(std::move(chlo));
+
+  const auto& ext = view.getExtension<ServerNameList>();
+  ASSERT_TRUE(ext.hasValue());
+  EXPECT_EQ(
+      StringPiece(ext->server_name_list[0].hostname->coalesce()),
+      StringPiece("www.facebook.com"));
+  EXPECT_EQ(&view.getExtension<ServerNameList>(), &ext);
+
+  EXPECT_TRUE(view.getExtension<ProtocolNameList>().hasValue());
+  EXPECT_TRUE(view.getExtension<Cookie>().hasValue());
+  EXPECT_FALSE(view.getExtension<ClientEarlyData>().hasValue());
+  EXPECT_FALSE(view.getExtension<SupportedGroups>().hasValue());
+  EXPECT_TRUE(IOBufEqualTo()(
+      view.getExtensionData(ExtensionType::cookie),
+      getExtensions(cookie).front().extension_data));
+  EXPECT_FALSE(view.getExtensionData(ExtensionType::early_data));
+  EXPECT_EQ(
+      view.getExtensionTypes(),
+      std::vector<ExtensionType>(
+          {ExtensionType::application_layer_protocol_negotiation,
+           ExtensionType::cookie,
+           ExtensionType::server_name}));
+  view.checkDuplicateExtensions();
+}
+
+TEST_F(ExtensionsTest, TestClientHelloViewDeferred) {
+  ClientHello chlo;
+  chlo.deferredExtensions = getBuf(alpn);
+  chlo.deferredExtensions->prependChain(getBuf(cookie));
+  chlo.deferredExtensions->prependChain(getBuf(sni));
+  ClientHelloView view(std::move(chlo));
+
+  const auto& ext = view.getExtension<ServerNameList>();
+  ASSERT_TRUE(ext.hasValue());
+  EXPECT_EQ(
+      StringPiece(ext->server_name_list[0].hostname->coalesce()),
+      StringPiece("www.facebook.com"));
+  EXPECT_TRUE(view.getExtension<ProtocolNameList>().hasValue());
+  EXPECT_FALSE(view.getExtension<ClientEarlyData>().hasValue());
+  EXPECT_TRUE(IOBufEqualTo()(
+      view.getExtensionData(ExtensionType::cookie),
+      getExtensions(cookie).front().extension_data));
+  EXPECT_EQ(
+      view.getExtensionTypes(),
+      std::vector<ExtensionType>(
+          {ExtensionType::application_layer_protocol_negotiation,
+           ExtensionType::cookie,
+           ExtensionType::server_name}));
+
+  EXPECT_TRUE(view.clientHello().extensions.empty());
+  const auto& extensions = view.clientHelloWithExtensions().extensions;
+  ASSERT_EQ(extensions.size(), 3);
+  EXPECT_EQ(extensions[1].extension_type, ExtensionType::cookie);
+  EXPECT_TRUE(IOBufEqualTo()(
+      extensions[1].extension_data,
+      getExtensions(cookie).front().extension_data));
+}
+
+TEST_F(ExtensionsTest, TestClientHelloViewDeferredTruncated) {
+  auto buf = getBuf(sni);
+  buf->trimEnd(1);
+  ClientHello chlo;
+  chlo.deferredExtensions = std::move(buf);
+  EXPECT_THROW(ClientHelloView(std::move(chlo)), std::out_of_range);
+}
+
+TEST_F(ExtensionsTest, TestClientHelloViewDuplicate) {
+  ClientHello chlo;
+  chlo.extensions = getExtensions(cookie);
+  chlo.extensions.push_back(std::move(getExtensions(sni).front()));
+  Extension duplicate;
+  duplicate.extension_type = ExtensionType::cookie;
+  duplicate.extension_data = folly::IOBuf::create(0);
+  chlo.extensions.push_back(std::move(duplicate));
+  ClientHelloView view(std::move(chlo));
+
+  EXPECT_EQ(
+      StringPiece(view.getExtension<Cookie>()->cookie->coalesce()),
+      StringPiece("cookie"));
+  EXPECT_THROW(view.checkDuplicateExtensions(), FizzException);
+}
+
+TEST_F(ExtensionsTest, TestClientHelloViewBadlyFormedExtension) {
+  auto buf = getBuf(sni);
+  buf->reserve(0, 1);
+  buf->append(1);
+  ClientHello chlo;
+  Extension ext;
+  ext.extension_type = ExtensionType::server_name;
+  ext.extension_data = std::move(buf);
+  chlo.extensions.push_back(std::move(ext));
+  ClientHelloView view(std::move(chlo));
+  EXPECT_THROW(view.getExtension<ServerNameList>(), std::runtime_error);
+}
 } // namespace test
 } // namespace fizz
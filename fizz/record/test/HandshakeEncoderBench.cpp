@@ -0,0 +1,205 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <fizz/record/HandshakeEncoder.h>
+
+using namespace fizz;
+
+namespace {
+
+/**
+ * The parts of a server flight that are not already encoded, built once up
+ * front so that the benchmarks only measure serialization.
+ */
+struct Flight {
+  Random random;
+  Buf legacySessionId;
+  Buf keyShare;
+  Buf finished;
+  Buf ticket;
+  Buf ticketNonce;
+
+  Flight() {
+    random.fill(0x44);
+    legacySessionId = folly::IOBuf::copyBuffer(std::string(32, 's'));
+    keyShare = folly::IOBuf::copyBuffer(std::string(32, 'k'));
+    finished = folly::IOBuf::copyBuffer(std::string(32, 'f'));
+    ticket = folly::IOBuf::copyBuffer(std::string(128, 't'));
+    ticketNonce = folly::IOBuf::copyBuffer(std::string(8, 'n'));
+  }
+};
+
+ServerHello serverHello(const Flight& flight) {
+  ServerHello shlo;
+  shlo.random = flight.random;
+  shlo.legacy_session_id_echo = flight.legacySessionId->clone();
+  shlo.cipher_suite = CipherSuite::TLS_AES_128_GCM_SHA256;
+  return shlo;
+}
+
+ServerSupportedVersions supportedVersions() {
+  ServerSupportedVersions versions;
+  versions.selected_version = ProtocolVersion::tls_1_3;
+  return versions;
+}
+
+ServerKeyShare keyShare(const Flight& flight) {
+  ServerKeyShare share;
+  share.server_share.group = NamedGroup::x25519;
+  share.server_share.key_exchange = flight.keyShare->clone();
+  return share;
+}
+
+ProtocolNameList alpn() {
+  ProtocolNameList names;
+  ProtocolName name;
+  name.name = folly::IOBuf::copyBuffer("h2");
+  names.protocol_name_list.push_back(std::move(name));
+  return names;
+}
+
+SignatureAlgorithms sigSchemes() {
+  SignatureAlgorithms sigs;
+  sigs.supported_signature_algorithms = {
+      SignatureScheme::ecdsa_secp256r1_sha256,
+      SignatureScheme::rsa_pss_sha256,
+  };
+  return sigs;
+}
+
+Finished finished(const Flight& flight) {
+  Finished fin;
+  fin.verify_data = flight.finished->clone();
+  return fin;
+}
+
+NewSessionTicket newSessionTicket(const Flight& flight) {
+  NewSessionTicket nst;
+  nst.ticket_lifetime = 3600;
+  nst.ticket_age_add = 0x44444444;
+  nst.ticket_nonce = flight.ticketNonce->clone();
+  nst.ticket = flight.ticket->clone();
+  return nst;
+}
+
+TicketEarlyData earlyData() {
+  TicketEarlyData early;
+  early.max_early_data_size = 0xffffffff;
+  return early;
+}
+} // namespace
+
+BENCHMARK(encodeHandshakeServerHello, n) {
+  Flight flight;
+  Buf encoded;
+  for (size_t i = 0; i < n; ++i) {
+    auto shlo = serverHello(flight);
+    shlo.extensions.push_back(encodeExtension(supportedVersions()));
+    shlo.extensions.push_back(encodeExtension(keyShare(flight)));
+    encoded = encodeHandshake(std::move(shlo));
+  }
+  folly::doNotOptimizeAway(encoded);
+}
+
+BENCHMARK_RELATIVE(handshakeEncoderServerHello, n) {
+  Flight flight;
+  folly::IOBuf arena(folly::IOBuf::CREATE, 4096);
+  for (size_t i = 0; i < n; ++i) {
+    arena.clear();
+    HandshakeEncoder(arena).encode(
+        serverHello(flight), supportedVersions(), keyShare(flight));
+  }
+  folly::doNotOptimizeAway(arena);
+}
+
+BENCHMARK(encodeHandshakeFinished, n) {
+  Flight flight;
+  Buf encoded;
+  for (size_t i = 0; i < n; ++i) {
+    encoded = encodeHandshake(finished(flight));
+  }
+  folly::doNotOptimizeAway(encoded);
+}
+
+BENCHMARK_RELATIVE(handshakeEncoderFinished, n) {
+  Flight flight;
+  folly::IOBuf arena(folly::IOBuf::CREATE, 4096);
+  for (size_t i = 0; i < n; ++i) {
+    arena.clear();
+    HandshakeEncoder(arena).encode(finished(flight));
+  }
+  folly::doNotOptimizeAway(arena);
+}
+
+BENCHMARK(encodeHandshakeNewSessionTicket, n) {
+  Flight flight;
+  Buf encoded;
+  for (size_t i = 0; i < n; ++i) {
+    auto nst = newSessionTicket(flight);
+    nst.extensions.push_back(encodeExtension(earlyData()));
+    encoded = encodeHandshake(std::move(nst));
+  }
+  folly::doNotOptimizeAway(encoded);
+}
+
+BENCHMARK_RELATIVE(handshakeEncoderNewSessionTicket, n) {
+  Flight flight;
+  folly::IOBuf arena(folly::IOBuf::CREATE, 4096);
+  for (size_t i = 0; i < n; ++i) {
+    arena.clear();
+    HandshakeEncoder(arena).encode(newSessionTicket(flight), earlyData());
+  }
+  folly::doNotOptimizeAway(arena);
+}
+
+BENCHMARK_DRAW_LINE();
+
+// ServerHello, EncryptedExtensions, CertificateRequest and Finished, as sent
+// in a full handshake with client auth.
+BENCHMARK(encodeHandshakeServerFlight, n) {
+  Flight flight;
+  std::vector<Buf> encoded;
+  for (size_t i = 0; i < n; ++i) {
+    encoded.clear();
+    auto shlo = serverHello(flight);
+    shlo.extensions.push_back(encodeExtension(supportedVersions()));
+    shlo.extensions.push_back(encodeExtension(keyShare(flight)));
+    encoded.push_back(encodeHandshake(std::move(shlo)));
+
+    EncryptedExtensions ee;
+    ee.extensions.push_back(encodeExtension(alpn()));
+    encoded.push_back(encodeHandshake(std::move(ee)));
+
+    CertificateRequest cr;
+    cr.certificate_request_context = folly::IOBuf::create(0);
+    cr.extensions.push_back(encodeExtension(sigSchemes()));
+    encoded.push_back(encodeHandshake(std::move(cr)));
+
+    encoded.push_back(encodeHandshake(finished(flight)));
+  }
+  folly::doNotOptimizeAway(encoded);
+}
+
+BENCHMARK_RELATIVE(handshakeEncoderServerFlight, n) {
+  Flight flight;
+  folly::IOBuf arena(folly::IOBuf::CREATE, 4096);
+  for (size_t i = 0; i < n; ++i) {
+    arena.clear();
+    HandshakeEncoder encoder(arena);
+    encoder.encode(serverHello(flight), supportedVersions(), keyShare(flight));
+    encoder.encode(EncryptedExtensions(), alpn());
+    CertificateRequest cr;
+    encoder.encode(cr, sigSchemes());
+    encoder.encode(finished(flight));
+  }
+  folly::doNotOptimizeAway(arena);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
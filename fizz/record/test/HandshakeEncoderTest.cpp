@@ -0,0 +1,234 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+
+#include <fizz/record/HandshakeEncoder.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+class HandshakeEncoderTest : public testing::Test {
+ protected:
+  static ServerHello serverHello() {
+    ServerHello shlo;
+    shlo.random.fill(0x44);
+    shlo.legacy_session_id_echo = IOBuf::copyBuffer("session");
+    shlo.cipher_suite = CipherSuite::TLS_AES_128_GCM_SHA256;
+    ServerSupportedVersions versions;
+    versions.selected_version = ProtocolVersion::tls_1_3;
+    shlo.extensions.push_back(encodeExtension(versions));
+    return shlo;
+  }
+
+  static ServerKeyShare keyShare() {
+    ServerKeyShare share;
+    share.server_share.group = NamedGroup::x25519;
+    share.server_share.key_exchange = IOBuf::copyBuffer("keyshare");
+    return share;
+  }
+
+  static ProtocolNameList alpn() {
+    ProtocolNameList names;
+    ProtocolName name;
+    name.name = IOBuf::copyBuffer("h2");
+    names.protocol_name_list.push_back(std::move(name));
+    return names;
+  }
+
+  static NewSessionTicket newSessionTicket() {
+    NewSessionTicket nst;
+    nst.ticket_lifetime = 100;
+    nst.ticket_age_add = 0x44444444;
+    nst.ticket_nonce = IOBuf::copyBuffer("nonce");
+    nst.ticket = IOBuf::copyBuffer("ticket");
+    return nst;
+  }
+
+  IOBuf arena_{IOBuf::CREATE, 4096};
+};
+
+TEST_F(HandshakeEncoderTest, TestServerHello) {
+  auto size = HandshakeEncoder(arena_).encode(serverHello());
+  auto expected = encodeHandshake(serverHello());
+  EXPECT_EQ(size, expected->computeChainDataLength());
+  EXPECT_TRUE(IOBufEqualTo()(arena_, *expected));
+}
+
+TEST_F(HandshakeEncoderTest, TestServerHelloTypedExtensions) {
+  ServerPresharedKey psk;
+  psk.selected_identity = 0;
+  HandshakeEncoder(arena_).encode(serverHello(), keyShare(), psk);
+
+  auto shlo = serverHello();
+  shlo.extensions.push_back(encodeExtension(keyShare()));
+  shlo.extensions.push_back(encodeExtension(psk));
+  EXPECT_TRUE(IOBufEqualTo()(arena_, *encodeHandshake(std::move(shlo))));
+}
+
+TEST_F(HandshakeEncoderTest, TestServerHelloNoSessionId) {
+  auto shlo = serverHello();
+  shlo.legacy_session_id_echo = nullptr;
+  HandshakeEncoder(arena_).encode(shlo);
+  EXPECT_TRUE(IOBufEqualTo()(arena_, *encodeHandshake(std::move(shlo))));
+}
+
+TEST_F(HandshakeEncoderTest, TestEncryptedExtensions) {
+  EncryptedExtensions ee;
+  HandshakeEncoder(arena_).encode(ee, alpn(), ServerEarlyData());
+
+  ee.extensions.push_back(encodeExtension(alpn()));
+  ee.extensions.push_back(encodeExtension(ServerEarlyData()));
+  EXPECT_TRUE(IOBufEqualTo()(arena_, *encodeHandshake(std::move(ee))));
+}
+
+TEST_F(HandshakeEncoderTest, TestEncryptedExtensionsEmpty) {
+  auto size = HandshakeEncoder(arena_).encode(EncryptedExtensions());
+  EXPECT_EQ(size, 6);
+  EXPECT_TRUE(
+      IOBufEqualTo()(arena_, *encodeHandshake(EncryptedExtensions())));
+}
+
+TEST_F(HandshakeEncoderTest, TestCertificateRequest) {
+  CertificateRequest cr;
+  cr.certificate_request_context = IOBuf::copyBuffer("context");
+  SignatureAlgorithms sigs;
+  sigs.supported_signature_algorithms = {
+      SignatureScheme::ecdsa_secp256r1_sha256, SignatureScheme::rsa_pss_sha256};
+  HandshakeEncoder(arena_).encode(cr, sigs);
+
+  cr.extensions.push_back(encodeExtension(sigs));
+  EXPECT_TRUE(IOBufEqualTo()(arena_, *encodeHandshake(std::move(cr))));
+}
+
+TEST_F(HandshakeEncoderTest, TestFinished) {
+  Finished fin;
+  fin.verify_data = IOBuf::copyBuffer("verify");
+  fin.verify_data->prependChain(IOBuf::copyBuffer("data"));
+  auto size = HandshakeEncoder(arena_).encode(fin);
+  EXPECT_EQ(size, 14);
+  EXPECT_TRUE(IOBufEqualTo()(arena_, *encodeHandshake(std::move(fin))));
+}
+
+TEST_F(HandshakeEncoderTest, TestNewSessionTicket) {
+  TicketEarlyData early;
+  early.max_early_data_size = 1000;
+  HandshakeEncoder(arena_).encode(newSessionTicket(), early);
+
+  auto nst = newSessionTicket();
+  nst.extensions.push_back(encodeExtension(early));
+  EXPECT_TRUE(IOBufEqualTo()(arena_, *encodeHandshake(std::move(nst))));
+}
+
+TEST_F(HandshakeEncoderTest, TestFallbackExtensionWriter) {
+  EncryptedExtensions ee;
+  Cookie cookie;
+  cookie.cookie = IOBuf::copyBuffer("cookie");
+  HandshakeEncoder(arena_).encode(ee, cookie);
+
+  ee.extensions.push_back(encodeExtension(cookie));
+  EXPECT_TRUE(IOBufEqualTo()(arena_, *encodeHandshake(std::move(ee))));
+}
+
+TEST_F(HandshakeEncoderTest, TestOptionalAndVectorExtensions) {
+  Optional<ProtocolNameList> names = alpn();
+  Optional<ServerEarlyData> early;
+  Cookie cookie;
+  cookie.cookie = IOBuf::copyBuffer("cookie");
+  std::vector<Extension> others;
+  others.push_back(encodeExtension(cookie));
+  HandshakeEncoder(arena_).encode(EncryptedExtensions(), names, early, others);
+
+  EncryptedExtensions ee;
+  ee.extensions.push_back(encodeExtension(alpn()));
+  ee.extensions.push_back(encodeExtension(cookie));
+  EXPECT_TRUE(IOBufEqualTo()(arena_, *encodeHandshake(std::move(ee))));
+}
+
+TEST_F(HandshakeEncoderTest, TestMultipleMessages) {
+  auto data = arena_.data();
+  HandshakeEncoder encoder(arena_);
+  encoder.encode(serverHello(), keyShare());
+  encoder.encode(EncryptedExtensions(), alpn());
+  encoder.encode(newSessionTicket());
+
+  auto shlo = serverHello();
+  shlo.extensions.push_back(encodeExtension(keyShare()));
+  EncryptedExtensions ee;
+  ee.extensions.push_back(encodeExtension(alpn()));
+  auto expected = encodeHandshake(std::move(shlo));
+  expected->prependChain(encodeHandshake(std::move(ee)));
+  expected->prependChain(encodeHandshake(newSessionTicket()));
+  EXPECT_TRUE(IOBufEqualTo()(arena_, *expected));
+
+  // Everything fit in the arena, so nothing was allocated.
+  EXPECT_FALSE(arena_.isChained());
+  EXPECT_EQ(arena_.data(), data);
+}
+
+TEST_F(HandshakeEncoderTest, TestGrowArena) {
+  IOBuf arena(IOBuf::CREATE, 8);
+  NewSessionTicket nst = newSessionTicket();
+  nst.ticket = IOBuf::create(2000);
+  nst.ticket->append(2000);
+  memset(nst.ticket->writableData(), 'a', 2000);
+  HandshakeEncoder encoder(arena, 16);
+  encoder.encode(serverHello(), keyShare(), alpn());
+  encoder.encode(nst);
+
+  auto shlo = serverHello();
+  shlo.extensions.push_back(encodeExtension(keyShare()));
+  shlo.extensions.push_back(encodeExtension(alpn()));
+  auto expected = encodeHandshake(std::move(shlo));
+  expected->prependChain(encodeHandshake(std::move(nst)));
+  EXPECT_TRUE(arena.isChained());
+  EXPECT_TRUE(IOBufEqualTo()(arena, *expected));
+}
+
+TEST_F(HandshakeEncoderTest, TestCloneMessages) {
+  IOBuf arena(IOBuf::CREATE, 8);
+  NewSessionTicket nst = newSessionTicket();
+  nst.ticket = IOBuf::create(2000);
+  nst.ticket->append(2000);
+  memset(nst.ticket->writableData(), 'a', 2000);
+  HandshakeEncoder encoder(arena, 16);
+  auto shloStart = encoder.position();
+  auto shloSize = encoder.encode(serverHello(), keyShare());
+  auto nstStart = encoder.position();
+  auto nstSize = encoder.encode(nst);
+  EXPECT_EQ(shloStart, 0u);
+  EXPECT_EQ(nstStart, shloSize);
+  EXPECT_EQ(encoder.position(), shloSize + nstSize);
+
+  auto shlo = serverHello();
+  shlo.extensions.push_back(encodeExtension(keyShare()));
+  EXPECT_TRUE(IOBufEqualTo()(
+      *encoder.clone(shloStart, shloSize), *encodeHandshake(std::move(shlo))));
+  auto encodedNst = encoder.clone(nstStart, nstSize);
+  EXPECT_TRUE(encodedNst->isShared());
+  EXPECT_TRUE(IOBufEqualTo()(*encodedNst, *encodeHandshake(std::move(nst))));
+}
+
+TEST_F(HandshakeEncoderTest, TestNonEmptyChainedArena) {
+  auto arena = IOBuf::copyBuffer("prefix");
+  arena->prependChain(IOBuf::create(4));
+  HandshakeEncoder encoder(*arena, 16);
+  auto size = encoder.encode(serverHello(), keyShare());
+
+  auto shlo = serverHello();
+  shlo.extensions.push_back(encodeExtension(keyShare()));
+  auto expected = IOBuf::copyBuffer("prefix");
+  expected->prependChain(encodeHandshake(std::move(shlo)));
+  EXPECT_EQ(size, expected->computeChainDataLength() - 6);
+  EXPECT_TRUE(IOBufEqualTo()(*arena, *expected));
+}
+} // namespace test
+} // namespace fizz
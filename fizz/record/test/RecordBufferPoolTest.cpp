@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/portability/GTest.h>
+
+#include <fizz/record/RecordBufferPool.h>
+
+#include <thread>
+#include <vector>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+TEST(RecordBufferPoolTest, TestGet) {
+  auto buf = RecordBufferPool::get();
+  EXPECT_EQ(buf->length(), 0);
+  EXPECT_EQ(buf->tailroom(), RecordBufferPool::kBufferSize);
+  EXPECT_FALSE(buf->isChained());
+}
+
+TEST(RecordBufferPoolTest, TestSizeClasses) {
+  auto before = RecordBufferPool::getStats();
+  auto small = RecordBufferPool::get(RecordBufferPool::kMinSizeClassSize);
+  EXPECT_EQ(small->tailroom(), RecordBufferPool::kMinSizeClassSize);
+  auto medium = RecordBufferPool::get(RecordBufferPool::kMinSizeClassSize + 1);
+  EXPECT_EQ(medium->tailroom(), 2 * RecordBufferPool::kMinSizeClassSize);
+  auto large = RecordBufferPool::get(RecordBufferPool::kBufferSize - 1);
+  EXPECT_EQ(large->tailroom(), RecordBufferPool::kBufferSize);
+  auto after = RecordBufferPool::getStats();
+  EXPECT_EQ(
+      after.allocated + after.reused, before.allocated + before.reused + 3);
+  EXPECT_THROW(
+      RecordBufferPool::get(RecordBufferPool::kBufferSize + 1),
+      std::runtime_error);
+}
+
+TEST(RecordBufferPoolTest, TestSizeClassesCachedSeparately) {
+  auto small = RecordBufferPool::get(RecordBufferPool::kMinPooledSize);
+  auto data = small->data();
+  small.reset();
+  // A larger record doesn't take the cached small buffer.
+  auto large = RecordBufferPool::get(RecordBufferPool::kBufferSize);
+  EXPECT_NE(large->data(), data);
+  small = RecordBufferPool::get(RecordBufferPool::kMinPooledSize);
+  EXPECT_EQ(small->data(), data);
+}
+
+TEST(RecordBufferPoolTest, TestSmallRecordNotPooled) {
+  auto before = RecordBufferPool::getStats();
+  auto buf = RecordBufferPool::get(RecordBufferPool::kMinPooledSize - 1);
+  EXPECT_GE(buf->tailroom(), RecordBufferPool::kMinPooledSize - 1);
+  buf.reset();
+  auto after = RecordBufferPool::getStats();
+  EXPECT_EQ(after.allocated, before.allocated);
+  EXPECT_EQ(after.reused, before.reused);
+  EXPECT_EQ(after.cached, before.cached);
+}
+
+TEST(RecordBufferPoolTest, TestReuse) {
+  auto buf = RecordBufferPool::get();
+  auto data = buf->data();
+  auto before = RecordBufferPool::getStats();
+  buf.reset();
+  buf = RecordBufferPool::get();
+  auto after = RecordBufferPool::getStats();
+  EXPECT_EQ(buf->data(), data);
+  EXPECT_EQ(after.cached, before.cached + 1);
+  EXPECT_EQ(after.reused, before.reused + 1);
+  EXPECT_EQ(after.allocated, before.allocated);
+}
+
+TEST(RecordBufferPoolTest, TestSharedBufferReturnedOnce) {
+  auto buf = RecordBufferPool::get();
+  auto clone = buf->clone();
+  auto before = RecordBufferPool::getStats();
+  buf.reset();
+  EXPECT_EQ(RecordBufferPool::getStats().cached, before.cached);
+  clone.reset();
+  EXPECT_EQ(RecordBufferPool::getStats().cached, before.cached + 1);
+}
+
+TEST(RecordBufferPoolTest, TestCacheBounded) {
+  // Taking more buffers than the cache holds leaves it empty.
+  std::vector<std::unique_ptr<IOBuf>> bufs;
+  for (size_t i = 0; i <= RecordBufferPool::kMaxCachedBuffers; ++i) {
+    bufs.push_back(RecordBufferPool::get());
+  }
+  auto before = RecordBufferPool::getStats();
+  bufs.clear();
+  auto after = RecordBufferPool::getStats();
+  EXPECT_EQ(after.cached, before.cached + RecordBufferPool::kMaxCachedBuffers);
+  EXPECT_EQ(after.freed, before.freed + 1);
+}
+
+TEST(RecordBufferPoolTest, TestReleasedOnOtherThread) {
+  auto buf = RecordBufferPool::get();
+  auto before = RecordBufferPool::getStats();
+  std::thread([buf = std::move(buf)]() mutable { buf.reset(); }).join();
+  auto after = RecordBufferPool::getStats();
+  // Cached by the other thread, then freed when it exited.
+  EXPECT_EQ(after.cached, before.cached + 1);
+  EXPECT_EQ(after.freed, before.freed + 1);
+}
+} // namespace test
+} // namespace fizz
@@ -9,6 +9,7 @@
 #include <folly/portability/GMock.h>
 #include <folly/portability/GTest.h>
 
+#include <fizz/record/ClientHelloView.h>
 #include <fizz/record/RecordLayer.h>
 #include <fizz/record/test/Mocks.h>
 
@@ -90,6 +91,40 @@ TEST_F(RecordTest, TestHandshake) {
   expectSame(*finished.originalEncoding, "140000023232");
 }
 
+TEST_F(RecordTest, TestHandshakeClientHelloDeferExtensions) {
+  read_.setDeferClientHelloExtensions(true);
+  EXPECT_CALL(read_, read(_)).WillOnce(InvokeWithoutArgs([]() {
+    return TLSMessage{
+        ContentType::handshake,
+        getBuf("01000036"
+               "0303"
+               "00000000000000000000000000000000"
+               "00000000000000000000000000000000"
+               "00"
+               "00021301"
+               "0100"
+               "000b"
+               "002b0003020304"
+               "002a0000")};
+  }));
+  auto param = read_.readEvent(queue_);
+  auto& chlo = boost::get<ClientHello>(*param);
+  EXPECT_EQ(
+      chlo.cipher_suites,
+      std::vector<CipherSuite>({CipherSuite::TLS_AES_128_GCM_SHA256}));
+  EXPECT_TRUE(chlo.extensions.empty());
+  EXPECT_TRUE(eq_(chlo.deferredExtensions, getBuf("002b0003020304002a0000")));
+
+  ClientHelloView view(std::move(chlo));
+  const auto& versions = view.getExtension<SupportedVersions>();
+  ASSERT_TRUE(versions.hasValue());
+  EXPECT_EQ(
+      versions->versions,
+      std::vector<ProtocolVersion>({ProtocolVersion::tls_1_3}));
+  EXPECT_TRUE(view.getExtension<ClientEarlyData>().hasValue());
+  EXPECT_EQ(view.clientHelloWithExtensions().extensions.size(), 2);
+}
+
 TEST_F(RecordTest, TestHandshakeTooLong) {
   EXPECT_CALL(read_, read(_)).WillOnce(InvokeWithoutArgs([]() {
     return TLSMessage{ContentType::handshake, getBuf("14400000")};
@@ -154,6 +189,89 @@ TEST_F(RecordTest, TestHandshakeSpliced) {
   EXPECT_ANY_THROW(read_.readEvent(queue_));
 }
 
+TEST_F(RecordTest, TestReadAppDataBatched) {
+  read_.setBatchAppData(true);
+  EXPECT_CALL(read_, read(_))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::application_data,
+                          IOBuf::copyBuffer("hi")};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::application_data,
+                          IOBuf::copyBuffer("there")};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() { return none; }));
+  auto param = read_.readEvent(queue_);
+  auto& appData = boost::get<AppData>(*param);
+  EXPECT_TRUE(eq_(appData.data, IOBuf::copyBuffer("hithere")));
+}
+
+TEST_F(RecordTest, TestReadAppDataBatchedStopsAtHandshake) {
+  read_.setBatchAppData(true);
+  Sequence s;
+  EXPECT_CALL(read_, read(_))
+      .InSequence(s)
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::application_data,
+                          IOBuf::copyBuffer("hi")};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake, getBuf("1800000100")};
+      }));
+  auto param = read_.readEvent(queue_);
+  auto& appData = boost::get<AppData>(*param);
+  EXPECT_TRUE(eq_(appData.data, IOBuf::copyBuffer("hi")));
+  EXPECT_TRUE(read_.hasUnparsedHandshakeData());
+
+  // The key update is returned without reading another record.
+  param = read_.readEvent(queue_);
+  boost::get<KeyUpdate>(*param);
+  EXPECT_FALSE(read_.hasUnparsedHandshakeData());
+
+  EXPECT_CALL(read_, read(_)).InSequence(s).WillOnce(InvokeWithoutArgs([]() {
+    return TLSMessage{ContentType::application_data,
+                      IOBuf::copyBuffer("after")};
+  }));
+  EXPECT_CALL(read_, read(_)).InSequence(s).WillOnce(InvokeWithoutArgs([]() {
+    return none;
+  }));
+  param = read_.readEvent(queue_);
+  auto& after = boost::get<AppData>(*param);
+  EXPECT_TRUE(eq_(after.data, IOBuf::copyBuffer("after")));
+}
+
+TEST_F(RecordTest, TestReadAppDataBatchedStopsAtAlert) {
+  read_.setBatchAppData(true);
+  EXPECT_CALL(read_, read(_))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::application_data,
+                          IOBuf::copyBuffer("hi")};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::alert, getBuf("0100")};
+      }));
+  auto param = read_.readEvent(queue_);
+  boost::get<AppData>(*param);
+  param = read_.readEvent(queue_);
+  boost::get<CloseNotify>(*param);
+}
+
+TEST_F(RecordTest, TestReadAppDataBatchedError) {
+  read_.setBatchAppData(true);
+  EXPECT_CALL(read_, read(_))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::application_data,
+                          IOBuf::copyBuffer("hi")};
+      }))
+      .WillOnce(InvokeWithoutArgs(
+          []() -> folly::Optional<TLSMessage> {
+            throw std::runtime_error("bad record");
+          }));
+  auto param = read_.readEvent(queue_);
+  EXPECT_TRUE(eq_(boost::get<AppData>(*param).data, IOBuf::copyBuffer("hi")));
+  EXPECT_THROW(read_.readEvent(queue_), std::runtime_error);
+}
+
 TEST_F(RecordTest, TestWriteAppData) {
   EXPECT_CALL(write_, _write(_)).WillOnce(Invoke([&](TLSMessage& msg) {
     TLSContent content;
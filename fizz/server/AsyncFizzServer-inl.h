@@ -95,6 +95,7 @@ std::string AsyncFizzServerT<SM>::getApplicationProtocol() const noexcept {
 template <typename SM>
 void AsyncFizzServerT<SM>::close() {
   if (transport_->good()) {
+    flushCoalescedWrites();
     fizzServer_.appCloseImmediate();
   } else {
     DelayedDestruction::DestructorGuard dg(this);
@@ -193,12 +194,45 @@ void AsyncFizzServerT<SM>::transportDataAvailable() {
   fizzServer_.newTransportData();
 }
 
+template <typename SM>
+void AsyncFizzServerT<SM>::updateWriteRecordLayer() {
+  if (isKTLSOffloaded()) {
+    // A key update installed a new user space write record layer; move the
+    // kernel over to its key instead.
+    auto params =
+        KTLS::getWriteParams(getState(), AppTrafficSecrets::ServerAppTraffic);
+    if (params) {
+      rekeyKTLS(std::move(*params));
+      state_.writeRecordLayer() = std::make_unique<KTLSWriteRecordLayer>();
+    }
+    return;
+  }
+  configureWriteRecordLayer(state_.writeRecordLayer().get());
+}
+
+template <typename SM>
+bool AsyncFizzServerT<SM>::offloadWriteRecordLayer(int fd) {
+  if (fizzServer_.actionProcessing() ||
+      getState().state() != StateEnum::AcceptingData) {
+    return false;
+  }
+  auto params =
+      KTLS::getWriteParams(getState(), AppTrafficSecrets::ServerAppTraffic);
+  if (!params) {
+    return false;
+  }
+  KTLS::enableTx(fd, *params);
+  state_.writeRecordLayer() = std::make_unique<KTLSWriteRecordLayer>();
+  return true;
+}
+
 template <typename SM>
 void AsyncFizzServerT<SM>::deliverAllErrors(
     const folly::AsyncSocketException& ex,
     bool closeTransport) {
   deliverHandshakeError(ex);
   fizzServer_.moveToErrorState(ex);
+  failCoalescedWrites(ex);
   deliverError(ex, closeTransport);
 }
 
@@ -219,6 +253,10 @@ void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(DeliverAppData& data) {
 template <typename SM>
 void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(WriteToSocket& data) {
   DCHECK(!data.contents.empty());
+  if (server_.isKTLSOffloaded()) {
+    server_.writeToKTLSSocket(data);
+    return;
+  }
   Buf allData = std::move(data.contents.front().data);
   for (size_t i = 1; i < data.contents.size(); ++i) {
     allData->prependChain(std::move(data.contents[i].data));
@@ -262,6 +300,7 @@ void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(
     server_.handshakeCallback_ = nullptr;
     callback->fizzHandshakeSuccess(&server_);
   }
+  server_.startKTLSOffload();
 }
 
 template <typename SM>
@@ -285,6 +324,7 @@ void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(WaitForData&) {
 template <typename SM>
 void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(MutateState& mutator) {
   mutator(server_.state_);
+  server_.updateWriteRecordLayer();
 }
 
 template <typename SM>
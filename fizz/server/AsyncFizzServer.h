@@ -95,6 +95,10 @@ class AsyncFizzServerT : public AsyncFizzBase {
 
   void transportDataAvailable() override;
 
+  void updateWriteRecordLayer() override;
+
+  bool offloadWriteRecordLayer(int fd) override;
+
  private:
   void deliverAllErrors(
       const folly::AsyncSocketException& ex,
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/AsyncSigningSelfCert.h>
+
+#include <folly/executors/CPUThreadPoolExecutor.h>
+
+namespace fizz {
+
+AsyncSigningSelfCert::AsyncSigningSelfCert(
+    std::shared_ptr<SelfCert> cert,
+    std::shared_ptr<folly::Executor> executor,
+    Options options)
+    : state_(std::make_shared<State>()),
+      executor_(std::move(executor)),
+      options_(options) {
+  state_->cert = std::move(cert);
+}
+
+AsyncSigningSelfCert::AsyncSigningSelfCert(
+    std::shared_ptr<SelfCert> cert,
+    size_t numThreads,
+    Options options)
+    : AsyncSigningSelfCert(
+          std::move(cert),
+          std::make_shared<folly::CPUThreadPoolExecutor>(numThreads),
+          options) {}
+
+folly::Future<folly::Optional<Buf>> AsyncSigningSelfCert::signFuture(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned) const {
+  auto start = std::chrono::steady_clock::now();
+  auto state = state_;
+
+  auto rejected = [&]() -> folly::Future<folly::Optional<Buf>> {
+    {
+      std::lock_guard<std::mutex> lock(state->statsMutex);
+      state->stats[scheme].rejected++;
+    }
+    if (options_.rejectionPolicy == RejectionPolicy::Fail) {
+      return folly::makeFuture<folly::Optional<Buf>>(
+          std::runtime_error("signing queue full"));
+    }
+    return folly::makeFutureWith([&]() -> folly::Optional<Buf> {
+      return state->cert->sign(scheme, context, toBeSigned);
+    });
+  };
+
+  if (state->queueDepth.fetch_add(1) >= options_.maxQueueDepth) {
+    state->queueDepth--;
+    return rejected();
+  }
+
+  folly::Promise<folly::Optional<Buf>> promise;
+  auto future = promise.getFuture();
+  try {
+    executor_->add([state,
+                    scheme,
+                    context,
+                    start,
+                    toBeSigned = folly::IOBuf::copyBuffer(toBeSigned),
+                    promise = std::move(promise)]() mutable {
+      auto signature = folly::makeTryWith([&]() -> folly::Optional<Buf> {
+        return state->cert->sign(scheme, context, toBeSigned->coalesce());
+      });
+      state->queueDepth--;
+      state->record(scheme, signature.hasException(), start);
+      promise.setTry(std::move(signature));
+    });
+  } catch (const std::exception&) {
+    // The executor's own queue is full or it is shutting down.
+    state->queueDepth--;
+    return rejected();
+  }
+  return future;
+}
+
+std::map<SignatureScheme, AsyncSigningSelfCert::SchemeStats>
+AsyncSigningSelfCert::getStats() const {
+  std::lock_guard<std::mutex> lock(state_->statsMutex);
+  return state_->stats;
+}
+
+void AsyncSigningSelfCert::State::record(
+    SignatureScheme scheme,
+    bool failed,
+    std::chrono::steady_clock::time_point start) {
+  auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  std::lock_guard<std::mutex> lock(statsMutex);
+  auto& schemeStats = stats[scheme];
+  if (failed) {
+    schemeStats.failures++;
+  } else {
+    schemeStats.signatures++;
+  }
+  schemeStats.totalLatency += latency;
+  schemeStats.maxLatency = std::max(schemeStats.maxLatency, latency);
+}
+} // namespace fizz
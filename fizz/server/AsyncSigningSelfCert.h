@@ -0,0 +1,146 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/AsyncSelfCert.h>
+#include <folly/Executor.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace fizz {
+
+/**
+ * AsyncSelfCert that runs the signatures of any SelfCert on an executor, so
+ * that expensive signatures (RSA in particular) don't stall the EventBase the
+ * handshake is running on.
+ *
+ * The number of signatures queued or running at once is bounded. Once the
+ * bound is reached, further signatures are either signed inline or failed,
+ * depending on the rejection policy.
+ *
+ * Everything else, including the synchronous sign(), is forwarded to the
+ * wrapped cert.
+ */
+class AsyncSigningSelfCert : public AsyncSelfCert {
+ public:
+  enum class RejectionPolicy {
+    // Sign on the calling thread, as if the cert wasn't wrapped.
+    SignInline,
+    // Fail the signature, which aborts the handshake.
+    Fail,
+  };
+
+  struct Options {
+    // Signatures queued or running on the executor at once.
+    size_t maxQueueDepth{1024};
+    RejectionPolicy rejectionPolicy{RejectionPolicy::SignInline};
+  };
+
+  /**
+   * Per signature scheme counters. Latency is measured from signFuture() to
+   * the signature being ready, queueing included.
+   */
+  struct SchemeStats {
+    uint64_t signatures{0};
+    uint64_t failures{0};
+    uint64_t rejected{0};
+    std::chrono::microseconds totalLatency{0};
+    std::chrono::microseconds maxLatency{0};
+  };
+
+  AsyncSigningSelfCert(
+      std::shared_ptr<SelfCert> cert,
+      std::shared_ptr<folly::Executor> executor,
+      Options options);
+
+  /**
+   * Signs on a new CPUThreadPoolExecutor with numThreads threads.
+   */
+  AsyncSigningSelfCert(
+      std::shared_ptr<SelfCert> cert,
+      size_t numThreads,
+      Options options);
+
+  std::string getIdentity() const override {
+    return state_->cert->getIdentity();
+  }
+
+  std::vector<std::string> getAltIdentities() const override {
+    return state_->cert->getAltIdentities();
+  }
+
+  std::vector<SignatureScheme> getSigSchemes() const override {
+    return state_->cert->getSigSchemes();
+  }
+
+  CertificateMsg getCertMessage(
+      Buf certificateRequestContext = nullptr) const override {
+    return state_->cert->getCertMessage(std::move(certificateRequestContext));
+  }
+
+  Buf getEncodedCertMessage() const override {
+    return state_->cert->getEncodedCertMessage();
+  }
+
+  CompressedCertificate getCompressedCert(
+      CertificateCompressionAlgorithm algo) const override {
+    return state_->cert->getCompressedCert(algo);
+  }
+
+  folly::ssl::X509UniquePtr getX509() const override {
+    return state_->cert->getX509();
+  }
+
+  Buf sign(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override {
+    return state_->cert->sign(scheme, context, toBeSigned);
+  }
+
+  /**
+   * Signs on the executor. toBeSigned is copied, so it only needs to be valid
+   * for the duration of the call.
+   */
+  folly::Future<folly::Optional<Buf>> signFuture(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override;
+
+  /**
+   * Returns the number of signatures queued or running on the executor.
+   */
+  size_t getQueueDepth() const {
+    return state_->queueDepth.load();
+  }
+
+  std::map<SignatureScheme, SchemeStats> getStats() const;
+
+ private:
+  // Shared with queued signatures, which may outlive this object.
+  struct State {
+    std::shared_ptr<SelfCert> cert;
+    std::atomic<size_t> queueDepth{0};
+    std::mutex statsMutex;
+    std::map<SignatureScheme, SchemeStats> stats;
+
+    void record(
+        SignatureScheme scheme,
+        bool failed,
+        std::chrono::steady_clock::time_point start);
+  };
+
+  std::shared_ptr<State> state_;
+  std::shared_ptr<folly::Executor> executor_;
+  Options options_;
+};
+} // namespace fizz
@@ -17,6 +17,7 @@
 #include <fizz/server/Negotiator.h>
 #include <fizz/server/ReplayCache.h>
 #include <fizz/server/TicketCipher.h>
+#include <folly/Executor.h>
 
 namespace fizz {
 namespace server {
@@ -296,6 +297,41 @@ class FizzServerContext {
     return omitEarlyRecordLayer_;
   }
 
+  /**
+   * Encrypt and decrypt application data on executor instead of the
+   * connection's executor once a write or a received record is at least
+   * threshold bytes. Only one record operation is outstanding per connection
+   * at a time, so sequence numbers and write ordering are unchanged, and the
+   * results are handed back to the connection's executor.
+   * Default is no executor, which keeps all record processing inline.
+   */
+  void setCryptoOffload(
+      std::shared_ptr<folly::Executor> executor,
+      size_t threshold) {
+    cryptoOffloadExecutor_ = std::move(executor);
+    cryptoOffloadThreshold_ = threshold;
+  }
+  folly::Executor* getCryptoOffloadExecutor() const {
+    return cryptoOffloadExecutor_.get();
+  }
+  size_t getCryptoOffloadThreshold() const {
+    return cryptoOffloadThreshold_;
+  }
+
+  /**
+   * Whether to batch the shared secret computations of handshakes that run on
+   * the same EventBase, see SharedSecretBatcher. Each handshake then waits
+   * until the end of the loop iteration for its shared secret. Only takes
+   * effect for connections whose executor is an EventBase.
+   * Default is false.
+   */
+  void setBatchSharedSecrets(bool enabled) {
+    batchSharedSecrets_ = enabled;
+  }
+  bool getBatchSharedSecrets() const {
+    return batchSharedSecrets_;
+  }
+
   void setClock(std::shared_ptr<Clock> clock) {
     clock_ = clock;
   }
@@ -348,6 +384,11 @@ class FizzServerContext {
   bool sendNewSessionTicket_{true};
 
   bool omitEarlyRecordLayer_{false};
+
+  std::shared_ptr<folly::Executor> cryptoOffloadExecutor_;
+  size_t cryptoOffloadThreshold_{0};
+
+  bool batchSharedSecrets_{false};
 };
 } // namespace server
 } // namespace fizz
@@ -11,13 +11,17 @@
 #include <fizz/crypto/Utils.h>
 #include <fizz/protocol/CertificateVerifier.h>
 #include <fizz/protocol/Protocol.h>
+#include <fizz/protocol/SharedSecretBatcher.h>
 #include <fizz/protocol/StateMachine.h>
+#include <fizz/record/ClientHelloView.h>
 #include <fizz/record/Extensions.h>
+#include <fizz/record/HandshakeEncoder.h>
 #include <fizz/record/PlaintextRecordLayer.h>
 #include <fizz/server/AsyncSelfCert.h>
 #include <fizz/server/Negotiator.h>
 #include <fizz/server/ReplayCache.h>
 #include <folly/Overload.h>
+#include <folly/io/Cursor.h>
 #include <algorithm>
 
 using folly::Future;
@@ -142,6 +146,123 @@ AsyncActions ServerStateMachine::processAccept(
   return detail::processEvent(state, std::move(accept));
 }
 
+static constexpr size_t kRecordHeaderSize =
+    sizeof(ContentType) + sizeof(ProtocolVersion) + sizeof(uint16_t);
+
+/**
+ * Splits the next record off buf if it is complete and its payload is at least
+ * threshold bytes. Returns nullptr otherwise.
+ */
+static Buf splitLargeRecord(folly::IOBufQueue& buf, size_t threshold) {
+  if (buf.empty()) {
+    return nullptr;
+  }
+  folly::io::Cursor cursor(buf.front());
+  if (!cursor.canAdvance(kRecordHeaderSize)) {
+    return nullptr;
+  }
+  cursor.skip(sizeof(ContentType) + sizeof(ProtocolVersion));
+  auto length = cursor.readBE<uint16_t>();
+  if (length < threshold || !cursor.canAdvance(length)) {
+    return nullptr;
+  }
+  return buf.split(kRecordHeaderSize + length);
+}
+
+static Future<Actions> toFuture(AsyncActions asyncActions) {
+  return folly::variant_match(
+      asyncActions,
+      [](Future<Actions>& futureActions) { return std::move(futureActions); },
+      [](Actions& immediateActions) {
+        return folly::makeFuture(std::move(immediateActions));
+      });
+}
+
+/**
+ * Handles an error reading socket data, whether the record was read inline or
+ * on the offload executor. Errors that carry an alert send it; anything else
+ * means the record couldn't be decoded.
+ */
+static Actions handleSocketDataError(
+    const State& state,
+    folly::exception_wrapper ew) {
+  folly::Optional<AlertDescription> alert = AlertDescription::decode_error;
+  auto ex = ew.get_exception<FizzException>();
+  if (ex) {
+    alert = ex->getAlert();
+  }
+  return detail::handleError(state, ReportError(std::move(ew)), alert);
+}
+
+static AsyncActions processSocketDataInline(
+    const State& state,
+    folly::IOBufQueue& buf) {
+  auto param = state.readRecordLayer()->readEvent(buf);
+  if (!param.hasValue()) {
+    return actions(WaitForData());
+  }
+  return detail::processEvent(state, std::move(*param));
+}
+
+/**
+ * Decrypts record on the offload executor and processes the resulting event
+ * back on the connection's executor. No other event is processed until the
+ * returned actions complete, so the record layer is never used concurrently.
+ * If the offload executor refuses the record, it is processed inline instead.
+ */
+static AsyncActions offloadSocketData(
+    const State& state,
+    folly::Executor* executor,
+    folly::IOBufQueue& buf,
+    Buf record) {
+  using ReadResult = std::pair<Optional<Param>, Buf>;
+  // Kept here as well, so that the record can be recovered if the executor
+  // throws away the task.
+  auto pendingRecord = std::make_shared<Buf>(std::move(record));
+  folly::Promise<ReadResult> promise;
+  auto future = promise.getFuture();
+  try {
+    executor->add([readRecordLayer = state.readRecordLayer(),
+                   pendingRecord,
+                   promise = std::move(promise)]() mutable {
+      promise.setWith([&]() {
+        folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+        queue.append(std::move(*pendingRecord));
+        auto param = readRecordLayer->readEvent(queue);
+        return ReadResult(std::move(param), queue.move());
+      });
+    });
+  } catch (const std::exception& e) {
+    VLOG(8) << "Crypto offload executor rejected record: " << e.what();
+    auto rest = buf.move();
+    buf.append(std::move(*pendingRecord));
+    buf.append(std::move(rest));
+    return processSocketDataInline(state, buf);
+  }
+
+  return std::move(future)
+      .via(state.executor())
+      .thenValue([&state, &buf](ReadResult result) {
+        // The record layer may have returned a message it had buffered
+        // instead, in which case the record goes back in front of any data
+        // that arrived in the meantime.
+        if (result.second) {
+          auto rest = buf.move();
+          buf.append(std::move(result.second));
+          buf.append(std::move(rest));
+        }
+        if (!result.first) {
+          // Not WaitForData: data may have arrived during the offload, and
+          // whatever is complete in buf should be processed right away.
+          return folly::makeFuture(Actions());
+        }
+        return toFuture(detail::processEvent(state, std::move(*result.first)));
+      })
+      .thenError([&state](folly::exception_wrapper ew) {
+        return handleSocketDataError(state, std::move(ew));
+      });
+}
+
 AsyncActions ServerStateMachine::processSocketData(
     const State& state,
     folly::IOBufQueue& buf) {
@@ -152,16 +273,22 @@ AsyncActions ServerStateMachine::processSocketData(
           ReportError("attempting to process data without record layer"),
           folly::none);
     }
-    auto param = state.readRecordLayer()->readEvent(buf);
-    if (!param.hasValue()) {
-      return actions(WaitForData());
+    if (state.state() == StateEnum::AcceptingData &&
+        state.context()->getCryptoOffloadExecutor()) {
+      auto record = splitLargeRecord(
+          buf, state.context()->getCryptoOffloadThreshold());
+      if (record) {
+        return offloadSocketData(
+            state,
+            state.context()->getCryptoOffloadExecutor(),
+            buf,
+            std::move(record));
+      }
     }
-    return detail::processEvent(state, std::move(*param));
+    return processSocketDataInline(state, buf);
   } catch (const std::exception& e) {
-    return detail::handleError(
-        state,
-        ReportError(folly::exception_wrapper(std::current_exception(), e)),
-        AlertDescription::decode_error);
+    return handleSocketDataError(
+        state, folly::exception_wrapper(std::current_exception(), e));
   }
 }
 
@@ -341,6 +468,7 @@ EventHandler<ServerTypes, StateEnum::Uninitialized, Event::Accept>::handle(
   auto& accept = boost::get<Accept>(param);
   auto factory = accept.context->getFactory();
   auto readRecordLayer = factory->makePlaintextReadRecordLayer();
+  readRecordLayer->setDeferClientHelloExtensions(true);
   auto writeRecordLayer = factory->makePlaintextWriteRecordLayer();
   auto handshakeLogging = std::make_unique<HandshakeLogging>();
   return actions(
@@ -360,39 +488,49 @@ EventHandler<ServerTypes, StateEnum::Uninitialized, Event::Accept>::handle(
       &Transition<StateEnum::ExpectingClientHello>);
 }
 
-static void addHandshakeLogging(const State& state, const ClientHello& chlo) {
+static Optional<std::string> getSni(const ClientHelloView& chlo) {
+  const auto& serverNameList = chlo.getExtension<ServerNameList>();
+  if (!serverNameList || serverNameList->server_name_list.empty()) {
+    return folly::none;
+  }
+  // The decoded extension is shared, so leave its buffer alone.
+  return serverNameList->server_name_list.front()
+      .hostname->clone()
+      ->moveToFbString()
+      .toStdString();
+}
+
+static void addHandshakeLogging(
+    const State& state,
+    const ClientHelloView& chlo) {
   if (state.handshakeLogging()) {
-    state.handshakeLogging()->clientLegacyVersion = chlo.legacy_version;
-    auto supportedVersions = getExtension<SupportedVersions>(chlo.extensions);
+    state.handshakeLogging()->clientLegacyVersion =
+        chlo.clientHello().legacy_version;
+    const auto& supportedVersions = chlo.getExtension<SupportedVersions>();
     if (supportedVersions) {
       state.handshakeLogging()->clientSupportedVersions =
           supportedVersions->versions;
     }
-    state.handshakeLogging()->clientCiphers = chlo.cipher_suites;
+    state.handshakeLogging()->clientCiphers = chlo.clientHello().cipher_suites;
     state.handshakeLogging()->clientExtensions.clear();
-    for (const auto& extension : chlo.extensions) {
-      state.handshakeLogging()->clientExtensions.push_back(
-          extension.extension_type);
-    }
+    state.handshakeLogging()->clientExtensions = chlo.getExtensionTypes();
     auto plaintextReadRecord =
         dynamic_cast<PlaintextReadRecordLayer*>(state.readRecordLayer());
     if (plaintextReadRecord) {
       state.handshakeLogging()->clientRecordVersion =
           plaintextReadRecord->getReceivedRecordVersion();
     }
-    auto sni = getExtension<ServerNameList>(chlo.extensions);
-    if (sni && !sni->server_name_list.empty()) {
-      state.handshakeLogging()->clientSni = sni->server_name_list.front()
-                                                .hostname->moveToFbString()
-                                                .toStdString();
+    auto sni = getSni(chlo);
+    if (sni) {
+      state.handshakeLogging()->clientSni = std::move(*sni);
     }
-    auto supportedGroups = getExtension<SupportedGroups>(chlo.extensions);
+    const auto& supportedGroups = chlo.getExtension<SupportedGroups>();
     if (supportedGroups) {
       state.handshakeLogging()->clientSupportedGroups =
-          std::move(supportedGroups->named_group_list);
+          supportedGroups->named_group_list;
     }
 
-    auto keyShare = getExtension<ClientKeyShare>(chlo.extensions);
+    const auto& keyShare = chlo.getExtension<ClientKeyShare>();
     if (keyShare && !state.handshakeLogging()->clientKeyShares) {
       std::vector<NamedGroup> shares;
       for (const auto& entry : keyShare->client_shares) {
@@ -401,38 +539,39 @@ static void addHandshakeLogging(const State& state, const ClientHello& chlo) {
       state.handshakeLogging()->clientKeyShares = std::move(shares);
     }
 
-    auto exchangeModes = getExtension<PskKeyExchangeModes>(chlo.extensions);
+    const auto& exchangeModes = chlo.getExtension<PskKeyExchangeModes>();
     if (exchangeModes) {
-      state.handshakeLogging()->clientKeyExchangeModes =
-          std::move(exchangeModes->modes);
+      state.handshakeLogging()->clientKeyExchangeModes = exchangeModes->modes;
     }
 
-    auto clientSigSchemes = getExtension<SignatureAlgorithms>(chlo.extensions);
+    const auto& clientSigSchemes = chlo.getExtension<SignatureAlgorithms>();
     if (clientSigSchemes) {
       state.handshakeLogging()->clientSignatureAlgorithms =
-          std::move(clientSigSchemes->supported_signature_algorithms);
+          clientSigSchemes->supported_signature_algorithms;
     }
 
+    const auto& legacySessionId = chlo.clientHello().legacy_session_id;
     state.handshakeLogging()->clientSessionIdSent =
-        chlo.legacy_session_id && !chlo.legacy_session_id->empty();
-    state.handshakeLogging()->clientRandom = chlo.random;
+        legacySessionId && !legacySessionId->empty();
+    state.handshakeLogging()->clientRandom = chlo.clientHello().random;
   }
 }
 
-static void validateClientHello(const ClientHello& chlo) {
-  if (chlo.legacy_compression_methods.size() != 1 ||
-      chlo.legacy_compression_methods.front() != 0x00) {
+static void validateClientHello(const ClientHelloView& chlo) {
+  const auto& compressionMethods =
+      chlo.clientHello().legacy_compression_methods;
+  if (compressionMethods.size() != 1 || compressionMethods.front() != 0x00) {
     throw FizzException(
         "client compression methods not exactly NULL",
         AlertDescription::illegal_parameter);
   }
-  Protocol::checkDuplicateExtensions(chlo.extensions);
+  chlo.checkDuplicateExtensions();
 }
 
 static Optional<ProtocolVersion> negotiateVersion(
-    const ClientHello& chlo,
+    const ClientHelloView& chlo,
     const std::vector<ProtocolVersion>& versions) {
-  const auto& clientVersions = getExtension<SupportedVersions>(chlo.extensions);
+  const auto& clientVersions = chlo.getExtension<SupportedVersions>();
   if (!clientVersions) {
     return folly::none;
   }
@@ -444,11 +583,11 @@ static Optional<ProtocolVersion> negotiateVersion(
 }
 
 static Optional<CookieState> getCookieState(
-    const ClientHello& chlo,
+    const ClientHelloView& chlo,
     ProtocolVersion version,
     CipherSuite cipher,
     const CookieCipher* cookieCipher) {
-  auto cookieExt = getExtension<Cookie>(chlo.extensions);
+  const auto& cookieExt = chlo.getExtension<Cookie>();
   if (!cookieExt) {
     return folly::none;
   }
@@ -460,7 +599,7 @@ static Optional<CookieState> getCookieState(
         "no cookie cipher", AlertDescription::unsupported_extension);
   }
 
-  auto cookieState = cookieCipher->decrypt(std::move(cookieExt->cookie));
+  auto cookieState = cookieCipher->decrypt(cookieExt->cookie->clone());
 
   if (!cookieState) {
     throw FizzException(
@@ -497,11 +636,11 @@ struct ResumptionStateResult {
 } // namespace
 
 static ResumptionStateResult getResumptionState(
-    const ClientHello& chlo,
+    const ClientHelloView& chlo,
     const TicketCipher* ticketCipher,
     const std::vector<PskKeyExchangeMode>& supportedModes) {
-  auto psks = getExtension<ClientPresharedKey>(chlo.extensions);
-  auto clientModes = getExtension<PskKeyExchangeModes>(chlo.extensions);
+  const auto& psks = chlo.getExtension<ClientPresharedKey>();
+  const auto& clientModes = chlo.getExtension<PskKeyExchangeModes>();
   if (psks && !clientModes) {
     throw FizzException("no psk modes", AlertDescription::missing_extension);
   }
@@ -534,15 +673,15 @@ static ResumptionStateResult getResumptionState(
 }
 
 Future<ReplayCacheResult> getReplayCacheResult(
-    const ClientHello& chlo,
+    const ClientHelloView& chlo,
     bool zeroRttEnabled,
     ReplayCache* replayCache) {
   if (!zeroRttEnabled || !replayCache ||
-      !getExtension<ClientEarlyData>(chlo.extensions)) {
+      !chlo.getExtension<ClientEarlyData>()) {
     return ReplayCacheResult::NotChecked;
   }
 
-  return replayCache->check(folly::range(chlo.random));
+  return replayCache->check(folly::range(chlo.clientHello().random));
 }
 
 static bool validateResumptionState(
@@ -588,7 +727,7 @@ static std::
     setupSchedulerAndContext(
         const Factory& factory,
         CipherSuite cipher,
-        const ClientHello& chlo,
+        const ClientHelloView& chlo,
         const Optional<ResumptionState>& resState,
         const Optional<CookieState>& cookieState,
         PskType pskType,
@@ -608,12 +747,12 @@ static std::
     chloHash.hash = cookieState->chloHash->clone();
     handshakeContext->appendToTranscript(encodeHandshake(std::move(chloHash)));
 
-    auto cookie = getExtension<Cookie>(chlo.extensions);
+    const auto& cookie = chlo.getExtension<Cookie>();
     handshakeContext->appendToTranscript(getStatelessHelloRetryRequest(
         cookieState->version,
         cookieState->cipher,
         cookieState->group,
-        std::move(cookie->cookie)));
+        cookie->cookie->clone()));
   } else if (!handshakeContext) {
     handshakeContext = factory.makeHandshakeContext(cipher);
   }
@@ -630,12 +769,12 @@ static std::
                          .secret;
 
     folly::IOBufQueue chloQueue(folly::IOBufQueue::cacheChainLength());
-    chloQueue.append((*chlo.originalEncoding)->clone());
-    auto chloPrefix =
-        chloQueue.split(chloQueue.chainLength() - getBinderLength(chlo));
+    chloQueue.append((*chlo.clientHello().originalEncoding)->clone());
+    auto chloPrefix = chloQueue.split(
+        chloQueue.chainLength() - chlo.getBinderLength());
     handshakeContext->appendToTranscript(chloPrefix);
 
-    const auto& psks = getExtension<ClientPresharedKey>(chlo.extensions);
+    const auto& psks = chlo.getExtension<ClientPresharedKey>();
     if (!psks || psks->binders.size() <= kPskIndex) {
       throw FizzException("no binders", AlertDescription::illegal_parameter);
     }
@@ -651,7 +790,7 @@ static std::
     handshakeContext->appendToTranscript(chloQueue.move());
     return std::make_pair(std::move(scheduler), std::move(handshakeContext));
   } else {
-    handshakeContext->appendToTranscript(*chlo.originalEncoding);
+    handshakeContext->appendToTranscript(*chlo.clientHello().originalEncoding);
     return std::make_pair(std::move(scheduler), std::move(handshakeContext));
   }
 }
@@ -671,9 +810,9 @@ static void validateGroups(const std::vector<KeyShareEntry>& client_shares) {
 
 static std::tuple<NamedGroup, Optional<Buf>> negotiateGroup(
     ProtocolVersion version,
-    const ClientHello& chlo,
+    const ClientHelloView& chlo,
     const std::vector<NamedGroup>& supportedGroups) {
-  auto groups = getExtension<SupportedGroups>(chlo.extensions);
+  const auto& groups = chlo.getExtension<SupportedGroups>();
   if (!groups) {
     throw FizzException("no named groups", AlertDescription::missing_extension);
   }
@@ -681,7 +820,7 @@ static std::tuple<NamedGroup, Optional<Buf>> negotiateGroup(
   if (!group) {
     throw FizzException("no group match", AlertDescription::handshake_failure);
   }
-  auto clientShares = getExtension<ClientKeyShare>(chlo.extensions);
+  const auto& clientShares = chlo.getExtension<ClientKeyShare>();
   if (!clientShares) {
     throw FizzException(
         "no client shares", AlertDescription::missing_extension);
@@ -696,16 +835,41 @@ static std::tuple<NamedGroup, Optional<Buf>> negotiateGroup(
   return std::make_tuple(*group, folly::none);
 }
 
-static Buf doKex(
+/**
+ * Returns our key share along with the shared secret. With a batcher the shared
+ * secret is computed when its batch runs, otherwise it is computed here.
+ */
+static std::pair<Buf, Future<Optional<Buf>>> doKex(
     const Factory& factory,
     NamedGroup group,
     const Buf& clientShare,
-    KeyScheduler& scheduler) {
+    SharedSecretBatcher* batcher) {
   auto kex = factory.makeKeyExchange(group);
   kex->generateKeyPair();
-  auto sharedSecret = kex->generateSharedSecret(clientShare->coalesce());
-  scheduler.deriveHandshakeSecret(sharedSecret->coalesce());
-  return kex->getKeyShare();
+  auto serverShare = kex->getKeyShare();
+  if (!batcher) {
+    Optional<Buf> sharedSecret =
+        kex->generateSharedSecret(clientShare->coalesce());
+    return std::make_pair(
+        std::move(serverShare), makeFuture(std::move(sharedSecret)));
+  }
+  auto sharedSecret =
+      batcher->generateSharedSecret(*kex, clientShare->coalesce());
+  // The key exchange has to outlive the batch.
+  return std::make_pair(
+      std::move(serverShare),
+      std::move(sharedSecret)
+          .thenValue([kex = std::move(kex)](Buf secret) -> Optional<Buf> {
+            return std::move(secret);
+          }));
+}
+
+static SharedSecretBatcher* getSharedSecretBatcher(const State& state) {
+  if (!state.context()->getBatchSharedSecrets()) {
+    return nullptr;
+  }
+  auto evb = dynamic_cast<folly::EventBase*>(state.executor());
+  return evb ? &SharedSecretBatcher::get(evb) : nullptr;
 }
 
 static Buf getHelloRetryRequest(
@@ -738,44 +902,47 @@ static Buf getServerHello(
     Optional<NamedGroup> group,
     Optional<Buf> serverShare,
     Buf legacySessionId,
-    HandshakeContext& handshakeContext) {
+    HandshakeContext& handshakeContext,
+    folly::IOBuf& arena) {
   ServerHello serverHello;
 
   serverHello.legacy_version = ProtocolVersion::tls_1_2;
   ServerSupportedVersions versionExt;
   versionExt.selected_version = version;
-  serverHello.extensions.push_back(encodeExtension(std::move(versionExt)));
   serverHello.legacy_session_id_echo = std::move(legacySessionId);
 
   serverHello.random = std::move(random);
   serverHello.cipher_suite = cipher;
+  Optional<ServerKeyShare> serverKeyShare;
   if (group) {
-    ServerKeyShare serverKeyShare;
-    serverKeyShare.server_share.group = *group;
-    serverKeyShare.server_share.key_exchange = std::move(*serverShare);
-
-    serverHello.extensions.push_back(
-        encodeExtension(std::move(serverKeyShare)));
+    serverKeyShare.emplace();
+    serverKeyShare->server_share.group = *group;
+    serverKeyShare->server_share.key_exchange = std::move(*serverShare);
   }
+  Optional<ServerPresharedKey> serverPsk;
   if (psk) {
-    ServerPresharedKey serverPsk;
-    serverPsk.selected_identity = kPskIndex;
-    serverHello.extensions.push_back(encodeExtension(std::move(serverPsk)));
-  }
-  auto encodedServerHello = encodeHandshake(std::move(serverHello));
+    serverPsk.emplace();
+    serverPsk->selected_identity = kPskIndex;
+  }
+  HandshakeEncoder encoder(arena);
+  auto start = encoder.position();
+  auto size =
+      encoder.encode(serverHello, versionExt, serverKeyShare, serverPsk);
+  auto encodedServerHello = encoder.clone(start, size);
   handshakeContext.appendToTranscript(encodedServerHello);
   return encodedServerHello;
 }
 
 static Optional<std::string> negotiateAlpn(
-    const ClientHello& chlo,
+    const ClientHelloView& chlo,
     folly::Optional<std::string> zeroRttAlpn,
     const FizzServerContext& context) {
-  auto ext = getExtension<ProtocolNameList>(chlo.extensions);
+  const auto& ext = chlo.getExtension<ProtocolNameList>();
   std::vector<std::string> clientProtocols;
   if (ext) {
-    for (auto& protocol : ext->protocol_name_list) {
-      clientProtocols.push_back(protocol.name->moveToFbString().toStdString());
+    for (const auto& protocol : ext->protocol_name_list) {
+      clientProtocols.push_back(
+          protocol.name->clone()->moveToFbString().toStdString());
     }
   } else {
     VLOG(6) << "Client did not send ALPN extension";
@@ -808,7 +975,7 @@ static Optional<std::chrono::milliseconds> getClockSkew(
 
 static EarlyDataType negotiateEarlyDataType(
     bool acceptEarlyData,
-    const ClientHello& chlo,
+    const ClientHelloView& chlo,
     const Optional<ResumptionState>& psk,
     CipherSuite cipher,
     Optional<KeyExchangeType> keyExchangeType,
@@ -818,7 +985,7 @@ static EarlyDataType negotiateEarlyDataType(
     Optional<std::chrono::milliseconds> clockSkew,
     ClockSkewTolerance clockSkewTolerance,
     const AppTokenValidator* appTokenValidator) {
-  if (!getExtension<ClientEarlyData>(chlo.extensions)) {
+  if (!chlo.getExtension<ClientEarlyData>()) {
     return EarlyDataType::NotAttempted;
   }
 
@@ -880,44 +1047,38 @@ static Buf getEncryptedExt(
     HandshakeContext& handshakeContext,
     const folly::Optional<std::string>& selectedAlpn,
     EarlyDataType earlyData,
-    std::vector<Extension> otherExtensions) {
-  EncryptedExtensions encryptedExt;
+    std::vector<Extension> otherExtensions,
+    folly::IOBuf& arena) {
+  Optional<ProtocolNameList> alpn;
   if (selectedAlpn) {
-    ProtocolNameList alpn;
+    alpn.emplace();
     ProtocolName protocol;
     protocol.name = folly::IOBuf::copyBuffer(*selectedAlpn);
-    alpn.protocol_name_list.push_back(std::move(protocol));
-    encryptedExt.extensions.push_back(encodeExtension(std::move(alpn)));
+    alpn->protocol_name_list.push_back(std::move(protocol));
   }
 
+  Optional<ServerEarlyData> serverEarlyData;
   if (earlyData == EarlyDataType::Accepted) {
-    encryptedExt.extensions.push_back(encodeExtension(ServerEarlyData()));
+    serverEarlyData.emplace();
   }
 
-  for (auto& ext : otherExtensions) {
-    encryptedExt.extensions.push_back(std::move(ext));
-  }
-  auto encodedEncryptedExt =
-      encodeHandshake<EncryptedExtensions>(std::move(encryptedExt));
+  HandshakeEncoder encoder(arena);
+  auto start = encoder.position();
+  auto size = encoder.encode(
+      EncryptedExtensions(), alpn, serverEarlyData, otherExtensions);
+  auto encodedEncryptedExt = encoder.clone(start, size);
   handshakeContext.appendToTranscript(encodedEncryptedExt);
   return encodedEncryptedExt;
 }
 
 static std::pair<std::shared_ptr<SelfCert>, SignatureScheme> chooseCert(
     const FizzServerContext& context,
-    const ClientHello& chlo) {
-  const auto& clientSigSchemes =
-      getExtension<SignatureAlgorithms>(chlo.extensions);
+    const ClientHelloView& chlo) {
+  const auto& clientSigSchemes = chlo.getExtension<SignatureAlgorithms>();
   if (!clientSigSchemes) {
     throw FizzException("no sig schemes", AlertDescription::missing_extension);
   }
-  Optional<std::string> sni;
-  auto serverNameList = getExtension<ServerNameList>(chlo.extensions);
-  if (serverNameList && !serverNameList->server_name_list.empty()) {
-    sni = serverNameList->server_name_list.front()
-              .hostname->moveToFbString()
-              .toStdString();
-  }
+  auto sni = getSni(chlo);
 
   auto certAndScheme =
       context.getCert(sni, clientSigSchemes->supported_signature_algorithms);
@@ -932,13 +1093,13 @@ static std::tuple<Buf, folly::Optional<CertificateCompressionAlgorithm>>
 getCertificate(
     const std::shared_ptr<const SelfCert>& serverCert,
     const FizzServerContext& context,
-    const ClientHello& chlo,
+    const ClientHelloView& chlo,
     HandshakeContext& handshakeContext) {
   // Check for compression support first, and if so, send compressed.
   Buf encodedCertificate;
   folly::Optional<CertificateCompressionAlgorithm> algo;
-  auto compAlgos =
-      getExtension<CertificateCompressionAlgorithms>(chlo.extensions);
+  const auto& compAlgos =
+      chlo.getExtension<CertificateCompressionAlgorithms>();
   if (compAlgos && !context.getSupportedCompressionAlgorithms().empty()) {
     algo = negotiate(
         context.getSupportedCompressionAlgorithms(), compAlgos->algorithms);
@@ -947,7 +1108,7 @@ getCertificate(
   if (algo) {
     encodedCertificate = encodeHandshake(serverCert->getCompressedCert(*algo));
   } else {
-    encodedCertificate = encodeHandshake(serverCert->getCertMessage());
+    encodedCertificate = serverCert->getEncodedCertMessage();
   }
   handshakeContext.appendToTranscript(encodedCertificate);
   return std::make_tuple(std::move(encodedCertificate), std::move(algo));
@@ -968,26 +1129,41 @@ static Buf getCertificateVerify(
 static Buf getCertificateRequest(
     const std::vector<SignatureScheme>& acceptableSigSchemes,
     const CertificateVerifier* const verifier,
-    HandshakeContext& handshakeContext) {
+    HandshakeContext& handshakeContext,
+    folly::IOBuf& arena) {
   CertificateRequest request;
   SignatureAlgorithms algos;
   algos.supported_signature_algorithms = acceptableSigSchemes;
-  request.extensions.push_back(encodeExtension(std::move(algos)));
+  std::vector<Extension> verifierExtensions;
   if (verifier) {
-    auto verifierExtensions = verifier->getCertificateRequestExtensions();
-    for (auto& ext : verifierExtensions) {
-      request.extensions.push_back(std::move(ext));
-    }
+    verifierExtensions = verifier->getCertificateRequestExtensions();
   }
-  auto encodedCertificateRequest = encodeHandshake(std::move(request));
+  HandshakeEncoder encoder(arena);
+  auto start = encoder.position();
+  auto size = encoder.encode(request, algos, verifierExtensions);
+  auto encodedCertificateRequest = encoder.clone(start, size);
   handshakeContext.appendToTranscript(encodedCertificateRequest);
   return encodedCertificateRequest;
 }
 
+static Buf getFinished(
+    folly::ByteRange handshakeWriteSecret,
+    HandshakeContext& handshakeContext,
+    folly::IOBuf& arena) {
+  Finished finished;
+  finished.verify_data = handshakeContext.getFinishedData(handshakeWriteSecret);
+  HandshakeEncoder encoder(arena);
+  auto start = encoder.position();
+  auto size = encoder.encode(finished);
+  auto encodedFinished = encoder.clone(start, size);
+  handshakeContext.appendToTranscript(encodedFinished);
+  return encodedFinished;
+}
+
 AsyncActions
 EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
     handle(const State& state, Param param) {
-  auto chlo = std::move(boost::get<ClientHello>(param));
+  ClientHelloView chlo(std::move(boost::get<ClientHello>(param)));
 
   addHandshakeLogging(state, chlo);
 
@@ -1007,7 +1183,7 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
   }
 
   if (!version) {
-    if (getExtension<ClientEarlyData>(chlo.extensions)) {
+    if (chlo.getExtension<ClientEarlyData>()) {
       throw FizzException(
           "supported version mismatch with early data",
           AlertDescription::protocol_version);
@@ -1019,7 +1195,8 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
       // should be ok.
       fallback.clientHello =
           PlaintextWriteRecordLayer()
-              .writeInitialClientHello(std::move(*chlo.originalEncoding))
+              .writeInitialClientHello(
+                  (*chlo.clientHello().originalEncoding)->clone())
               .data;
       return actions(&Transition<StateEnum::Error>, std::move(fallback));
     } else {
@@ -1032,7 +1209,8 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
 
   validateClientHello(chlo);
 
-  auto cipher = negotiateCipher(chlo, state.context()->getSupportedCiphers());
+  auto cipher = negotiateCipher(
+      chlo.clientHello(), state.context()->getSupportedCiphers());
 
   auto cookieState = getCookieState(
       chlo, *version, cipher, state.context()->getCookieCipher());
@@ -1077,7 +1255,7 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
           pskMode = folly::none;
         }
 
-        auto legacySessionId = chlo.legacy_session_id->clone();
+        auto legacySessionId = chlo.clientHello().legacy_session_id->clone();
 
         std::unique_ptr<KeyScheduler> scheduler;
         std::unique_ptr<HandshakeContext> handshakeContext;
@@ -1149,6 +1327,7 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
 
         Optional<NamedGroup> group;
         Optional<Buf> serverShare;
+        Future<Optional<Buf>> sharedSecret = folly::none;
         KeyExchangeType keyExchangeType;
         if (!pskMode || *pskMode != PskKeyExchangeMode::psk_ke) {
           Optional<Buf> clientShare;
@@ -1202,6 +1381,7 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
                 state.context()->getFactory()->makePlaintextReadRecordLayer();
             newReadRecordLayer->setSkipEncryptedRecords(
                 earlyDataType == EarlyDataType::Rejected);
+            newReadRecordLayer->setDeferClientHelloExtensions(true);
 
             return Future<Actions>(actions(
                 [handshakeContext = std::move(handshakeContext),
@@ -1236,16 +1416,19 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
             keyExchangeType = KeyExchangeType::OneRtt;
           }
 
-          serverShare = doKex(
-              *state.context()->getFactory(), *group, *clientShare, *scheduler);
+          std::tie(serverShare, sharedSecret) = doKex(
+              *state.context()->getFactory(),
+              *group,
+              *clientShare,
+              getSharedSecretBatcher(state));
         } else {
           keyExchangeType = KeyExchangeType::None;
-          scheduler->deriveHandshakeSecret();
         }
 
         std::vector<Extension> additionalExtensions;
         if (state.extensions()) {
-          additionalExtensions = state.extensions()->getExtensions(chlo);
+          additionalExtensions = state.extensions()->getExtensions(
+              chlo.clientHelloWithExtensions());
         }
 
         if (state.group().hasValue() && (!group || *group != *state.group())) {
@@ -1264,6 +1447,10 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
               AlertDescription::illegal_parameter);
         }
 
+        // The server's own messages in this flight are all encoded into one
+        // arena, each handed out as a view into it.
+        auto flightArena =
+            folly::IOBuf::create(HandshakeEncoder::kDefaultGrowth);
         auto encodedServerHello = getServerHello(
             version,
             state.context()->getFactory()->makeRandom(),
@@ -1272,46 +1459,19 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
             group,
             std::move(serverShare),
             legacySessionId ? legacySessionId->clone() : nullptr,
-            *handshakeContext);
-
-        // Derive handshake keys.
-        auto handshakeWriteRecordLayer =
-            state.context()->getFactory()->makeEncryptedWriteRecordLayer(
-                EncryptionLevel::Handshake);
-        handshakeWriteRecordLayer->setProtocolVersion(version);
-        auto handshakeWriteSecret = scheduler->getSecret(
-            HandshakeSecrets::ServerHandshakeTraffic,
-            handshakeContext->getHandshakeContext()->coalesce());
-        Protocol::setAead(
-            *handshakeWriteRecordLayer,
-            cipher,
-            folly::range(handshakeWriteSecret.secret),
-            *state.context()->getFactory(),
-            *scheduler);
-
-        auto handshakeReadRecordLayer =
-            state.context()->getFactory()->makeEncryptedReadRecordLayer(
-                EncryptionLevel::Handshake);
-        handshakeReadRecordLayer->setProtocolVersion(version);
-        handshakeReadRecordLayer->setSkipFailedDecryption(
-            earlyDataType == EarlyDataType::Rejected);
-        auto handshakeReadSecret = scheduler->getSecret(
-            HandshakeSecrets::ClientHandshakeTraffic,
-            handshakeContext->getHandshakeContext()->coalesce());
-        Protocol::setAead(
-            *handshakeReadRecordLayer,
-            cipher,
-            folly::range(handshakeReadSecret.secret),
-            *state.context()->getFactory(),
-            *scheduler);
-        auto clientHandshakeSecret =
-            folly::IOBuf::copyBuffer(folly::range(handshakeReadSecret.secret));
+            *handshakeContext,
+            *flightArena);
+
+        // The handshake keys are derived from the transcript up to the
+        // ServerHello once the shared secret is available.
+        auto serverHelloContext = handshakeContext->getHandshakeContext();
 
         auto encodedEncryptedExt = getEncryptedExt(
             *handshakeContext,
             alpn,
             earlyDataType,
-            std::move(additionalExtensions));
+            std::move(additionalExtensions),
+            *flightArena);
 
         /*
          * Determine we are requesting client auth.
@@ -1325,7 +1485,8 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
           encodedCertRequest = getCertificateRequest(
               state.context()->getSupportedSigSchemes(),
               state.context()->getClientCertVerifier().get(),
-              *handshakeContext);
+              *handshakeContext,
+              *flightArena);
         }
 
         /*
@@ -1367,25 +1528,22 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
           clientCert = std::move(resState->clientCert);
         }
 
-        return signature.via(state.executor())
+        using SignatureAndSecret =
+            std::tuple<folly::Try<Optional<Buf>>, folly::Try<Optional<Buf>>>;
+        return collectAll(signature, sharedSecret)
+            .via(state.executor())
             .thenValue([&state,
                         scheduler = std::move(scheduler),
                         handshakeContext = std::move(handshakeContext),
+                        serverHelloContext = std::move(serverHelloContext),
                         cipher,
                         group,
+                        flightArena = std::move(flightArena),
                         encodedServerHello = std::move(encodedServerHello),
-                        handshakeWriteRecordLayer =
-                            std::move(handshakeWriteRecordLayer),
-                        handshakeWriteSecret = std::move(handshakeWriteSecret),
-                        handshakeReadRecordLayer =
-                            std::move(handshakeReadRecordLayer),
-                        handshakeReadSecret = std::move(handshakeReadSecret),
                         earlyReadRecordLayer = std::move(earlyReadRecordLayer),
                         earlyReadSecretAvailable =
                             std::move(earlyReadSecretAvailable),
                         earlyExporterMaster = std::move(earlyExporterMaster),
-                        clientHandshakeSecret =
-                            std::move(clientHandshakeSecret),
                         encodedEncryptedExt = std::move(encodedEncryptedExt),
                         encodedCertificate = std::move(encodedCertificate),
                         encodedCertRequest = std::move(encodedCertRequest),
@@ -1402,16 +1560,59 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
                         alpn = std::move(alpn),
                         clockSkew,
                         legacySessionId = std::move(legacySessionId),
-                        serverCertCompAlgo =
-                            certCompressionAlgo](Optional<Buf> sig) mutable {
+                        serverCertCompAlgo = certCompressionAlgo](
+                           SignatureAndSecret result) mutable {
+              auto sig = std::move(std::get<0>(result).value());
+              auto& ecdhe = std::get<1>(result).value();
+              if (ecdhe) {
+                scheduler->deriveHandshakeSecret((*ecdhe)->coalesce());
+              } else {
+                scheduler->deriveHandshakeSecret();
+              }
+
+              // Derive handshake keys.
+              auto handshakeWriteRecordLayer =
+                  state.context()->getFactory()->makeEncryptedWriteRecordLayer(
+                      EncryptionLevel::Handshake);
+              handshakeWriteRecordLayer->setProtocolVersion(version);
+              auto handshakeWriteSecret = scheduler->getSecret(
+                  HandshakeSecrets::ServerHandshakeTraffic,
+                  serverHelloContext->coalesce());
+              Protocol::setAead(
+                  *handshakeWriteRecordLayer,
+                  cipher,
+                  folly::range(handshakeWriteSecret.secret),
+                  *state.context()->getFactory(),
+                  *scheduler);
+
+              auto handshakeReadRecordLayer =
+                  state.context()->getFactory()->makeEncryptedReadRecordLayer(
+                      EncryptionLevel::Handshake);
+              handshakeReadRecordLayer->setProtocolVersion(version);
+              handshakeReadRecordLayer->setSkipFailedDecryption(
+                  earlyDataType == EarlyDataType::Rejected);
+              auto handshakeReadSecret = scheduler->getSecret(
+                  HandshakeSecrets::ClientHandshakeTraffic,
+                  serverHelloContext->coalesce());
+              Protocol::setAead(
+                  *handshakeReadRecordLayer,
+                  cipher,
+                  folly::range(handshakeReadSecret.secret),
+                  *state.context()->getFactory(),
+                  *scheduler);
+              auto clientHandshakeSecret = folly::IOBuf::copyBuffer(
+                  folly::range(handshakeReadSecret.secret));
+
               Optional<Buf> encodedCertificateVerify;
               if (sig) {
                 encodedCertificateVerify = getCertificateVerify(
                     *sigScheme, std::move(*sig), *handshakeContext);
               }
 
-              auto encodedFinished = Protocol::getFinished(
-                  folly::range(handshakeWriteSecret.secret), *handshakeContext);
+              auto encodedFinished = getFinished(
+                  folly::range(handshakeWriteSecret.secret),
+                  *handshakeContext,
+                  *flightArena);
 
               folly::IOBufQueue combined;
               if (encodedCertificate) {
@@ -1681,13 +1882,14 @@ static WriteToSocket writeNewSessionTicket(
   nst.ticket_nonce = std::move(nonce);
   nst.ticket = std::move(ticket);
 
+  Optional<TicketEarlyData> early;
   if (context.getAcceptEarlyData(version)) {
-    TicketEarlyData early;
-    early.max_early_data_size = context.getMaxEarlyDataSize();
-    nst.extensions.push_back(encodeExtension(std::move(early)));
+    early.emplace();
+    early->max_early_data_size = context.getMaxEarlyDataSize();
   }
 
-  auto encodedNst = encodeHandshake(std::move(nst));
+  auto encodedNst = folly::IOBuf::create(HandshakeEncoder::kDefaultGrowth);
+  HandshakeEncoder(*encodedNst).encode(nst, early);
   WriteToSocket nstWrite;
   nstWrite.contents.emplace_back(
       recordLayer.writeHandshake(std::move(encodedNst)));
@@ -1811,7 +2013,7 @@ AsyncActions EventHandler<
   leafCert->verify(
       certVerify.algorithm,
       CertificateVerifyContext::Client,
-      state.handshakeContext()->getHandshakeContext()->coalesce(),
+      state.handshakeContext()->getHandshakeContextRange(),
       certVerify.signature->coalesce());
 
   try {
@@ -1872,7 +2074,7 @@ EventHandler<ServerTypes, StateEnum::ExpectingFinished, Event::Finished>::
       state.keyScheduler()
           ->getSecret(
               MasterSecrets::ResumptionMaster,
-              state.handshakeContext()->getHandshakeContext()->coalesce())
+              state.handshakeContext()->getHandshakeContextRange())
           .secret;
   state.keyScheduler()->clearMasterSecret();
 
@@ -1942,19 +2144,70 @@ EventHandler<ServerTypes, StateEnum::AcceptingData, Event::AppData>::handle(
   return actions(DeliverAppData{std::move(appData.data)});
 }
 
+static Actions writeAppDataInline(const State& state, AppWrite appWrite) {
+  WriteToSocket write;
+  write.callback = appWrite.callback;
+  write.contents.emplace_back(
+      state.writeRecordLayer()->writeAppData(std::move(appWrite.data)));
+  write.flags = appWrite.flags;
+  return actions(std::move(write));
+}
+
+/**
+ * Encrypts the write on the offload executor and hands the records back to the
+ * connection's executor. As with reads, nothing else uses the record layer
+ * until the returned actions complete, so sequence numbers stay in order.
+ * If the offload executor refuses the write, it is encrypted inline instead.
+ */
+static AsyncActions offloadAppWrite(
+    const State& state,
+    folly::Executor* executor,
+    AppWrite appWrite) {
+  // Kept here as well, so that the data can be recovered if the executor
+  // throws away the task.
+  auto pendingData = std::make_shared<Buf>(std::move(appWrite.data));
+  folly::Promise<TLSContent> promise;
+  auto future = promise.getFuture();
+  try {
+    executor->add([writeRecordLayer = state.writeRecordLayer(),
+                   pendingData,
+                   promise = std::move(promise)]() mutable {
+      promise.setWith([&]() {
+        return writeRecordLayer->writeAppData(std::move(*pendingData));
+      });
+    });
+  } catch (const std::exception& e) {
+    VLOG(8) << "Crypto offload executor rejected write: " << e.what();
+    appWrite.data = std::move(*pendingData);
+    return writeAppDataInline(state, std::move(appWrite));
+  }
+
+  return std::move(future)
+      .via(state.executor())
+      .thenValue([callback = appWrite.callback,
+                  flags = appWrite.flags](TLSContent content) {
+        WriteToSocket write;
+        write.callback = callback;
+        write.contents.emplace_back(std::move(content));
+        write.flags = flags;
+        return actions(std::move(write));
+      });
+}
+
 AsyncActions
 EventHandler<ServerTypes, StateEnum::AcceptingData, Event::AppWrite>::handle(
     const State& state,
     Param param) {
   auto& appWrite = boost::get<AppWrite>(param);
 
-  WriteToSocket write;
-  write.callback = appWrite.callback;
-  write.contents.emplace_back(
-      state.writeRecordLayer()->writeAppData(std::move(appWrite.data)));
-  write.flags = appWrite.flags;
+  auto offloadExecutor = state.context()->getCryptoOffloadExecutor();
+  if (offloadExecutor &&
+      appWrite.data->computeChainDataLength() >=
+          state.context()->getCryptoOffloadThreshold()) {
+    return offloadAppWrite(state, offloadExecutor, std::move(appWrite));
+  }
 
-  return actions(std::move(write));
+  return writeAppDataInline(state, std::move(appWrite));
 }
 
 AsyncActions
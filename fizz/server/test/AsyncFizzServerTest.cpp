@@ -11,6 +11,7 @@
 
 #include <fizz/server/AsyncFizzServer.h>
 
+#include <fizz/crypto/aead/test/Mocks.h>
 #include <fizz/extensions/tokenbinding/Types.h>
 #include <fizz/server/test/Mocks.h>
 #include <folly/io/async/test/MockAsyncTransport.h>
@@ -266,6 +267,110 @@ TEST_F(AsyncFizzServerTest, TestMutateState) {
   EXPECT_EQ(numTimesRun, 1);
 }
 
+TEST_F(AsyncFizzServerTest, TestDynamicRecordSizing) {
+  completeHandshake();
+  DynamicRecordSizing settings;
+  settings.initialRecordSize = 1000;
+  server_->setDynamicRecordSizing(settings);
+
+  MockAead* aead = nullptr;
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(InvokeWithoutArgs([&aead]() {
+        return actions(
+            [&aead](State& newState) {
+              auto writeAead = std::make_unique<MockAead>();
+              aead = writeAead.get();
+              auto writeRecordLayer =
+                  std::make_unique<EncryptedWriteRecordLayer>(
+                      EncryptionLevel::AppTraffic);
+              writeRecordLayer->setAead(
+                  folly::ByteRange(), std::move(writeAead));
+              newState.writeRecordLayer() = std::move(writeRecordLayer);
+            },
+            WaitForData());
+      }));
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("KeyUpdate"));
+  ASSERT_NE(aead, nullptr);
+
+  std::vector<size_t> lengths;
+  EXPECT_CALL(*aead, _encrypt(_, _, _))
+      .WillRepeatedly(
+          Invoke([&](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+            lengths.push_back(buf->computeChainDataLength());
+            return IOBuf::copyBuffer("ciphertext");
+          }));
+  auto data = IOBuf::create(2500);
+  data->append(2500);
+  server_->getState().writeRecordLayer()->writeAppData(std::move(data));
+  // one byte for footer
+  EXPECT_EQ(lengths, std::vector<size_t>({1001, 1001, 501}));
+}
+
+TEST_F(AsyncFizzServerTest, TestDynamicRecordSizingAcrossKeyUpdate) {
+  completeHandshake();
+  DynamicRecordSizing settings;
+  settings.initialRecordSize = 1000;
+  settings.rampUpBytes = 2000;
+  settings.idleTimeout = std::chrono::hours(1);
+  server_->setDynamicRecordSizing(settings);
+
+  std::vector<size_t> lengths;
+  auto keyUpdate = [&]() {
+    MockAead* aead = nullptr;
+    EXPECT_CALL(*machine_, _processSocketData(_, _))
+        .WillOnce(InvokeWithoutArgs([&aead]() {
+          return actions(
+              [&aead](State& newState) {
+                auto writeAead = std::make_unique<MockAead>();
+                aead = writeAead.get();
+                auto writeRecordLayer =
+                    std::make_unique<EncryptedWriteRecordLayer>(
+                        EncryptionLevel::AppTraffic);
+                writeRecordLayer->setAead(
+                    folly::ByteRange(), std::move(writeAead));
+                newState.writeRecordLayer() = std::move(writeRecordLayer);
+              },
+              WaitForData());
+        }));
+    socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("KeyUpdate"));
+    ASSERT_NE(aead, nullptr);
+    EXPECT_CALL(*aead, _encrypt(_, _, _))
+        .WillRepeatedly(
+            Invoke([&](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+              lengths.push_back(buf->computeChainDataLength());
+              return IOBuf::copyBuffer("ciphertext");
+            }));
+  };
+  auto write = [this](size_t length) {
+    auto data = IOBuf::create(length);
+    data->append(length);
+    server_->getState().writeRecordLayer()->writeAppData(std::move(data));
+  };
+
+  keyUpdate();
+  write(1500);
+  // one byte for footer
+  EXPECT_EQ(lengths, std::vector<size_t>({1001, 501}));
+
+  // The new layer is 1500 bytes into ramping up, not starting over.
+  lengths.clear();
+  keyUpdate();
+  write(2500);
+  EXPECT_EQ(lengths, std::vector<size_t>({1001, 1501}));
+}
+
+TEST_F(AsyncFizzServerTest, TestDestroyFailsCoalescedWrites) {
+  completeHandshake();
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb_));
+  server_->setWriteCoalescing(AsyncFizzBase::WriteCoalescing());
+
+  MockWriteCallback cb;
+  EXPECT_CALL(*machine_, _processAppWrite(_, _)).Times(0);
+  server_->writeChain(&cb, IOBuf::copyBuffer("aaa"));
+  EXPECT_CALL(cb, writeErr_(0, _));
+  server_.reset();
+}
+
 TEST_F(AsyncFizzServerTest, TestAttemptVersionFallback) {
   accept();
   EXPECT_CALL(*machine_, _processSocketData(_, _))
@@ -0,0 +1,171 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+
+#include <fizz/protocol/test/Mocks.h>
+#include <fizz/server/AsyncSigningSelfCert.h>
+#include <folly/executors/ManualExecutor.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+class AsyncSigningSelfCertTest : public Test {
+ public:
+  void SetUp() override {
+    cert_ = std::make_shared<MockSelfCert>();
+    executor_ = std::make_shared<ManualExecutor>();
+  }
+
+ protected:
+  std::unique_ptr<AsyncSigningSelfCert> makeCert(
+      AsyncSigningSelfCert::Options options = {}) {
+    return std::make_unique<AsyncSigningSelfCert>(cert_, executor_, options);
+  }
+
+  void expectSign(SignatureScheme scheme, std::string toBeSigned) {
+    EXPECT_CALL(*cert_, sign(scheme, CertificateVerifyContext::Server, _))
+        .WillOnce(Invoke([toBeSigned](
+                             SignatureScheme,
+                             CertificateVerifyContext,
+                             ByteRange tbs) {
+          EXPECT_EQ(StringPiece(tbs), toBeSigned);
+          return IOBuf::copyBuffer("signature");
+        }));
+  }
+
+  std::shared_ptr<MockSelfCert> cert_;
+  std::shared_ptr<ManualExecutor> executor_;
+};
+
+TEST_F(AsyncSigningSelfCertTest, TestSignOnExecutor) {
+  auto cert = makeCert();
+  Future<Optional<Buf>> signature = makeFuture<Optional<Buf>>(none);
+  {
+    // toBeSigned only needs to live through the call.
+    std::string toBeSigned("tbs");
+    signature = cert->signFuture(
+        SignatureScheme::rsa_pss_sha256,
+        CertificateVerifyContext::Server,
+        StringPiece(toBeSigned));
+    toBeSigned = "xxx";
+  }
+  EXPECT_FALSE(signature.isReady());
+  EXPECT_EQ(cert->getQueueDepth(), 1);
+
+  expectSign(SignatureScheme::rsa_pss_sha256, "tbs");
+  executor_->run();
+  ASSERT_TRUE(signature.isReady());
+  EXPECT_TRUE(IOBufEqualTo()(
+      *std::move(signature).get(), IOBuf::copyBuffer("signature")));
+  EXPECT_EQ(cert->getQueueDepth(), 0);
+
+  auto stats = cert->getStats();
+  EXPECT_EQ(stats[SignatureScheme::rsa_pss_sha256].signatures, 1);
+  EXPECT_EQ(stats[SignatureScheme::rsa_pss_sha256].failures, 0);
+}
+
+TEST_F(AsyncSigningSelfCertTest, TestSignFailure) {
+  auto cert = makeCert();
+  auto signature = cert->signFuture(
+      SignatureScheme::ecdsa_secp256r1_sha256,
+      CertificateVerifyContext::Server,
+      StringPiece("tbs"));
+  EXPECT_CALL(*cert_, sign(_, _, _))
+      .WillOnce(Throw(std::runtime_error("no key")));
+  executor_->run();
+  EXPECT_THROW(std::move(signature).get(), std::runtime_error);
+  EXPECT_EQ(
+      cert->getStats()[SignatureScheme::ecdsa_secp256r1_sha256].failures, 1);
+}
+
+TEST_F(AsyncSigningSelfCertTest, TestQueueFullSignInline) {
+  AsyncSigningSelfCert::Options options;
+  options.maxQueueDepth = 1;
+  auto cert = makeCert(options);
+  auto queued = cert->signFuture(
+      SignatureScheme::rsa_pss_sha256,
+      CertificateVerifyContext::Server,
+      StringPiece("queued"));
+
+  expectSign(SignatureScheme::rsa_pss_sha256, "inline");
+  auto inlined = cert->signFuture(
+      SignatureScheme::rsa_pss_sha256,
+      CertificateVerifyContext::Server,
+      StringPiece("inline"));
+  EXPECT_TRUE(inlined.isReady());
+  EXPECT_FALSE(queued.isReady());
+  EXPECT_EQ(cert->getStats()[SignatureScheme::rsa_pss_sha256].rejected, 1);
+
+  expectSign(SignatureScheme::rsa_pss_sha256, "queued");
+  executor_->run();
+  EXPECT_TRUE(queued.isReady());
+}
+
+TEST_F(AsyncSigningSelfCertTest, TestQueueFullFail) {
+  AsyncSigningSelfCert::Options options;
+  options.maxQueueDepth = 1;
+  options.rejectionPolicy = AsyncSigningSelfCert::RejectionPolicy::Fail;
+  auto cert = makeCert(options);
+  auto queued = cert->signFuture(
+      SignatureScheme::rsa_pss_sha256,
+      CertificateVerifyContext::Server,
+      StringPiece("queued"));
+  auto rejected = cert->signFuture(
+      SignatureScheme::rsa_pss_sha256,
+      CertificateVerifyContext::Server,
+      StringPiece("rejected"));
+  EXPECT_THROW(std::move(rejected).get(), std::runtime_error);
+
+  // There is room again once the queued signature ran.
+  expectSign(SignatureScheme::rsa_pss_sha256, "queued");
+  executor_->run();
+  expectSign(SignatureScheme::rsa_pss_sha256, "next");
+  auto next = cert->signFuture(
+      SignatureScheme::rsa_pss_sha256,
+      CertificateVerifyContext::Server,
+      StringPiece("next"));
+  executor_->run();
+  EXPECT_TRUE(next.isReady());
+}
+
+TEST_F(AsyncSigningSelfCertTest, TestOutlivesWrapper) {
+  auto cert = makeCert();
+  auto signature = cert->signFuture(
+      SignatureScheme::rsa_pss_sha256,
+      CertificateVerifyContext::Server,
+      StringPiece("tbs"));
+  cert.reset();
+  expectSign(SignatureScheme::rsa_pss_sha256, "tbs");
+  executor_->run();
+  EXPECT_TRUE(signature.isReady());
+}
+
+TEST_F(AsyncSigningSelfCertTest, TestForwarding) {
+  auto cert = makeCert();
+  EXPECT_CALL(*cert_, getIdentity()).WillOnce(Return("id"));
+  EXPECT_EQ(cert->getIdentity(), "id");
+  EXPECT_CALL(*cert_, getSigSchemes())
+      .WillOnce(Return(
+          std::vector<SignatureScheme>{SignatureScheme::rsa_pss_sha256}));
+  EXPECT_EQ(cert->getSigSchemes().size(), 1);
+
+  // The synchronous sign() still signs in place.
+  expectSign(SignatureScheme::rsa_pss_sha256, "sync");
+  cert->sign(
+      SignatureScheme::rsa_pss_sha256,
+      CertificateVerifyContext::Server,
+      StringPiece("sync"));
+  EXPECT_EQ(executor_->run(), 0);
+}
+} // namespace test
+} // namespace fizz
@@ -4260,6 +4260,226 @@ TEST_F(ServerProtocolTest, TestAppWrite) {
   EXPECT_EQ(write.contents[0].contentType, ContentType::application_data);
 }
 
+TEST_F(ServerProtocolTest, TestAppWriteOffload) {
+  setUpAcceptingData();
+  auto offload = std::make_shared<ManualExecutor>();
+  context_->setCryptoOffload(offload, 7);
+  EXPECT_CALL(*appWrite_, _write(_)).WillOnce(Invoke([&](TLSMessage& msg) {
+    TLSContent content;
+    content.contentType = msg.type;
+    content.encryptionLevel = appWrite_->getEncryptionLevel();
+    EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("appdata")));
+    content.data = IOBuf::copyBuffer("writtenappdata");
+    return content;
+  }));
+
+  auto asyncActions = detail::processEvent(state_, TestMessages::appWrite());
+  auto futureActions = boost::get<folly::Future<Actions>>(&asyncActions);
+  ASSERT_NE(futureActions, nullptr);
+  while (executor_.run())
+    ;
+  EXPECT_FALSE(futureActions->isReady());
+  offload->run();
+  auto actions = getActions(std::move(asyncActions));
+
+  auto write = expectSingleAction<WriteToSocket>(std::move(actions));
+  EXPECT_TRUE(IOBufEqualTo()(
+      write.contents[0].data, IOBuf::copyBuffer("writtenappdata")));
+  EXPECT_EQ(write.contents[0].encryptionLevel, EncryptionLevel::AppTraffic);
+}
+
+TEST_F(ServerProtocolTest, TestAppWriteBelowOffloadThreshold) {
+  setUpAcceptingData();
+  auto offload = std::make_shared<ManualExecutor>();
+  context_->setCryptoOffload(offload, 8);
+  EXPECT_CALL(*appWrite_, _write(_));
+
+  auto asyncActions = detail::processEvent(state_, TestMessages::appWrite());
+  EXPECT_NE(boost::get<Actions>(&asyncActions), nullptr);
+  EXPECT_EQ(offload->run(), 0);
+  expectSingleAction<WriteToSocket>(getActions(std::move(asyncActions)));
+}
+
+TEST_F(ServerProtocolTest, TestAppWriteOffloadRejected) {
+  class RejectingExecutor : public folly::Executor {
+   public:
+    void add(folly::Func) override {
+      throw std::runtime_error("queue full");
+    }
+  };
+  setUpAcceptingData();
+  context_->setCryptoOffload(std::make_shared<RejectingExecutor>(), 7);
+  EXPECT_CALL(*appWrite_, _write(_)).WillOnce(Invoke([&](TLSMessage& msg) {
+    TLSContent content;
+    content.contentType = msg.type;
+    content.encryptionLevel = appWrite_->getEncryptionLevel();
+    EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("appdata")));
+    content.data = IOBuf::copyBuffer("writtenappdata");
+    return content;
+  }));
+
+  auto asyncActions = detail::processEvent(state_, TestMessages::appWrite());
+  ASSERT_NE(boost::get<Actions>(&asyncActions), nullptr);
+  auto write =
+      expectSingleAction<WriteToSocket>(getActions(std::move(asyncActions)));
+  EXPECT_TRUE(IOBufEqualTo()(
+      write.contents[0].data, IOBuf::copyBuffer("writtenappdata")));
+}
+
+TEST_F(ServerProtocolTest, TestSocketDataError) {
+  setUpAcceptingData();
+  EXPECT_CALL(*appRead_, read(_))
+      .WillOnce(Invoke([](IOBufQueue&) -> Optional<TLSMessage> {
+        throw std::runtime_error("bad record");
+      }));
+
+  IOBufQueue queue{IOBufQueue::cacheChainLength()};
+  queue.append(IOBuf::copyBuffer("data"));
+  auto actions =
+      getActions(ServerStateMachine().processSocketData(state_, queue));
+  expectError<std::runtime_error>(
+      actions, AlertDescription::decode_error, "bad record");
+}
+
+TEST_F(ServerProtocolTest, TestSocketDataErrorAlert) {
+  setUpAcceptingData();
+  EXPECT_CALL(*appRead_, read(_))
+      .WillOnce(Invoke([](IOBufQueue&) -> Optional<TLSMessage> {
+        throw FizzException("bad mac", AlertDescription::bad_record_mac);
+      }));
+
+  IOBufQueue queue{IOBufQueue::cacheChainLength()};
+  queue.append(IOBuf::copyBuffer("data"));
+  auto actions =
+      getActions(ServerStateMachine().processSocketData(state_, queue));
+  expectError<FizzException>(
+      actions, AlertDescription::bad_record_mac, "bad mac");
+}
+
+TEST_F(ServerProtocolTest, TestSocketDataOffload) {
+  setUpAcceptingData();
+  auto offload = std::make_shared<ManualExecutor>();
+  context_->setCryptoOffload(offload, 10);
+  EXPECT_CALL(*appRead_, read(_)).WillOnce(Invoke([](IOBufQueue& buf) {
+    EXPECT_EQ(buf.chainLength(), 15);
+    buf.move();
+    return TLSMessage{ContentType::application_data,
+                      IOBuf::copyBuffer("appdata")};
+  }));
+
+  IOBufQueue queue{IOBufQueue::cacheChainLength()};
+  queue.append(IOBuf::copyBuffer(unhexlify("170303000a")));
+  queue.append(IOBuf::copyBuffer("0123456789next"));
+  auto asyncActions = ServerStateMachine().processSocketData(state_, queue);
+  EXPECT_EQ(queue.chainLength(), 4);
+  EXPECT_EQ(offload->run(), 1);
+  auto actions = getActions(std::move(asyncActions));
+
+  auto appData = expectSingleAction<DeliverAppData>(std::move(actions));
+  EXPECT_TRUE(IOBufEqualTo()(appData.data, IOBuf::copyBuffer("appdata")));
+  EXPECT_TRUE(IOBufEqualTo()(queue.move(), IOBuf::copyBuffer("next")));
+}
+
+TEST_F(ServerProtocolTest, TestSocketDataOffloadIncomplete) {
+  setUpAcceptingData();
+  auto offload = std::make_shared<ManualExecutor>();
+  context_->setCryptoOffload(offload, 10);
+  EXPECT_CALL(*appRead_, read(_)).WillOnce(Return(none));
+
+  IOBufQueue queue{IOBufQueue::cacheChainLength()};
+  queue.append(IOBuf::copyBuffer(unhexlify("170303000a")));
+  queue.append(IOBuf::copyBuffer("012345678"));
+  auto actions = getActions(
+      ServerStateMachine().processSocketData(state_, queue));
+  EXPECT_EQ(offload->run(), 0);
+  expectSingleAction<WaitForData>(std::move(actions));
+  EXPECT_EQ(queue.chainLength(), 14);
+}
+
+TEST_F(ServerProtocolTest, TestSocketDataOffloadError) {
+  setUpAcceptingData();
+  auto offload = std::make_shared<ManualExecutor>();
+  context_->setCryptoOffload(offload, 10);
+  EXPECT_CALL(*appRead_, read(_))
+      .WillOnce(Invoke([](IOBufQueue&) -> Optional<TLSMessage> {
+        throw std::runtime_error("bad record");
+      }));
+
+  IOBufQueue queue{IOBufQueue::cacheChainLength()};
+  queue.append(IOBuf::copyBuffer(unhexlify("170303000a")));
+  queue.append(IOBuf::copyBuffer("0123456789"));
+  auto asyncActions = ServerStateMachine().processSocketData(state_, queue);
+  offload->run();
+  auto actions = getActions(std::move(asyncActions));
+  expectError<std::runtime_error>(
+      actions, AlertDescription::decode_error, "bad record");
+}
+
+TEST_F(ServerProtocolTest, TestSocketDataOffloadNoMessage) {
+  setUpAcceptingData();
+  auto offload = std::make_shared<ManualExecutor>();
+  context_->setCryptoOffload(offload, 10);
+  EXPECT_CALL(*appRead_, read(_)).WillOnce(Invoke([](IOBufQueue& buf) {
+    // e.g. a handshake fragment.
+    buf.move();
+    return none;
+  }));
+
+  IOBufQueue queue{IOBufQueue::cacheChainLength()};
+  queue.append(IOBuf::copyBuffer(unhexlify("170303000a")));
+  queue.append(IOBuf::copyBuffer("0123456789"));
+  auto asyncActions = ServerStateMachine().processSocketData(state_, queue);
+  EXPECT_EQ(offload->run(), 1);
+  // No WaitForData, so that data that arrived meanwhile is still processed.
+  EXPECT_TRUE(getActions(std::move(asyncActions)).empty());
+}
+
+TEST_F(ServerProtocolTest, TestSocketDataOffloadRejected) {
+  class RejectingExecutor : public folly::Executor {
+   public:
+    void add(folly::Func) override {
+      throw std::runtime_error("queue full");
+    }
+  };
+  setUpAcceptingData();
+  context_->setCryptoOffload(std::make_shared<RejectingExecutor>(), 10);
+  EXPECT_CALL(*appRead_, read(_)).WillOnce(Invoke([](IOBufQueue& buf) {
+    EXPECT_EQ(buf.chainLength(), 19);
+    buf.split(15);
+    return TLSMessage{ContentType::application_data,
+                      IOBuf::copyBuffer("appdata")};
+  }));
+
+  IOBufQueue queue{IOBufQueue::cacheChainLength()};
+  queue.append(IOBuf::copyBuffer(unhexlify("170303000a")));
+  queue.append(IOBuf::copyBuffer("0123456789next"));
+  auto asyncActions = ServerStateMachine().processSocketData(state_, queue);
+  ASSERT_NE(boost::get<Actions>(&asyncActions), nullptr);
+  auto appData = expectSingleAction<DeliverAppData>(
+      getActions(std::move(asyncActions)));
+  EXPECT_TRUE(IOBufEqualTo()(appData.data, IOBuf::copyBuffer("appdata")));
+  EXPECT_TRUE(IOBufEqualTo()(queue.move(), IOBuf::copyBuffer("next")));
+}
+
+TEST_F(ServerProtocolTest, TestSocketDataOffloadErrorAlert) {
+  setUpAcceptingData();
+  auto offload = std::make_shared<ManualExecutor>();
+  context_->setCryptoOffload(offload, 10);
+  EXPECT_CALL(*appRead_, read(_))
+      .WillOnce(Invoke([](IOBufQueue&) -> Optional<TLSMessage> {
+        throw FizzException("bad mac", AlertDescription::bad_record_mac);
+      }));
+
+  IOBufQueue queue{IOBufQueue::cacheChainLength()};
+  queue.append(IOBuf::copyBuffer(unhexlify("170303000a")));
+  queue.append(IOBuf::copyBuffer("0123456789"));
+  auto asyncActions = ServerStateMachine().processSocketData(state_, queue);
+  offload->run();
+  auto actions = getActions(std::move(asyncActions));
+  expectError<FizzException>(
+      actions, AlertDescription::bad_record_mac, "bad mac");
+}
+
 TEST_F(ServerProtocolTest, TestKeyUpdateNotRequested) {
   setUpAcceptingData();
   auto actions =
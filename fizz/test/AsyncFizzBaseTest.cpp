@@ -11,6 +11,8 @@
 
 #include <fizz/protocol/AsyncFizzBase.h>
 
+#include <folly/FileUtil.h>
+#include <folly/experimental/TestUtil.h>
 #include <folly/io/async/test/MockAsyncTransport.h>
 #include <folly/io/async/test/MockTimeoutManager.h>
 
@@ -489,6 +491,233 @@ TEST_F(AsyncFizzBaseTest, TestWriteError) {
   writeCallback->writeErr(0, ase_);
 }
 
+TEST_F(AsyncFizzBaseTest, TestWriteCoalescing) {
+  EventBase evb;
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb));
+  EXPECT_CALL(*socket_, attachEventBase(&evb));
+  attachEventBase(&evb);
+  setWriteCoalescing(WriteCoalescing());
+
+  MockWriteCallback cb1;
+  MockWriteCallback cb2;
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  writeChain(&cb1, IOBuf::copyBuffer("aaa"));
+  writeChain(nullptr, IOBuf::copyBuffer("bbb"));
+  writeChain(&cb2, IOBuf::copyBuffer("ccc"));
+  EXPECT_EQ(getAppBytesWritten(), 9);
+  Mock::VerifyAndClearExpectations(this);
+
+  AsyncTransportWrapper::WriteCallback* callback;
+  auto expected = IOBuf::copyBuffer("aaabbbccc");
+  EXPECT_CALL(
+      *this,
+      writeAppDataInternal(_, BufMatches(expected.get()), WriteFlags::NONE))
+      .WillOnce(SaveArg<0>(&callback));
+  evb.loopOnce();
+
+  EXPECT_CALL(cb1, writeSuccess_());
+  EXPECT_CALL(cb2, writeSuccess_());
+  callback->writeSuccess();
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteCoalescingSingleCallback) {
+  EventBase evb;
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb));
+  EXPECT_CALL(*socket_, attachEventBase(&evb));
+  attachEventBase(&evb);
+  setWriteCoalescing(WriteCoalescing());
+
+  MockWriteCallback cb;
+  writeChain(nullptr, IOBuf::copyBuffer("aaa"));
+  writeChain(&cb, IOBuf::copyBuffer("bbb"));
+  EXPECT_CALL(*this, writeAppDataInternal(&cb, _, _));
+  evb.loopOnce();
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteCoalescingMaxBufferedBytes) {
+  EventBase evb;
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb));
+  EXPECT_CALL(*socket_, attachEventBase(&evb));
+  attachEventBase(&evb);
+  WriteCoalescing settings;
+  settings.maxBufferedBytes = 6;
+  setWriteCoalescing(settings);
+
+  writeChain(nullptr, IOBuf::copyBuffer("aaa"));
+  auto expected = IOBuf::copyBuffer("aaabbb");
+  EXPECT_CALL(*this, writeAppDataInternal(_, BufMatches(expected.get()), _));
+  writeChain(nullptr, IOBuf::copyBuffer("bbb"));
+  Mock::VerifyAndClearExpectations(this);
+
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  evb.loopOnce();
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteCoalescingEOR) {
+  EventBase evb;
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb));
+  EXPECT_CALL(*socket_, attachEventBase(&evb));
+  attachEventBase(&evb);
+  setWriteCoalescing(WriteCoalescing());
+
+  writeChain(nullptr, IOBuf::copyBuffer("aaa"));
+  auto expected = IOBuf::copyBuffer("aaabbb");
+  EXPECT_CALL(
+      *this,
+      writeAppDataInternal(_, BufMatches(expected.get()), WriteFlags::EOR));
+  writeChain(nullptr, IOBuf::copyBuffer("bbb"), WriteFlags::EOR);
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteCoalescingCork) {
+  EventBase evb;
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb));
+  EXPECT_CALL(*socket_, attachEventBase(&evb));
+  attachEventBase(&evb);
+  WriteCoalescing settings;
+  settings.flushTimeout = std::chrono::milliseconds(1);
+  setWriteCoalescing(settings);
+
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  writeChain(nullptr, IOBuf::copyBuffer("aaa"), WriteFlags::CORK);
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  Mock::VerifyAndClearExpectations(this);
+
+  auto expected = IOBuf::copyBuffer("aaa");
+  EXPECT_CALL(
+      *this,
+      writeAppDataInternal(_, BufMatches(expected.get()), WriteFlags::NONE));
+  evb.loop();
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteCoalescingCorkSequence) {
+  EventBase evb;
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb));
+  EXPECT_CALL(*socket_, attachEventBase(&evb));
+  attachEventBase(&evb);
+  setWriteCoalescing(WriteCoalescing());
+
+  MockWriteCallback cb1;
+  MockWriteCallback cb2;
+  MockWriteCallback cb3;
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  writeChain(&cb1, IOBuf::copyBuffer("aaa"), WriteFlags::CORK);
+  writeChain(&cb2, IOBuf::copyBuffer("bbb"), WriteFlags::CORK);
+  writeChain(&cb3, IOBuf::copyBuffer("ccc"));
+  Mock::VerifyAndClearExpectations(this);
+
+  // The batch takes the CORK bit of its last write.
+  auto expected = IOBuf::copyBuffer("aaabbbccc");
+  EXPECT_CALL(
+      *this,
+      writeAppDataInternal(_, BufMatches(expected.get()), WriteFlags::NONE));
+  evb.loopOnce();
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteCoalescingDifferentFlags) {
+  EventBase evb;
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb));
+  EXPECT_CALL(*socket_, attachEventBase(&evb));
+  attachEventBase(&evb);
+  setWriteCoalescing(WriteCoalescing());
+
+  MockWriteCallback cb1;
+  MockWriteCallback cb2;
+  writeChain(&cb1, IOBuf::copyBuffer("aaa"));
+  auto expected = IOBuf::copyBuffer("aaa");
+  EXPECT_CALL(
+      *this,
+      writeAppDataInternal(&cb1, BufMatches(expected.get()), WriteFlags::NONE));
+  writeChain(&cb2, IOBuf::copyBuffer("bbb"), WriteFlags::WRITE_SHUTDOWN);
+  Mock::VerifyAndClearExpectations(this);
+
+  expected = IOBuf::copyBuffer("bbb");
+  EXPECT_CALL(
+      *this,
+      writeAppDataInternal(
+          &cb2, BufMatches(expected.get()), WriteFlags::WRITE_SHUTDOWN));
+  evb.loopOnce();
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteCoalescingNoEventBase) {
+  setWriteCoalescing(WriteCoalescing());
+
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, WriteFlags::CORK));
+  writeChain(nullptr, IOBuf::copyBuffer("aaa"), WriteFlags::CORK);
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteCoalescingFlush) {
+  EventBase evb;
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb));
+  EXPECT_CALL(*socket_, attachEventBase(&evb));
+  attachEventBase(&evb);
+  setWriteCoalescing(WriteCoalescing());
+
+  writeChain(nullptr, IOBuf::copyBuffer("aaa"));
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _));
+  flushCoalescedWrites();
+  Mock::VerifyAndClearExpectations(this);
+
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  flushCoalescedWrites();
+  evb.loopOnce();
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteCoalescingFail) {
+  EventBase evb;
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb));
+  EXPECT_CALL(*socket_, attachEventBase(&evb));
+  attachEventBase(&evb);
+  setWriteCoalescing(WriteCoalescing());
+
+  MockWriteCallback cb1;
+  MockWriteCallback cb2;
+  writeChain(&cb1, IOBuf::copyBuffer("aaa"));
+  writeChain(&cb2, IOBuf::copyBuffer("bbb"));
+
+  EXPECT_CALL(cb1, writeErr_(0, _));
+  EXPECT_CALL(cb2, writeErr_(0, _));
+  failCoalescedWrites(ase_);
+
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  evb.loopOnce();
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteFile) {
+  folly::test::TemporaryFile file("fizz");
+  std::string contents(10000, 'a');
+  contents.replace(5000, 5, "hello");
+  ASSERT_EQ(
+      folly::writeFull(file.fd(), contents.data(), contents.size()),
+      (ssize_t)contents.size());
+
+  MockWriteCallback cb;
+  auto expected = IOBuf::copyBuffer("hello");
+  EXPECT_CALL(
+      *this,
+      writeAppDataInternal(&cb, BufMatches(expected.get()), WriteFlags::NONE));
+  writeFile(&cb, file.fd(), 5000, 5);
+}
+
+TEST_F(AsyncFizzBaseTest, TestWriteFilePastEOF) {
+  folly::test::TemporaryFile file("fizz");
+  std::string contents(10, 'a');
+  ASSERT_EQ(
+      folly::writeFull(file.fd(), contents.data(), contents.size()),
+      (ssize_t)contents.size());
+
+  MockWriteCallback cb;
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  EXPECT_CALL(cb, writeErr_(0, _))
+      .Times(2)
+      .WillRepeatedly(Invoke([](size_t, const AsyncSocketException& ex) {
+        EXPECT_EQ(ex.getType(), AsyncSocketException::BAD_ARGS);
+      }));
+  // Mapping past the end of the file would raise SIGBUS once the page past
+  // the end is touched.
+  writeFile(&cb, file.fd(), 5, 10000);
+  writeFile(&cb, file.fd(), 20, 1);
+}
+
 TEST_F(AsyncFizzBaseTest, TestHandshakeTimeout) {
   MockTimeoutManager manager;
   ON_CALL(manager, isInTimeoutManagerThread()).WillByDefault(Return(true));
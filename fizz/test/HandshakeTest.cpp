@@ -581,6 +581,55 @@ TEST_F(HandshakeTest, PskKe) {
   sendAppData();
 }
 
+TEST_F(HandshakeTest, BatchedSharedSecretP256) {
+  clientContext_->setSupportedGroups({NamedGroup::secp256r1});
+  clientContext_->setDefaultShares({NamedGroup::secp256r1});
+  serverContext_->setSupportedGroups({NamedGroup::secp256r1});
+  serverContext_->setBatchSharedSecrets(true);
+  expected_.group = NamedGroup::secp256r1;
+
+  expectSuccess();
+  doHandshake();
+  verifyParameters();
+  sendAppData();
+}
+
+TEST_F(HandshakeTest, BatchedSharedSecretX25519) {
+  serverContext_->setBatchSharedSecrets(true);
+
+  expectSuccess();
+  doHandshake();
+  verifyParameters();
+  sendAppData();
+}
+
+TEST_F(HandshakeTest, BatchedSharedSecretHrr) {
+  clientContext_->setDefaultShares({});
+  serverContext_->setBatchSharedSecrets(true);
+  expected_.clientKexType = expected_.serverKexType =
+      KeyExchangeType::HelloRetryRequest;
+
+  expectSuccess();
+  doHandshake();
+  verifyParameters();
+  sendAppData();
+}
+
+TEST_F(HandshakeTest, BatchedSharedSecretPskKe) {
+  serverContext_->setSupportedPskModes({PskKeyExchangeMode::psk_ke});
+  serverContext_->setBatchSharedSecrets(true);
+  setupResume();
+
+  expected_.group = none;
+  expected_.pskMode = PskKeyExchangeMode::psk_ke;
+  expected_.clientKexType = expected_.serverKexType = KeyExchangeType::None;
+
+  expectSuccess();
+  doHandshake();
+  verifyParameters();
+  sendAppData();
+}
+
 // This test is only run with 1.1.0 as it requires chacha to run (chacha and
 // aes-gcm-128 are the only ciphers with a compatible hash algorithm).
 #if FOLLY_OPENSSL_IS_110